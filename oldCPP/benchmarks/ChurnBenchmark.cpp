@@ -0,0 +1,270 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+// Publisher churn against StreamManager: every worker plays an encoder that connects, streams a few
+// packets, drops and reconnects under the same stream ID, with a few subscribers attached each time.
+// Handlers are in memory, so what is measured is the session lifecycle itself: session and thread
+// start, the disconnect event, removePublishingStream and teardown.
+//
+// Usage: dl_srt_server_churn_benchmark [--cycles N] [--concurrency N] [--subscribers N] [--packets N]
+//            [--min-cycles-per-second X] [--max-p99-ms X] [--max-threads N] [--max-rss-mb N]
+// Exits with failure if any result is past its threshold; a threshold of 0 disables the check.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/StreamManager.h"
+#include "utils/Logger.h"
+
+namespace {
+    struct Options {
+        int cycles = 5000;
+        int concurrency = 32;
+        int subscribers = 2;
+        int packets = 10;
+        double minCyclesPerSecond = 100.0;
+        double maxP99Ms = 500.0;
+        int64_t maxThreads = 512;
+        int64_t maxRssMb = 512;
+    };
+
+    // Publisher side plays packets then fails, like an encoder that drops; subscribers just count
+    class ChurnHandler : public StreamHandler {
+    public:
+        ChurnHandler(std::string streamId, int packets)
+            : m_streamId(std::move(streamId)), m_packetsLeft(packets) {
+        }
+
+        bool disconnect() override {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_disconnected = true;
+            m_disconnectedCV.notify_all();
+            return true;
+        }
+
+        int receive(char *buffer, int len, MessageControl &) override {
+            if (m_packetsLeft-- <= 0) {
+                return STREAM_ERROR;
+            }
+            std::memset(buffer, 0x47, std::min(len, 188));
+            return std::min(len, 188);
+        }
+
+        int send(const char *, int len, const MessageControl &) override { return len; }
+
+        bool isConnected() const override { return true; }
+        std::string getStreamId() const override { return m_streamId; }
+        const StreamIdParams &getStreamParams() const override { return m_params; }
+        void setBandwidthHints(int64_t, int) override {}
+        std::string getLastErrorMessage() const override { return "end of stream"; }
+        int getLastErrorCode() const override { return 0; }
+        std::string getPeerAddress() const override { return "memory"; }
+        bool getLinkStats(LinkStats &) const override { return false; }
+
+        void waitForDisconnect() {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_disconnectedCV.wait(lock, [this] { return m_disconnected; });
+        }
+
+    private:
+        std::string m_streamId;
+        StreamIdParams m_params;
+        int m_packetsLeft;
+
+        std::mutex m_mutex;
+        std::condition_variable m_disconnectedCV;
+        bool m_disconnected = false;
+    };
+
+    // Current thread count and peak resident set, 0 where the platform doesn't tell
+    void readProcessStatus(int64_t &threads, int64_t &peakRssKb) {
+        threads = 0;
+        peakRssKb = 0;
+#ifdef __linux__
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line)) {
+            if (line.rfind("Threads:", 0) == 0) {
+                threads = std::atoll(line.c_str() + 8);
+            } else if (line.rfind("VmHWM:", 0) == 0) {
+                peakRssKb = std::atoll(line.c_str() + 6);
+            }
+        }
+#endif
+    }
+
+    bool parseOptions(int argc, char *argv[], Options &options) {
+        for (int i = 1; i + 1 < argc; i += 2) {
+            std::string name = argv[i];
+            const char *value = argv[i + 1];
+            if (name == "--cycles") {
+                options.cycles = std::atoi(value);
+            } else if (name == "--concurrency") {
+                options.concurrency = std::max(std::atoi(value), 1);
+            } else if (name == "--subscribers") {
+                options.subscribers = std::atoi(value);
+            } else if (name == "--packets") {
+                options.packets = std::atoi(value);
+            } else if (name == "--min-cycles-per-second") {
+                options.minCyclesPerSecond = std::atof(value);
+            } else if (name == "--max-p99-ms") {
+                options.maxP99Ms = std::atof(value);
+            } else if (name == "--max-threads") {
+                options.maxThreads = std::atoll(value);
+            } else if (name == "--max-rss-mb") {
+                options.maxRssMb = std::atoll(value);
+            } else {
+                std::fprintf(stderr, "unknown option %s\n", name.c_str());
+                return false;
+            }
+        }
+        return argc % 2 == 1;
+    }
+
+    double percentile(const std::vector<int64_t> &sorted, double fraction) {
+        if (sorted.empty()) {
+            return 0.0;
+        }
+        size_t index = std::min(sorted.size() - 1, static_cast<size_t>(fraction * sorted.size()));
+        return static_cast<double>(sorted[index]) / 1000.0;
+    }
+
+    bool check(const char *name, bool enabled, bool passed) {
+        if (enabled && !passed) {
+            std::printf("REGRESSION: %s past threshold\n", name);
+            return false;
+        }
+        return true;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        return EXIT_FAILURE;
+    }
+
+    LogSettings logSettings;
+    logSettings.minLevel = LogLevel::Error;
+    Logger::instance().configure(logSettings);
+
+    auto streamManager = std::make_shared<StreamManager>();
+
+    std::atomic<int> nextCycle{0};
+    std::atomic<int64_t> rejectedConnects{0};
+    std::mutex latenciesMutex;
+    std::vector<int64_t> latenciesMicros;
+    latenciesMicros.reserve(options.cycles);
+
+    std::atomic<bool> sampling{true};
+    std::atomic<int64_t> peakThreads{0};
+    std::thread sampler([&] {
+        while (sampling.load()) {
+            int64_t threads;
+            int64_t peakRssKb;
+            readProcessStatus(threads, peakRssKb);
+            peakThreads = std::max(peakThreads.load(), threads);
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> encoders;
+    for (int worker = 0; worker < options.concurrency; ++worker) {
+        encoders.emplace_back([&, worker] {
+            const std::string streamId = "churn-" + std::to_string(worker);
+            std::vector<int64_t> latencies;
+            while (nextCycle.fetch_add(1) < options.cycles) {
+                auto publisher = std::make_shared<ChurnHandler>(streamId, options.packets);
+                std::vector<std::shared_ptr<ChurnHandler> > subscribers;
+                for (int i = 0; i < options.subscribers; ++i) {
+                    subscribers.push_back(std::make_shared<ChurnHandler>(streamId, 0));
+                    streamManager->onSubscriberConnected(subscribers.back());
+                }
+
+                auto cycleStart = std::chrono::steady_clock::now();
+                // The previous session of this stream ID may still be tearing down
+                while (!streamManager->onPublisherConnected(publisher)) {
+                    ++rejectedConnects;
+                    std::this_thread::sleep_for(std::chrono::microseconds(100));
+                }
+                publisher->waitForDisconnect();
+                for (auto &subscriber: subscribers) {
+                    subscriber->waitForDisconnect();
+                }
+                latencies.push_back(std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - cycleStart).count());
+            }
+            std::lock_guard<std::mutex> lock(latenciesMutex);
+            latenciesMicros.insert(latenciesMicros.end(), latencies.begin(), latencies.end());
+        });
+    }
+    for (auto &encoder: encoders) {
+        encoder.join();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    sampling = false;
+    sampler.join();
+    // Event threads still returning from teardown hold the manager; once they let go it is
+    // destroyed here rather than on one of them while the process exits
+    while (streamManager.use_count() > 1) {
+        std::this_thread::yield();
+    }
+    streamManager.reset();
+
+    int64_t threads;
+    int64_t peakRssKb;
+    readProcessStatus(threads, peakRssKb);
+
+    std::sort(latenciesMicros.begin(), latenciesMicros.end());
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    double cyclesPerSecond = seconds > 0 ? latenciesMicros.size() / seconds : 0.0;
+    double p50 = percentile(latenciesMicros, 0.50);
+    double p99 = percentile(latenciesMicros, 0.99);
+    double p999 = percentile(latenciesMicros, 0.999);
+    double maxMs = latenciesMicros.empty() ? 0.0 : latenciesMicros.back() / 1000.0;
+    int64_t peakRssMb = peakRssKb / 1024;
+
+    std::printf("cycles=%zu concurrency=%d subscribers=%d packets=%d\n", latenciesMicros.size(),
+                options.concurrency, options.subscribers, options.packets);
+    std::printf("throughput:  %10.1f cycles/s\n", cyclesPerSecond);
+    std::printf("latency ms:  p50=%.2f p99=%.2f p99.9=%.2f max=%.2f\n", p50, p99, p999, maxMs);
+    std::printf("peak threads: %lld  peak rss: %lld MB  rejected reconnects: %lld\n",
+                static_cast<long long>(peakThreads.load()), static_cast<long long>(peakRssMb),
+                static_cast<long long>(rejectedConnects.load()));
+
+    bool passed = true;
+    passed &= check("cycles/s", options.minCyclesPerSecond > 0, cyclesPerSecond >= options.minCyclesPerSecond);
+    passed &= check("p99 latency", options.maxP99Ms > 0, p99 <= options.maxP99Ms);
+    passed &= check("peak threads", options.maxThreads > 0 && peakThreads > 0, peakThreads <= options.maxThreads);
+    passed &= check("peak rss", options.maxRssMb > 0 && peakRssKb > 0, peakRssMb <= options.maxRssMb);
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
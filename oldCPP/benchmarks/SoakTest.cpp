@@ -0,0 +1,404 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+// Soak test: a real server on loopback under hours of mixed traffic. Encoders connect, stream and
+// drop; viewers join before and after their publisher, leave on their own or are cut off with it.
+// Traffic pauses at every checkpoint until the node is idle, then RSS, heap in use, open file
+// descriptors, threads and server-side connections are sampled. Growth that shows up at every
+// checkpoint, or connections left behind by clients that are gone, fail the run.
+//
+// Usage: dl_srt_server_soak [--duration-seconds N] [--checkpoint-seconds N] [--publishers N]
+//            [--subscribers N] [--bitrate-kbps N] [--publisher-port N] [--subscriber-port N] [--seed N]
+//            [--max-growth-percent X] [--max-thread-growth N] [--max-fd-growth N]
+// Exits with failure if any check fails; a threshold of 0 disables the check.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#include "core/SRTServer.h"
+#include "utils/Logger.h"
+#include "utils/NetworkAddress.h"
+
+namespace {
+    struct Options {
+        int64_t durationSeconds = 4 * 3600;
+        int64_t checkpointSeconds = 300;
+        int publishers = 8;
+        int subscribers = 4;
+        int64_t bitrateKbps = 2000;
+        int publisherPort = 15500;
+        int subscriberPort = 16000;
+        uint64_t seed = 1;
+        double maxGrowthPercent = 10.0;
+        int64_t maxThreadGrowth = 4;
+        int64_t maxFdGrowth = 8;
+    };
+
+    // Process and server state while no client is connected
+    struct Checkpoint {
+        int64_t elapsedSeconds = 0;
+        int64_t rssKb = 0;
+        int64_t heapBytes = 0;
+        int64_t openFds = 0;
+        int64_t threads = 0;
+        // Sessions, subscribers and waiting subscribers the server still holds
+        int64_t connections = 0;
+    };
+
+    // Checkpoints required before growth at every one of them counts as a leak
+    constexpr size_t MIN_CHECKPOINTS_FOR_TREND = 4;
+    constexpr int PACKET_SIZE = 1316;
+    // libsrt closes sockets in the background, give it that long before sampling
+    constexpr std::chrono::seconds SETTLE_TIME{5};
+
+    struct Traffic {
+        std::atomic<bool> stopping{false};
+        std::atomic<bool> paused{false};
+        std::atomic<int> busySlots{0};
+        std::atomic<int64_t> publisherSessions{0};
+        std::atomic<int64_t> subscriberSessions{0};
+        std::atomic<int64_t> failedConnects{0};
+        std::atomic<int64_t> bytesReceived{0};
+    };
+
+    void readProcessStatus(int64_t &threads, int64_t &rssKb) {
+        threads = 0;
+        rssKb = 0;
+#ifdef __linux__
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line)) {
+            if (line.rfind("Threads:", 0) == 0) {
+                threads = std::atoll(line.c_str() + 8);
+            } else if (line.rfind("VmRSS:", 0) == 0) {
+                rssKb = std::atoll(line.c_str() + 6);
+            }
+        }
+#endif
+    }
+
+    int64_t countOpenFds() {
+#ifdef __linux__
+        std::error_code error;
+        int64_t count = 0;
+        for (auto it = std::filesystem::directory_iterator("/proc/self/fd", error);
+             !error && it != std::filesystem::directory_iterator(); it.increment(error)) {
+            ++count;
+        }
+        return count;
+#else
+        return 0;
+#endif
+    }
+
+    int64_t heapInUse() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+        return static_cast<int64_t>(mallinfo2().uordblks);
+#else
+        return 0;
+#endif
+    }
+
+    int64_t serverConnections(StreamManager &streamManager) {
+        streamManager.publishAdminSnapshot();
+        auto snapshot = streamManager.getAdminSnapshot();
+        int64_t connections = static_cast<int64_t>(streamManager.getWaitingSubscriberCount());
+        for (const auto &stream: snapshot->streams) {
+            connections += 1 + static_cast<int64_t>(stream.subscribers.size());
+        }
+        return connections;
+    }
+
+    SRTSOCKET connectTo(int port, const std::string &streamId) {
+        sockaddr_storage address{};
+        int addressLength = 0;
+        if (!NetworkAddress::resolve("127.0.0.1:" + std::to_string(port), false, address, addressLength)) {
+            return SRT_INVALID_SOCK;
+        }
+        SRTSOCKET socket = srt_create_socket();
+        if (socket == SRT_INVALID_SOCK) {
+            return SRT_INVALID_SOCK;
+        }
+        int receiveTimeoutMs = 200;
+        srt_setsockflag(socket, SRTO_STREAMID, streamId.c_str(), static_cast<int>(streamId.size()));
+        srt_setsockflag(socket, SRTO_RCVTIMEO, &receiveTimeoutMs, sizeof(receiveTimeoutMs));
+        if (srt_connect(socket, reinterpret_cast<const sockaddr *>(&address), addressLength) == SRT_ERROR) {
+            srt_close(socket);
+            return SRT_INVALID_SOCK;
+        }
+        return socket;
+    }
+
+    // Watches until its lifetime ends or the server closes the stream
+    void runViewer(const Options &options, Traffic &traffic, const std::string &streamId,
+                   std::chrono::milliseconds lifetime) {
+        SRTSOCKET socket = connectTo(options.subscriberPort, streamId);
+        if (socket == SRT_INVALID_SOCK) {
+            ++traffic.failedConnects;
+            return;
+        }
+        ++traffic.subscriberSessions;
+        std::vector<char> buffer(PACKET_SIZE * 2);
+        auto leaveAt = std::chrono::steady_clock::now() + lifetime;
+        while (std::chrono::steady_clock::now() < leaveAt && !traffic.stopping) {
+            SRT_MSGCTRL control = srt_msgctrl_default;
+            int received = srt_recvmsg2(socket, buffer.data(), static_cast<int>(buffer.size()), &control);
+            if (received > 0) {
+                traffic.bytesReceived += received;
+            } else if (srt_getsockstate(socket) != SRTS_CONNECTED) {
+                break;
+            }
+        }
+        srt_close(socket);
+    }
+
+    // One encoder slot: viewers arrive, the encoder streams for a while and drops, repeat
+    void runSlot(const Options &options, Traffic &traffic, int slot) {
+        std::mt19937_64 random(options.seed * 1000 + static_cast<uint64_t>(slot));
+        auto between = [&random](int64_t low, int64_t high) {
+            return low + static_cast<int64_t>(random() % static_cast<uint64_t>(high - low + 1));
+        };
+        const int64_t packetIntervalMicros = static_cast<int64_t>(PACKET_SIZE) * 8 * 1000 / options.bitrateKbps;
+        std::vector<char> packet(PACKET_SIZE, 0x47);
+        int64_t generation = 0;
+
+        while (!traffic.stopping) {
+            if (traffic.paused) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                continue;
+            }
+            ++traffic.busySlots;
+            // Alternate stream IDs so reconnects under the same ID and fresh IDs both get exercised
+            std::string streamId = "soak-" + std::to_string(slot) + "-" + std::to_string(generation++ % 3);
+            auto streamTime = std::chrono::milliseconds(between(1000, 20000));
+
+            // Some viewers wait for the publisher, some outlive it and some leave early
+            std::vector<std::thread> viewers;
+            int viewerCount = static_cast<int>(between(0, options.subscribers));
+            for (int i = 0; i < viewerCount; ++i) {
+                auto lifetime = std::chrono::milliseconds(between(500, streamTime.count() + 5000));
+                viewers.emplace_back(runViewer, std::cref(options), std::ref(traffic), streamId, lifetime);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(between(0, 500)));
+
+            SRTSOCKET publisher = connectTo(options.publisherPort, streamId);
+            if (publisher == SRT_INVALID_SOCK) {
+                ++traffic.failedConnects;
+            } else {
+                ++traffic.publisherSessions;
+                auto stopAt = std::chrono::steady_clock::now() + streamTime;
+                auto nextSend = std::chrono::steady_clock::now();
+                while (std::chrono::steady_clock::now() < stopAt && !traffic.stopping) {
+                    SRT_MSGCTRL control = srt_msgctrl_default;
+                    if (srt_sendmsg2(publisher, packet.data(), PACKET_SIZE, &control) == SRT_ERROR) {
+                        break;
+                    }
+                    nextSend += std::chrono::microseconds(packetIntervalMicros);
+                    std::this_thread::sleep_until(nextSend);
+                }
+                srt_close(publisher);
+            }
+            for (auto &viewer: viewers) {
+                viewer.join();
+            }
+            --traffic.busySlots;
+        }
+    }
+
+    bool parseOptions(int argc, char *argv[], Options &options) {
+        for (int i = 1; i + 1 < argc; i += 2) {
+            std::string name = argv[i];
+            const char *value = argv[i + 1];
+            if (name == "--duration-seconds") {
+                options.durationSeconds = std::atoll(value);
+            } else if (name == "--checkpoint-seconds") {
+                options.checkpointSeconds = std::max<int64_t>(std::atoll(value), 1);
+            } else if (name == "--publishers") {
+                options.publishers = std::max(std::atoi(value), 1);
+            } else if (name == "--subscribers") {
+                options.subscribers = std::max(std::atoi(value), 0);
+            } else if (name == "--bitrate-kbps") {
+                options.bitrateKbps = std::max<int64_t>(std::atoll(value), 100);
+            } else if (name == "--publisher-port") {
+                options.publisherPort = std::atoi(value);
+            } else if (name == "--subscriber-port") {
+                options.subscriberPort = std::atoi(value);
+            } else if (name == "--seed") {
+                options.seed = std::strtoull(value, nullptr, 10);
+            } else if (name == "--max-growth-percent") {
+                options.maxGrowthPercent = std::atof(value);
+            } else if (name == "--max-thread-growth") {
+                options.maxThreadGrowth = std::atoll(value);
+            } else if (name == "--max-fd-growth") {
+                options.maxFdGrowth = std::atoll(value);
+            } else {
+                std::fprintf(stderr, "unknown option %s\n", name.c_str());
+                return false;
+            }
+        }
+        return argc % 2 == 1;
+    }
+
+    Checkpoint takeCheckpoint(StreamManager &streamManager, int64_t elapsedSeconds) {
+        Checkpoint checkpoint;
+        checkpoint.elapsedSeconds = elapsedSeconds;
+        readProcessStatus(checkpoint.threads, checkpoint.rssKb);
+        checkpoint.heapBytes = heapInUse();
+        checkpoint.openFds = countOpenFds();
+        checkpoint.connections = serverConnections(streamManager);
+        return checkpoint;
+    }
+
+    // A leak grows at every checkpoint; noise goes up and down. Both the trend and the total have to be past the limit.
+    bool growsMonotonically(const std::vector<Checkpoint> &checkpoints, int64_t Checkpoint::*metric,
+                            double maxGrowthPercent) {
+        if (checkpoints.size() < MIN_CHECKPOINTS_FOR_TREND || maxGrowthPercent <= 0) {
+            return false;
+        }
+        for (size_t i = 1; i < checkpoints.size(); ++i) {
+            if (checkpoints[i].*metric <= checkpoints[i - 1].*metric) {
+                return false;
+            }
+        }
+        double first = static_cast<double>(checkpoints.front().*metric);
+        double last = static_cast<double>(checkpoints.back().*metric);
+        return first > 0 && (last - first) * 100.0 / first > maxGrowthPercent;
+    }
+
+    bool check(const char *name, bool enabled, bool passed) {
+        if (enabled && !passed) {
+            std::printf("LEAK: %s\n", name);
+            return false;
+        }
+        return true;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        return EXIT_FAILURE;
+    }
+
+    LogSettings logSettings;
+    logSettings.minLevel = LogLevel::Error;
+    Logger::instance().configure(logSettings);
+
+    ServerConfig config;
+    config.apply("listen.publisher", "127.0.0.1:" + std::to_string(options.publisherPort));
+    config.apply("listen.subscriber", "127.0.0.1:" + std::to_string(options.subscriberPort));
+    config.waiting.timeout = std::chrono::seconds(5);
+    SRTServer server(config);
+    if (!server.initialize() || !server.start()) {
+        std::fprintf(stderr, "failed to start the server\n");
+        return EXIT_FAILURE;
+    }
+    auto streamManager = server.getStreamManager();
+
+    Traffic traffic;
+    std::vector<std::thread> slots;
+    for (int slot = 0; slot < options.publishers; ++slot) {
+        slots.emplace_back(runSlot, std::cref(options), std::ref(traffic), slot);
+    }
+
+    // The first checkpoint is the baseline, taken once pools, caches and thread pools have warmed up
+    std::vector<Checkpoint> checkpoints;
+    bool leftConnections = false;
+    auto start = std::chrono::steady_clock::now();
+    auto deadline = start + std::chrono::seconds(options.durationSeconds);
+    auto nextCheckpoint = start + std::chrono::seconds(options.checkpointSeconds);
+    while (true) {
+        auto now = std::chrono::steady_clock::now();
+        bool last = now >= deadline;
+        if (!last && now < nextCheckpoint) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            continue;
+        }
+        nextCheckpoint += std::chrono::seconds(options.checkpointSeconds);
+
+        traffic.paused = true;
+        if (last) {
+            traffic.stopping = true;
+        }
+        while (traffic.busySlots > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        // Sessions end once the server notices their clients are gone
+        auto idleBy = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+        while (serverConnections(*streamManager) > 0 && std::chrono::steady_clock::now() < idleBy) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        }
+        std::this_thread::sleep_for(SETTLE_TIME);
+
+        int64_t elapsed = std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::steady_clock::now() - start).count();
+        Checkpoint checkpoint = takeCheckpoint(*streamManager, elapsed);
+        checkpoints.push_back(checkpoint);
+        leftConnections |= checkpoint.connections > 0;
+        std::printf("t=%llds rss=%lldKB heap=%lldB fds=%lld threads=%lld connections=%lld publishers=%lld "
+                    "subscribers=%lld failed_connects=%lld\n",
+                    static_cast<long long>(checkpoint.elapsedSeconds), static_cast<long long>(checkpoint.rssKb),
+                    static_cast<long long>(checkpoint.heapBytes), static_cast<long long>(checkpoint.openFds),
+                    static_cast<long long>(checkpoint.threads), static_cast<long long>(checkpoint.connections),
+                    static_cast<long long>(traffic.publisherSessions.load()),
+                    static_cast<long long>(traffic.subscriberSessions.load()),
+                    static_cast<long long>(traffic.failedConnects.load()));
+        std::fflush(stdout);
+        if (last) {
+            break;
+        }
+        traffic.paused = false;
+    }
+    for (auto &slot: slots) {
+        slot.join();
+    }
+    streamManager.reset();
+    server.stop();
+
+    const Checkpoint &baseline = checkpoints.front();
+    const Checkpoint &latest = checkpoints.back();
+    bool passed = true;
+    passed &= check("connections left on the server with no client connected", true, !leftConnections);
+    passed &= check("rss grows at every checkpoint", true,
+                    !growsMonotonically(checkpoints, &Checkpoint::rssKb, options.maxGrowthPercent));
+    passed &= check("heap grows at every checkpoint", true,
+                    !growsMonotonically(checkpoints, &Checkpoint::heapBytes, options.maxGrowthPercent));
+    passed &= check("open file descriptors grew", options.maxFdGrowth > 0 && baseline.openFds > 0,
+                    latest.openFds - baseline.openFds <= options.maxFdGrowth);
+    passed &= check("threads grew", options.maxThreadGrowth > 0 && baseline.threads > 0,
+                    latest.threads - baseline.threads <= options.maxThreadGrowth);
+    passed &= check("no traffic got through", true,
+                    traffic.publisherSessions > 0 && traffic.bytesReceived > 0);
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,382 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "AdminServer.h"
+
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+#include "StreamManager.h"
+#include "utils/Logger.h"
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#include <afunix.h>
+#include <cstdio>
+using NativeSocket = SOCKET;
+#define poll WSAPoll
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+using NativeSocket = int;
+#endif
+
+namespace {
+#if defined(MSG_NOSIGNAL)
+    constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+    constexpr int SEND_FLAGS = 0;
+#endif
+
+    NativeSocket native(intptr_t socket) {
+        return static_cast<NativeSocket>(socket);
+    }
+
+    bool isValidSocket(NativeSocket socket) {
+#if defined(_WIN32)
+        return socket != INVALID_SOCKET;
+#else
+        return socket >= 0;
+#endif
+    }
+
+    void closeSocket(intptr_t socket) {
+#if defined(_WIN32)
+        closesocket(native(socket));
+#else
+        ::close(native(socket));
+#endif
+    }
+
+    void removeSocketFile(const std::string &path) {
+#if defined(_WIN32)
+        std::remove(path.c_str());
+#else
+        ::unlink(path.c_str());
+#endif
+    }
+
+    bool makeAddress(const std::string &path, sockaddr_un &address) {
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+            return false;
+        }
+        std::memcpy(address.sun_path, path.data(), path.size());
+        return true;
+    }
+
+    bool setNonBlocking(intptr_t socket) {
+#if defined(_WIN32)
+        u_long enabled = 1;
+        return ioctlsocket(native(socket), FIONBIO, &enabled) == 0;
+#else
+        int flags = ::fcntl(native(socket), F_GETFL, 0);
+        return flags >= 0 && ::fcntl(native(socket), F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+    }
+
+    bool wouldBlock() {
+#if defined(_WIN32)
+        return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+    }
+
+    // Sends what the socket takes without waiting, false once the connection is gone
+    bool flush(intptr_t socket, std::string &output) {
+        size_t sent = 0;
+        while (sent < output.size()) {
+            int result = ::send(native(socket), output.data() + sent, static_cast<int>(output.size() - sent),
+                                SEND_FLAGS);
+            if (result < 0 && wouldBlock()) {
+                break;
+            }
+            if (result <= 0) {
+                return false;
+            }
+            sent += static_cast<size_t>(result);
+        }
+        output.erase(0, sent);
+        return true;
+    }
+
+    bool sendAll(intptr_t socket, const std::string &data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            int result = ::send(native(socket), data.data() + sent, static_cast<int>(data.size() - sent), SEND_FLAGS);
+            if (result <= 0) {
+                return false;
+            }
+            sent += static_cast<size_t>(result);
+        }
+        return true;
+    }
+
+    std::string errorReply(const std::string &message) {
+        return "{\"ok\":false,\"error\":\"" + AdminSnapshot::escapeJson(message) + "\"}";
+    }
+}
+
+AdminServer::AdminServer(AdminSettings settings, std::shared_ptr<StreamManager> streamManager)
+    : m_settings(std::move(settings)),
+      m_streamManager(std::move(streamManager)) {
+}
+
+AdminServer::~AdminServer() {
+    stop();
+}
+
+void AdminServer::setReloadHandler(ReloadHandler handler) {
+    std::lock_guard<std::mutex> lock(m_handlerMutex);
+    m_reloadHandler = std::move(handler);
+}
+
+void AdminServer::setDrainHandler(DrainHandler handler) {
+    std::lock_guard<std::mutex> lock(m_handlerMutex);
+    m_drainHandler = std::move(handler);
+}
+
+bool AdminServer::start() {
+    sockaddr_un address{};
+    if (!makeAddress(m_settings.socketPath, address)) {
+        LOG_ERROR("Invalid admin socket path", LogFields().with(m_settings.socketPath));
+        return false;
+    }
+
+    NativeSocket socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (!isValidSocket(socket)) {
+        LOG_ERROR("Failed to create admin socket", LogFields().with(m_settings.socketPath));
+        return false;
+    }
+    m_socket = static_cast<intptr_t>(socket);
+
+    // A socket file left by a previous run would make bind fail
+    removeSocketFile(m_settings.socketPath);
+#if !defined(_WIN32)
+    // Owner and group only, the commands can disconnect anyone. Set through the umask so the
+    // file never exists with looser permissions, a chmod after bind would leave a window.
+    mode_t previousMask = ::umask(0117);
+#endif
+    bool bound = ::bind(socket, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0;
+#if !defined(_WIN32)
+    ::umask(previousMask);
+#endif
+    if (!bound || ::listen(socket, static_cast<int>(MAX_CLIENTS)) != 0) {
+        LOG_ERROR("Failed to listen on admin socket", LogFields().with(m_settings.socketPath));
+        closeSocket(m_socket);
+        m_socket = -1;
+        return false;
+    }
+
+    m_running = true;
+    m_thread = std::make_unique<std::thread>(&AdminServer::serveThread, this);
+    LOG_INFO("Admin socket listening", LogFields().with(m_settings.socketPath));
+    return true;
+}
+
+void AdminServer::stop() {
+    if (!m_running.exchange(false)) {
+        return;
+    }
+    if (m_thread && m_thread->joinable()) {
+        m_thread->join();
+    }
+    m_thread.reset();
+    closeSocket(m_socket);
+    m_socket = -1;
+    removeSocketFile(m_settings.socketPath);
+}
+
+std::string AdminServer::handleCommand(const std::string &line) {
+    std::istringstream arguments(line);
+    std::string command;
+    arguments >> command;
+
+    if (command == "status") {
+        return m_streamManager->getAdminSnapshot()->toJson();
+    }
+    if (command == "kick") {
+        std::string streamId;
+        std::string peerAddress;
+        if (!(arguments >> streamId >> peerAddress)) {
+            return errorReply("usage: kick <stream id> <ip:port>");
+        }
+        size_t kicked = m_streamManager->kickSubscriber(streamId, peerAddress);
+        return "{\"ok\":" + std::string(kicked > 0 ? "true" : "false") + ",\"kicked\":" + std::to_string(kicked) +
+               "}";
+    }
+    if (command == "drop") {
+        std::string streamId;
+        if (!(arguments >> streamId)) {
+            return errorReply("usage: drop <stream id>");
+        }
+        // Replied to once the teardown has started, it would stall every admin client until it ends
+        if (!m_streamManager->dropStreamInBackground(streamId)) {
+            return errorReply("unknown stream");
+        }
+        return "{\"ok\":true}";
+    }
+    if (command == "drain" || command == "resume") {
+        DrainHandler handler; {
+            std::lock_guard<std::mutex> lock(m_handlerMutex);
+            handler = m_drainHandler;
+        }
+        if (handler) {
+            handler(command == "drain");
+        } else {
+            m_streamManager->setDraining(command == "drain");
+        }
+        return "{\"ok\":true,\"draining\":" + std::string(command == "drain" ? "true" : "false") + "}";
+    }
+    if (command == "reload") {
+        ReloadHandler handler; {
+            std::lock_guard<std::mutex> lock(m_handlerMutex);
+            handler = m_reloadHandler;
+        }
+        std::vector<std::string> notApplied;
+        if (!handler || !handler(notApplied)) {
+            return errorReply("reload failed");
+        }
+        std::string reply = "{\"ok\":true,\"not_applied\":[";
+        for (size_t i = 0; i < notApplied.size(); ++i) {
+            reply += (i == 0 ? "\"" : ",\"") + AdminSnapshot::escapeJson(notApplied[i]) + "\"";
+        }
+        return reply + "]}";
+    }
+    return errorReply("unknown command");
+}
+
+void AdminServer::serveThread() {
+    struct Client {
+        intptr_t socket;
+        std::string pending;
+        // Replies the client hasn't read yet, sent as the socket drains
+        std::string output;
+    };
+    std::vector<Client> clients;
+    std::vector<pollfd> fds;
+    char buffer[1024];
+
+    while (m_running.load(std::memory_order_relaxed)) {
+        fds.clear();
+        fds.push_back(pollfd{native(m_socket), POLLIN, 0});
+        for (const auto &client: clients) {
+            short events = client.output.empty() ? POLLIN : static_cast<short>(POLLIN | POLLOUT);
+            fds.push_back(pollfd{native(client.socket), events, 0});
+        }
+        if (::poll(fds.data(), static_cast<unsigned long>(fds.size()), POLL_INTERVAL_MS) <= 0) {
+            continue;
+        }
+
+        // Clients first, fds[i + 1] belongs to clients[i] until the list changes
+        std::vector<Client> remaining;
+        for (size_t i = 0; i < clients.size(); ++i) {
+            auto &client = clients[i];
+            if (fds[i + 1].revents == 0) {
+                remaining.push_back(std::move(client));
+                continue;
+            }
+            bool open = true;
+            if (fds[i + 1].revents & ~POLLOUT) {
+                int received = ::recv(native(client.socket), buffer, sizeof(buffer), 0);
+                open = received > 0 || (received < 0 && wouldBlock());
+                if (received > 0) {
+                    client.pending.append(buffer, static_cast<size_t>(received));
+                    size_t newline;
+                    while ((newline = client.pending.find('\n')) != std::string::npos) {
+                        std::string line = client.pending.substr(0, newline);
+                        client.pending.erase(0, newline + 1);
+                        if (!line.empty() && line.back() == '\r') {
+                            line.pop_back();
+                        }
+                        client.output += handleCommand(line) + "\n";
+                    }
+                    open = client.pending.size() <= MAX_LINE_LENGTH;
+                }
+            }
+            // Never wait on a client here, one that doesn't read its replies would stall every other one
+            open = open && flush(client.socket, client.output);
+            if (open && client.output.size() > MAX_CLIENT_BACKLOG) {
+                LOG_WARNING("Admin client is not reading its replies, closing connection");
+                open = false;
+            }
+            if (open) {
+                remaining.push_back(std::move(client));
+            } else {
+                closeSocket(client.socket);
+            }
+        }
+        clients.swap(remaining);
+
+        if (fds[0].revents & POLLIN) {
+            NativeSocket accepted = ::accept(native(m_socket), nullptr, nullptr);
+            bool valid = isValidSocket(accepted);
+            if (valid && clients.size() < MAX_CLIENTS && setNonBlocking(static_cast<intptr_t>(accepted))) {
+                clients.push_back(Client{static_cast<intptr_t>(accepted), {}, {}});
+            } else if (valid) {
+                LOG_WARNING("Too many admin clients, closing connection");
+                closeSocket(static_cast<intptr_t>(accepted));
+            }
+        }
+    }
+
+    for (const auto &client: clients) {
+        closeSocket(client.socket);
+    }
+}
+
+bool AdminServer::sendCommand(const std::string &socketPath, const std::string &command, std::string &reply) {
+    sockaddr_un address{};
+    if (!makeAddress(socketPath, address)) {
+        return false;
+    }
+    NativeSocket socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (!isValidSocket(socket)) {
+        return false;
+    }
+    auto handle = static_cast<intptr_t>(socket);
+    bool ok = ::connect(socket, reinterpret_cast<sockaddr *>(&address), sizeof(address)) == 0 &&
+              sendAll(handle, command + "\n");
+
+    reply.clear();
+    char buffer[1024];
+    while (ok) {
+        int received = ::recv(socket, buffer, sizeof(buffer), 0);
+        if (received <= 0) {
+            ok = false;
+            break;
+        }
+        reply.append(buffer, static_cast<size_t>(received));
+        size_t newline = reply.find('\n');
+        if (newline != std::string::npos) {
+            reply.resize(newline);
+            break;
+        }
+    }
+    closeSocket(handle);
+    return ok;
+}
@@ -0,0 +1,103 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef ADMINSERVER_H
+#define ADMINSERVER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class StreamManager;
+
+struct AdminSettings {
+    // Unix-domain socket the control commands are served on, empty disables it
+    std::string socketPath;
+    // How often the session snapshot served by "status" is rebuilt
+    std::chrono::milliseconds snapshotInterval{1000};
+};
+
+// Local control socket. Each request is one line, each reply one line of JSON:
+//
+//   status                      streams, publishers and subscribers from the last snapshot
+//   kick <stream id> <ip:port>  disconnect a subscriber
+//   drop <stream id>            disconnect a publisher and its subscribers
+//   drain | resume              stop or resume accepting new connections, redirecting clients to peers
+//   reload                      re-read the config file, lists the settings that need a restart
+//
+// Status is served from the manager's published snapshot, so polling never takes a session lock.
+class AdminServer {
+public:
+    // Returns false if the config could not be loaded
+    using ReloadHandler = std::function<bool(std::vector<std::string> &notApplied)>;
+    // Starts or cancels a drain, with its deadline
+    using DrainHandler = std::function<void(bool draining)>;
+
+    AdminServer(AdminSettings settings, std::shared_ptr<StreamManager> streamManager);
+
+    ~AdminServer();
+
+    AdminServer(const AdminServer &) = delete;
+
+    AdminServer &operator=(const AdminServer &) = delete;
+
+    // Without a handler "reload" is refused
+    void setReloadHandler(ReloadHandler handler);
+
+    // Without a handler "drain" only toggles the manager, no deadline applies
+    void setDrainHandler(DrainHandler handler);
+
+    bool start();
+
+    void stop();
+
+    // Runs one command line and returns its JSON reply
+    std::string handleCommand(const std::string &line);
+
+    // Client side: sends one command and reads the reply line, for tools and tests
+    static bool sendCommand(const std::string &socketPath, const std::string &command, std::string &reply);
+
+private:
+    void serveThread();
+
+    AdminSettings m_settings;
+    std::shared_ptr<StreamManager> m_streamManager;
+    std::mutex m_handlerMutex;
+    ReloadHandler m_reloadHandler;
+    DrainHandler m_drainHandler;
+
+    intptr_t m_socket = -1;
+    std::atomic<bool> m_running{false};
+    std::unique_ptr<std::thread> m_thread;
+
+    static constexpr size_t MAX_CLIENTS = 16;
+    static constexpr size_t MAX_LINE_LENGTH = 4096;
+    // Unsent replies a client may queue before it is disconnected
+    static constexpr size_t MAX_CLIENT_BACKLOG = 1024 * 1024;
+    static constexpr int POLL_INTERVAL_MS = 200;
+};
+
+
+#endif //ADMINSERVER_H
@@ -0,0 +1,99 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "AdminSnapshot.h"
+
+#include <cstdio>
+
+std::string AdminSnapshot::escapeJson(const std::string &value) {
+    std::string escaped;
+    escaped.reserve(value.size() + 2);
+    for (char c: value) {
+        switch (c) {
+            case '"':
+                escaped += "\\\"";
+                break;
+            case '\\':
+                escaped += "\\\\";
+                break;
+            case '\n':
+                escaped += "\\n";
+                break;
+            case '\r':
+                escaped += "\\r";
+                break;
+            case '\t':
+                escaped += "\\t";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char code[8];
+                    std::snprintf(code, sizeof(code), "\\u%04x", static_cast<unsigned char>(c));
+                    escaped += code;
+                } else {
+                    escaped += c;
+                }
+        }
+    }
+    return escaped;
+}
+
+std::string AdminSnapshot::toJson() const {
+    auto quoted = [](const std::string &value) { return "\"" + escapeJson(value) + "\""; };
+    auto boolean = [](bool value) { return value ? std::string("true") : std::string("false"); };
+
+    std::string json = "{\"taken_at_ms\":" + std::to_string(
+                           std::chrono::duration_cast<std::chrono::milliseconds>(
+                               takenAt.time_since_epoch()).count()) +
+                       ",\"draining\":" + boolean(draining) + ",\"streams\":[";
+    for (size_t i = 0; i < streams.size(); ++i) {
+        const auto &stream = streams[i];
+        json += (i == 0 ? "" : ",");
+        json += "{\"stream_id\":" + quoted(stream.streamId) +
+                ",\"publisher\":" + quoted(stream.publisherAddress) +
+                ",\"uptime_s\":" + std::to_string(stream.uptimeSeconds) +
+                ",\"bitrate_bps\":" + std::to_string(stream.bitsPerSecond) +
+                ",\"overloaded\":" + boolean(stream.overloaded) + ",\"subscribers\":[";
+        for (size_t j = 0; j < stream.subscribers.size(); ++j) {
+            const auto &subscriber = stream.subscribers[j];
+            json += (j == 0 ? "" : ",");
+            json += "{\"peer\":" + quoted(subscriber.peerAddress) +
+                    ",\"qos\":" + quoted(subscriber.qosClass) +
+                    ",\"paced\":" + boolean(subscriber.paced) +
+                    ",\"lag_us\":" + std::to_string(subscriber.lagMicros) +
+                    ",\"rtt_ms\":" + std::to_string(static_cast<int64_t>(subscriber.rttMs)) + "}";
+        }
+        json += "]}";
+    }
+    json += "],\"startup\":{";
+    auto stages = [](const std::vector<StageLatency> &latencies) {
+        std::string stagesJson = "[";
+        for (size_t i = 0; i < latencies.size(); ++i) {
+            const auto &latency = latencies[i];
+            stagesJson += (i == 0 ? "" : ",");
+            stagesJson += "{\"stage\":\"" + latency.stage + "\"" +
+                    ",\"count\":" + std::to_string(latency.count) +
+                    ",\"avg_us\":" + std::to_string(latency.averageMicros) +
+                    ",\"max_us\":" + std::to_string(latency.maxMicros) + "}";
+        }
+        return stagesJson + "]";
+    };
+    json += "\"publisher\":" + stages(startup.publisher) + ",\"subscriber\":" + stages(startup.subscriber) + "}}";
+    return json;
+}
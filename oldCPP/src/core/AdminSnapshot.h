@@ -0,0 +1,74 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef ADMINSNAPSHOT_H
+#define ADMINSNAPSHOT_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct SubscriberStatus {
+    std::string peerAddress;
+    std::string qosClass;
+    bool paced = false;
+    // How far behind the publisher the subscriber is: queued time when paced, else the SRT send buffer
+    int64_t lagMicros = 0;
+    double rttMs = 0.0;
+};
+
+struct StreamStatus {
+    std::string streamId;
+    std::string publisherAddress;
+    int64_t uptimeSeconds = 0;
+    int64_t bitsPerSecond = 0;
+    bool overloaded = false;
+    std::vector<SubscriberStatus> subscribers;
+};
+
+// Connection startup time spent in one stage since the last stats report
+struct StageLatency {
+    std::string stage;
+    int64_t count = 0;
+    int64_t averageMicros = 0;
+    int64_t maxMicros = 0;
+};
+
+// Stages with samples only, in the order a connection passes them
+struct StartupStatus {
+    std::vector<StageLatency> publisher;
+    std::vector<StageLatency> subscriber;
+};
+
+// Immutable view of the node, rebuilt periodically so readers never touch the session locks
+struct AdminSnapshot {
+    std::chrono::system_clock::time_point takenAt{};
+    bool draining = false;
+    std::vector<StreamStatus> streams;
+    StartupStatus startup;
+
+    // One line of JSON
+    std::string toJson() const;
+
+    static std::string escapeJson(const std::string &value);
+};
+
+
+#endif //ADMINSNAPSHOT_H
@@ -0,0 +1,131 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "ClusterPlacement.h"
+
+#include <algorithm>
+
+#include "utils/Logger.h"
+
+std::shared_ptr<ClusterPlacement> ClusterPlacement::create(const ClusterSettings &settings) {
+    if (settings.nodeAddress.empty() || settings.nodes.empty()) {
+        return nullptr;
+    }
+    std::shared_ptr<StreamDirectory> directory;
+    if (!settings.directoryPath.empty()) {
+        directory = std::make_shared<FileStreamDirectory>(settings.directoryPath);
+    }
+    return std::make_shared<ClusterPlacement>(settings, directory);
+}
+
+ClusterPlacement::ClusterPlacement(ClusterSettings settings, std::shared_ptr<StreamDirectory> directory)
+    : m_settings(std::move(settings)),
+      m_directory(std::move(directory)),
+      m_ring(m_settings.pointsPerNode),
+      m_placements(std::make_shared<Placements>()) {
+    if (nodeIndex(m_settings.nodeAddress) < 0) {
+        LOG_WARNING("This node is missing from cluster.nodes, other nodes won't send it streams",
+                    LogFields().with(m_settings.nodeAddress));
+        m_settings.nodes.push_back(m_settings.nodeAddress);
+    }
+    for (const auto &node: m_settings.nodes) {
+        m_ring.addNode(node);
+    }
+    LOG_INFO("Cluster placement enabled", LogFields().with(
+                 m_settings.nodeAddress + " nodes=" + std::to_string(m_settings.nodes.size()) +
+                 (m_directory ? " directory=" + m_settings.directoryPath : "")));
+}
+
+std::string ClusterPlacement::ownerFor(const std::string &streamId) {
+    auto placements = std::atomic_load(&m_placements);
+    if (placements->localStreams.count(streamId) > 0) {
+        return m_settings.nodeAddress;
+    }
+    auto it = placements->owners.find(streamId);
+    if (it != placements->owners.end()) {
+        return it->second;
+    }
+    return m_ring.nodeFor(streamId);
+}
+
+void ClusterPlacement::refreshPlacements() {
+    if (!m_directory) {
+        return;
+    }
+    std::unordered_map<std::string, std::string> owners;
+    if (!m_directory->listStreams(owners)) {
+        return;
+    }
+    // Entries naming this node are either published here or left over from before a restart
+    for (auto it = owners.begin(); it != owners.end();) {
+        it = isLocal(it->second) ? owners.erase(it) : std::next(it);
+    }
+    updatePlacements([&owners](Placements &updated) {
+        updated.owners = std::move(owners);
+    });
+}
+
+std::chrono::milliseconds ClusterPlacement::getRefreshInterval() const {
+    return std::max(m_settings.cacheTtl, std::chrono::milliseconds(100));
+}
+
+void ClusterPlacement::updatePlacements(const std::function<void(Placements &)> &update) {
+    std::lock_guard<std::mutex> lock(m_placementsMutex);
+    auto updated = std::make_shared<Placements>(*m_placements);
+    update(*updated);
+    std::atomic_store(&m_placements, std::shared_ptr<const Placements>(std::move(updated)));
+}
+
+int ClusterPlacement::nodeIndex(const std::string &node) const {
+    auto it = std::find(m_settings.nodes.begin(), m_settings.nodes.end(), node);
+    return it == m_settings.nodes.end() ? -1 : static_cast<int>(it - m_settings.nodes.begin());
+}
+
+void ClusterPlacement::streamStarted(const std::string &streamId) {
+    updatePlacements([&streamId](Placements &updated) {
+        updated.localStreams.insert(streamId);
+        updated.owners.erase(streamId);
+    });
+    if (m_directory) {
+        m_directory->registerStream(streamId, m_settings.nodeAddress, m_settings.registrationTtl);
+    }
+}
+
+void ClusterPlacement::streamEnded(const std::string &streamId) {
+    updatePlacements([&streamId](Placements &updated) {
+        updated.localStreams.erase(streamId);
+    });
+    if (m_directory) {
+        m_directory->unregisterStream(streamId, m_settings.nodeAddress);
+    }
+}
+
+void ClusterPlacement::renew(const std::vector<std::string> &streamIds) {
+    if (!m_directory) {
+        return;
+    }
+    for (const auto &streamId: streamIds) {
+        m_directory->registerStream(streamId, m_settings.nodeAddress, m_settings.registrationTtl);
+    }
+}
+
+std::chrono::milliseconds ClusterPlacement::getRenewInterval() const {
+    auto interval = std::chrono::duration_cast<std::chrono::milliseconds>(m_settings.registrationTtl) / 3;
+    return std::max(interval, std::chrono::milliseconds(1000));
+}
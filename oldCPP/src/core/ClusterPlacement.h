@@ -0,0 +1,113 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef CLUSTERPLACEMENT_H
+#define CLUSTERPLACEMENT_H
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "StreamDirectory.h"
+#include "utils/ConsistentHashRing.h"
+
+// Several servers sharing the stream IDs. Disabled while nodeAddress or nodes is empty.
+struct ClusterSettings {
+    // This node as clients reach it, one of nodes
+    std::string nodeAddress;
+    // Every node, "host:port" separated by ';'. Stream IDs are spread over them by consistent hashing,
+    // and a client is pointed at a node by its index here.
+    std::vector<std::string> nodes;
+    // Folder the file directory keeps its entries in, empty places streams by hashing alone
+    std::string directoryPath;
+    // How often the placement snapshot is rebuilt from the directory, so how stale it may get
+    std::chrono::milliseconds cacheTtl{2000};
+    // Entries not renewed in time are ignored, so a crashed node's streams don't stay claimed
+    std::chrono::seconds registrationTtl{30};
+    size_t pointsPerNode = 64;
+};
+
+// Decides which node a publisher or subscriber of a stream belongs on. A stream already published
+// somewhere stays there, new streams go where the hash ring puts them.
+class ClusterPlacement {
+public:
+    // Null when clustering isn't configured
+    static std::shared_ptr<ClusterPlacement> create(const ClusterSettings &settings);
+
+    // directory may be null, leaving placement to the ring
+    ClusterPlacement(ClusterSettings settings, std::shared_ptr<StreamDirectory> directory);
+
+    // Node publishing streamId, or the node the ring assigns it to. Answered from the placement
+    // snapshot without locks or I/O, for the handshake path: streams published here, then the
+    // directory as of the last refresh, then the ring.
+    std::string ownerFor(const std::string &streamId);
+
+    // Reloads where the other nodes' streams are from the directory; runs on the timer wheel. The
+    // snapshot is the in-process cache of the directory, an entry that went stale is gone once its
+    // owner unregisters it or stops renewing it past registrationTtl.
+    void refreshPlacements();
+
+    // How often refreshPlacements() should run, cacheTtl
+    std::chrono::milliseconds getRefreshInterval() const;
+
+    bool isLocal(const std::string &node) const { return node == m_settings.nodeAddress; }
+
+    // Position of node in the configured list, -1 if it isn't listed
+    int nodeIndex(const std::string &node) const;
+
+    // Registration of the streams published here
+    void streamStarted(const std::string &streamId);
+
+    void streamEnded(const std::string &streamId);
+
+    // Renews the entries of the streams still published here
+    void renew(const std::vector<std::string> &streamIds);
+
+    // Often enough that an entry is renewed a few times within its ttl
+    std::chrono::milliseconds getRenewInterval() const;
+
+    const ClusterSettings &getSettings() const { return m_settings; }
+
+private:
+    struct Placements {
+        std::unordered_set<std::string> localStreams;
+        // Streams of other nodes, from the directory
+        std::unordered_map<std::string, std::string> owners;
+    };
+
+    // Copy-on-write, serialized by m_placementsMutex
+    void updatePlacements(const std::function<void(Placements &)> &update);
+
+    ClusterSettings m_settings;
+    std::shared_ptr<StreamDirectory> m_directory;
+    // Built once, the node list doesn't change while running
+    ConsistentHashRing m_ring;
+
+    // Read by the listen callbacks with atomic_load, never waiting on a writer
+    std::shared_ptr<const Placements> m_placements;
+    std::mutex m_placementsMutex;
+};
+
+
+#endif //CLUSTERPLACEMENT_H
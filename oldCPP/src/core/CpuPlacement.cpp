@@ -0,0 +1,112 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "CpuPlacement.h"
+
+#include <algorithm>
+#include <set>
+
+#include "utils/Logger.h"
+
+CpuPlacement::CpuPlacement(AffinitySettings settings)
+    : m_settings(std::move(settings)),
+      m_sessionsPerSlot(m_settings.sessionCpuSets.size(), 0),
+      m_coreCounters(ThreadPlacement::cpuCount()) {
+    for (int cpu = 0; cpu < static_cast<int>(m_coreCounters.size()); ++cpu) {
+        m_numaNodes.push_back(ThreadPlacement::numaNodeOfCpu(cpu));
+    }
+
+    // A session set spanning nodes defeats the point of keeping ingest and fan-out together
+    for (const auto &cpus: m_settings.sessionCpuSets) {
+        std::set<int> nodes;
+        for (int cpu: cpus) {
+            if (cpu < static_cast<int>(m_numaNodes.size()) && m_numaNodes[cpu] >= 0) {
+                nodes.insert(m_numaNodes[cpu]);
+            }
+        }
+        if (nodes.size() > 1) {
+            LOG_WARNING("Session CPU set spans multiple NUMA nodes",
+                        LogFields().with(ThreadPlacement::formatCpuList(cpus)));
+        }
+    }
+}
+
+int CpuPlacement::acquireSessionSlot(const CpuSet &preferredCpus) {
+    std::lock_guard<std::mutex> lock(m_slotsMutex);
+    if (m_sessionsPerSlot.empty()) {
+        return -1;
+    }
+
+    int best = -1;
+    bool bestPreferred = false;
+    for (int slot = 0; slot < static_cast<int>(m_sessionsPerSlot.size()); ++slot) {
+        const CpuSet &cpus = m_settings.sessionCpuSets[slot];
+        bool preferred = std::any_of(cpus.begin(), cpus.end(), [&preferredCpus](int cpu) {
+            return std::find(preferredCpus.begin(), preferredCpus.end(), cpu) != preferredCpus.end();
+        });
+        if (best < 0 || (preferred && !bestPreferred) ||
+            (preferred == bestPreferred && m_sessionsPerSlot[slot] < m_sessionsPerSlot[best])) {
+            best = slot;
+            bestPreferred = preferred;
+        }
+    }
+    ++m_sessionsPerSlot[best];
+    return best;
+}
+
+void CpuPlacement::releaseSessionSlot(int slot) {
+    std::lock_guard<std::mutex> lock(m_slotsMutex);
+    if (slot >= 0 && slot < static_cast<int>(m_sessionsPerSlot.size()) && m_sessionsPerSlot[slot] > 0) {
+        --m_sessionsPerSlot[slot];
+    }
+}
+
+bool CpuPlacement::pinToSessionSlot(int slot) const {
+    if (slot < 0 || slot >= static_cast<int>(m_settings.sessionCpuSets.size())) {
+        return false;
+    }
+    return ThreadPlacement::pinCurrentThread(m_settings.sessionCpuSets[slot]);
+}
+
+bool CpuPlacement::pinAcceptThread() const {
+    return ThreadPlacement::pinCurrentThread(m_settings.acceptCpus);
+}
+
+bool CpuPlacement::pinPacerThread() const {
+    return ThreadPlacement::pinCurrentThread(m_settings.pacerCpus);
+}
+
+std::vector<CoreLoad> CpuPlacement::getCoreLoad() const {
+    std::vector<CoreLoad> load;
+    load.reserve(m_coreCounters.size());
+    for (int cpu = 0; cpu < static_cast<int>(m_coreCounters.size()); ++cpu) {
+        load.push_back(CoreLoad{
+            cpu,
+            m_numaNodes[cpu],
+            m_coreCounters[cpu].packets.load(std::memory_order_relaxed),
+            m_coreCounters[cpu].bytes.load(std::memory_order_relaxed),
+        });
+    }
+    return load;
+}
+
+std::vector<int> CpuPlacement::getSessionsPerSlot() {
+    std::lock_guard<std::mutex> lock(m_slotsMutex);
+    return m_sessionsPerSlot;
+}
@@ -0,0 +1,98 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef CPUPLACEMENT_H
+#define CPUPLACEMENT_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "utils/ThreadPlacement.h"
+
+struct AffinitySettings {
+    // CPUs for the publisher/subscriber accept threads, empty leaves them unpinned
+    CpuSet acceptCpus;
+    // CPUs for the shared subscriber pacer thread
+    CpuSet pacerCpus;
+    // Core sets handed out to sessions; all of a session's threads run on one set
+    std::vector<CpuSet> sessionCpuSets;
+};
+
+struct CoreLoad {
+    int cpu;
+    int numaNode;
+    int64_t packets;
+    int64_t bytes;
+};
+
+// Assigns sessions to core sets and keeps per-core load counters.
+// Session threads pin themselves before allocating their buffers, so per-session memory is
+// first-touched (and therefore allocated) on the NUMA node local to the session's cores.
+class CpuPlacement {
+public:
+    explicit CpuPlacement(AffinitySettings settings = AffinitySettings());
+
+    bool hasSessionCpuSets() const { return !m_settings.sessionCpuSets.empty(); }
+
+    // Pick the core set with the fewest sessions, preferring sets that share CPUs with
+    // preferredCpus (e.g. those local to the listener's NIC). -1 when sessions are not pinned.
+    int acquireSessionSlot(const CpuSet &preferredCpus = CpuSet());
+
+    void releaseSessionSlot(int slot);
+
+    bool pinToSessionSlot(int slot) const;
+
+    bool pinAcceptThread() const;
+
+    bool pinPacerThread() const;
+
+    // Account work done by the calling thread to the core it is running on
+    void recordWork(int64_t bytes) {
+        int cpu = ThreadPlacement::currentCpu();
+        if (cpu >= 0 && cpu < static_cast<int>(m_coreCounters.size())) {
+            m_coreCounters[cpu].packets.fetch_add(1, std::memory_order_relaxed);
+            m_coreCounters[cpu].bytes.fetch_add(bytes, std::memory_order_relaxed);
+        }
+    }
+
+    std::vector<CoreLoad> getCoreLoad() const;
+
+    std::vector<int> getSessionsPerSlot();
+
+private:
+    // Padded so cores updating their own counters don't share cache lines
+    struct alignas(64) CoreCounters {
+        std::atomic<int64_t> packets{0};
+        std::atomic<int64_t> bytes{0};
+    };
+
+    AffinitySettings m_settings;
+
+    std::mutex m_slotsMutex;
+    std::vector<int> m_sessionsPerSlot;
+
+    std::vector<CoreCounters> m_coreCounters;
+    std::vector<int> m_numaNodes;
+};
+
+
+#endif //CPUPLACEMENT_H
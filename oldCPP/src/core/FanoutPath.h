@@ -0,0 +1,89 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef FANOUTPATH_H
+#define FANOUTPATH_H
+
+#include <atomic>
+#include <memory>
+#include <typeinfo>
+#include <vector>
+
+#include "utils/SRTHandler.h"
+
+// Transports for sendToAll. Each sends through a static function, so an instantiation over a
+// contiguous target array compiles to direct, inlinable calls rather than a virtual call per subscriber.
+
+// Plain SRT subscribers, straight to srt_sendmsg2
+struct SrtTransport {
+    using Target = SrtTarget;
+
+    static int send(const Target &target, const char *data, int len, const MessageControl &control) {
+        return SRTHandler::sendTo(target, data, len, control);
+    }
+};
+
+// Any StreamHandler through its virtual interface, e.g. test mocks
+struct HandlerTransport {
+    using Target = std::shared_ptr<StreamHandler>;
+
+    static int send(const Target &target, const char *data, int len, const MessageControl &control) {
+        return target->send(data, len, control);
+    }
+};
+
+// Subscribers of one QoS class. Plain SRT subscribers are also kept as a contiguous array of
+// socket targets, which fan-out sends to without virtual calls.
+struct SubscriberClassGroup {
+    std::vector<std::shared_ptr<StreamHandler> > handlers;
+    std::vector<SrtTarget> srtTargets;
+    // Owners of srtTargets, same order
+    std::vector<std::shared_ptr<StreamHandler> > srtHandlers;
+    // Mocks and other StreamHandler implementations, sent to through the interface
+    std::vector<std::shared_ptr<StreamHandler> > otherHandlers;
+
+    void add(const std::shared_ptr<StreamHandler> &subscriber) {
+        handlers.push_back(subscriber);
+        // Only the exact SRTHandler type is safe to bypass, subclasses (mocks) may override send()
+        if (typeid(*subscriber) == typeid(SRTHandler)) {
+            srtTargets.push_back(static_cast<const SRTHandler &>(*subscriber).getSrtTarget());
+            srtHandlers.push_back(subscriber);
+        } else {
+            otherHandlers.push_back(subscriber);
+        }
+    }
+};
+
+// Send one packet to every target. onFailure(index) runs right after a failed send, while the
+// transport's error state still describes that failure.
+template<typename Transport, typename OnFailure>
+void sendToAll(const typename Transport::Target *targets, size_t count, const char *data, int len,
+               const MessageControl &control, const std::atomic<bool> &isDisconnecting, OnFailure &&onFailure) {
+    for (size_t i = 0; i < count; ++i) {
+        if (isDisconnecting.load(std::memory_order_acquire)) {
+            break;
+        }
+        if (Transport::send(targets[i], data, len, control) == STREAM_ERROR) {
+            onFailure(i);
+        }
+    }
+}
+
+
+#endif //FANOUTPATH_H
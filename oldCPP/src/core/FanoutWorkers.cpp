@@ -0,0 +1,190 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "FanoutWorkers.h"
+
+#include <algorithm>
+
+#include "utils/Logger.h"
+
+FanoutWorkers::FanoutWorkers(std::string streamId, FanoutSettings settings,
+                             std::shared_ptr<CpuPlacement> placement, int placementSlot)
+    : m_streamId(std::move(streamId)),
+      m_settings(settings),
+      m_placement(std::move(placement)),
+      m_placementSlot(placementSlot),
+      m_shards(settings.maxWorkers + 1) {
+}
+
+FanoutWorkers::~FanoutWorkers() {
+    stop();
+}
+
+void FanoutWorkers::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_jobMutex);
+        if (!m_running) {
+            return;
+        }
+        m_running = false;
+    }
+    m_jobCV.notify_all();
+
+    for (auto &worker: m_workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    m_workers.clear();
+}
+
+void FanoutWorkers::send(const SubscriberClassGroup &subscribers, const char *data, int len,
+                         const MessageControl &control, const std::atomic<bool> &isDisconnecting,
+                         std::vector<std::shared_ptr<StreamHandler> > &failedSubscribers) {
+    size_t total = subscribers.srtTargets.size() + subscribers.otherHandlers.size();
+    size_t perShard = std::max<size_t>(m_settings.minSubscribersPerShard, 1);
+    size_t shardCount = std::min((total + perShard - 1) / perShard, m_shards.size());
+    shardCount = std::max<size_t>(shardCount, 1);
+    ensureWorkers(shardCount - 1);
+
+    // Even split; the remainder is spread over the first shards
+    size_t baseSize = total / shardCount;
+    size_t remainder = total % shardCount;
+    size_t begin = 0;
+    for (size_t i = 0; i < shardCount; ++i) {
+        size_t size = baseSize + (i < remainder ? 1 : 0);
+        m_shards[i].begin = begin;
+        m_shards[i].end = begin + size;
+        m_shards[i].failed.clear();
+        begin += size;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_jobMutex);
+        m_subscribers = &subscribers;
+        m_data = data;
+        m_len = len;
+        m_control = &control;
+        m_isDisconnecting = &isDisconnecting;
+        m_activeShards = shardCount;
+        m_pendingShards = shardCount - 1;
+        ++m_generation;
+    }
+    m_jobCV.notify_all();
+
+    // The calling thread serves the first shard while the workers serve the rest
+    sendShard(m_shards[0]);
+
+    {
+        std::unique_lock<std::mutex> lock(m_jobMutex);
+        m_doneCV.wait(lock, [this] { return m_pendingShards == 0; });
+        m_subscribers = nullptr;
+    }
+
+    for (size_t i = 0; i < shardCount; ++i) {
+        failedSubscribers.insert(failedSubscribers.end(), m_shards[i].failed.begin(), m_shards[i].failed.end());
+    }
+}
+
+int64_t FanoutWorkers::getCpuMicros() const {
+    std::lock_guard<std::mutex> lock(m_jobMutex);
+    int64_t total = 0;
+    for (const auto &clock: m_workerClocks) {
+        total += clock.cpuMicros();
+    }
+    return total;
+}
+
+void FanoutWorkers::ensureWorkers(size_t workerCount) {
+    while (m_workers.size() < workerCount) {
+        // Shard 0 belongs to the caller, worker N serves shard N + 1
+        m_workers.emplace_back(&FanoutWorkers::workerThread, this, m_workers.size() + 1);
+        LOG_INFO("Started fan-out worker", LogFields().stream(m_streamId)
+                 .with("workers=" + std::to_string(m_workers.size())));
+    }
+}
+
+void FanoutWorkers::workerThread(size_t shardIndex) {
+    // Share the session's cores so fan-out stays next to ingest
+    if (m_placement && m_placementSlot >= 0) {
+        m_placement->pinToSessionSlot(m_placementSlot);
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_jobMutex);
+        m_workerClocks.push_back(ThreadCpuClock::forCurrentThread());
+    }
+
+    uint64_t lastGeneration = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_jobMutex);
+            m_jobCV.wait(lock, [this, lastGeneration] {
+                return !m_running || m_generation != lastGeneration;
+            });
+            if (!m_running) {
+                return;
+            }
+            lastGeneration = m_generation;
+            if (shardIndex >= m_activeShards) {
+                continue;
+            }
+        }
+
+        sendShard(m_shards[shardIndex]);
+
+        bool lastShard; {
+            std::lock_guard<std::mutex> lock(m_jobMutex);
+            lastShard = --m_pendingShards == 0;
+        }
+        if (lastShard) {
+            m_doneCV.notify_one();
+        }
+    }
+}
+
+void FanoutWorkers::sendShard(Shard &shard) {
+    const SubscriberClassGroup &subscribers = *m_subscribers;
+    size_t srtCount = subscribers.srtTargets.size();
+
+    size_t srtBegin = std::min(shard.begin, srtCount);
+    size_t srtEnd = std::min(shard.end, srtCount);
+    sendToAll<SrtTransport>(subscribers.srtTargets.data() + srtBegin, srtEnd - srtBegin, m_data, m_len, *m_control,
+                            *m_isDisconnecting, [&](size_t index) {
+                                const auto &subscriber = subscribers.srtHandlers[srtBegin + index];
+                                LOG_WARNING("Failed to send data to subscriber", LogFields()
+                                            .stream(m_streamId)
+                                            .from(subscriber->getPeerAddress())
+                                            .error(srt_getlasterror(nullptr))
+                                            .with(srt_getlasterror_str()));
+                                shard.failed.push_back(subscriber);
+                            });
+
+    size_t otherBegin = std::max(shard.begin, srtCount) - srtCount;
+    size_t otherEnd = std::max(shard.end, srtCount) - srtCount;
+    sendToAll<HandlerTransport>(subscribers.otherHandlers.data() + otherBegin, otherEnd - otherBegin, m_data, m_len,
+                                *m_control, *m_isDisconnecting, [&](size_t index) {
+                                    const auto &subscriber = subscribers.otherHandlers[otherBegin + index];
+                                    LOG_WARNING("Failed to send data to subscriber", LogFields()
+                                                .stream(m_streamId)
+                                                .from(subscriber->getPeerAddress())
+                                                .error(subscriber->getLastErrorCode())
+                                                .with(subscriber->getLastErrorMessage()));
+                                    shard.failed.push_back(subscriber);
+                                });
+}
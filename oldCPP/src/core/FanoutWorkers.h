@@ -0,0 +1,113 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef FANOUTWORKERS_H
+#define FANOUTWORKERS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CpuPlacement.h"
+#include "FanoutPath.h"
+#include "utils/StreamHandler.h"
+#include "utils/ThreadCpuClock.h"
+
+struct FanoutSettings {
+    // Subscriber count above which a session splits its fan-out across worker threads
+    size_t shardThreshold = 512;
+    // Smallest shard worth handing to a separate thread
+    size_t minSubscribersPerShard = 256;
+    // Worker threads per session, the publisher thread always serves one shard itself
+    size_t maxWorkers = 3;
+};
+
+// Splits one session's subscriber list into shards sent to in parallel.
+// Every shard reads the same packet buffer; send() returns once all shards are done,
+// so the buffer can be reused and each subscriber still sees packets in order.
+// Shards are slices of the group's SRT targets and other handlers, sent to with sendToAll.
+class FanoutWorkers {
+public:
+    FanoutWorkers(std::string streamId, FanoutSettings settings,
+                  std::shared_ptr<CpuPlacement> placement = nullptr, int placementSlot = -1);
+
+    ~FanoutWorkers();
+
+    void send(const SubscriberClassGroup &subscribers, const char *data, int len,
+              const MessageControl &control, const std::atomic<bool> &isDisconnecting,
+              std::vector<std::shared_ptr<StreamHandler> > &failedSubscribers);
+
+    void stop();
+
+    size_t getWorkerCount() const { return m_workers.size(); }
+
+    // True if the pool was built for these sharding settings
+    bool hasSettings(const FanoutSettings &settings) const {
+        return settings.maxWorkers == m_settings.maxWorkers &&
+               settings.minSubscribersPerShard == m_settings.minSubscribersPerShard;
+    }
+
+    // CPU time used by the worker threads, safe to call from any thread
+    int64_t getCpuMicros() const;
+
+private:
+    // A range over the group's SRT targets followed by its other handlers
+    struct Shard {
+        size_t begin = 0;
+        size_t end = 0;
+        std::vector<std::shared_ptr<StreamHandler> > failed;
+    };
+
+    void ensureWorkers(size_t workerCount);
+
+    void workerThread(size_t shardIndex);
+
+    void sendShard(Shard &shard);
+
+    std::string m_streamId;
+    FanoutSettings m_settings;
+    std::shared_ptr<CpuPlacement> m_placement;
+    int m_placementSlot;
+
+    // Current job, only written by send() while no shard is in progress
+    const SubscriberClassGroup *m_subscribers = nullptr;
+    const char *m_data = nullptr;
+    int m_len = 0;
+    const MessageControl *m_control = nullptr;
+    const std::atomic<bool> *m_isDisconnecting = nullptr;
+    std::vector<Shard> m_shards;
+    size_t m_activeShards = 0;
+
+    mutable std::mutex m_jobMutex;
+    std::condition_variable m_jobCV;
+    std::condition_variable m_doneCV;
+    uint64_t m_generation = 0;
+    size_t m_pendingShards = 0;
+    bool m_running = true;
+    std::vector<ThreadCpuClock> m_workerClocks;
+
+    std::vector<std::thread> m_workers;
+};
+
+
+#endif //FANOUTWORKERS_H
@@ -0,0 +1,131 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "LatencyPolicy.h"
+
+#include <sstream>
+
+namespace {
+    double parseLimit(const std::string &value) {
+        return value == "*" ? std::numeric_limits<double>::infinity() : std::stod(value);
+    }
+}
+
+bool LatencySettings::parseTiers(const std::string &value, std::vector<LatencyTier> &tiers) {
+    std::vector<LatencyTier> parsed;
+    std::stringstream stream(value);
+    std::string tier;
+
+    try {
+        while (std::getline(stream, tier, ',')) {
+            std::stringstream fields(tier);
+            std::string rtt, loss, latency;
+            if (!std::getline(fields, rtt, '/') || !std::getline(fields, loss, '/') ||
+                !std::getline(fields, latency)) {
+                return false;
+            }
+            parsed.push_back(LatencyTier{parseLimit(rtt), parseLimit(loss), std::stoi(latency)});
+        }
+    } catch (const std::exception &) {
+        return false;
+    }
+
+    if (parsed.empty()) {
+        return false;
+    }
+    tiers = parsed;
+    return true;
+}
+
+LatencyPolicy::LatencyPolicy(LatencySettings settings)
+    : m_settings(std::make_shared<const LatencySettings>(std::move(settings))) {
+}
+
+void LatencyPolicy::setSettings(LatencySettings settings) {
+    std::atomic_store(&m_settings, std::shared_ptr<const LatencySettings>(
+                          std::make_shared<const LatencySettings>(std::move(settings))));
+}
+
+int LatencyPolicy::chooseLatencyMs(const std::string &peerHost) {
+    auto settings = std::atomic_load(&m_settings);
+    if (!settings->adaptive) {
+        return settings->defaultLatencyMs;
+    }
+
+    std::lock_guard<std::mutex> lock(m_peersMutex);
+    auto it = m_peers.find(peerHost);
+    if (it == m_peers.end()) {
+        return settings->defaultLatencyMs;
+    }
+    if (std::chrono::steady_clock::now() - it->second.lastSeen > settings->peerTtl) {
+        m_lru.erase(it->second.lruPosition);
+        m_peers.erase(it);
+        return settings->defaultLatencyMs;
+    }
+    return latencyForSample(it->second.smoothed);
+}
+
+void LatencyPolicy::recordSample(const std::string &peerHost, const LinkSample &sample) {
+    if (peerHost.empty()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_peersMutex);
+    auto now = std::chrono::steady_clock::now();
+    auto it = m_peers.find(peerHost);
+    if (it != m_peers.end()) {
+        LinkSample &smoothed = it->second.smoothed;
+        smoothed.rttMs += SMOOTHING * (sample.rttMs - smoothed.rttMs);
+        smoothed.lossPercent += SMOOTHING * (sample.lossPercent - smoothed.lossPercent);
+        it->second.lastSeen = now;
+        m_lru.splice(m_lru.begin(), m_lru, it->second.lruPosition);
+        return;
+    }
+
+    if (m_peers.size() >= std::atomic_load(&m_settings)->maxPeers && !m_lru.empty()) {
+        m_peers.erase(m_lru.back());
+        m_lru.pop_back();
+    }
+    m_lru.push_front(peerHost);
+    m_peers[peerHost] = PeerEntry{sample, now, m_lru.begin()};
+}
+
+int LatencyPolicy::latencyForSample(const LinkSample &sample) const {
+    auto settings = std::atomic_load(&m_settings);
+    for (const auto &tier: settings->tiers) {
+        if (sample.rttMs <= tier.maxRttMs && sample.lossPercent <= tier.maxLossPercent) {
+            return tier.latencyMs;
+        }
+    }
+    return settings->tiers.empty() ? settings->defaultLatencyMs : settings->tiers.back().latencyMs;
+}
+
+size_t LatencyPolicy::getPeerCount() {
+    std::lock_guard<std::mutex> lock(m_peersMutex);
+    return m_peers.size();
+}
+
+std::string LatencyPolicy::hostFromAddress(const std::string &address) {
+    if (!address.empty() && address[0] == '[') {
+        size_t end = address.find(']');
+        return end == std::string::npos ? address : address.substr(1, end - 1);
+    }
+    size_t colon = address.rfind(':');
+    return colon == std::string::npos ? address : address.substr(0, colon);
+}
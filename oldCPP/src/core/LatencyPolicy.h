@@ -0,0 +1,102 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LATENCYPOLICY_H
+#define LATENCYPOLICY_H
+
+#include <chrono>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Links with RTT and loss at or below the limits get the tier's latency
+struct LatencyTier {
+    double maxRttMs;
+    double maxLossPercent;
+    int latencyMs;
+};
+
+struct LatencySettings {
+    bool adaptive = true;
+    // Used for peers we have no measurements for yet
+    int defaultLatencyMs = 120;
+    // Checked in order, the first matching tier wins
+    std::vector<LatencyTier> tiers = {
+        {10, 1, 40},
+        {30, 2, 120},
+        {60, 5, 250},
+        {120, 10, 500},
+        {std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity(), 1000},
+    };
+    // Remembered peers, least recently seen are evicted first
+    size_t maxPeers = 10000;
+    std::chrono::minutes peerTtl{60};
+
+    // Parse "rtt/loss/latency" tiers separated by commas, '*' means unlimited
+    static bool parseTiers(const std::string &value, std::vector<LatencyTier> &tiers);
+};
+
+struct LinkSample {
+    double rttMs;
+    double lossPercent;
+};
+
+// Chooses the SRT latency for a subscriber from what previous connections from the same
+// host measured. Samples are smoothed so one bad session doesn't swing the choice.
+class LatencyPolicy {
+public:
+    explicit LatencyPolicy(LatencySettings settings = LatencySettings());
+
+    int chooseLatencyMs(const std::string &peerHost);
+
+    void recordSample(const std::string &peerHost, const LinkSample &sample);
+
+    int latencyForSample(const LinkSample &sample) const;
+
+    size_t getPeerCount();
+
+    // New tiers apply to the next choice; remembered peers are kept
+    void setSettings(LatencySettings settings);
+
+    // "1.2.3.4:5000" -> "1.2.3.4", "[::1]:5000" -> "::1"
+    static std::string hostFromAddress(const std::string &address);
+
+private:
+    struct PeerEntry {
+        LinkSample smoothed;
+        std::chrono::steady_clock::time_point lastSeen;
+        std::list<std::string>::iterator lruPosition;
+    };
+
+    // Replaced whole on reload, readers keep the copy they loaded
+    std::shared_ptr<const LatencySettings> m_settings;
+
+    std::mutex m_peersMutex;
+    std::unordered_map<std::string, PeerEntry> m_peers;
+    std::list<std::string> m_lru;
+
+    static constexpr double SMOOTHING = 0.3;
+};
+
+
+#endif //LATENCYPOLICY_H
@@ -0,0 +1,53 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "QosPolicy.h"
+
+QosClass QosSettings::classOf(const StreamIdParams &params) const {
+    QosClass qosClass = defaultClass;
+    if (params.has("qos")) {
+        parseClass(params.get("qos"), qosClass);
+    }
+    return qosClass;
+}
+
+bool QosSettings::parseClass(const std::string &name, QosClass &qosClass) {
+    if (name == "critical") {
+        qosClass = QosClass::Critical;
+    } else if (name == "standard") {
+        qosClass = QosClass::Standard;
+    } else if (name == "best_effort" || name == "preview") {
+        qosClass = QosClass::BestEffort;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char *QosSettings::className(QosClass qosClass) {
+    switch (qosClass) {
+        case QosClass::Critical:
+            return "critical";
+        case QosClass::Standard:
+            return "standard";
+        case QosClass::BestEffort:
+            return "best_effort";
+    }
+    return "unknown";
+}
@@ -0,0 +1,70 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef QOSPOLICY_H
+#define QOSPOLICY_H
+
+#include <array>
+#include <chrono>
+#include <string>
+
+#include "utils/StreamIdParams.h"
+
+// Subscriber priority, picked with the "qos" stream ID parameter. Lower classes are sent to first.
+enum class QosClass {
+    Critical = 0,
+    Standard = 1,
+    BestEffort = 2,
+};
+
+constexpr size_t QOS_CLASS_COUNT = 3;
+
+struct QosClassSettings {
+    // A packet that has been in the server longer than this skips the class, 0 never skips
+    std::chrono::microseconds sendBudget{0};
+    // Paced subscriber queue limit, as a percentage of pacing.max_queued_packets
+    int queuePercent = 100;
+};
+
+struct QosSettings {
+    QosClass defaultClass = QosClass::Standard;
+    // Indexed by QosClass. Best-effort previews are shed first when fan-out falls behind.
+    std::array<QosClassSettings, QOS_CLASS_COUNT> classes{{
+        {std::chrono::microseconds(0), 400},
+        {std::chrono::microseconds(0), 100},
+        {std::chrono::microseconds(20000), 50},
+    }};
+    // Best effort subscribers an overload has starved this long are disconnected, 0 keeps them
+    std::chrono::milliseconds overloadDisconnect{5000};
+
+    const QosClassSettings &get(QosClass qosClass) const { return classes[static_cast<size_t>(qosClass)]; }
+
+    QosClassSettings &get(QosClass qosClass) { return classes[static_cast<size_t>(qosClass)]; }
+
+    // Class from the subscriber's stream ID, the default class if absent or unknown
+    QosClass classOf(const StreamIdParams &params) const;
+
+    // "critical", "standard" or "best_effort" ("preview" is accepted too)
+    static bool parseClass(const std::string &name, QosClass &qosClass);
+
+    static const char *className(QosClass qosClass);
+};
+
+
+#endif //QOSPOLICY_H
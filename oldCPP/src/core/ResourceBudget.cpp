@@ -0,0 +1,67 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "ResourceBudget.h"
+
+#include <algorithm>
+
+ResourceBudget::ResourceBudget(ResourceBudgetSettings settings)
+    : m_settings(settings) {
+}
+
+std::vector<StreamUsage> ResourceBudget::evaluate(const std::vector<std::pair<std::string, SessionUsage> > &samples,
+                                                  std::chrono::steady_clock::time_point now, bool &nodeOverBudget) {
+    double elapsedMicros = m_lastSample == std::chrono::steady_clock::time_point()
+                               ? 0.0
+                               : static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(
+                                   now - m_lastSample).count());
+    m_lastSample = now;
+
+    std::unordered_map<std::string, int64_t> cpuMicros;
+    std::vector<StreamUsage> results;
+    results.reserve(samples.size());
+    double totalCpuPercent = 0.0;
+    size_t totalBufferedBytes = 0;
+    for (const auto &sample: samples) {
+        StreamUsage result;
+        result.streamId = sample.first;
+        result.usage = sample.second;
+
+        // A stream seen for the first time has no rate yet
+        auto last = m_lastCpuMicros.find(sample.first);
+        if (last != m_lastCpuMicros.end() && elapsedMicros > 0) {
+            int64_t used = std::max<int64_t>(sample.second.cpuMicros - last->second, 0);
+            result.cpuPercent = static_cast<double>(used) * 100.0 / elapsedMicros;
+        }
+        cpuMicros[sample.first] = sample.second.cpuMicros;
+
+        result.overBudget =
+                (m_settings.streamCpuPercent > 0 && result.cpuPercent > m_settings.streamCpuPercent) ||
+                (m_settings.streamBufferedBytes > 0 && result.usage.bufferedBytes > m_settings.streamBufferedBytes);
+        totalCpuPercent += result.cpuPercent;
+        totalBufferedBytes += result.usage.bufferedBytes;
+        results.push_back(std::move(result));
+    }
+    // Streams that ended are forgotten
+    m_lastCpuMicros.swap(cpuMicros);
+
+    nodeOverBudget = (m_settings.totalCpuPercent > 0 && totalCpuPercent > m_settings.totalCpuPercent) ||
+                     (m_settings.totalBufferedBytes > 0 && totalBufferedBytes > m_settings.totalBufferedBytes);
+    return results;
+}
@@ -0,0 +1,80 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef RESOURCEBUDGET_H
+#define RESOURCEBUDGET_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// What one session costs the node. CPU time and allocations are cumulative.
+struct SessionUsage {
+    // Publisher and fan-out worker threads
+    int64_t cpuMicros = 0;
+    // Paced subscriber queues, packets queued in outputs and partial repacked payloads
+    size_t bufferedBytes = 0;
+    // Output buffers allocated up front, not budgeted
+    size_t reservedBytes = 0;
+    // Packet copies and subscriber snapshots made by the session
+    uint64_t allocations = 0;
+    size_t subscribers = 0;
+};
+
+// CPU budgets are percent of one core, so a node budget of 400 allows four busy cores. 0 disables a budget.
+struct ResourceBudgetSettings {
+    int streamCpuPercent = 0;
+    size_t streamBufferedBytes = 0;
+    int totalCpuPercent = 0;
+    size_t totalBufferedBytes = 0;
+    std::chrono::milliseconds checkInterval{1000};
+};
+
+struct StreamUsage {
+    std::string streamId;
+    SessionUsage usage;
+    // Over the last check interval
+    double cpuPercent = 0.0;
+    bool overBudget = false;
+};
+
+// Turns periodic usage samples into rates and checks them against the per-stream and node budgets
+class ResourceBudget {
+public:
+    explicit ResourceBudget(ResourceBudgetSettings settings = ResourceBudgetSettings());
+
+    // nodeOverBudget is set when the sum of all streams is past a node budget
+    std::vector<StreamUsage> evaluate(const std::vector<std::pair<std::string, SessionUsage> > &samples,
+                                      std::chrono::steady_clock::time_point now, bool &nodeOverBudget);
+
+    const ResourceBudgetSettings &getSettings() const { return m_settings; }
+
+    void setSettings(ResourceBudgetSettings settings) { m_settings = settings; }
+
+private:
+    ResourceBudgetSettings m_settings;
+    std::unordered_map<std::string, int64_t> m_lastCpuMicros;
+    std::chrono::steady_clock::time_point m_lastSample{};
+};
+
+
+#endif //RESOURCEBUDGET_H
@@ -18,11 +18,21 @@
  */
 
 #include "SRTServer.h"
-#include <iostream>
 
+#include <algorithm>
 
-SRTServer::SRTServer()
-    : m_streamManager(std::make_shared<StreamManager>()) {
+#include "utils/FileReplayHandler.h"
+#include "utils/Logger.h"
+#include "utils/NetworkAddress.h"
+#include "utils/StreamIdParams.h"
+
+
+SRTServer::SRTServer(const ServerConfig &config, std::string configPath)
+    : m_config(config),
+      m_configPath(std::move(configPath)),
+      m_streamManager(std::make_shared<StreamManager>(config)),
+      m_latencyPolicy(std::make_shared<LatencyPolicy>(config.latency)),
+      m_redirectPeerCount(config.drain.redirectPeers.size()) {
 }
 
 SRTServer::~SRTServer() {
@@ -32,102 +42,584 @@ SRTServer::~SRTServer() {
 
 bool SRTServer::initialize() {
     if (!initializeSrt()) {
-        std::cerr << "Failed to initialize SRT" << std::endl;
+        LOG_ERROR("Failed to initialize SRT");
         return false;
     }
 
-    m_publisherSocket = createSocket(PUBLISHER_PORT);
-    if (m_publisherSocket == SRT_INVALID_SOCK) {
-        std::cerr << "Failed to create publisher socket" << std::endl;
+    if (!addListeners(m_config.listen.publisher, true) || !addListeners(m_config.listen.subscriber, false)) {
+        closeListeners();
         return false;
     }
 
-    m_subscriberSocket = createSocket(SUBSCRIBER_PORT);
-    if (m_subscriberSocket == SRT_INVALID_SOCK) {
-        std::cerr << "Failed to create subscriber socket" << std::endl;
-        srt_close(m_publisherSocket);
-        return false;
+    LOG_INFO("SRT Server initialized");
+    for (const auto &listener: m_listeners) {
+        std::string cpus = listener->cpus.empty() ? "" : " cpus=" + ThreadPlacement::formatCpuList(listener->cpus);
+        LOG_INFO(listener->isPublisher ? "Publisher listener" : "Subscriber listener",
+                 LogFields().with(listener->address + cpus));
     }
 
-    std::cout << "SRT Server initialized" << std::endl;
-    std::cout << "Publisher port: " << PUBLISHER_PORT << std::endl;
-    std::cout << "Subscriber port: " << SUBSCRIBER_PORT << std::endl;
-
     return true;
 }
 
 bool SRTServer::start() {
     if (m_running.exchange(true)) {
-        std::cerr << "Server is already running" << std::endl;
+        LOG_WARNING("Server is already running");
         return false;
     }
 
-    m_publisherThread = std::make_unique<std::thread>(&SRTServer::handleConnections, this,
-                                                      m_publisherSocket, true);
-    m_subscriberThread = std::make_unique<std::thread>(&SRTServer::handleConnections, this,
-                                                       m_subscriberSocket, false);
+    for (auto &listener: m_listeners) {
+        listener->thread = std::make_unique<std::thread>(&SRTServer::handleConnections, this, std::ref(*listener));
+    }
+    m_statsTimer = m_streamManager->getTimers()->scheduleRepeating(STATS_REPORT_INTERVAL, [this] {
+        reportStats();
+    });
+
+    // Snapshots are taken on the timer thread so admin reads never wait on a session
+    m_streamManager->publishAdminSnapshot();
+    m_snapshotTimer = m_streamManager->getTimers()->scheduleRepeating(m_config.admin.snapshotInterval, [this] {
+        m_streamManager->publishAdminSnapshot();
+    });
+    // The listen callbacks only read placements, the directory is polled here off the handshake path
+    if (auto cluster = m_streamManager->getCluster()) {
+        cluster->refreshPlacements();
+        m_placementTimer = m_streamManager->getTimers()->scheduleRepeating(cluster->getRefreshInterval(), [cluster] {
+            cluster->refreshPlacements();
+        });
+    }
+    if (!m_config.admin.socketPath.empty()) {
+        m_adminServer = std::make_unique<AdminServer>(m_config.admin, m_streamManager);
+        m_adminServer->setReloadHandler([this](std::vector<std::string> &notApplied) {
+            return reload(notApplied);
+        });
+        m_adminServer->setDrainHandler([this](bool draining) {
+            draining ? startDrain() : stopDrain();
+        });
+        if (!m_adminServer->start()) {
+            m_adminServer.reset();
+        }
+    }
+    startReplays();
 
     return true;
 }
 
+void SRTServer::startReplays() {
+    for (const auto &file: m_config.replay.files) {
+        auto source = ReplaySource::open(file.second, m_config.replay.bitrate);
+        if (!source) {
+            continue;
+        }
+        int copies = std::max(m_config.replay.copies, 1);
+        for (int i = 0; i < copies; ++i) {
+            std::string streamId = copies == 1 ? file.first : file.first + "-" + std::to_string(i);
+            auto handler = std::make_shared<FileReplayHandler>(source, streamId, m_config.replay.loop);
+            m_streamManager->onPublisherConnected(handler);
+        }
+        LOG_INFO("Replaying file", LogFields().stream(file.first).with(
+                     file.second + " copies=" + std::to_string(copies) + " duration_ms=" +
+                     std::to_string(source->getDurationMicros() / 1000)));
+    }
+}
+
 void SRTServer::stop() {
     if (!m_running.exchange(false)) {
         return;
     }
 
-    srt_close(m_publisherSocket);
-    srt_close(m_subscriberSocket);
-
-    if (m_publisherThread && m_publisherThread->joinable()) {
-        m_publisherThread->join();
-    }
-    if (m_subscriberThread && m_subscriberThread->joinable()) {
-        m_subscriberThread->join();
+    // The admin thread may be reloading, stop it before taking the reload lock
+    if (m_adminServer) {
+        m_adminServer->stop();
+        m_adminServer.reset();
     }
+    std::lock_guard<std::mutex> lock(m_reloadMutex);
+    closeListeners();
 
+    // Waits for a report that may be running before the manager goes away
+    m_streamManager->getTimers()->cancel(m_drainTimer);
+    m_streamManager->getTimers()->cancel(m_statsTimer);
+    m_streamManager->getTimers()->cancel(m_snapshotTimer);
+    m_streamManager->getTimers()->cancel(m_placementTimer);
+    m_streamManager->getTimers()->stop();
     m_streamManager.reset();
     srt_cleanup();
 }
 
-void SRTServer::handleConnections(SRTSOCKET listener, bool isPublisher) {
-    while (m_running.load(std::memory_order_acquire)) {
+namespace {
+    std::string portOf(const std::string &address, bool &isIpv6) {
+        std::string host;
+        std::string port;
+        NetworkAddress::splitHostPort(address, host, port);
+        isIpv6 = host.find(':') != std::string::npos;
+        return port;
+    }
+
+    // An IPv6 wildcard socket has to leave the port to an IPv4 listener that shares it
+    bool needsIpv6Only(const std::vector<ListenAddress> &addresses, const ListenAddress &listenAddress) {
+        bool isIpv6 = false;
+        std::string port = portOf(listenAddress.address, isIpv6);
+        return isIpv6 && std::any_of(addresses.begin(), addresses.end(), [&](const ListenAddress &other) {
+            bool otherIsIpv6 = false;
+            return portOf(other.address, otherIsIpv6) == port && !otherIsIpv6;
+        });
+    }
+
+    bool sameListenAddress(const ListenAddress &a, const ListenAddress &b) {
+        return a.address == b.address && a.cpus == b.cpus;
+    }
+
+    bool sameReplay(const ReplaySettings &a, const ReplaySettings &b) {
+        return a.files == b.files && a.copies == b.copies && a.loop == b.loop && a.bitrate == b.bitrate;
+    }
+
+    bool sameAffinity(const AffinitySettings &a, const AffinitySettings &b) {
+        return a.acceptCpus == b.acceptCpus && a.pacerCpus == b.pacerCpus && a.sessionCpuSets == b.sessionCpuSets;
+    }
+
+    bool sameCluster(const ClusterSettings &a, const ClusterSettings &b) {
+        return a.nodeAddress == b.nodeAddress && a.nodes == b.nodes && a.directoryPath == b.directoryPath &&
+               a.cacheTtl == b.cacheTtl && a.registrationTtl == b.registrationTtl &&
+               a.pointsPerNode == b.pointsPerNode;
+    }
+}
+
+bool SRTServer::addListeners(const std::vector<ListenAddress> &addresses, bool isPublisher) {
+    for (const auto &listenAddress: addresses) {
+        if (!addListener(listenAddress, isPublisher, needsIpv6Only(addresses, listenAddress))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SRTServer::addListener(const ListenAddress &listenAddress, bool isPublisher, bool ipv6Only) {
+    auto listener = std::make_unique<Listener>();
+    listener->address = listenAddress.address;
+    listener->configuredCpus = listenAddress.cpus;
+    listener->isPublisher = isPublisher;
+    listener->cpus = listenerCpus(listenAddress);
+    srt_listen_callback_fn *callback = isPublisher
+                                           ? &SRTServer::publisherListenCallback
+                                           : &SRTServer::subscriberListenCallback;
+
+    if (listener->cpus.empty()) {
+        listener->socket = createSocket(listener->address, ipv6Only, callback);
+    } else {
+        // SRT starts the socket's send/receive threads when it binds. On Linux they inherit the
+        // creating thread's affinity, so bind from a thread already pinned to the listener's CPUs.
+        std::thread([&] {
+            ThreadPlacement::pinCurrentThread(listener->cpus);
+            listener->socket = createSocket(listener->address, ipv6Only, callback);
+        }).join();
+    }
+    if (listener->socket == SRT_INVALID_SOCK) {
+        LOG_ERROR("Failed to create listener", LogFields().with(listener->address));
+        return false;
+    }
+    m_listeners.push_back(std::move(listener));
+    return true;
+}
+
+void SRTServer::closeListener(Listener &listener) {
+    listener.active = false;
+    if (listener.socket != SRT_INVALID_SOCK) {
+        srt_close(listener.socket);
+        listener.socket = SRT_INVALID_SOCK;
+    }
+    if (listener.thread && listener.thread->joinable()) {
+        listener.thread->join();
+    }
+}
+
+void SRTServer::closeListeners() {
+    for (auto &listener: m_listeners) {
+        listener->active = false;
+        if (listener->socket != SRT_INVALID_SOCK) {
+            srt_close(listener->socket);
+            listener->socket = SRT_INVALID_SOCK;
+        }
+    }
+    for (auto &listener: m_listeners) {
+        closeListener(*listener);
+    }
+    m_listeners.clear();
+}
+
+void SRTServer::updateListeners(const ListenerSettings &settings, std::vector<std::string> &notApplied) {
+    // Listeners no longer configured stop accepting; sessions they accepted keep running
+    for (auto it = m_listeners.begin(); it != m_listeners.end();) {
+        const auto &addresses = (*it)->isPublisher ? settings.publisher : settings.subscriber;
+        ListenAddress current{(*it)->address, (*it)->configuredCpus};
+        bool kept = std::any_of(addresses.begin(), addresses.end(), [&current](const ListenAddress &address) {
+            return sameListenAddress(address, current);
+        });
+        if (kept) {
+            ++it;
+            continue;
+        }
+        LOG_INFO((*it)->isPublisher ? "Closing publisher listener" : "Closing subscriber listener",
+                 LogFields().with((*it)->address));
+        closeListener(**it);
+        it = m_listeners.erase(it);
+    }
+
+    for (bool isPublisher: {true, false}) {
+        const auto &addresses = isPublisher ? settings.publisher : settings.subscriber;
+        for (const auto &listenAddress: addresses) {
+            bool exists = std::any_of(m_listeners.begin(), m_listeners.end(), [&](const std::unique_ptr<Listener> &l) {
+                return l->isPublisher == isPublisher && sameListenAddress({l->address, l->configuredCpus}, listenAddress);
+            });
+            if (exists) {
+                continue;
+            }
+            if (!addListener(listenAddress, isPublisher, needsIpv6Only(addresses, listenAddress))) {
+                notApplied.push_back(std::string(isPublisher ? "listen.publisher " : "listen.subscriber ") +
+                                     listenAddress.address);
+                continue;
+            }
+            auto &listener = *m_listeners.back();
+            LOG_INFO(isPublisher ? "Publisher listener" : "Subscriber listener", LogFields().with(listener.address));
+            if (m_running) {
+                listener.thread = std::make_unique<std::thread>(&SRTServer::handleConnections, this,
+                                                                std::ref(listener));
+            }
+        }
+    }
+}
+
+bool SRTServer::reload(std::vector<std::string> &notApplied) {
+    std::lock_guard<std::mutex> lock(m_reloadMutex);
+    if (m_configPath.empty() || !m_streamManager) {
+        LOG_WARNING("No config file to reload");
+        return false;
+    }
+    ServerConfig config;
+    if (!ServerConfig::loadFromFile(m_configPath, config)) {
+        return false;
+    }
+
+    // These are wired into running threads and shared resources; keep the old values until a restart
+    notApplied.clear();
+    if (!sameAffinity(config.affinity, m_config.affinity)) {
+        notApplied.emplace_back("affinity");
+        config.affinity = m_config.affinity;
+    }
+    if (config.listen.pinToNicNode != m_config.listen.pinToNicNode) {
+        notApplied.emplace_back("listen.pin_to_nic_node");
+        config.listen.pinToNicNode = m_config.listen.pinToNicNode;
+    }
+    if (config.timerTick != m_config.timerTick) {
+        notApplied.emplace_back("timers.tick_ms");
+        config.timerTick = m_config.timerTick;
+    }
+    if (!sameReplay(config.replay, m_config.replay)) {
+        notApplied.emplace_back("replay");
+        config.replay = m_config.replay;
+    }
+    if (!sameCluster(config.cluster, m_config.cluster)) {
+        notApplied.emplace_back("cluster");
+        config.cluster = m_config.cluster;
+    }
+    if (config.admin.socketPath != m_config.admin.socketPath) {
+        notApplied.emplace_back("admin.socket_path");
+        config.admin.socketPath = m_config.admin.socketPath;
+    }
+
+    Logger::instance().configure(config.log);
+    m_latencyPolicy->setSettings(config.latency);
+    m_streamManager->applyConfig(config);
+    m_redirectPeerCount = config.drain.redirectPeers.size();
+    if (m_running && config.admin.snapshotInterval != m_config.admin.snapshotInterval) {
+        m_streamManager->getTimers()->cancel(m_snapshotTimer);
+        m_snapshotTimer = m_streamManager->getTimers()->scheduleRepeating(config.admin.snapshotInterval, [this] {
+            m_streamManager->publishAdminSnapshot();
+        });
+    }
+
+    // New listeners read the backlog from m_config
+    m_config = config;
+    updateListeners(config.listen, notApplied);
+
+    std::string skipped;
+    for (const auto &setting: notApplied) {
+        skipped += (skipped.empty() ? "" : ", ") + setting;
+    }
+    if (skipped.empty()) {
+        LOG_INFO("Configuration reloaded", LogFields().with(m_configPath));
+    } else {
+        LOG_WARNING("Configuration reloaded, some settings need a restart",
+                    LogFields().with(m_configPath + ": " + skipped));
+    }
+    return true;
+}
+
+void SRTServer::startDrain() {
+    std::lock_guard<std::mutex> lock(m_reloadMutex);
+    if (!m_running || m_streamManager->isDraining()) {
+        return;
+    }
+    m_streamManager->setDraining(true);
+    LOG_INFO("Draining for shutdown", LogFields().with(
+                 "sessions=" + std::to_string(m_streamManager->getSessionCount()) + " deadline_s=" +
+                 std::to_string(m_config.drain.deadline.count()) + " redirect_peers=" +
+                 std::to_string(m_config.drain.redirectPeers.size())));
+
+    auto spread = m_config.drain.closeSpread;
+    m_drainTimer = m_streamManager->getTimers()->schedule(m_config.drain.deadline, [this, spread] {
+        m_streamManager->dropAllStreams(spread);
+    });
+}
+
+void SRTServer::stopDrain() {
+    std::lock_guard<std::mutex> lock(m_reloadMutex);
+    if (!m_running || !m_streamManager->isDraining()) {
+        return;
+    }
+    m_streamManager->getTimers()->cancel(m_drainTimer);
+    m_drainTimer = TimerWheel::INVALID_TIMER;
+    m_streamManager->setDraining(false);
+}
+
+bool SRTServer::isDraining() const {
+    return m_running && m_streamManager->isDraining();
+}
+
+bool SRTServer::isDrainComplete() const {
+    return isDraining() && m_streamManager->getSessionCount() == 0;
+}
+
+CpuSet SRTServer::listenerCpus(const ListenAddress &listenAddress) const {
+    if (!listenAddress.cpus.empty() || !m_config.listen.pinToNicNode) {
+        return listenAddress.cpus;
+    }
+
+    // A wildcard listener spans every NIC, only a specific address has a home node
+    sockaddr_storage resolved{};
+    int length = 0;
+    std::string host;
+    std::string port;
+    if (!NetworkAddress::resolve(listenAddress.address, true, resolved, length) ||
+        NetworkAddress::isWildcard(resolved) || !NetworkAddress::splitHostPort(listenAddress.address, host, port)) {
+        return CpuSet();
+    }
+    return ThreadPlacement::cpusOfNumaNode(ThreadPlacement::numaNodeOfAddress(host));
+}
+
+void SRTServer::handleConnections(Listener &listener) {
+    if (!ThreadPlacement::pinCurrentThread(listener.cpus)) {
+        m_streamManager->getCpuPlacement()->pinAcceptThread();
+    }
+    const bool isPublisher = listener.isPublisher;
+    const ConnectionRole role = isPublisher ? ConnectionRole::Publisher : ConnectionRole::Subscriber;
+    auto startup = m_streamManager->getStartupLatency();
+
+    while (m_running.load(std::memory_order_acquire) && listener.active.load(std::memory_order_acquire)) {
         std::shared_ptr<SRTHandler> streamConnection = std::make_shared<SRTHandler>();
 
-        if (!streamConnection->connect(listener)) {
-            std::cerr << "Failed to accept incoming connection: " << streamConnection->getLastErrorMessage() <<
-                    std::endl;
+        if (!streamConnection->connect(listener.socket)) {
+            // Closed by a reload that removed this listener
+            if (!listener.active.load(std::memory_order_acquire)) {
+                break;
+            }
+            LOG_WARNING("Failed to accept incoming connection", LogFields()
+                        .error(streamConnection->getLastErrorCode())
+                        .with(streamConnection->getLastErrorMessage()));
             continue;
         }
+        startup->record(role, StartupStage::AcceptQueue, streamConnection->getAcceptQueueMicros());
+        startup->record(role, StartupStage::StreamId, streamConnection->getStreamIdMicros());
 
+        if (!isPublisher) {
+            // What this connection measures decides the latency of the peer's next connection
+            std::weak_ptr<LatencyPolicy> latencyPolicy = m_latencyPolicy;
+            streamConnection->setCloseObserver([latencyPolicy](const std::string &peerAddress,
+                                                               const LinkStats &stats) {
+                auto policy = latencyPolicy.lock();
+                if (!policy || stats.packetsSent < MIN_PACKETS_FOR_LATENCY_SAMPLE) {
+                    return;
+                }
+                double lossPercent = 100.0 * static_cast<double>(stats.packetsSendLost) /
+                                     static_cast<double>(stats.packetsSent);
+                policy->recordSample(LatencyPolicy::hostFromAddress(peerAddress), LinkSample{stats.rttMs, lossPercent});
+            });
+        }
+
+        auto stageStart = std::chrono::steady_clock::now();
         if (!m_streamManager->validateStreamId(streamConnection->getStreamId())) {
-            std::cerr << "Invalid stream ID: " << streamConnection->getStreamId() << std::endl;
+            LOG_WARNING("Invalid stream ID", LogFields().stream(streamConnection->getStreamId())
+                        .from(streamConnection->getPeerAddress()));
             streamConnection->disconnect();
             continue;
         }
+        startup->record(role, StartupStage::Validate, StartupLatency::microsSince(stageStart));
 
+        stageStart = std::chrono::steady_clock::now();
         bool success = isPublisher
-                           ? m_streamManager->onPublisherConnected(streamConnection)
+                           ? m_streamManager->onPublisherConnected(streamConnection, listener.cpus)
                            : m_streamManager->onSubscriberConnected(streamConnection);
+        if (success) {
+            startup->record(role, StartupStage::Attach, StartupLatency::microsSince(stageStart));
+        }
 
         if (!success) {
-            std::cerr << "Failed to add client to stream manager" << std::endl;
+            LOG_WARNING("Failed to add client to stream manager", LogFields()
+                        .stream(streamConnection->getStreamId())
+                        .from(streamConnection->getPeerAddress()));
             streamConnection->disconnect();
         }
     }
 }
 
+void SRTServer::logCoreLoad() const {
+    if (!m_streamManager) {
+        return;
+    }
+    auto placement = m_streamManager->getCpuPlacement();
+    for (const auto &core: placement->getCoreLoad()) {
+        if (core.packets == 0) {
+            continue;
+        }
+        LOG_INFO("Core load", LogFields().with(
+                     "cpu=" + std::to_string(core.cpu) + " node=" + std::to_string(core.numaNode) +
+                     " packets=" + std::to_string(core.packets) + " bytes=" + std::to_string(core.bytes)));
+    }
+    auto sessionsPerSlot = placement->getSessionsPerSlot();
+    for (size_t slot = 0; slot < sessionsPerSlot.size(); ++slot) {
+        LOG_INFO("Session CPU set load", LogFields().with(
+                     "set=" + std::to_string(slot) + " sessions=" + std::to_string(sessionsPerSlot[slot])));
+    }
+}
+
+void SRTServer::reportStats() {
+    logCoreLoad();
+
+    auto timers = m_streamManager->getTimers();
+    TimerWheelStats stats = timers->getStats();
+    LOG_INFO("Timer wheel", LogFields().with(
+                 "active=" + std::to_string(stats.activeTimers) + " fired=" + std::to_string(stats.firedTimers) +
+                 " lateness_avg_us=" + std::to_string(stats.averageLatenessMicros) +
+                 " lateness_max_us=" + std::to_string(stats.maxLatenessMicros)));
+    timers->resetLatenessStats();
+
+    auto closer = m_streamManager->getConnectionCloser();
+    TeardownStats teardown = closer->getStats();
+    LOG_INFO("Connection teardown", LogFields().with(
+                 "closed=" + std::to_string(teardown.closedConnections) +
+                 " pending=" + std::to_string(teardown.pendingConnections) +
+                 " timed_out_waits=" + std::to_string(teardown.timedOutWaits) +
+                 " teardown_avg_us=" + std::to_string(teardown.averageTeardownMicros) +
+                 " teardown_max_us=" + std::to_string(teardown.maxTeardownMicros)));
+    closer->resetTeardownStats();
+
+    auto startup = m_streamManager->getStartupLatency();
+    auto logStartup = [](const std::string &role, const std::vector<StageLatency> &stages) {
+        for (const auto &stage: stages) {
+            LOG_INFO("Connection startup", LogFields().with(
+                         "role=" + role + " stage=" + stage.stage + " count=" + std::to_string(stage.count) +
+                         " avg_us=" + std::to_string(stage.averageMicros) +
+                         " max_us=" + std::to_string(stage.maxMicros)));
+        }
+    };
+    StartupStatus startupStats = startup->getStats();
+    logStartup("publisher", startupStats.publisher);
+    logStartup("subscriber", startupStats.subscriber);
+    startup->reset();
+
+    for (const auto &usage: m_streamManager->getSessionUsage()) {
+        LOG_INFO("Session resource usage", LogFields().stream(usage.streamId).with(
+                     "cpu_percent=" + std::to_string(static_cast<int>(usage.cpuPercent)) +
+                     " buffered_bytes=" + std::to_string(usage.usage.bufferedBytes) +
+                     " reserved_bytes=" + std::to_string(usage.usage.reservedBytes) +
+                     " allocations=" + std::to_string(usage.usage.allocations) +
+                     " subscribers=" + std::to_string(usage.usage.subscribers) +
+                     (usage.overBudget ? " over_budget=true" : "")));
+    }
+}
+
 bool SRTServer::initializeSrt() {
     if (srt_startup() == SRT_ERROR) {
-        std::cerr << "Failed to initialize SRT" << std::endl;
+        LOG_ERROR("Failed to initialize SRT", LogFields().error(srt_getlasterror(nullptr)));
         return false;
     }
     return true;
 }
 
-SRTSOCKET SRTServer::createSocket(int port) {
+int SRTServer::subscriberListenCallback(void *opaque, SRTSOCKET socket, int, const struct sockaddr *peerAddress,
+                                        const char *streamId) {
+    auto *server = static_cast<SRTServer *>(opaque);
+    if (server->m_streamManager->isDraining()) {
+        return server->rejectDraining(socket, peerAddress, false);
+    }
+    if (server->redirectToOwner(socket, peerAddress, streamId, false) != 0) {
+        return -1;
+    }
+    std::string peer = SRTHandler::formatAddress(peerAddress);
+    int latencyMs = server->m_latencyPolicy->chooseLatencyMs(LatencyPolicy::hostFromAddress(peer));
+
+    // SRT negotiates the larger of our peer latency and the player's own receive latency
+    srt_setsockflag(socket, SRTO_PEERLATENCY, &latencyMs, sizeof(latencyMs));
+    srt_setsockflag(socket, SRTO_RCVLATENCY, &latencyMs, sizeof(latencyMs));
+    LOG_DEBUG("Offering subscriber latency", LogFields().from(peer).with(std::to_string(latencyMs) + "ms"));
+    return 0;
+}
+
+int SRTServer::publisherListenCallback(void *opaque, SRTSOCKET socket, int, const struct sockaddr *peerAddress,
+                                       const char *streamId) {
+    auto *server = static_cast<SRTServer *>(opaque);
+    if (server->m_streamManager->isDraining()) {
+        return server->rejectDraining(socket, peerAddress, true);
+    }
+    return server->redirectToOwner(socket, peerAddress, streamId, true);
+}
+
+int SRTServer::redirectToOwner(SRTSOCKET socket, const struct sockaddr *peerAddress, const char *streamId,
+                               bool isPublisher) {
+    auto cluster = m_streamManager->getCluster();
+    if (!cluster || streamId == nullptr) {
+        return 0;
+    }
+    std::string resource = StreamIdParams::parse(streamId).getResource();
+    if (resource.empty()) {
+        return 0;
+    }
+    // Runs on SRT's receive thread, nothing here may block
+    std::string peer = SRTHandler::formatAddress(peerAddress);
+    std::string owner = cluster->ownerFor(resource);
+    int index = cluster->nodeIndex(owner);
+    // A node outside the list can't be named in a reject, the client is served here instead
+    if (cluster->isLocal(owner) || index < 0) {
+        return 0;
+    }
+    srt_setrejectreason(socket, REJECT_CLUSTER_BASE + index);
+    LOG_DEBUG(isPublisher ? "Publisher redirected to stream owner" : "Subscriber redirected to stream owner",
+              LogFields().stream(resource).from(peer).with(owner));
+    return -1;
+}
+
+int SRTServer::rejectDraining(SRTSOCKET socket, const struct sockaddr *peerAddress, bool isPublisher) {
+    // Round robin over the peers spreads the clients of this node evenly across them
+    size_t peers = m_redirectPeerCount.load(std::memory_order_relaxed);
+    int reason = REJECT_UNAVAILABLE;
+    if (peers > 0) {
+        reason = REJECT_REDIRECT_BASE + static_cast<int>(m_nextRedirectPeer.fetch_add(1) % peers);
+    }
+    srt_setrejectreason(socket, reason);
+    LOG_DEBUG(isPublisher ? "Publisher rejected, draining" : "Subscriber rejected, draining",
+              LogFields().from(SRTHandler::formatAddress(peerAddress)).with("reason=" + std::to_string(reason)));
+    return -1;
+}
+
+SRTSOCKET SRTServer::createSocket(const std::string &address, bool ipv6Only, srt_listen_callback_fn *listenCallback) {
+    sockaddr_storage socketAddress{};
+    int socketAddressLength = 0;
+    if (!NetworkAddress::resolve(address, true, socketAddress, socketAddressLength)) {
+        LOG_ERROR("Invalid listen address", LogFields().with(address));
+        return SRT_INVALID_SOCK;
+    }
+
     SRTSOCKET sock = srt_create_socket();
     if (sock == SRT_INVALID_SOCK) {
-        std::cerr << "Failed to create SRT socket" << srt_getlasterror_str() << std::endl;
+        LOG_ERROR("Failed to create SRT socket", LogFields().error(srt_getlasterror(nullptr))
+                  .with(srt_getlasterror_str()));
         return SRT_INVALID_SOCK;
     }
 
@@ -135,22 +627,29 @@ SRTSOCKET SRTServer::createSocket(int port) {
     int yes = 1;
     srt_setsockopt(sock, 0, SRTO_RCVSYN, &yes, sizeof(yes));
     srt_setsockopt(sock, 0, SRTO_REUSEADDR, &yes, sizeof(yes));
+    if (socketAddress.ss_family == AF_INET6) {
+        int v6only = ipv6Only ? 1 : 0;
+        srt_setsockflag(sock, SRTO_IPV6ONLY, &v6only, sizeof(v6only));
+    }
 
+    if (srt_bind(sock, (sockaddr *) &socketAddress, socketAddressLength) == SRT_ERROR) {
+        LOG_ERROR("Failed to bind socket", LogFields().error(srt_getlasterror(nullptr))
+                  .with(address + ": " + srt_getlasterror_str()));
+        srt_close(sock);
+        return SRT_INVALID_SOCK;
+    }
 
-    sockaddr_in socketAddress;
-    socketAddress.sin_family = AF_INET;
-    socketAddress.sin_port = htons(port);
-    socketAddress.sin_addr.s_addr = INADDR_ANY;
-
-
-    if (srt_bind(sock, (sockaddr *) &socketAddress, sizeof(socketAddress)) == SRT_ERROR) {
-        std::cerr << "Failed to bind to socket port " << port << ": " << srt_getlasterror_str() << std::endl;
+    // The callback has to be in place before the socket starts listening
+    if (listenCallback != nullptr && srt_listen_callback(sock, listenCallback, this) == SRT_ERROR) {
+        LOG_ERROR("Failed to set listen callback", LogFields().error(srt_getlasterror(nullptr))
+                  .with(address + ": " + srt_getlasterror_str()));
         srt_close(sock);
         return SRT_INVALID_SOCK;
     }
 
-    if (srt_listen(sock, BACKLOG) == SRT_ERROR) {
-        std::cerr << "Failed to listen on socket port " << port << ": " << srt_getlasterror_str() << std::endl;
+    if (srt_listen(sock, m_config.listen.backlog) == SRT_ERROR) {
+        LOG_ERROR("Failed to listen on socket", LogFields().error(srt_getlasterror(nullptr))
+                  .with(address + ": " + srt_getlasterror_str()));
         srt_close(sock);
         return SRT_INVALID_SOCK;
     }
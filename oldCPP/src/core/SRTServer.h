@@ -20,15 +20,21 @@
 #ifndef SRT_SERVER_H
 #define SRT_SERVER_H
 
+#include "AdminServer.h"
+#include "LatencyPolicy.h"
+#include "ServerConfig.h"
 #include "StreamManager.h"
 #include <atomic>
+#include <mutex>
 #include <thread>
+#include <vector>
 #include "utils/SRTHandler.h"
 
 
 class SRTServer {
 public:
-    SRTServer();
+    // configPath is re-read by reload(), empty disables reloading
+    explicit SRTServer(const ServerConfig &config = ServerConfig(), std::string configPath = "");
 
     ~SRTServer();
 
@@ -41,26 +47,116 @@ public:
     // Stop the server and cleanup
     void stop();
 
+    // Print per-core packet counters and sessions per core set
+    void logCoreLoad() const;
+
+    // Re-reads the config file and applies it without dropping sessions. Limits, tuning, worker
+    // counts and listeners change in place; notApplied lists the settings that need a restart.
+    bool reload(std::vector<std::string> &notApplied);
+
+    // Rolling upgrade: new publishers and subscribers are rejected with a reason naming a peer node,
+    // running sessions continue until they end or drain.deadline passes, then the rest are closed
+    // spread over drain.close_spread so their viewers don't reconnect all at once
+    void startDrain();
+
+    // Cancels a drain, closes already started at the deadline are not undone
+    void stopDrain();
+
+    bool isDraining() const;
+
+    // True once a drain has no sessions left
+    bool isDrainComplete() const;
+
+    // Null once stopped
+    std::shared_ptr<StreamManager> getStreamManager() const { return m_streamManager; }
+
 private:
-    void handleConnections(SRTSOCKET listener, bool isPublisher);
+    struct Listener {
+        SRTSOCKET socket = SRT_INVALID_SOCK;
+        std::string address;
+        bool isPublisher = false;
+        // Accept thread and publisher sessions of this listener run here, empty leaves them to the defaults
+        CpuSet cpus;
+        // As configured, before NIC node placement filled them in; reload compares these
+        CpuSet configuredCpus;
+        // Cleared when a reload removes the listener
+        std::atomic<bool> active{true};
+        std::unique_ptr<std::thread> thread;
+    };
+
+    void handleConnections(Listener &listener);
+
+    bool addListeners(const std::vector<ListenAddress> &addresses, bool isPublisher);
+
+    bool addListener(const ListenAddress &listenAddress, bool isPublisher, bool ipv6Only);
+
+    void closeListener(Listener &listener);
+
+    void closeListeners();
+
+    // Opens listeners new to settings and closes the ones it no longer has, leaving the rest untouched
+    void updateListeners(const ListenerSettings &settings, std::vector<std::string> &notApplied);
+
+    CpuSet listenerCpus(const ListenAddress &listenAddress) const;
+
+    // Publish the configured replay files as if their encoders had connected
+    void startReplays();
 
     bool initializeSrt();
 
-    SRTSOCKET createSocket(int port);
+    // Periodic core load and timer wheel report, runs on the timer wheel
+    void reportStats();
+
+    // ipv6Only keeps an IPv6 wildcard socket off the IPv4 port another listener already binds
+    SRTSOCKET createSocket(const std::string &address, bool ipv6Only, srt_listen_callback_fn *listenCallback = nullptr);
+
+    // Runs during the subscriber handshake to pick the latency offered to that peer
+    static int subscriberListenCallback(void *opaque, SRTSOCKET socket, int hsVersion,
+                                        const struct sockaddr *peerAddress, const char *streamId);
+
+    // Turns publishers away during the handshake while draining
+    static int publisherListenCallback(void *opaque, SRTSOCKET socket, int hsVersion,
+                                       const struct sockaddr *peerAddress, const char *streamId);
+
+    // Rejects a handshake on a draining node, returns the listen callback result
+    int rejectDraining(SRTSOCKET socket, const struct sockaddr *peerAddress, bool isPublisher);
+
+    // Rejects a handshake for a stream the cluster places on another node, pointing the client there.
+    // Returns 0 when the stream belongs here.
+    int redirectToOwner(SRTSOCKET socket, const struct sockaddr *peerAddress, const char *streamId,
+                        bool isPublisher);
 
     // Server state
     std::atomic<bool> m_running{false};
-    SRTSOCKET m_publisherSocket;
-    SRTSOCKET m_subscriberSocket;
+    // Settings in effect; reload() swaps in what it could apply
+    ServerConfig m_config;
+    std::string m_configPath;
+    // Serializes reloads with each other and with stop()
+    std::mutex m_reloadMutex;
+    std::vector<std::unique_ptr<Listener> > m_listeners;
 
     std::shared_ptr<StreamManager> m_streamManager;
-    std::unique_ptr<std::thread> m_publisherThread;
-    std::unique_ptr<std::thread> m_subscriberThread;
-
-    // TODO: Move to configuration file
-    static constexpr int PUBLISHER_PORT = 5500;
-    static constexpr int SUBSCRIBER_PORT = 6000;
-    static constexpr int BACKLOG = 10;
+    std::shared_ptr<LatencyPolicy> m_latencyPolicy;
+    TimerWheel::TimerId m_statsTimer = TimerWheel::INVALID_TIMER;
+    TimerWheel::TimerId m_snapshotTimer = TimerWheel::INVALID_TIMER;
+    TimerWheel::TimerId m_placementTimer = TimerWheel::INVALID_TIMER;
+    std::unique_ptr<AdminServer> m_adminServer;
+    TimerWheel::TimerId m_drainTimer = TimerWheel::INVALID_TIMER;
+    // Copies of drain.redirect_peers size, read by the listen callbacks without the reload lock
+    std::atomic<size_t> m_redirectPeerCount{0};
+    std::atomic<size_t> m_nextRedirectPeer{0};
+
+    // Reject reasons seen by clients of a draining node. SRT has no redirect code, so the peer is
+    // announced by its index in drain.redirect_peers within the user-defined range.
+    static constexpr int REJECT_REDIRECT_BASE = SRT_REJC_USERDEFINED + 300;
+    // SRT_REJX_DOWN, service unavailable, when no peer is configured
+    static constexpr int REJECT_UNAVAILABLE = SRT_REJC_PREDEFINED + 503;
+    // The node owning a stream, by its index in cluster.nodes
+    static constexpr int REJECT_CLUSTER_BASE = SRT_REJC_USERDEFINED + 400;
+
+    // Connections shorter than this tell us too little about the link to learn from
+    static constexpr int64_t MIN_PACKETS_FOR_LATENCY_SAMPLE = 500;
+    static constexpr std::chrono::seconds STATS_REPORT_INTERVAL{60};
 };
 
 
@@ -0,0 +1,287 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "ServerConfig.h"
+
+#include <fstream>
+#include <sstream>
+
+#include "utils/Logger.h"
+
+namespace {
+    // "udp.output.<stream id> = host:port" sends that stream to a UDP destination
+    const std::string UDP_OUTPUT_PREFIX = "udp.output.";
+    // "qos.<class>.<setting>" tunes one subscriber class
+    const std::string QOS_PREFIX = "qos.";
+    // "replay.file.<stream id> = path.ts" publishes a recording under that stream ID
+    const std::string REPLAY_FILE_PREFIX = "replay.file.";
+
+    std::string trim(const std::string &value) {
+        size_t first = value.find_first_not_of(" \t\r");
+        if (first == std::string::npos) {
+            return "";
+        }
+        size_t last = value.find_last_not_of(" \t\r");
+        return value.substr(first, last - first + 1);
+    }
+
+    bool parseBool(const std::string &value) {
+        return value == "1" || value == "true" || value == "yes" || value == "on";
+    }
+
+    // ';' separated "host:port" list, empty entries are skipped
+    bool parseAddressList(const std::string &value, std::vector<std::string> &addresses) {
+        std::vector<std::string> parsed;
+        std::stringstream entries(value);
+        std::string entry;
+        while (std::getline(entries, entry, ';')) {
+            entry = trim(entry);
+            if (entry.empty()) {
+                continue;
+            }
+            if (entry.find(':') == std::string::npos) {
+                return false;
+            }
+            parsed.push_back(entry);
+        }
+        addresses = parsed;
+        return true;
+    }
+
+    bool applyQosClass(const std::string &key, const std::string &value, QosSettings &qos) {
+        size_t dot = key.find('.', QOS_PREFIX.size());
+        if (dot == std::string::npos) {
+            return false;
+        }
+        QosClass qosClass;
+        if (!QosSettings::parseClass(key.substr(QOS_PREFIX.size(), dot - QOS_PREFIX.size()), qosClass)) {
+            return false;
+        }
+        std::string setting = key.substr(dot + 1);
+        if (setting == "send_budget_us") {
+            qos.get(qosClass).sendBudget = std::chrono::microseconds(std::stoll(value));
+        } else if (setting == "queue_percent") {
+            qos.get(qosClass).queuePercent = std::stoi(value);
+        } else {
+            return false;
+        }
+        return true;
+    }
+}
+
+bool ListenerSettings::parse(const std::string &value, std::vector<ListenAddress> &addresses) {
+    std::vector<ListenAddress> parsed;
+    std::stringstream entries(value);
+    std::string entry;
+    while (std::getline(entries, entry, ';')) {
+        entry = trim(entry);
+        if (entry.empty()) {
+            continue;
+        }
+        ListenAddress listenAddress;
+        size_t at = entry.find('@');
+        listenAddress.address = trim(entry.substr(0, at));
+        if (at != std::string::npos) {
+            listenAddress.cpus = ThreadPlacement::parseCpuList(trim(entry.substr(at + 1)));
+        }
+        if (listenAddress.address.find(':') == std::string::npos) {
+            return false;
+        }
+        parsed.push_back(listenAddress);
+    }
+    if (parsed.empty()) {
+        return false;
+    }
+    addresses = parsed;
+    return true;
+}
+
+bool ServerConfig::loadFromFile(const std::string &path, ServerConfig &config) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        LOG_ERROR("Failed to open config file", LogFields().with(path));
+        return false;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        ++lineNumber;
+        line = trim(line);
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        size_t separator = line.find('=');
+        if (separator == std::string::npos) {
+            LOG_WARNING("Config line is not key = value", LogFields().with(path + ":" + std::to_string(lineNumber)));
+            continue;
+        }
+
+        std::string key = trim(line.substr(0, separator));
+        std::string value = trim(line.substr(separator + 1));
+        if (!config.apply(key, value)) {
+            LOG_WARNING("Invalid config setting", LogFields().with(path + ":" + std::to_string(lineNumber) + " " + key));
+        }
+    }
+    return true;
+}
+
+bool ServerConfig::apply(const std::string &key, const std::string &value) {
+    try {
+        if (key == "pacing.enabled_by_default") {
+            pacing.enabledByDefault = parseBool(value);
+        } else if (key == "pacing.headroom_percent") {
+            pacing.headroomPercent = std::stoi(value);
+        } else if (key == "pacing.tick_interval_ms") {
+            pacing.tickInterval = std::chrono::milliseconds(std::stoi(value));
+        } else if (key == "pacing.max_burst_ms") {
+            pacing.maxBurst = std::chrono::milliseconds(std::stoi(value));
+        } else if (key == "pacing.max_queued_packets") {
+            pacing.maxQueuedPackets = std::stoul(value);
+        } else if (key == "log.level") {
+            log.minLevel = Logger::parseLevel(value, log.minLevel);
+        } else if (key == "log.max_per_site_per_second") {
+            log.maxPerSitePerSecond = std::stoul(value);
+        } else if (key == "fanout.shard_threshold") {
+            fanout.shardThreshold = std::stoul(value);
+        } else if (key == "fanout.min_subscribers_per_shard") {
+            fanout.minSubscribersPerShard = std::stoul(value);
+        } else if (key == "fanout.max_workers") {
+            fanout.maxWorkers = std::stoul(value);
+        } else if (key == "latency.adaptive") {
+            latency.adaptive = parseBool(value);
+        } else if (key == "latency.default_ms") {
+            latency.defaultLatencyMs = std::stoi(value);
+        } else if (key == "latency.tiers") {
+            return LatencySettings::parseTiers(value, latency.tiers);
+        } else if (key == "latency.max_peers") {
+            latency.maxPeers = std::stoul(value);
+        } else if (key == "shm.enabled_by_default") {
+            sharedMemory.enabledByDefault = parseBool(value);
+        } else if (key == "shm.name_prefix") {
+            sharedMemory.namePrefix = value;
+        } else if (key == "shm.slot_count") {
+            sharedMemory.slotCount = static_cast<uint32_t>(std::stoul(value));
+        } else if (key == "shm.slot_size") {
+            sharedMemory.slotSize = static_cast<uint32_t>(std::stoul(value));
+        } else if (key.rfind(UDP_OUTPUT_PREFIX, 0) == 0 && key.size() > UDP_OUTPUT_PREFIX.size()) {
+            udpOutputs.destinations[key.substr(UDP_OUTPUT_PREFIX.size())] = value;
+        } else if (key == "udp.multicast_ttl") {
+            udpOutputs.multicastTtl = std::stoi(value);
+        } else if (key == "udp.multicast_loopback") {
+            udpOutputs.multicastLoopback = parseBool(value);
+        } else if (key == "udp.multicast_interface") {
+            udpOutputs.multicastInterface = value;
+        } else if (key == "udp.max_queued_packets") {
+            udpOutputs.maxQueuedPackets = std::stoul(value);
+        } else if (key == "waiting.timeout_seconds") {
+            waiting.timeout = std::chrono::seconds(std::stoi(value));
+        } else if (key == "waiting.max_per_stream") {
+            waiting.maxPerStream = std::stoul(value);
+        } else if (key == "drain.deadline_seconds") {
+            drain.deadline = std::chrono::seconds(std::stoi(value));
+        } else if (key == "drain.close_spread_seconds") {
+            drain.closeSpread = std::chrono::seconds(std::stoi(value));
+        } else if (key == "drain.redirect_peers") {
+            return parseAddressList(value, drain.redirectPeers);
+        } else if (key == "cluster.node_address") {
+            cluster.nodeAddress = value;
+        } else if (key == "cluster.nodes") {
+            return parseAddressList(value, cluster.nodes);
+        } else if (key == "cluster.directory_path") {
+            cluster.directoryPath = value;
+        } else if (key == "cluster.cache_ttl_ms") {
+            cluster.cacheTtl = std::chrono::milliseconds(std::stoi(value));
+        } else if (key == "cluster.registration_ttl_seconds") {
+            cluster.registrationTtl = std::chrono::seconds(std::stoi(value));
+        } else if (key == "cluster.points_per_node") {
+            cluster.pointsPerNode = std::stoul(value);
+        } else if (key == "prewarm.session_threads") {
+            prewarm.sessionThreads = std::stoul(value);
+        } else if (key == "prewarm.max_idle_threads") {
+            prewarm.maxIdleThreads = std::stoul(value);
+        } else if (key == "qos.default_class") {
+            return QosSettings::parseClass(value, qos.defaultClass);
+        } else if (key == "qos.overload_disconnect_ms") {
+            qos.overloadDisconnect = std::chrono::milliseconds(std::stoll(value));
+        } else if (key.rfind(QOS_PREFIX, 0) == 0) {
+            return applyQosClass(key, value, qos);
+        } else if (key == "budget.stream_cpu_percent") {
+            budget.streamCpuPercent = std::stoi(value);
+        } else if (key == "budget.stream_buffered_kb") {
+            budget.streamBufferedBytes = std::stoul(value) * 1024;
+        } else if (key == "budget.total_cpu_percent") {
+            budget.totalCpuPercent = std::stoi(value);
+        } else if (key == "budget.total_buffered_kb") {
+            budget.totalBufferedBytes = std::stoul(value) * 1024;
+        } else if (key == "budget.check_interval_ms") {
+            budget.checkInterval = std::chrono::milliseconds(std::stoi(value));
+        } else if (key == "admin.socket_path") {
+            admin.socketPath = value;
+        } else if (key == "admin.snapshot_interval_ms") {
+            admin.snapshotInterval = std::chrono::milliseconds(std::stoi(value));
+        } else if (key == "teardown.workers") {
+            teardown.workers = std::stoul(value);
+        } else if (key == "teardown.batch_size") {
+            teardown.batchSize = std::stoul(value);
+        } else if (key == "teardown.max_wait_ms") {
+            teardown.maxWait = std::chrono::milliseconds(std::stoi(value));
+        } else if (key.rfind(REPLAY_FILE_PREFIX, 0) == 0 && key.size() > REPLAY_FILE_PREFIX.size()) {
+            replay.files[key.substr(REPLAY_FILE_PREFIX.size())] = value;
+        } else if (key == "replay.copies") {
+            replay.copies = std::stoi(value);
+        } else if (key == "replay.loop") {
+            replay.loop = parseBool(value);
+        } else if (key == "replay.bitrate_kbps") {
+            replay.bitrate = std::stoll(value) * 1000;
+        } else if (key == "timers.tick_ms") {
+            timerTick = std::chrono::milliseconds(std::stoi(value));
+        } else if (key == "listen.publisher") {
+            return ListenerSettings::parse(value, listen.publisher);
+        } else if (key == "listen.subscriber") {
+            return ListenerSettings::parse(value, listen.subscriber);
+        } else if (key == "listen.backlog") {
+            listen.backlog = std::stoi(value);
+        } else if (key == "session.buffer_size") {
+            sessionBufferSize = std::stoi(value);
+        } else if (key == "listen.pin_to_nic_node") {
+            listen.pinToNicNode = parseBool(value);
+        } else if (key == "affinity.accept_cpus") {
+            affinity.acceptCpus = ThreadPlacement::parseCpuList(value);
+        } else if (key == "affinity.pacer_cpus") {
+            affinity.pacerCpus = ThreadPlacement::parseCpuList(value);
+        } else if (key == "affinity.session_cpu_sets") {
+            affinity.sessionCpuSets.clear();
+            std::stringstream sets(value);
+            std::string set;
+            while (std::getline(sets, set, ';')) {
+                CpuSet cpus = ThreadPlacement::parseCpuList(trim(set));
+                if (!cpus.empty()) {
+                    affinity.sessionCpuSets.push_back(cpus);
+                }
+            }
+        } else {
+            return false;
+        }
+    } catch (const std::exception &) {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,129 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SERVERCONFIG_H
+#define SERVERCONFIG_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "AdminServer.h"
+#include "ClusterPlacement.h"
+#include "CpuPlacement.h"
+#include "FanoutWorkers.h"
+#include "LatencyPolicy.h"
+#include "QosPolicy.h"
+#include "ResourceBudget.h"
+#include "SubscriberPacer.h"
+#include "utils/ConnectionCloser.h"
+#include "utils/FileReplayHandler.h"
+#include "utils/Logger.h"
+#include "utils/SharedMemoryOutput.h"
+#include "utils/UdpOutput.h"
+#include "utils/WarmThreadPool.h"
+
+// Subscribers that arrive before their stream is published
+struct WaitingSettings {
+    // How long a subscriber is held waiting for the publisher, 0 rejects it right away
+    std::chrono::seconds timeout{30};
+    // Further subscribers to the same absent stream are rejected
+    size_t maxPerStream = 1000;
+};
+
+// Graceful shutdown for rolling upgrades
+struct DrainSettings {
+    // Sessions still running this long after the drain started are closed
+    std::chrono::seconds deadline{300};
+    // Streams left at the deadline are closed one by one over this window, not all at once
+    std::chrono::seconds closeSpread{30};
+    // Nodes rejected clients are pointed at, "host:port" separated by ';'. The peer at index i is
+    // announced as SRT reject reason SRT_REJC_USERDEFINED + 300 + i, empty sends SRT_REJX_DOWN.
+    std::vector<std::string> redirectPeers;
+};
+
+// One listening socket: "host:port" plus the CPUs its accept thread and sessions should use
+struct ListenAddress {
+    std::string address;
+    CpuSet cpus;
+};
+
+// Listeners for publishers and subscribers. Lists are ';' separated, each entry optionally followed
+// by "@<cpu list>": "10.0.0.5:5500@2-3; [fd00::5]:5500@4-5". An IPv6 wildcard listener is
+// dual-stack unless an IPv4 listener shares its port.
+struct ListenerSettings {
+    std::vector<ListenAddress> publisher{{"0.0.0.0:5500", {}}};
+    std::vector<ListenAddress> subscriber{{"0.0.0.0:6000", {}}};
+    // Listeners without explicit CPUs use the CPUs of the NUMA node their NIC is attached to
+    bool pinToNicNode = false;
+    // Pending handshakes per listening socket
+    int backlog = 10;
+
+    static bool parse(const std::string &value, std::vector<ListenAddress> &addresses);
+};
+
+// Server settings, loaded from a "key = value" file. Lines starting with '#' are comments.
+// Sending SIGHUP or "reload" on the admin socket re-reads the file; see SRTServer::reload().
+//
+//   log.level = info
+//   listen.publisher = 0.0.0.0:5500; [::]:5500
+//   pacing.enabled_by_default = false
+//   pacing.headroom_percent = 25
+//   affinity.accept_cpus = 0
+//   affinity.session_cpu_sets = 2-3;4-5
+//   udp.output.live = 239.1.1.1:5000
+//   replay.file.load-test = /captures/prod.ts
+//   qos.best_effort.send_budget_us = 20000
+//   qos.overload_disconnect_ms = 5000
+//   budget.stream_cpu_percent = 50
+//   admin.socket_path = /run/dl_srt_server/admin.sock
+//   drain.redirect_peers = 10.0.0.6:6000; 10.0.0.7:6000
+//   cluster.nodes = 10.0.0.5:6000; 10.0.0.6:6000; 10.0.0.7:6000
+//   prewarm.session_threads = 8
+struct ServerConfig {
+    LogSettings log;
+    PacingSettings pacing;
+    AffinitySettings affinity;
+    FanoutSettings fanout;
+    LatencySettings latency;
+    SharedMemorySettings sharedMemory;
+    UdpOutputSettings udpOutputs;
+    ListenerSettings listen;
+    WaitingSettings waiting;
+    DrainSettings drain;
+    TeardownSettings teardown;
+    ReplaySettings replay;
+    QosSettings qos;
+    ResourceBudgetSettings budget;
+    AdminSettings admin;
+    ClusterSettings cluster;
+    PrewarmSettings prewarm;
+    // Granularity of the shared timer wheel driving timeouts and periodic tasks
+    std::chrono::milliseconds timerTick{10};
+    // Largest publisher message a session reads, applies to sessions started afterwards
+    int sessionBufferSize = 1456;
+
+    // Returns false if the file can't be read; unknown keys and bad values are reported and skipped
+    static bool loadFromFile(const std::string &path, ServerConfig &config);
+
+    bool apply(const std::string &key, const std::string &value);
+};
+
+
+#endif //SERVERCONFIG_H
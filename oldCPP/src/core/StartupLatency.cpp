@@ -0,0 +1,84 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "StartupLatency.h"
+
+#include <algorithm>
+
+namespace {
+    std::vector<StageLatency> toStageLatencies(const std::array<LatencyStats, STARTUP_STAGE_COUNT> &stats) {
+        std::vector<StageLatency> latencies;
+        for (size_t i = 0; i < stats.size(); ++i) {
+            if (stats[i].getCount() == 0) {
+                continue;
+            }
+            StageLatency latency;
+            latency.stage = StartupLatency::stageName(static_cast<StartupStage>(i));
+            latency.count = stats[i].getCount();
+            latency.averageMicros = stats[i].getAverage();
+            latency.maxMicros = stats[i].getMax();
+            latencies.push_back(std::move(latency));
+        }
+        return latencies;
+    }
+}
+
+void StartupLatency::record(ConnectionRole role, StartupStage stage, int64_t microseconds) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto &stats = role == ConnectionRole::Publisher ? m_publisher : m_subscriber;
+    stats[static_cast<size_t>(stage)].record(std::max<int64_t>(microseconds, 0));
+}
+
+StartupStatus StartupLatency::getStats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    StartupStatus status;
+    status.publisher = toStageLatencies(m_publisher);
+    status.subscriber = toStageLatencies(m_subscriber);
+    return status;
+}
+
+void StartupLatency::reset() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto &stats: m_publisher) {
+        stats.reset();
+    }
+    for (auto &stats: m_subscriber) {
+        stats.reset();
+    }
+}
+
+const char *StartupLatency::stageName(StartupStage stage) {
+    switch (stage) {
+        case StartupStage::AcceptQueue:
+            return "accept_queue";
+        case StartupStage::StreamId:
+            return "stream_id";
+        case StartupStage::Validate:
+            return "validate";
+        case StartupStage::Attach:
+            return "attach";
+        case StartupStage::ThreadStart:
+            return "thread_start";
+        case StartupStage::FirstData:
+            return "first_data";
+        case StartupStage::Total:
+            return "total";
+    }
+    return "unknown";
+}
@@ -0,0 +1,78 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef STARTUPLATENCY_H
+#define STARTUPLATENCY_H
+
+#include <array>
+#include <chrono>
+#include <mutex>
+
+#include "AdminSnapshot.h"
+#include "utils/LatencyStats.h"
+
+enum class ConnectionRole {
+    Publisher,
+    Subscriber,
+};
+
+// Where a new connection spends its time before media flows, in order
+enum class StartupStage {
+    // Handshake completed until srt_accept returned it
+    AcceptQueue,
+    // Reading and parsing the stream ID
+    StreamId,
+    Validate,
+    // Publisher: session created and its thread requested. Subscriber: added to the session or waiting list
+    Attach,
+    // Publisher only: thread requested until it ran
+    ThreadStart,
+    // Publisher: thread running until the first packet arrived. Subscriber: attached until the first send
+    FirstData,
+    // Accepted until the first packet arrived or was sent
+    Total,
+};
+
+static constexpr size_t STARTUP_STAGE_COUNT = static_cast<size_t>(StartupStage::Total) + 1;
+
+// Per stage latency of new publishers and subscribers, shared by the accept threads and the sessions
+class StartupLatency {
+public:
+    void record(ConnectionRole role, StartupStage stage, int64_t microseconds);
+
+    // Since the last reset
+    StartupStatus getStats() const;
+
+    void reset();
+
+    static const char *stageName(StartupStage stage);
+
+    static int64_t microsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+
+private:
+    mutable std::mutex m_mutex;
+    std::array<LatencyStats, STARTUP_STAGE_COUNT> m_publisher;
+    std::array<LatencyStats, STARTUP_STAGE_COUNT> m_subscriber;
+};
+
+
+#endif //STARTUPLATENCY_H
@@ -0,0 +1,155 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "StreamDirectory.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <thread>
+
+#include "utils/Logger.h"
+
+namespace {
+    int64_t unixSeconds(std::chrono::system_clock::time_point time) {
+        return std::chrono::duration_cast<std::chrono::seconds>(time.time_since_epoch()).count();
+    }
+}
+
+FileStreamDirectory::FileStreamDirectory(std::string path)
+    : m_path(std::move(path)) {
+    std::error_code error;
+    std::filesystem::create_directories(m_path, error);
+    if (error) {
+        LOG_ERROR("Failed to create stream directory", LogFields().with(m_path + ": " + error.message()));
+    }
+}
+
+bool FileStreamDirectory::registerStream(const std::string &streamId, const std::string &node,
+                                         std::chrono::seconds ttl) {
+    std::string path = entryPath(streamId);
+    // Unique per writer, two nodes registering at once each rename a complete file
+    std::string temporary = path + ".tmp" + std::to_string(std::hash<std::string>()(node)) + "-" +
+                            std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    {
+        std::ofstream file(temporary, std::ios::trunc);
+        file << node << " " << unixSeconds(std::chrono::system_clock::now() + ttl) << "\n";
+        if (!file) {
+            LOG_ERROR("Failed to write stream directory entry", LogFields().stream(streamId).with(temporary));
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    if (error) {
+        LOG_ERROR("Failed to register stream", LogFields().stream(streamId).with(path + ": " + error.message()));
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+    return true;
+}
+
+void FileStreamDirectory::unregisterStream(const std::string &streamId, const std::string &node) {
+    std::string path = entryPath(streamId);
+    std::string holder;
+    int64_t expiresAt;
+    // A node that took the stream over in the meantime keeps its entry
+    if (!readEntry(path, holder, expiresAt) || holder != node) {
+        return;
+    }
+    std::error_code error;
+    std::filesystem::remove(path, error);
+}
+
+bool FileStreamDirectory::lookup(const std::string &streamId, std::string &node) {
+    int64_t expiresAt;
+    if (!readEntry(entryPath(streamId), node, expiresAt)) {
+        return false;
+    }
+    // Left behind by a node that stopped without unregistering
+    return expiresAt > unixSeconds(std::chrono::system_clock::now());
+}
+
+bool FileStreamDirectory::listStreams(std::unordered_map<std::string, std::string> &owners) {
+    std::error_code error;
+    std::filesystem::directory_iterator entries(m_path, error);
+    if (error) {
+        LOG_WARNING("Failed to list stream directory", LogFields().with(m_path + ": " + error.message()));
+        return false;
+    }
+    int64_t now = unixSeconds(std::chrono::system_clock::now());
+    for (const auto &entry: entries) {
+        std::string streamId;
+        std::string node;
+        int64_t expiresAt;
+        if (streamIdFromFileName(entry.path().filename().string(), streamId) &&
+            readEntry(entry.path().string(), node, expiresAt) && expiresAt > now) {
+            owners[streamId] = node;
+        }
+    }
+    return true;
+}
+
+std::string FileStreamDirectory::entryPath(const std::string &streamId) const {
+    static const char *HEX = "0123456789abcdef";
+    std::string name;
+    name.reserve(streamId.size());
+    for (unsigned char c: streamId) {
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '_') {
+            name += static_cast<char>(c);
+        } else {
+            name += '%';
+            name += HEX[c >> 4];
+            name += HEX[c & 0xf];
+        }
+    }
+    return (std::filesystem::path(m_path) / (name + ".stream")).string();
+}
+
+bool FileStreamDirectory::streamIdFromFileName(const std::string &fileName, std::string &streamId) {
+    static const std::string EXTENSION = ".stream";
+    // Temporary files of writers end in ".stream.tmp..."
+    if (fileName.size() <= EXTENSION.size() ||
+        fileName.compare(fileName.size() - EXTENSION.size(), EXTENSION.size(), EXTENSION) != 0) {
+        return false;
+    }
+    auto hexValue = [](char c) {
+        return c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+    };
+    size_t end = fileName.size() - EXTENSION.size();
+    streamId.clear();
+    for (size_t i = 0; i < end; ++i) {
+        if (fileName[i] != '%') {
+            streamId += fileName[i];
+            continue;
+        }
+        if (i + 2 >= end || hexValue(fileName[i + 1]) < 0 || hexValue(fileName[i + 2]) < 0) {
+            return false;
+        }
+        streamId += static_cast<char>(hexValue(fileName[i + 1]) << 4 | hexValue(fileName[i + 2]));
+        i += 2;
+    }
+    return true;
+}
+
+bool FileStreamDirectory::readEntry(const std::string &path, std::string &node, int64_t &expiresAt) const {
+    std::ifstream file(path);
+    return file.is_open() && (file >> node >> expiresAt) && !node.empty();
+}
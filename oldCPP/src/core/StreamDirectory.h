@@ -0,0 +1,76 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef STREAMDIRECTORY_H
+#define STREAMDIRECTORY_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+// Which node of the cluster publishes each stream. Nodes register the streams they publish and look
+// up the rest; backends are pluggable, FileStreamDirectory stands in for a real service.
+class StreamDirectory {
+public:
+    virtual ~StreamDirectory() = default;
+
+    // Records node as publishing streamId for ttl, registering again renews the entry
+    virtual bool registerStream(const std::string &streamId, const std::string &node, std::chrono::seconds ttl) = 0;
+
+    // Removes the entry if node still holds it
+    virtual void unregisterStream(const std::string &streamId, const std::string &node) = 0;
+
+    // False when no node holds a live entry for streamId
+    virtual bool lookup(const std::string &streamId, std::string &node) = 0;
+
+    // Every live entry by stream ID, false if the directory can't be read
+    virtual bool listStreams(std::unordered_map<std::string, std::string> &owners) = 0;
+};
+
+// One file per stream under a directory, holding "<node> <expiry unix seconds>". Works for nodes on one
+// host or sharing a mount. Entries are written to a temporary file and renamed into place so readers
+// never see a partial one.
+class FileStreamDirectory : public StreamDirectory {
+public:
+    explicit FileStreamDirectory(std::string path);
+
+    bool registerStream(const std::string &streamId, const std::string &node, std::chrono::seconds ttl) override;
+
+    void unregisterStream(const std::string &streamId, const std::string &node) override;
+
+    bool lookup(const std::string &streamId, std::string &node) override;
+
+    bool listStreams(std::unordered_map<std::string, std::string> &owners) override;
+
+private:
+    // Stream IDs are escaped so any of them makes a valid file name
+    std::string entryPath(const std::string &streamId) const;
+
+    // Reverses the escaping of entryPath(), false for names that aren't entries
+    static bool streamIdFromFileName(const std::string &fileName, std::string &streamId);
+
+    // Reads an entry, including expired ones
+    bool readEntry(const std::string &path, std::string &node, int64_t &expiresAt) const;
+
+    std::string m_path;
+};
+
+
+#endif //STREAMDIRECTORY_H
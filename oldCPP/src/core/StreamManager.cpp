@@ -19,50 +19,148 @@
 
 #include "StreamManager.h"
 
-#include <iostream>
+#include <algorithm>
 
-StreamManager::StreamManager() = default;
+#include "utils/Logger.h"
+#include "utils/PidFilter.h"
 
-StreamManager::~StreamManager() = default;
+StreamManager::StreamManager(const ServerConfig &config)
+    : m_budget(config.budget) {
+    m_sessionContext.placement = std::make_shared<CpuPlacement>(config.affinity);
+    m_sessionContext.timers = std::make_shared<TimerWheel>(config.timerTick);
+    m_sessionContext.pacer = std::make_shared<SubscriberPacer>(config.pacing, m_sessionContext.placement);
+    m_sessionContext.closer = std::make_shared<ConnectionCloser>(config.teardown);
+    m_sessionContext.fanout = config.fanout;
+    m_sessionContext.qos = config.qos;
+    m_sessionContext.bufferSize = config.sessionBufferSize;
+    m_sessionContext.startup = std::make_shared<StartupLatency>();
+    m_sessionContext.threads = std::make_shared<WarmThreadPool>(config.prewarm);
+    m_sharedMemory = config.sharedMemory;
+    m_udpOutputs = config.udpOutputs;
+    m_waiting = config.waiting;
+    m_adminSnapshot = std::make_shared<AdminSnapshot>();
+    m_cluster = ClusterPlacement::create(config.cluster);
+}
+
+StreamManager::~StreamManager() {
+    m_sessionContext.timers->stop();
+    std::vector<std::shared_ptr<StreamHandler> > waitingSubscribers;
+    for (auto &waiting: m_waitingByStreamId) {
+        for (auto &subscriber: waiting.second) {
+            waitingSubscribers.push_back(std::move(subscriber.handler));
+        }
+    }
+    m_sessionContext.closer->wait(m_sessionContext.closer->submit(std::move(waitingSubscribers)));
+}
 
-bool StreamManager::onPublisherConnected(std::shared_ptr<StreamHandler> publisherHandler) {
+bool StreamManager::onPublisherConnected(std::shared_ptr<StreamHandler> publisherHandler,
+                                         const CpuSet &listenerCpus) {
+    if (isDraining()) {
+        LOG_WARNING("Node draining, rejecting publisher", LogFields().stream(publisherHandler->getStreamId())
+                    .from(publisherHandler->getPeerAddress()));
+        return false;
+    }
+    if (!startSession(publisherHandler, listenerCpus)) {
+        return false;
+    }
+    if (m_cluster) {
+        m_cluster->streamStarted(publisherHandler->getStreamId());
+    }
+    return true;
+}
+
+bool StreamManager::startSession(const std::shared_ptr<StreamHandler> &publisherHandler,
+                                 const CpuSet &listenerCpus) {
     std::lock_guard<std::mutex> lock(m_sessionsMutex);
 
     // Check if Stream ID already exists
     if (m_sessionsByStreamId.find(publisherHandler->getStreamId()) != m_sessionsByStreamId.end()) {
-        std::cerr << "Stream ID " << publisherHandler->getStreamId() << " already exists" << std::endl;
+        LOG_WARNING("Stream ID already exists", LogFields().stream(publisherHandler->getStreamId())
+                    .from(publisherHandler->getPeerAddress()));
         return false;
     }
 
     auto session = std::make_shared<StreamSession>(
         publisherHandler,
-        std::weak_ptr<StreamEventListener>(shared_from_this()));
+        std::weak_ptr<StreamEventListener>(shared_from_this()),
+        m_sessionContext);
     m_sessionsByStreamId[publisherHandler->getStreamId()] = session;
 
+    // Co-located consumers can read the stream from shared memory instead of subscribing over loopback
+    if (publisherHandler->getStreamParams().getBool("shm", m_sharedMemory.enabledByDefault)) {
+        if (auto output = SharedMemoryOutput::create(publisherHandler->getStreamId(), m_sharedMemory)) {
+            session->addOutput(output);
+        } else {
+            LOG_WARNING("Failed to create shared memory output", LogFields().stream(publisherHandler->getStreamId()));
+        }
+    }
+
+    auto udpDestination = m_udpOutputs.destinations.find(publisherHandler->getStreamId());
+    if (udpDestination != m_udpOutputs.destinations.end()) {
+        if (auto output = UdpOutput::create(publisherHandler->getStreamId(), udpDestination->second, m_udpOutputs)) {
+            session->addOutput(output);
+        }
+    }
+
     // Start publishing
-    if (!session->startPublishing()) {
+    if (!session->startPublishing(listenerCpus)) {
         // If already publishing, remove the session
         m_sessionsByStreamId.erase(publisherHandler->getStreamId());
         return false;
     }
 
-    std::cout << "Added publisher to stream " << publisherHandler->getStreamId() << std::endl;
+    LOG_INFO("Added publisher to stream", LogFields().stream(publisherHandler->getStreamId())
+             .from(publisherHandler->getPeerAddress()));
+
+    if (m_budgetTimer == TimerWheel::INVALID_TIMER) {
+        scheduleBudgetChecks();
+    }
+    if (m_cluster && m_directoryTimer == TimerWheel::INVALID_TIMER) {
+        std::weak_ptr<StreamManager> self = weak_from_this();
+        m_directoryTimer = m_sessionContext.timers->scheduleRepeating(m_cluster->getRenewInterval(), [self] {
+            if (auto manager = self.lock()) {
+                manager->renewDirectoryEntries();
+            }
+        });
+    }
+
+    // Everyone who arrived early joins in one batch instead of retrying all at once
+    auto waiting = m_waitingByStreamId.find(publisherHandler->getStreamId());
+    if (waiting != m_waitingByStreamId.end()) {
+        std::vector<std::shared_ptr<StreamHandler> > subscribers;
+        subscribers.reserve(waiting->second.size());
+        for (auto &subscriber: waiting->second) {
+            m_sessionContext.timers->cancel(subscriber.timeout);
+            subscribers.push_back(std::move(subscriber.handler));
+        }
+        m_waitingByStreamId.erase(waiting);
+        session->addSubscribers(subscribers);
+        LOG_INFO("Attached waiting subscribers", LogFields().stream(publisherHandler->getStreamId())
+                 .with(std::to_string(subscribers.size())));
+    }
     return true;
 }
 
 void StreamManager::removePublishingStream(std::shared_ptr<StreamHandler> publisherHandler) {
-    std::cout << "Removing publisher from stream " << publisherHandler->getStreamId() << std::endl;
-    std::shared_ptr<StreamSession> sessionToCleanup; {
+    LOG_INFO("Removing publisher from stream", LogFields().stream(publisherHandler->getStreamId()));
+    std::shared_ptr<StreamSession> sessionToCleanup;
+    std::shared_ptr<ClusterPlacement> cluster; {
         std::lock_guard<std::mutex> lock(m_sessionsMutex);
+        cluster = m_cluster;
 
+        // A late disconnect event of a publisher that was already dropped must not take down the
+        // session of an encoder that reconnected under the same ID since
         auto it = m_sessionsByStreamId.find(publisherHandler->getStreamId());
-        if (it != m_sessionsByStreamId.end()) {
+        if (it != m_sessionsByStreamId.end() && it->second->getStreamHandler() == publisherHandler) {
             sessionToCleanup = it->second;
             m_sessionsByStreamId.erase(it);
         }
     }
 
-    std::cout << "Removed publisher from stream " << publisherHandler->getStreamId() << std::endl;
+    LOG_INFO("Removed publisher from stream", LogFields().stream(publisherHandler->getStreamId()));
+    if (sessionToCleanup && cluster) {
+        cluster->streamEnded(publisherHandler->getStreamId());
+    }
     // Wait for cleanup to complete
     if (sessionToCleanup) {
         sessionToCleanup->cleanupSession();
@@ -71,25 +169,340 @@ void StreamManager::removePublishingStream(std::shared_ptr<StreamHandler> publis
 }
 
 bool StreamManager::onSubscriberConnected(std::shared_ptr<StreamHandler> subscriber) {
+    if (isDraining()) {
+        LOG_WARNING("Node draining, rejecting subscriber", LogFields().stream(subscriber->getStreamId())
+                    .from(subscriber->getPeerAddress()));
+        return false;
+    }
+    // Serving the whole stream instead would send the subscriber what it asked not to get
+    PidFilter filter;
+    const auto &params = subscriber->getStreamParams();
+    if (params.has("pids") && !PidFilter::parse(params.get("pids"), filter)) {
+        LOG_WARNING("Invalid PID filter, rejecting subscriber", LogFields().stream(subscriber->getStreamId())
+                    .from(subscriber->getPeerAddress()).with("pids=" + params.get("pids")));
+        return false;
+    }
+
     std::lock_guard<std::mutex> lock(m_sessionsMutex);
 
     auto it = m_sessionsByStreamId.find(subscriber->getStreamId());
     if (it == m_sessionsByStreamId.end()) {
-        std::cerr << "Stream Session for ID " << subscriber->getStreamId() << " not found" << std::endl;
-        return false;
+        auto &waiting = m_waitingByStreamId[subscriber->getStreamId()];
+        if (m_waiting.timeout.count() <= 0 || waiting.size() >= m_waiting.maxPerStream) {
+            if (waiting.empty()) {
+                m_waitingByStreamId.erase(subscriber->getStreamId());
+            }
+            LOG_WARNING("Stream session not found", LogFields().stream(subscriber->getStreamId())
+                        .from(subscriber->getPeerAddress()));
+            return false;
+        }
+
+        // Hold the subscriber until the publisher arrives instead of making it retry
+        std::weak_ptr<StreamManager> self = weak_from_this();
+        auto timeout = m_sessionContext.timers->schedule(m_waiting.timeout, [self, subscriber] {
+            if (auto manager = self.lock()) {
+                manager->expireWaitingSubscriber(subscriber->getStreamId(), subscriber);
+            }
+        });
+        waiting.push_back(WaitingSubscriber{subscriber, timeout});
+        LOG_INFO("Subscriber waiting for stream", LogFields().stream(subscriber->getStreamId())
+                 .from(subscriber->getPeerAddress()));
+        return true;
     }
     auto streamSession = it->second;
 
+    // Adding viewers to a stream already over budget would only degrade the ones it has
+    if (streamSession->isOverloaded()) {
+        LOG_WARNING("Stream over resource budget, rejecting subscriber", LogFields().stream(subscriber->getStreamId())
+                    .from(subscriber->getPeerAddress()));
+        return false;
+    }
+
     streamSession->addSubscriber(subscriber);
     return true;
 }
 
+size_t StreamManager::getWaitingSubscriberCount() {
+    std::lock_guard<std::mutex> lock(m_sessionsMutex);
+    size_t count = 0;
+    for (const auto &waiting: m_waitingByStreamId) {
+        count += waiting.second.size();
+    }
+    return count;
+}
+
+void StreamManager::renewDirectoryEntries() {
+    std::vector<std::string> streamIds; {
+        std::lock_guard<std::mutex> lock(m_sessionsMutex);
+        streamIds.reserve(m_sessionsByStreamId.size());
+        for (const auto &entry: m_sessionsByStreamId) {
+            streamIds.push_back(entry.first);
+        }
+    }
+    m_cluster->renew(streamIds);
+}
+
+void StreamManager::checkResourceBudgets() {
+    std::vector<std::shared_ptr<StreamSession> > sessions;
+    std::vector<std::pair<std::string, SessionUsage> > samples; {
+        std::lock_guard<std::mutex> lock(m_sessionsMutex);
+        sessions.reserve(m_sessionsByStreamId.size());
+        for (const auto &entry: m_sessionsByStreamId) {
+            sessions.push_back(entry.second);
+            samples.emplace_back(entry.first, SessionUsage());
+        }
+    }
+    // Sampled off the sessions lock, getUsage() takes each session's own locks
+    for (size_t i = 0; i < sessions.size(); ++i) {
+        samples[i].second = sessions[i]->getUsage();
+    }
+
+    bool nodeOverloaded = false;
+    std::vector<StreamUsage> usage;
+    {
+        std::lock_guard<std::mutex> lock(m_usageMutex);
+        usage = m_budget.evaluate(samples, std::chrono::steady_clock::now(), nodeOverloaded);
+        if (nodeOverloaded != m_nodeOverloaded) {
+            if (nodeOverloaded) {
+                LOG_WARNING("Node over resource budget, shedding best effort subscribers on all streams");
+            } else {
+                LOG_INFO("Node back within resource budget");
+            }
+        }
+        m_nodeOverloaded = nodeOverloaded;
+    }
+
+    for (size_t i = 0; i < sessions.size(); ++i) {
+        bool overloaded = nodeOverloaded || usage[i].overBudget;
+        if (overloaded == sessions[i]->isOverloaded()) {
+            continue;
+        }
+        sessions[i]->setOverloaded(overloaded);
+        std::string detail = "cpu_percent=" + std::to_string(static_cast<int>(usage[i].cpuPercent)) +
+                             " buffered_bytes=" + std::to_string(usage[i].usage.bufferedBytes);
+        if (overloaded) {
+            LOG_WARNING("Stream over resource budget, shedding best effort and rejecting subscribers",
+                        LogFields().stream(usage[i].streamId).with(detail));
+        } else {
+            LOG_INFO("Stream back within resource budget", LogFields().stream(usage[i].streamId).with(detail));
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_usageMutex);
+    m_lastUsage = std::move(usage);
+}
+
+std::vector<StreamUsage> StreamManager::getSessionUsage() {
+    std::lock_guard<std::mutex> lock(m_usageMutex);
+    return m_lastUsage;
+}
+
+bool StreamManager::isNodeOverloaded() {
+    std::lock_guard<std::mutex> lock(m_usageMutex);
+    return m_nodeOverloaded;
+}
+
+void StreamManager::publishAdminSnapshot() {
+    std::vector<std::shared_ptr<StreamSession> > sessions; {
+        std::lock_guard<std::mutex> lock(m_sessionsMutex);
+        sessions.reserve(m_sessionsByStreamId.size());
+        for (const auto &entry: m_sessionsByStreamId) {
+            sessions.push_back(entry.second);
+        }
+    }
+
+    auto snapshot = std::make_shared<AdminSnapshot>();
+    snapshot->takenAt = std::chrono::system_clock::now();
+    snapshot->draining = isDraining();
+    snapshot->startup = m_sessionContext.startup->getStats();
+    snapshot->streams.reserve(sessions.size());
+    for (const auto &session: sessions) {
+        snapshot->streams.push_back(session->getStatus());
+    }
+    std::sort(snapshot->streams.begin(), snapshot->streams.end(), [](const StreamStatus &a, const StreamStatus &b) {
+        return a.streamId < b.streamId;
+    });
+    std::atomic_store(&m_adminSnapshot, std::shared_ptr<const AdminSnapshot>(std::move(snapshot)));
+}
+
+size_t StreamManager::kickSubscriber(const std::string &streamId, const std::string &peerAddress) {
+    std::shared_ptr<StreamSession> session; {
+        std::lock_guard<std::mutex> lock(m_sessionsMutex);
+        auto it = m_sessionsByStreamId.find(streamId);
+        if (it == m_sessionsByStreamId.end()) {
+            return 0;
+        }
+        session = it->second;
+    }
+    return session->kickSubscriber(peerAddress);
+}
+
+bool StreamManager::dropStream(const std::string &streamId) {
+    std::shared_ptr<StreamHandler> publisherHandler; {
+        std::lock_guard<std::mutex> lock(m_sessionsMutex);
+        auto it = m_sessionsByStreamId.find(streamId);
+        if (it == m_sessionsByStreamId.end()) {
+            return false;
+        }
+        publisherHandler = it->second->getStreamHandler();
+    }
+    LOG_INFO("Dropping stream", LogFields().stream(streamId).from(publisherHandler->getPeerAddress()));
+    removePublishingStream(publisherHandler);
+    return true;
+}
+
+bool StreamManager::dropStreamInBackground(const std::string &streamId) {
+    {
+        std::lock_guard<std::mutex> lock(m_sessionsMutex);
+        if (m_sessionsByStreamId.find(streamId) == m_sessionsByStreamId.end()) {
+            return false;
+        }
+    }
+    std::weak_ptr<StreamManager> self = weak_from_this();
+    // Teardown blocks, so it runs on its own thread like a publisher disconnect
+    std::thread([self, streamId] {
+        if (auto manager = self.lock()) {
+            manager->dropStream(streamId);
+        }
+    }).detach();
+    return true;
+}
+
+void StreamManager::setDraining(bool draining) {
+    if (m_draining.exchange(draining) == draining) {
+        return;
+    }
+    if (!draining) {
+        LOG_INFO("Node accepting connections again");
+        return;
+    }
+
+    std::vector<std::shared_ptr<StreamHandler> > waitingSubscribers; {
+        std::lock_guard<std::mutex> lock(m_sessionsMutex);
+        for (auto &waiting: m_waitingByStreamId) {
+            for (auto &subscriber: waiting.second) {
+                m_sessionContext.timers->cancel(subscriber.timeout);
+                waitingSubscribers.push_back(std::move(subscriber.handler));
+            }
+        }
+        m_waitingByStreamId.clear();
+    }
+    LOG_INFO("Node draining, new publishers and subscribers are rejected", LogFields().with(
+                 "waiting_subscribers_released=" + std::to_string(waitingSubscribers.size())));
+    m_sessionContext.closer->submit(std::move(waitingSubscribers));
+}
+
+void StreamManager::dropAllStreams(std::chrono::steady_clock::duration spread) {
+    std::vector<std::string> streamIds; {
+        std::lock_guard<std::mutex> lock(m_sessionsMutex);
+        for (const auto &entry: m_sessionsByStreamId) {
+            streamIds.push_back(entry.first);
+        }
+    }
+    LOG_INFO("Dropping remaining streams", LogFields().with(
+                 "streams=" + std::to_string(streamIds.size()) + " spread_ms=" +
+                 std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(spread).count())));
+
+    std::weak_ptr<StreamManager> self = weak_from_this();
+    for (size_t i = 0; i < streamIds.size(); ++i) {
+        auto delay = spread * static_cast<int64_t>(i) / static_cast<int64_t>(streamIds.size());
+        m_sessionContext.timers->schedule(delay, [self, streamId = streamIds[i]] {
+            if (auto manager = self.lock()) {
+                manager->dropStreamInBackground(streamId);
+            }
+        });
+    }
+}
+
+size_t StreamManager::getSessionCount() {
+    std::lock_guard<std::mutex> lock(m_sessionsMutex);
+    return m_sessionsByStreamId.size();
+}
+
+void StreamManager::applyConfig(const ServerConfig &config) {
+    m_sessionContext.pacer->setSettings(config.pacing);
+    m_sessionContext.closer->setSettings(config.teardown);
+    m_sessionContext.threads->setSettings(config.prewarm);
+
+    bool intervalChanged; {
+        std::lock_guard<std::mutex> lock(m_usageMutex);
+        intervalChanged = m_budget.getSettings().checkInterval != config.budget.checkInterval;
+        m_budget.setSettings(config.budget);
+    }
+
+    std::vector<std::shared_ptr<StreamSession> > sessions; {
+        std::lock_guard<std::mutex> lock(m_sessionsMutex);
+        if (intervalChanged && m_budgetTimer != TimerWheel::INVALID_TIMER) {
+            m_sessionContext.timers->cancel(m_budgetTimer);
+            scheduleBudgetChecks();
+        }
+        m_sessionContext.fanout = config.fanout;
+        m_sessionContext.qos = config.qos;
+        m_sessionContext.bufferSize = config.sessionBufferSize;
+        m_sharedMemory = config.sharedMemory;
+        m_udpOutputs = config.udpOutputs;
+        m_waiting = config.waiting;
+        for (const auto &entry: m_sessionsByStreamId) {
+            sessions.push_back(entry.second);
+        }
+    }
+    for (const auto &session: sessions) {
+        session->applyTuning(config.fanout, config.qos);
+    }
+}
+
+void StreamManager::scheduleBudgetChecks() {
+    std::chrono::milliseconds interval; {
+        std::lock_guard<std::mutex> lock(m_usageMutex);
+        interval = m_budget.getSettings().checkInterval;
+    }
+    std::weak_ptr<StreamManager> self = weak_from_this();
+    m_budgetTimer = m_sessionContext.timers->scheduleRepeating(interval, [self] {
+        if (auto manager = self.lock()) {
+            manager->checkResourceBudgets();
+        }
+    });
+}
+
+void StreamManager::expireWaitingSubscriber(const std::string &streamId,
+                                            const std::shared_ptr<StreamHandler> &subscriber) {
+    {
+        std::lock_guard<std::mutex> lock(m_sessionsMutex);
+        auto waiting = m_waitingByStreamId.find(streamId);
+        if (waiting == m_waitingByStreamId.end()) {
+            return;
+        }
+        auto &subscribers = waiting->second;
+        auto it = std::find_if(subscribers.begin(), subscribers.end(), [&subscriber](const WaitingSubscriber &entry) {
+            return entry.handler == subscriber;
+        });
+        // Already attached, the publisher won the race against the timeout
+        if (it == subscribers.end()) {
+            return;
+        }
+        subscribers.erase(it);
+        if (subscribers.empty()) {
+            m_waitingByStreamId.erase(waiting);
+        }
+    }
+
+    LOG_INFO("Stream not published in time, disconnecting subscriber", LogFields().stream(streamId)
+             .from(subscriber->getPeerAddress()));
+    // On the timer thread, which the other timeouts share; the close runs on the closer's threads
+    m_sessionContext.closer->submit({subscriber});
+}
+
 void StreamManager::onStreamEvent(const StreamEvent &event) {
-    // Handle Stream Event on new thread
-    std::thread([this, event]() {
+    // Handle Stream Event on new thread, which keeps the manager alive until it is done
+    std::weak_ptr<StreamManager> self = weak_from_this();
+    std::thread([self, event]() {
+        auto manager = self.lock();
+        if (!manager) {
+            return;
+        }
         switch (event.type) {
             case StreamEventType::PublisherDisconnected:
-                removePublishingStream(event.handler);
+                manager->removePublishingStream(event.handler);
                 break;
         }
     }).detach();
@@ -97,7 +510,7 @@ void StreamManager::onStreamEvent(const StreamEvent &event) {
 
 bool StreamManager::validateStreamId(const std::string &streamId) {
     if (streamId.empty()) {
-        std::cerr << "Stream ID cannot be empty" << std::endl;
+        LOG_WARNING("Stream ID cannot be empty");
         return false;
     }
     // TODO: Validate stream ID via callback api
@@ -22,17 +22,21 @@
 
 #include <unordered_map>
 
+#include "ServerConfig.h"
 #include "StreamSession.h"
+#include "utils/SharedMemoryOutput.h"
 #include "utils/StreamHandler.h"
+#include "utils/UdpOutput.h"
 
 class StreamManager : public StreamEventListener, public std::enable_shared_from_this<StreamManager> {
 public:
-    StreamManager();
+    explicit StreamManager(const ServerConfig &config = ServerConfig());
 
     ~StreamManager();
 
     // Stream management
-    bool onPublisherConnected(std::shared_ptr<StreamHandler> publisherHandler);
+    // listenerCpus are the CPUs of the listener that accepted the publisher, if it is pinned
+    bool onPublisherConnected(std::shared_ptr<StreamHandler> publisherHandler, const CpuSet &listenerCpus = CpuSet());
 
     bool onSubscriberConnected(std::shared_ptr<StreamHandler> subscriber);
 
@@ -43,6 +47,59 @@ public:
     // Stream validation
     bool validateStreamId(const std::string &streamId);
 
+    std::shared_ptr<CpuPlacement> getCpuPlacement() const { return m_sessionContext.placement; }
+
+    std::shared_ptr<TimerWheel> getTimers() const { return m_sessionContext.timers; }
+
+    std::shared_ptr<ConnectionCloser> getConnectionCloser() const { return m_sessionContext.closer; }
+
+    std::shared_ptr<StartupLatency> getStartupLatency() const { return m_sessionContext.startup; }
+
+    size_t getWaitingSubscriberCount();
+
+    // Null unless this node is part of a cluster
+    std::shared_ptr<ClusterPlacement> getCluster() const { return m_cluster; }
+
+    // Samples every session against the resource budgets, marking sessions over budget as overloaded.
+    // Runs on the timer wheel every budget.check_interval_ms once a stream is published.
+    void checkResourceBudgets();
+
+    // Usage of each stream as of the last budget check
+    std::vector<StreamUsage> getSessionUsage();
+
+    bool isNodeOverloaded();
+
+    // Rebuilds the admin snapshot from the sessions; runs periodically on the timer wheel
+    void publishAdminSnapshot();
+
+    // Last published snapshot, never blocks on the session locks
+    std::shared_ptr<const AdminSnapshot> getAdminSnapshot() const { return std::atomic_load(&m_adminSnapshot); }
+
+    // Returns how many connections were kicked
+    size_t kickSubscriber(const std::string &streamId, const std::string &peerAddress);
+
+    // Disconnects the publisher and every subscriber of the stream
+    bool dropStream(const std::string &streamId);
+
+    // Same as dropStream(), but the teardown runs on its own thread and this returns right away
+    bool dropStreamInBackground(const std::string &streamId);
+
+    // A draining node keeps its sessions but turns away new publishers and subscribers.
+    // Subscribers waiting for a stream are let go, their publisher won't come here any more.
+    void setDraining(bool draining);
+
+    // Drops every stream, spreading the closes evenly over spread so their viewers don't all
+    // reconnect elsewhere at once
+    void dropAllStreams(std::chrono::steady_clock::duration spread);
+
+    size_t getSessionCount();
+
+    bool isDraining() const { return m_draining.load(std::memory_order_relaxed); }
+
+    // Live reload of limits and tuning. Running sessions take the new fan-out and QoS settings;
+    // output, buffer and waiting settings apply to streams and subscribers that arrive afterwards.
+    void applyConfig(const ServerConfig &config);
+
 protected:
     std::mutex &getSessionsMutex() { return m_sessionsMutex; }
 
@@ -51,8 +108,49 @@ protected:
     }
 
 private:
+    struct WaitingSubscriber {
+        std::shared_ptr<StreamHandler> handler;
+        TimerWheel::TimerId timeout;
+    };
+
+    // Must be called with m_sessionsMutex held, which also guards m_budgetTimer
+    void scheduleBudgetChecks();
+
+    bool startSession(const std::shared_ptr<StreamHandler> &publisherHandler, const CpuSet &listenerCpus);
+
+    // Keeps the cluster directory entries of the streams published here from expiring
+    void renewDirectoryEntries();
+
+    // Disconnects a waiting subscriber whose stream didn't show up in time
+    void expireWaitingSubscriber(const std::string &streamId, const std::shared_ptr<StreamHandler> &subscriber);
+
     std::mutex m_sessionsMutex;
     std::unordered_map<std::string, std::shared_ptr<StreamSession> > m_sessionsByStreamId;
+
+    // Pacer and placement are shared by all sessions, so paced subscribers are driven by one timer thread
+    SessionContext m_sessionContext;
+    SharedMemorySettings m_sharedMemory;
+    UdpOutputSettings m_udpOutputs;
+
+    // Subscribers parked per absent stream, guarded by m_sessionsMutex like the sessions they wait for
+    WaitingSettings m_waiting;
+    std::unordered_map<std::string, std::vector<WaitingSubscriber> > m_waitingByStreamId;
+
+    // Checked on the timer thread; the last results are kept for stats under m_usageMutex
+    ResourceBudget m_budget;
+    TimerWheel::TimerId m_budgetTimer = TimerWheel::INVALID_TIMER;
+    std::mutex m_usageMutex;
+    std::vector<StreamUsage> m_lastUsage;
+    bool m_nodeOverloaded = false;
+
+    // Swapped atomically, readers keep whichever snapshot they loaded
+    std::shared_ptr<const AdminSnapshot> m_adminSnapshot;
+    std::atomic<bool> m_draining{false};
+
+    // Streams published here are registered outside m_sessionsMutex, the directory may be on a slow mount
+    std::shared_ptr<ClusterPlacement> m_cluster;
+    // Guarded by m_sessionsMutex
+    TimerWheel::TimerId m_directoryTimer = TimerWheel::INVALID_TIMER;
 };
 
 
@@ -19,13 +19,25 @@
 
 #include "StreamSession.h"
 
-#include <iostream>
+#include <algorithm>
+
+#include "FanoutPath.h"
+
+#include "utils/Logger.h"
 
 StreamSession::StreamSession(
     std::shared_ptr<StreamHandler> streamHandler,
-    std::weak_ptr<StreamEventListener> eventListener)
+    std::weak_ptr<StreamEventListener> eventListener,
+    SessionContext context)
     : m_publisherHandler(std::move(streamHandler)),
-      m_eventListener(std::move(eventListener)) {
+      m_eventListener(std::move(eventListener)),
+      m_context(std::move(context)) {
+    if (!m_context.closer) {
+        m_context.closer = std::make_shared<ConnectionCloser>();
+    }
+    // The publisher thread reads the QoS settings from the snapshot, even with only paced subscribers
+    std::lock_guard<std::mutex> lock(m_subscribersMutex);
+    publishSubscribersSnapshot();
 }
 
 StreamSession::~StreamSession() {
@@ -39,7 +51,9 @@ void StreamSession::cleanupSession() {
     m_running = false;
 
     try {
-        removeAllSubscribers();
+        auto startedAt = std::chrono::steady_clock::now();
+        // Subscribers close on the closer's threads while the publisher side shuts down here
+        auto closing = removeAllSubscribers();
 
         // Only try to join if we're not in the publisher thread
         if (m_publisherThread && m_publisherThread->joinable()) {
@@ -48,16 +62,39 @@ void StreamSession::cleanupSession() {
             }
             m_publisherThread.reset();
         }
+        if (m_publisherJob) {
+            if (m_publisherJob->getThreadId() != std::this_thread::get_id()) {
+                m_publisherJob->wait();
+            }
+            m_publisherJob.reset();
+        }
+        std::shared_ptr<FanoutWorkers> fanoutWorkers; {
+            std::lock_guard<std::mutex> lock(m_usageMutex);
+            fanoutWorkers.swap(m_fanoutWorkers);
+        }
+        if (fanoutWorkers) {
+            fanoutWorkers->stop();
+        }
 
         m_publisherHandler->disconnect();
 
-        // Sleep for 100ms to allow the publisher thread to stop
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (m_context.placement && m_placementSlot >= 0) {
+            m_context.placement->releaseSessionSlot(m_placementSlot);
+            m_placementSlot = -1;
+        }
+
+        bool closed = m_context.closer->wait(closing);
+        LOG_INFO("Stream session torn down", LogFields().stream(m_publisherHandler->getStreamId()).with(
+                     "subscribers=" + std::to_string(closing->getSize()) + " teardown_us=" +
+                     std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(
+                         std::chrono::steady_clock::now() - startedAt).count()) +
+                     (closed ? "" : " still_closing=true")));
         // Signal cleanup is done
         m_cleanupDone = true;
         m_cleanupCV.notify_all();
     } catch (const std::exception &e) {
-        std::cerr << "Exception in StreamSession cleanup: " << e.what() << std::endl;
+        LOG_ERROR("Exception in StreamSession cleanup", LogFields().stream(m_publisherHandler->getStreamId())
+                  .with(e.what()));
         m_cleanupDone = true;
         m_cleanupCV.notify_all();
     }
@@ -72,35 +109,503 @@ void StreamSession::waitForCleanup() {
 
 void StreamSession::addSubscriber(std::shared_ptr<StreamHandler> subscriber) {
     std::lock_guard<std::mutex> lock(m_subscribersMutex);
+    if (addSubscriberLocked(subscriber)) {
+        publishSubscribersSnapshot();
+    }
+}
+
+void StreamSession::addSubscribers(const std::vector<std::shared_ptr<StreamHandler> > &subscribers) {
+    std::lock_guard<std::mutex> lock(m_subscribersMutex);
+    bool changed = false;
+    for (const auto &subscriber: subscribers) {
+        changed = addSubscriberLocked(subscriber) || changed;
+    }
+    if (changed) {
+        publishSubscribersSnapshot();
+    }
+}
+
+bool StreamSession::addSubscriberLocked(const std::shared_ptr<StreamHandler> &subscriber) {
+    if (m_context.startup && subscriber->getAcceptedAt() != std::chrono::steady_clock::time_point()) {
+        m_joining.push_back(JoiningSubscriber{subscriber, std::chrono::steady_clock::now()});
+        m_hasJoining.store(true, std::memory_order_relaxed);
+    }
+    // Filtered subscribers are sent repacked payloads by the publisher thread, never paced
+    PacingSettings pacing = m_context.pacer ? m_context.pacer->getSettings() : PacingSettings();
+    bool paced = m_context.pacer && !subscriber->getStreamParams().has("pids") &&
+                 subscriber->getStreamParams().getBool("pace", pacing.enabledByDefault);
+
+    if (paced) {
+        auto pacedSubscriber = std::make_shared<PacedSubscriber>(subscriber);
+        applyQosLocked(*pacedSubscriber, pacing);
+        updatePacingRate(pacedSubscriber);
+        m_pacedSubscribers.push_back(pacedSubscriber);
+        m_context.pacer->registerSubscriber(pacedSubscriber);
+        LOG_INFO("Added paced subscriber to stream", LogFields().stream(m_publisherHandler->getStreamId())
+                 .from(subscriber->getPeerAddress()));
+        return true;
+    }
     m_subscribers.push_back(subscriber);
-    std::cout << "Added subscriber to stream " << m_publisherHandler->getStreamId() << std::endl;
+    LOG_INFO("Added subscriber to stream", LogFields().stream(m_publisherHandler->getStreamId())
+             .from(subscriber->getPeerAddress()));
+    return true;
 }
 
 void StreamSession::removeSubscriber(std::shared_ptr<StreamHandler> subscriber) {
+    {
+        std::lock_guard<std::mutex> lock(m_subscribersMutex);
+        bool changed = false;
+        auto it = std::remove(m_subscribers.begin(), m_subscribers.end(), subscriber);
+        if (it != m_subscribers.end()) {
+            m_subscribers.erase(it, m_subscribers.end());
+            changed = true;
+        }
+        forgetJoiningLocked(subscriber);
+        for (auto paced = m_pacedSubscribers.begin(); paced != m_pacedSubscribers.end(); ++paced) {
+            if ((*paced)->getHandler() == subscriber) {
+                m_context.pacer->unregisterSubscriber(*paced);
+                m_pacedSubscribers.erase(paced);
+                changed = true;
+                break;
+            }
+        }
+        if (!changed) {
+            // Already removed, and closed, by whoever took it out
+            return;
+        }
+        publishSubscribersSnapshot();
+    }
+    // Closed off the lock, like every other removal
+    m_context.closer->submit({std::move(subscriber)});
+}
+
+void StreamSession::addOutput(std::shared_ptr<StreamOutput> output) {
     std::lock_guard<std::mutex> lock(m_subscribersMutex);
-    m_subscribers.erase(
-        std::remove(m_subscribers.begin(), m_subscribers.end(), subscriber),
-        m_subscribers.end()
-    );
-    subscriber->disconnect();
+    LOG_INFO("Added output to stream", LogFields().stream(m_publisherHandler->getStreamId()).with(output->getName()));
+    m_outputs.push_back(std::move(output));
+    publishSubscribersSnapshot();
+}
+
+std::shared_ptr<CloseGroup> StreamSession::removeAllSubscribers() {
+    LOG_INFO("Removing all subscribers from stream", LogFields().stream(m_publisherHandler->getStreamId()));
+    std::vector<std::shared_ptr<StreamHandler> > subscribers;
+    std::vector<std::shared_ptr<PacedSubscriber> > pacedSubscribers;
+    std::vector<std::shared_ptr<StreamOutput> > outputs; {
+        std::lock_guard<std::mutex> lock(m_subscribersMutex);
+        subscribers.swap(m_subscribers);
+        pacedSubscribers.swap(m_pacedSubscribers);
+        outputs.swap(m_outputs);
+        publishSubscribersSnapshot();
+        m_joining.clear();
+        m_hasJoining.store(false, std::memory_order_relaxed);
+    }
+
+    for (auto &pacedSubscriber: pacedSubscribers) {
+        m_context.pacer->unregisterSubscriber(pacedSubscriber);
+        subscribers.push_back(pacedSubscriber->getHandler());
+    }
+    for (auto &output: outputs) {
+        output->close();
+    }
+    return m_context.closer->submit(std::move(subscribers));
 }
 
-void StreamSession::removeAllSubscribers() {
-    std::cout << "Removing all subscribers from stream " << m_publisherHandler->getStreamId() << std::endl;
+void StreamSession::applyQosLocked(PacedSubscriber &pacedSubscriber, const PacingSettings &pacing) const {
+    QosClass qosClass = m_context.qos.classOf(pacedSubscriber.getHandler()->getStreamParams());
+    int queuePercent = m_context.qos.get(qosClass).queuePercent;
+    pacedSubscriber.setMaxQueuedPackets(std::max<size_t>(pacing.maxQueuedPackets * std::max(queuePercent, 0) / 100, 1));
+    pacedSubscriber.setBestEffort(qosClass == QosClass::BestEffort);
+}
+
+void StreamSession::applyTuning(const FanoutSettings &fanout, const QosSettings &qos) {
+    PacingSettings pacing = m_context.pacer ? m_context.pacer->getSettings() : PacingSettings();
     std::lock_guard<std::mutex> lock(m_subscribersMutex);
-    for (auto &subscriber: m_subscribers) {
-        subscriber->disconnect();
+    m_context.fanout = fanout;
+    m_context.qos = qos;
+    for (const auto &pacedSubscriber: m_pacedSubscribers) {
+        applyQosLocked(*pacedSubscriber, pacing);
+    }
+    publishSubscribersSnapshot();
+}
+
+void StreamSession::publishSubscribersSnapshot() {
+    auto snapshot = std::make_shared<SubscriberSnapshot>();
+    snapshot->fanout = m_context.fanout;
+    snapshot->qos = m_context.qos;
+    snapshot->paced = m_pacedSubscribers;
+    snapshot->outputs = m_outputs;
+    for (const auto &subscriber: m_subscribers) {
+        QosClass qosClass = m_context.qos.classOf(subscriber->getStreamParams());
+        SubscriberClassGroup *target = &snapshot->classes[static_cast<size_t>(qosClass)];
+        PidFilter filter;
+        const auto &params = subscriber->getStreamParams();
+        // The manager rejects subscribers whose filter doesn't parse
+        if (params.has("pids") && PidFilter::parse(params.get("pids"), filter)) {
+            auto &filtered = snapshot->filtered[static_cast<size_t>(qosClass)];
+            auto it = std::find_if(filtered.begin(), filtered.end(), [&filter](const FilteredSubscriberGroup &group) {
+                return group.filter.getKey() == filter.getKey();
+            });
+            if (it == filtered.end()) {
+                std::string key = std::string(QosSettings::className(qosClass)) + "/" + filter.getKey();
+                filtered.push_back(FilteredSubscriberGroup{filter, std::move(key), {}});
+                it = filtered.end() - 1;
+                ++snapshot->filteredGroupCount;
+            }
+            target = &it->subscribers;
+        }
+        target->add(subscriber);
+    }
+    for (const auto &group: snapshot->classes) {
+        snapshot->all.insert(snapshot->all.end(), group.handlers.begin(), group.handlers.end());
+    }
+    for (const auto &groups: snapshot->filtered) {
+        for (const auto &group: groups) {
+            snapshot->all.insert(snapshot->all.end(), group.subscribers.handlers.begin(),
+                                 group.subscribers.handlers.end());
+        }
+    }
+    m_subscribersSnapshot = std::move(snapshot);
+    m_allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+SessionUsage StreamSession::getUsage() const {
+    SessionUsage usage;
+    std::vector<std::shared_ptr<PacedSubscriber> > pacedSubscribers;
+    std::vector<std::shared_ptr<StreamOutput> > outputs; {
+        std::lock_guard<std::mutex> lock(m_subscribersMutex);
+        usage.subscribers = m_subscribers.size() + m_pacedSubscribers.size();
+        pacedSubscribers = m_pacedSubscribers;
+        outputs = m_outputs;
+    }
+    for (const auto &pacedSubscriber: pacedSubscribers) {
+        usage.bufferedBytes += pacedSubscriber->getQueuedBytes();
+    }
+    for (const auto &output: outputs) {
+        usage.bufferedBytes += output->getBufferedBytes();
+        usage.reservedBytes += output->getReservedBytes();
+    }
+    usage.bufferedBytes += m_repacketizerBytes.load(std::memory_order_relaxed);
+    usage.allocations = m_allocations.load(std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(m_usageMutex);
+    usage.cpuMicros = std::max<int64_t>(m_publisherClock.cpuMicros() - m_publisherCpuStart, 0);
+    if (m_fanoutWorkers) {
+        usage.cpuMicros += m_fanoutWorkers->getCpuMicros();
+    }
+    return usage;
+}
+
+StreamStatus StreamSession::getStatus() const {
+    StreamStatus status;
+    status.streamId = m_publisherHandler->getStreamId();
+    status.publisherAddress = m_publisherHandler->getPeerAddress();
+    if (m_startedAt != std::chrono::steady_clock::time_point()) {
+        status.uptimeSeconds = std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::steady_clock::now() - m_startedAt).count();
+    }
+    status.bitsPerSecond = m_inputRate.bytesPerSecond() * 8;
+    status.overloaded = isOverloaded();
+
+    std::vector<std::shared_ptr<StreamHandler> > subscribers;
+    std::vector<std::shared_ptr<PacedSubscriber> > pacedSubscribers;
+    QosSettings qos; {
+        std::lock_guard<std::mutex> lock(m_subscribersMutex);
+        subscribers = m_subscribers;
+        pacedSubscribers = m_pacedSubscribers;
+        qos = m_context.qos;
+    }
+    // Link stats are queried off the lock, they may call into the transport
+    for (const auto &subscriber: subscribers) {
+        SubscriberStatus subscriberStatus;
+        subscriberStatus.peerAddress = subscriber->getPeerAddress();
+        subscriberStatus.qosClass = QosSettings::className(qos.classOf(subscriber->getStreamParams()));
+        LinkStats stats;
+        if (subscriber->getLinkStats(stats)) {
+            subscriberStatus.lagMicros = static_cast<int64_t>(stats.sendBufferMs) * 1000;
+            subscriberStatus.rttMs = stats.rttMs;
+        }
+        status.subscribers.push_back(std::move(subscriberStatus));
+    }
+    for (const auto &pacedSubscriber: pacedSubscribers) {
+        const auto &handler = pacedSubscriber->getHandler();
+        SubscriberStatus subscriberStatus;
+        subscriberStatus.peerAddress = handler->getPeerAddress();
+        subscriberStatus.qosClass = QosSettings::className(qos.classOf(handler->getStreamParams()));
+        subscriberStatus.paced = true;
+        subscriberStatus.lagMicros = pacedSubscriber->getQueueDelayMicros();
+        LinkStats stats;
+        if (handler->getLinkStats(stats)) {
+            subscriberStatus.rttMs = stats.rttMs;
+        }
+        status.subscribers.push_back(std::move(subscriberStatus));
+    }
+    return status;
+}
+
+size_t StreamSession::kickSubscriber(const std::string &peerAddress) {
+    std::vector<std::shared_ptr<StreamHandler> > kicked; {
+        std::lock_guard<std::mutex> lock(m_subscribersMutex);
+        auto it = std::remove_if(m_subscribers.begin(), m_subscribers.end(),
+                                 [&peerAddress](const std::shared_ptr<StreamHandler> &subscriber) {
+                                     return subscriber->getPeerAddress() == peerAddress;
+                                 });
+        if (it != m_subscribers.end()) {
+            kicked.insert(kicked.end(), it, m_subscribers.end());
+            m_subscribers.erase(it, m_subscribers.end());
+        }
+        for (auto paced = m_pacedSubscribers.begin(); paced != m_pacedSubscribers.end();) {
+            if ((*paced)->getHandler()->getPeerAddress() != peerAddress) {
+                ++paced;
+                continue;
+            }
+            m_context.pacer->unregisterSubscriber(*paced);
+            kicked.push_back((*paced)->getHandler());
+            paced = m_pacedSubscribers.erase(paced);
+        }
+        for (const auto &subscriber: kicked) {
+            forgetJoiningLocked(subscriber);
+        }
+        if (!kicked.empty()) {
+            publishSubscribersSnapshot();
+        }
+    }
+    if (!kicked.empty()) {
+        LOG_INFO("Kicked subscriber", LogFields().stream(m_publisherHandler->getStreamId()).from(peerAddress)
+                 .with("connections=" + std::to_string(kicked.size())));
+    }
+    size_t count = kicked.size();
+    m_context.closer->submit(std::move(kicked));
+    return count;
+}
+
+void StreamSession::removePacedSubscriber(const std::shared_ptr<PacedSubscriber> &pacedSubscriber) {
+    {
+        std::lock_guard<std::mutex> lock(m_subscribersMutex);
+        auto it = std::find(m_pacedSubscribers.begin(), m_pacedSubscribers.end(), pacedSubscriber);
+        if (it == m_pacedSubscribers.end()) {
+            return;
+        }
+        m_pacedSubscribers.erase(it);
+        publishSubscribersSnapshot();
+        m_context.pacer->unregisterSubscriber(pacedSubscriber);
+        forgetJoiningLocked(pacedSubscriber->getHandler());
+    }
+    // Called from the publisher thread, the close runs on the closer's threads
+    m_context.closer->submit({pacedSubscriber->getHandler()});
+}
+
+void StreamSession::updatePacingRate(const std::shared_ptr<PacedSubscriber> &pacedSubscriber) const {
+    int64_t inputRate = m_inputRate.bytesPerSecond();
+    if (inputRate <= 0) {
+        return;
+    }
+    int headroomPercent = m_context.pacer->getSettings().headroomPercent;
+    pacedSubscriber->setRate(inputRate * (100 + headroomPercent) / 100);
+    pacedSubscriber->getHandler()->setBandwidthHints(inputRate, headroomPercent);
+}
+
+bool StreamSession::sendToPacedSubscribers(const std::vector<std::shared_ptr<PacedSubscriber> > &pacedSubscribers,
+                                           const char *data, int len, const MessageControl &control,
+                                           bool overloaded) {
+    // One shared copy of the packet serves every paced subscriber
+    auto packet = std::make_shared<StreamPacket>();
+    packet->data.assign(data, data + len);
+    packet->receivedAt = std::chrono::steady_clock::now();
+    packet->control = control;
+    m_allocations.fetch_add(1, std::memory_order_relaxed);
+
+    bool shed = false;
+    for (const auto &pacedSubscriber: pacedSubscribers) {
+        // Their queues are part of the budget the overload is about, shed them like unpaced previews
+        if (overloaded && pacedSubscriber->isBestEffort()) {
+            shed = true;
+            continue;
+        }
+        if (!pacedSubscriber->enqueue(packet, pacedSubscriber->getMaxQueuedPackets())) {
+            LOG_WARNING("Dropping paced subscriber", LogFields().stream(m_publisherHandler->getStreamId())
+                        .from(pacedSubscriber->getHandler()->getPeerAddress())
+                        .with(pacedSubscriber->hasFailed() ? "send failed" : "queue overflow"));
+            removePacedSubscriber(pacedSubscriber);
+        }
+    }
+    return shed;
+}
+
+void StreamSession::writeToOutputs(const std::vector<std::shared_ptr<StreamOutput> > &outputs,
+                                   const char *data, int len, const MessageControl &control) {
+    for (const auto &output: outputs) {
+        if (output->write(data, len, control)) {
+            continue;
+        }
+        LOG_WARNING("Dropping stream output", LogFields().stream(m_publisherHandler->getStreamId())
+                    .with(output->getName()));
+        {
+            std::lock_guard<std::mutex> lock(m_subscribersMutex);
+            m_outputs.erase(std::remove(m_outputs.begin(), m_outputs.end(), output), m_outputs.end());
+            publishSubscribersSnapshot();
+        }
+        // Closed off the lock, closing may join the output's own threads
+        output->close();
+    }
+}
+
+void StreamSession::sendToSubscribers(const SubscriberClassGroup &subscribers, const char *data, int len,
+                                      const MessageControl &control,
+                                      std::vector<std::shared_ptr<StreamHandler> > &failed) {
+    sendToAll<SrtTransport>(subscribers.srtTargets.data(), subscribers.srtTargets.size(), data, len, control,
+                            m_isDisconnecting, [&](size_t index) {
+                                const auto &subscriber = subscribers.srtHandlers[index];
+                                LOG_WARNING("Failed to send data to subscriber", LogFields()
+                                            .stream(m_publisherHandler->getStreamId())
+                                            .from(subscriber->getPeerAddress())
+                                            .error(srt_getlasterror(nullptr))
+                                            .with(srt_getlasterror_str()));
+                                failed.push_back(subscriber);
+                            });
+
+    sendToAll<HandlerTransport>(subscribers.otherHandlers.data(), subscribers.otherHandlers.size(), data, len,
+                                control, m_isDisconnecting, [&](size_t index) {
+                                    const auto &subscriber = subscribers.otherHandlers[index];
+                                    LOG_WARNING("Failed to send data to subscriber", LogFields()
+                                                .stream(m_publisherHandler->getStreamId())
+                                                .from(subscriber->getPeerAddress())
+                                                .error(subscriber->getLastErrorCode())
+                                                .with(subscriber->getLastErrorMessage()));
+                                    failed.push_back(subscriber);
+                                });
+}
+
+void StreamSession::sendToFilteredSubscribers(const FilteredSubscriberGroup &group, const char *data, int len,
+                                              const MessageControl &control,
+                                              std::chrono::steady_clock::time_point receivedAt,
+                                              std::vector<std::shared_ptr<StreamHandler> > &failed) {
+    auto it = m_repacketizers.find(group.key);
+    if (it == m_repacketizers.end()) {
+        it = m_repacketizers.emplace(group.key, TsRepacketizer(group.filter)).first;
+    }
+    it->second.process(data, len, control, receivedAt,
+                       [&](const char *payload, int payloadLen, const MessageControl &payloadControl) {
+                           sendToSubscribers(group.subscribers, payload, payloadLen, payloadControl, failed);
+                       });
+}
+
+void StreamSession::updateRepacketizers(const SubscriberSnapshot &subscribers) {
+    // Drop the state of groups nobody is in any more
+    if (m_repacketizers.size() > subscribers.filteredGroupCount) {
+        for (auto it = m_repacketizers.begin(); it != m_repacketizers.end();) {
+            bool used = std::any_of(subscribers.filtered.begin(), subscribers.filtered.end(),
+                                    [&it](const std::vector<FilteredSubscriberGroup> &groups) {
+                                        return std::any_of(groups.begin(), groups.end(),
+                                                           [&it](const FilteredSubscriberGroup &group) {
+                                                               return group.key == it->first;
+                                                           });
+                                    });
+            it = used ? std::next(it) : m_repacketizers.erase(it);
+        }
+    }
+    size_t bufferedBytes = 0;
+    for (const auto &repacketizer: m_repacketizers) {
+        bufferedBytes += repacketizer.second.getBufferedBytes();
+    }
+    m_repacketizerBytes.store(bufferedBytes, std::memory_order_relaxed);
+}
+
+void StreamSession::dropStarvedSubscribers(const SubscriberSnapshot &subscribers,
+                                           const std::vector<std::shared_ptr<PacedSubscriber> > &pacedSubscribers,
+                                           std::chrono::steady_clock::time_point now,
+                                           std::vector<std::shared_ptr<StreamHandler> > &failed) {
+    if (subscribers.qos.overloadDisconnect.count() <= 0) {
+        return;
+    }
+    if (m_starvedSince == std::chrono::steady_clock::time_point()) {
+        m_starvedSince = now;
+        return;
+    }
+    if (now - m_starvedSince < subscribers.qos.overloadDisconnect) {
+        return;
+    }
+    // Best effort subscribers that join later get a grace period of their own
+    m_starvedSince = std::chrono::steady_clock::time_point();
+
+    size_t index = static_cast<size_t>(QosClass::BestEffort);
+    size_t failedBefore = failed.size();
+    failed.insert(failed.end(), subscribers.classes[index].handlers.begin(), subscribers.classes[index].handlers.end());
+    for (const auto &group: subscribers.filtered[index]) {
+        failed.insert(failed.end(), group.subscribers.handlers.begin(), group.subscribers.handlers.end());
+    }
+    size_t starved = failed.size() - failedBefore;
+    for (const auto &pacedSubscriber: pacedSubscribers) {
+        if (pacedSubscriber->isBestEffort()) {
+            removePacedSubscriber(pacedSubscriber);
+            ++starved;
+        }
+    }
+    LOG_WARNING("Overload starved best effort subscribers, disconnecting", LogFields()
+                .stream(m_publisherHandler->getStreamId())
+                .with("subscribers=" + std::to_string(starved)));
+}
+
+bool StreamSession::shouldShed(QosClass qosClass, const QosSettings &qos, const SubscriberClassGroup &subscribers,
+                               std::chrono::steady_clock::time_point receivedAt) {
+    bool overloaded = qosClass == QosClass::BestEffort && m_overloaded.load(std::memory_order_relaxed);
+    auto budget = qos.get(qosClass).sendBudget;
+    bool overBudget = budget.count() > 0 && std::chrono::steady_clock::now() - receivedAt > budget;
+    if (!overloaded && !overBudget) {
+        return false;
     }
-    m_subscribers.clear();
+    m_shedPackets[static_cast<size_t>(qosClass)].fetch_add(1, std::memory_order_relaxed);
+    // Overload transitions are logged by the manager, not per packet
+    if (!overBudget) {
+        return true;
+    }
+    LOG_WARNING("Fan-out over budget, shedding packet", LogFields().stream(m_publisherHandler->getStreamId())
+                .with(std::string(QosSettings::className(qosClass)) + " subscribers=" +
+                      std::to_string(subscribers.handlers.size())));
+    return true;
 }
 
-bool StreamSession::startPublishing() {
+void StreamSession::recordHopLatency(const MessageControl &control,
+                                     std::chrono::steady_clock::time_point receivedAt) {
+    auto now = std::chrono::steady_clock::now();
+    if (control.sourceTime > 0 && control.receiveTime >= control.sourceTime) {
+        m_ingestLatency.record(control.receiveTime - control.sourceTime);
+    }
+    m_forwardLatency.record(std::chrono::duration_cast<std::chrono::microseconds>(now - receivedAt).count());
+
+    if (m_lastLatencyReport == std::chrono::steady_clock::time_point()) {
+        m_lastLatencyReport = now;
+    }
+    if (now - m_lastLatencyReport < LATENCY_REPORT_INTERVAL) {
+        return;
+    }
+
+    m_ingestLatencyMicros.store(m_ingestLatency.getAverage(), std::memory_order_relaxed);
+    m_forwardLatencyMicros.store(m_forwardLatency.getAverage(), std::memory_order_relaxed);
+    LOG_INFO("Hop latency", LogFields().stream(m_publisherHandler->getStreamId()).with(
+                 "ingest_avg_us=" + std::to_string(m_ingestLatency.getAverage()) +
+                 " ingest_max_us=" + std::to_string(m_ingestLatency.getMax()) +
+                 " forward_avg_us=" + std::to_string(m_forwardLatency.getAverage()) +
+                 " forward_max_us=" + std::to_string(m_forwardLatency.getMax())));
+    m_ingestLatency.reset();
+    m_forwardLatency.reset();
+    m_lastLatencyReport = now;
+}
+
+bool StreamSession::startPublishing(const CpuSet &preferredCpus) {
     if (m_running.exchange(true)) {
-        std::cerr << "Already publishing stream " << m_publisherHandler->getStreamId() << std::endl;
+        LOG_WARNING("Already publishing stream", LogFields().stream(m_publisherHandler->getStreamId()));
         return false;
     }
 
-    m_publisherThread = std::make_unique<std::thread>(&StreamSession::publisherThread, this);
+    if (m_context.placement) {
+        m_placementSlot = m_context.placement->acquireSessionSlot(preferredCpus);
+    }
+    m_startedAt = std::chrono::steady_clock::now();
+    if (m_context.threads) {
+        m_publisherJob = m_context.threads->run([this] { publisherThread(); });
+    } else {
+        m_publisherThread = std::make_unique<std::thread>(&StreamSession::publisherThread, this);
+    }
     return true;
 }
 
@@ -115,9 +620,73 @@ void StreamSession::notifyDisconnect() const {
     }
 }
 
+void StreamSession::recordFirstSends(const SubscriberSnapshot *subscribers,
+                                     const std::vector<std::shared_ptr<PacedSubscriber> > &pacedSubscribers,
+                                     const std::vector<std::shared_ptr<StreamHandler> > &failed) {
+    auto now = std::chrono::steady_clock::now();
+    std::vector<JoiningSubscriber> joined; {
+        std::lock_guard<std::mutex> lock(m_subscribersMutex);
+        // Subscribers attached after this packet's snapshot was taken wait for the next one
+        for (auto it = m_joining.begin(); it != m_joining.end();) {
+            const auto &handler = it->handler;
+            bool sent = (subscribers && std::find(subscribers->all.begin(), subscribers->all.end(), handler) !=
+                         subscribers->all.end()) ||
+                        std::any_of(pacedSubscribers.begin(), pacedSubscribers.end(),
+                                    [&handler](const std::shared_ptr<PacedSubscriber> &paced) {
+                                        return paced->getHandler() == handler;
+                                    });
+            if (!sent) {
+                ++it;
+                continue;
+            }
+            if (std::find(failed.begin(), failed.end(), handler) == failed.end()) {
+                joined.push_back(*it);
+            }
+            it = m_joining.erase(it);
+        }
+        m_hasJoining.store(!m_joining.empty(), std::memory_order_relaxed);
+    }
+    for (const auto &subscriber: joined) {
+        m_context.startup->record(ConnectionRole::Subscriber, StartupStage::FirstData,
+                                  std::chrono::duration_cast<std::chrono::microseconds>(
+                                      now - subscriber.attachedAt).count());
+        m_context.startup->record(ConnectionRole::Subscriber, StartupStage::Total,
+                                  std::chrono::duration_cast<std::chrono::microseconds>(
+                                      now - subscriber.handler->getAcceptedAt()).count());
+    }
+}
+
+void StreamSession::forgetJoiningLocked(const std::shared_ptr<StreamHandler> &subscriber) {
+    if (m_joining.empty()) {
+        return;
+    }
+    m_joining.erase(std::remove_if(m_joining.begin(), m_joining.end(), [&subscriber](const JoiningSubscriber &joining) {
+        return joining.handler == subscriber;
+    }), m_joining.end());
+    m_hasJoining.store(!m_joining.empty(), std::memory_order_relaxed);
+}
+
 void StreamSession::publisherThread() {
     m_publisherThreadId = std::this_thread::get_id();
-    std::vector<char> buffer(BUFFER_SIZE);
+    const bool recordStartup = m_context.startup &&
+                               m_publisherHandler->getAcceptedAt() != std::chrono::steady_clock::time_point();
+    if (recordStartup) {
+        m_context.startup->record(ConnectionRole::Publisher, StartupStage::ThreadStart,
+                                  StartupLatency::microsSince(m_startedAt));
+    }
+    auto runningAt = std::chrono::steady_clock::now();
+    bool awaitingFirstPacket = recordStartup;
+
+    // Pin before allocating so the receive buffer is first-touched on the session's NUMA node
+    if (m_context.placement && m_placementSlot >= 0) {
+        m_context.placement->pinToSessionSlot(m_placementSlot);
+    }
+    const int bufferSize = m_context.bufferSize;
+    std::vector<char> buffer(bufferSize); {
+        std::lock_guard<std::mutex> lock(m_usageMutex);
+        m_publisherClock = ThreadCpuClock::forCurrentThread();
+        m_publisherCpuStart = m_publisherClock.cpuMicros();
+    }
 
     while (m_running.load(std::memory_order_relaxed)) {
         // Check if we're disconnecting before any socket operations
@@ -126,58 +695,162 @@ void StreamSession::publisherThread() {
         }
 
         int bytesReceived = 0;
+        MessageControl control;
         try {
-            bytesReceived = m_publisherHandler->receive(buffer.data(), BUFFER_SIZE);
+            bytesReceived = m_publisherHandler->receive(buffer.data(), bufferSize, control);
             if (bytesReceived == STREAM_ERROR) {
                 if (!m_running.load(std::memory_order_acquire)) {
                     break;
                 }
-                std::cerr << "Failed to receive data from publisher: " << m_publisherHandler->getLastErrorMessage() <<
-                        std::endl;
+                LOG_ERROR("Failed to receive data from publisher", LogFields()
+                          .stream(m_publisherHandler->getStreamId())
+                          .from(m_publisherHandler->getPeerAddress())
+                          .error(m_publisherHandler->getLastErrorCode())
+                          .with(m_publisherHandler->getLastErrorMessage()));
 
                 notifyDisconnect();
                 break;
             }
         } catch (const std::exception &e) {
-            std::cerr << "Failed to receive Data: " << e.what() << std::endl;
+            LOG_ERROR("Failed to receive data", LogFields().stream(m_publisherHandler->getStreamId()).with(e.what()));
             notifyDisconnect();
             break;
         }
 
-        // Make a copy of subscribers to avoid a long lock
-        std::vector<std::shared_ptr<StreamHandler> > currentSubscribers; {
+        auto receivedAt = std::chrono::steady_clock::now();
+        if (awaitingFirstPacket) {
+            awaitingFirstPacket = false;
+            m_context.startup->record(ConnectionRole::Publisher, StartupStage::FirstData,
+                                      std::chrono::duration_cast<std::chrono::microseconds>(
+                                          receivedAt - runningAt).count());
+            m_context.startup->record(ConnectionRole::Publisher, StartupStage::Total,
+                                      std::chrono::duration_cast<std::chrono::microseconds>(
+                                          receivedAt - m_publisherHandler->getAcceptedAt()).count());
+        }
+        bool inputRateUpdated = m_inputRate.addBytes(bytesReceived, receivedAt);
+        if (m_context.placement) {
+            m_context.placement->recordWork(bytesReceived);
+        }
+
+        // Take the current snapshot of subscribers to avoid a long lock
+        std::shared_ptr<const SubscriberSnapshot> currentSubscribers; {
             std::lock_guard<std::mutex> lock(m_subscribersMutex);
-            currentSubscribers = m_subscribers;
+            currentSubscribers = m_subscribersSnapshot;
+        }
+        const auto &currentPacedSubscribers = currentSubscribers->paced;
+
+        // Local outputs are plain memory copies, serve them before any network send
+        if (!currentSubscribers->outputs.empty()) {
+            writeToOutputs(currentSubscribers->outputs, buffer.data(), bytesReceived, control);
+        }
+
+        bool overloaded = m_overloaded.load(std::memory_order_relaxed);
+        if (!overloaded) {
+            m_starvedSince = std::chrono::steady_clock::time_point();
+        }
+        const size_t bestEffort = static_cast<size_t>(QosClass::BestEffort);
+
+        // Paced subscribers are sent to by the shared pacer, only queue the packet here
+        bool pacedShed = false;
+        if (!currentPacedSubscribers.empty()) {
+            if (inputRateUpdated) {
+                for (const auto &pacedSubscriber: currentPacedSubscribers) {
+                    updatePacingRate(pacedSubscriber);
+                }
+            }
+            pacedShed = sendToPacedSubscribers(currentPacedSubscribers, buffer.data(), bytesReceived, control,
+                                               overloaded);
         }
 
         // If no subscribers, continue receiving (but not sending)
-        if (currentSubscribers.empty()) {
+        if (currentSubscribers->all.empty()) {
+            if (pacedShed) {
+                m_shedPackets[bestEffort].fetch_add(1, std::memory_order_relaxed);
+                std::vector<std::shared_ptr<StreamHandler> > none;
+                dropStarvedSubscribers(*currentSubscribers, currentPacedSubscribers, receivedAt, none);
+            }
+            recordHopLatency(control, receivedAt);
+            if (m_hasJoining.load(std::memory_order_relaxed)) {
+                recordFirstSends(currentSubscribers.get(), currentPacedSubscribers, {});
+            }
             continue;
         }
 
+        // Higher classes are served first; a class whose budget the packet has outlived is skipped for it
         std::vector<std::shared_ptr<StreamHandler> > failedSubscribers;
-        for (const auto &subscriber: currentSubscribers) {
-            if (m_isDisconnecting.load(std::memory_order_acquire)) {
-                break;
+        const FanoutSettings &fanout = currentSubscribers->fanout;
+        bool sharded = currentSubscribers->all.size() > fanout.shardThreshold;
+        // Reloaded worker settings replace the pool between packets
+        if (sharded && (!m_fanoutWorkers || !m_fanoutWorkers->hasSettings(fanout))) {
+            auto fanoutWorkers = std::make_shared<FanoutWorkers>(
+                m_publisherHandler->getStreamId(), fanout, m_context.placement, m_placementSlot);
+            std::lock_guard<std::mutex> lock(m_usageMutex);
+            m_fanoutWorkers.swap(fanoutWorkers);
+        }
+        bool bestEffortShed = false;
+        for (size_t i = 0; i < QOS_CLASS_COUNT; ++i) {
+            const auto &group = currentSubscribers->classes[i];
+            const auto &filteredGroups = currentSubscribers->filtered[i];
+            if (group.handlers.empty() && filteredGroups.empty()) {
+                continue;
             }
-            int bytesSent = subscriber->send(buffer.data(), bytesReceived);
-            if (bytesSent == STREAM_ERROR) {
-                std::cerr << "Failed to send data to subscriber: " << subscriber->getLastErrorMessage() <<
-                        std::endl;
-                failedSubscribers.push_back(subscriber);
+            // Filtered subscribers keep their class, a shed packet never reaches their repacketizers
+            auto qosClass = static_cast<QosClass>(i);
+            if (shouldShed(qosClass, currentSubscribers->qos, group, receivedAt)) {
+                bestEffortShed = bestEffortShed || (overloaded && qosClass == QosClass::BestEffort);
+                continue;
+            }
+            if (!group.handlers.empty()) {
+                if (sharded) {
+                    // Large audience, split the sends across the session's fan-out workers
+                    m_fanoutWorkers->send(group, buffer.data(), bytesReceived, control, m_isDisconnecting,
+                                          failedSubscribers);
+                } else {
+                    sendToSubscribers(group, buffer.data(), bytesReceived, control, failedSubscribers);
+                }
             }
+            for (const auto &filtered: filteredGroups) {
+                sendToFilteredSubscribers(filtered, buffer.data(), bytesReceived, control, receivedAt,
+                                          failedSubscribers);
+            }
+        }
+        // Paced previews count once per packet, like a shed class
+        if (pacedShed && !bestEffortShed) {
+            m_shedPackets[bestEffort].fetch_add(1, std::memory_order_relaxed);
+        }
+        if (pacedShed || bestEffortShed) {
+            dropStarvedSubscribers(*currentSubscribers, currentPacedSubscribers, receivedAt, failedSubscribers);
+        }
+        if (currentSubscribers->filteredGroupCount > 0 || !m_repacketizers.empty()) {
+            updateRepacketizers(*currentSubscribers);
+        }
+
+        recordHopLatency(control, receivedAt);
+        if (m_hasJoining.load(std::memory_order_relaxed)) {
+            recordFirstSends(currentSubscribers.get(), currentPacedSubscribers, failedSubscribers);
         }
 
-        // Remove failed subscribers
+        // Remove failed subscribers, closing them off the publisher thread
         if (!failedSubscribers.empty()) {
-            std::lock_guard<std::mutex> lock(m_subscribersMutex);
-            for (const auto &failedSubscriber: failedSubscribers) {
-                failedSubscriber->disconnect();
-                m_subscribers.erase(
-                    std::remove(m_subscribers.begin(), m_subscribers.end(), failedSubscriber),
-                    m_subscribers.end()
-                );
+            // Only the ones still listed are ours to close, a kick or removal since the snapshot closed the rest
+            std::vector<std::shared_ptr<StreamHandler> > removed; {
+                std::lock_guard<std::mutex> lock(m_subscribersMutex);
+                for (const auto &failedSubscriber: failedSubscribers) {
+                    auto it = std::find(m_subscribers.begin(), m_subscribers.end(), failedSubscriber);
+                    if (it != m_subscribers.end()) {
+                        m_subscribers.erase(it);
+                        removed.push_back(failedSubscriber);
+                    }
+                }
+                if (!removed.empty()) {
+                    publishSubscribersSnapshot();
+                }
             }
+            m_context.closer->submit(std::move(removed));
         }
     }
+
+    // A pooled thread runs on after the session, its later CPU time isn't ours
+    std::lock_guard<std::mutex> lock(m_usageMutex);
+    m_publisherClock = ThreadCpuClock();
 }
@@ -20,19 +20,78 @@
 #ifndef STREAMSESSION_H
 #define STREAMSESSION_H
 
+#include <array>
 #include <mutex>
 #include <thread>
+#include <unordered_map>
 #include <vector>
 
+#include "AdminSnapshot.h"
+#include "CpuPlacement.h"
+#include "FanoutWorkers.h"
+#include "QosPolicy.h"
+#include "ResourceBudget.h"
+#include "StartupLatency.h"
+#include "SubscriberPacer.h"
+#include "utils/BitrateMeter.h"
+#include "utils/ConnectionCloser.h"
+#include "utils/SRTHandler.h"
+#include "utils/LatencyStats.h"
+#include "utils/PidFilter.h"
 #include "utils/StreamEvents.h"
 #include "utils/StreamHandler.h"
+#include "utils/StreamOutput.h"
+#include "utils/TimerWheel.h"
+#include "utils/WarmThreadPool.h"
 
+// Subscribers of one QoS class sharing one PID filter, sent the same repacked payloads
+struct FilteredSubscriberGroup {
+    PidFilter filter;
+    // Class name and filter key, names the group's repacketizer
+    std::string key;
+    SubscriberClassGroup subscribers;
+};
+
+// Immutable view of the subscribers for the publisher thread, grouped by QoS class.
+// Carries the session's tuning too, so a reload reaches the publisher thread with the next packet.
+struct SubscriberSnapshot {
+    std::vector<std::shared_ptr<StreamHandler> > all;
+    // Indexed by QosClass, fan-out walks them in order
+    std::array<SubscriberClassGroup, QOS_CLASS_COUNT> classes;
+    // Subscribers that asked for a subset of PIDs, by QosClass too; each is served after its class
+    std::array<std::vector<FilteredSubscriberGroup>, QOS_CLASS_COUNT> filtered;
+    size_t filteredGroupCount = 0;
+    // Queued to by the publisher thread and sent by the shared pacer
+    std::vector<std::shared_ptr<PacedSubscriber> > paced;
+    // Written before any subscriber is sent to
+    std::vector<std::shared_ptr<StreamOutput> > outputs;
+    FanoutSettings fanout;
+    QosSettings qos;
+};
+
+// Services and settings shared by the sessions of one StreamManager
+struct SessionContext {
+    std::shared_ptr<SubscriberPacer> pacer;
+    std::shared_ptr<CpuPlacement> placement;
+    std::shared_ptr<TimerWheel> timers;
+    // Closes subscribers in parallel when the session ends; a private one is created if not shared
+    std::shared_ptr<ConnectionCloser> closer;
+    FanoutSettings fanout;
+    QosSettings qos;
+    // Receive buffer for publisher messages, SRT's live mode payload size by default
+    int bufferSize = 1456;
+    // Time to first packet of accepted publishers and subscribers, not recorded if null
+    std::shared_ptr<StartupLatency> startup;
+    // Publisher loops run on parked threads if set, instead of a thread created per session
+    std::shared_ptr<WarmThreadPool> threads;
+};
 
 class StreamSession {
 public:
     explicit StreamSession(
         std::shared_ptr<StreamHandler> streamHandler,
-        std::weak_ptr<StreamEventListener> eventListener
+        std::weak_ptr<StreamEventListener> eventListener,
+        SessionContext context = SessionContext()
     );
 
     ~StreamSession();
@@ -44,12 +103,50 @@ public:
     // Getters
     std::shared_ptr<StreamHandler> getStreamHandler() const { return m_publisherHandler; }
 
+    int64_t getInputBytesPerSecond() const { return m_inputRate.bytesPerSecond(); }
+
+    // Average time from the publisher's source time to arrival at the server, last report window
+    int64_t getIngestLatencyMicros() const { return m_ingestLatencyMicros.load(std::memory_order_relaxed); }
+
+    // Average time packets spent in the server before fan-out completed, last report window
+    int64_t getForwardLatencyMicros() const { return m_forwardLatencyMicros.load(std::memory_order_relaxed); }
+
+    // Packets a class was skipped for because they were already over its send budget
+    uint64_t getShedPackets(QosClass qosClass) const {
+        return m_shedPackets[static_cast<size_t>(qosClass)].load(std::memory_order_relaxed);
+    }
+
+    // CPU time of the session's threads plus what it holds in queues, safe to call from any thread
+    SessionUsage getUsage() const;
+
+    // An overloaded session sheds every packet for its best effort subscribers, and disconnects the ones
+    // it has starved for qos.overload_disconnect_ms so they can go elsewhere
+    void setOverloaded(bool overloaded) { m_overloaded.store(overloaded, std::memory_order_relaxed); }
+
+    bool isOverloaded() const { return m_overloaded.load(std::memory_order_relaxed); }
+
+    // Publisher and subscribers as seen now, for the admin snapshot
+    StreamStatus getStatus() const;
+
+    // Disconnects every subscriber connected from peerAddress ("ip:port"), returns how many
+    size_t kickSubscriber(const std::string &peerAddress);
+
+    // Live reload: regroups the subscribers by the new classes and resizes fan-out at the next packet
+    void applyTuning(const FanoutSettings &fanout, const QosSettings &qos);
+
     // Add/remove subscribers
     void addSubscriber(std::shared_ptr<StreamHandler> subscriber);
 
+    // Attach a group at once, publishing a single new subscriber snapshot
+    void addSubscribers(const std::vector<std::shared_ptr<StreamHandler> > &subscribers);
+
     void removeSubscriber(std::shared_ptr<StreamHandler> subscriber);
 
-    bool startPublishing();
+    // Outputs get every packet before the subscribers and are closed with the session
+    void addOutput(std::shared_ptr<StreamOutput> output);
+
+    // preferredCpus steers the session towards core sets near the publisher's NIC
+    bool startPublishing(const CpuSet &preferredCpus = CpuSet());
 
 protected:
     std::atomic<bool> &getRunning() { return m_running; }
@@ -60,16 +157,74 @@ protected:
 
     std::lock_guard<std::mutex> getSubscribersMutex() { return std::lock_guard<std::mutex>(m_subscribersMutex); }
     const std::vector<std::shared_ptr<StreamHandler> > &getSubscribers() const { return m_subscribers; }
+    const std::vector<std::shared_ptr<PacedSubscriber> > &getPacedSubscribers() const { return m_pacedSubscribers; }
+    const std::vector<std::shared_ptr<StreamOutput> > &getOutputs() const { return m_outputs; }
 
     std::atomic<bool> &getCleanupDone() { return m_cleanupDone; }
 
-    void removeAllSubscribers();
+    // Detaches every subscriber and output under the lock and hands the connections to the closer
+    std::shared_ptr<CloseGroup> removeAllSubscribers();
 
 private:
     void publisherThread();
 
     void notifyDisconnect() const;
 
+    // Records the first send to joining subscribers the packet was sent or queued to
+    void recordFirstSends(const SubscriberSnapshot *subscribers,
+                          const std::vector<std::shared_ptr<PacedSubscriber> > &pacedSubscribers,
+                          const std::vector<std::shared_ptr<StreamHandler> > &failed);
+
+    // Must be called with m_subscribersMutex held
+    void forgetJoiningLocked(const std::shared_ptr<StreamHandler> &subscriber);
+
+    // Must be called with m_subscribersMutex held, returns true if the snapshot needs publishing
+    bool addSubscriberLocked(const std::shared_ptr<StreamHandler> &subscriber);
+
+    // Returns true if best effort subscribers were skipped because the session is overloaded
+    bool sendToPacedSubscribers(const std::vector<std::shared_ptr<PacedSubscriber> > &pacedSubscribers,
+                                const char *data, int len, const MessageControl &control, bool overloaded);
+
+    void writeToOutputs(const std::vector<std::shared_ptr<StreamOutput> > &outputs,
+                        const char *data, int len, const MessageControl &control);
+
+    void sendToSubscribers(const SubscriberClassGroup &subscribers, const char *data, int len,
+                           const MessageControl &control, std::vector<std::shared_ptr<StreamHandler> > &failed);
+
+    // Filters the message once per group and sends the repacked payloads to it
+    void sendToFilteredSubscribers(const FilteredSubscriberGroup &group, const char *data, int len,
+                                   const MessageControl &control, std::chrono::steady_clock::time_point receivedAt,
+                                   std::vector<std::shared_ptr<StreamHandler> > &failed);
+
+    // Drops the repacketizers of groups that left and publishes what the rest hold
+    void updateRepacketizers(const SubscriberSnapshot &subscribers);
+
+    // Called for every packet an overload sheds for best effort, fails its subscribers once the
+    // overload has lasted qos.overloadDisconnect. Paced ones are removed here, the rest added to failed.
+    void dropStarvedSubscribers(const SubscriberSnapshot &subscribers,
+                                const std::vector<std::shared_ptr<PacedSubscriber> > &pacedSubscribers,
+                                std::chrono::steady_clock::time_point now,
+                                std::vector<std::shared_ptr<StreamHandler> > &failed);
+
+    // True if the packet is already past the class's send budget or best effort is shed for overload;
+    // counts the shed packet
+    bool shouldShed(QosClass qosClass, const QosSettings &qos, const SubscriberClassGroup &subscribers,
+                    std::chrono::steady_clock::time_point receivedAt);
+
+    void recordHopLatency(const MessageControl &control, std::chrono::steady_clock::time_point receivedAt);
+
+    void updatePacingRate(const std::shared_ptr<PacedSubscriber> &pacedSubscriber) const;
+
+    // Pacing queue limit scaled by the subscriber's QoS class, and whether an overload skips it;
+    // needs m_subscribersMutex held
+    void applyQosLocked(PacedSubscriber &pacedSubscriber, const PacingSettings &pacing) const;
+
+    void removePacedSubscriber(const std::shared_ptr<PacedSubscriber> &pacedSubscriber);
+
+    // Must be called with m_subscribersMutex held after every change to m_subscribers, m_pacedSubscribers
+    // or m_outputs
+    void publishSubscribersSnapshot();
+
     std::shared_ptr<StreamHandler> m_publisherHandler;
 
     std::weak_ptr<StreamEventListener> m_eventListener;
@@ -78,16 +233,58 @@ private:
     std::atomic<bool> m_isDisconnecting{false};
 
     std::unique_ptr<std::thread> m_publisherThread;
+    // Instead of m_publisherThread when the context has a thread pool
+    std::shared_ptr<PooledJob> m_publisherJob;
     std::thread::id m_publisherThreadId;
 
-    std::mutex m_subscribersMutex;
+    mutable std::mutex m_subscribersMutex;
     std::vector<std::shared_ptr<StreamHandler> > m_subscribers;
+    // Rebuilt on every change of m_subscribers, so the publisher thread doesn't copy the list per packet
+    std::shared_ptr<const SubscriberSnapshot> m_subscribersSnapshot;
+    std::vector<std::shared_ptr<PacedSubscriber> > m_pacedSubscribers;
+    std::vector<std::shared_ptr<StreamOutput> > m_outputs;
+    // Per filtered group key, owned by the publisher thread
+    std::unordered_map<std::string, TsRepacketizer> m_repacketizers;
+    std::atomic<size_t> m_repacketizerBytes{0};
+
+    struct JoiningSubscriber {
+        std::shared_ptr<StreamHandler> handler;
+        std::chrono::steady_clock::time_point attachedAt;
+    };
+    // Accepted subscribers nothing was sent to yet, guarded by m_subscribersMutex
+    std::vector<JoiningSubscriber> m_joining;
+    std::atomic<bool> m_hasJoining{false};
+
+    // Guards the clocks and worker pointer read by getUsage(); only the publisher thread writes them
+    mutable std::mutex m_usageMutex;
+    ThreadCpuClock m_publisherClock;
+    // CPU time a pooled thread had used before this session's loop started on it
+    int64_t m_publisherCpuStart = 0;
+    // Created the first time the audience crosses the shard threshold
+    std::shared_ptr<FanoutWorkers> m_fanoutWorkers;
+    std::atomic<uint64_t> m_allocations{0};
+    std::atomic<bool> m_overloaded{false};
+    // First packet the current overload shed for best effort, owned by the publisher thread
+    std::chrono::steady_clock::time_point m_starvedSince{};
+
+    SessionContext m_context;
+    int m_placementSlot = -1;
+    BitrateMeter m_inputRate;
+    std::chrono::steady_clock::time_point m_startedAt{};
+
+    // Owned by the publisher thread, the averages are published for readers at each report
+    LatencyStats m_ingestLatency;
+    LatencyStats m_forwardLatency;
+    std::chrono::steady_clock::time_point m_lastLatencyReport{};
+    std::atomic<int64_t> m_ingestLatencyMicros{0};
+    std::atomic<int64_t> m_forwardLatencyMicros{0};
+
+    std::array<std::atomic<uint64_t>, QOS_CLASS_COUNT> m_shedPackets{};
 
     std::mutex m_cleanupMutex;
     std::condition_variable m_cleanupCV;
     std::atomic<bool> m_cleanupDone{false};
 
-    // TODO: Move to configuration file
-    static constexpr int BUFFER_SIZE = 1456;
+    static constexpr std::chrono::seconds LATENCY_REPORT_INTERVAL{10};
 };
 #endif //STREAMSESSION_H
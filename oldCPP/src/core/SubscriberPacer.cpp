@@ -0,0 +1,208 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "SubscriberPacer.h"
+
+#include <algorithm>
+
+#include "utils/Logger.h"
+
+namespace {
+    // Always allow at least a couple of full-size packets per burst
+    constexpr double MIN_BURST_BYTES = 2 * 1456;
+}
+
+PacedSubscriber::PacedSubscriber(std::shared_ptr<StreamHandler> handler)
+    : m_handler(std::move(handler)) {
+    // One pacer thread drains every paced subscriber, a stalled viewer must not hold up the others
+    m_handler->setNonBlockingSend();
+}
+
+bool PacedSubscriber::enqueue(std::shared_ptr<const StreamPacket> packet, size_t maxQueuedPackets) {
+    if (hasFailed()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(m_queueMutex);
+    if (m_queue.size() >= maxQueuedPackets) {
+        return false;
+    }
+    m_queuedBytes += packet->size();
+    m_queue.push_back(std::move(packet));
+    return true;
+}
+
+size_t PacedSubscriber::getQueuedPackets() {
+    std::lock_guard<std::mutex> lock(m_queueMutex);
+    return m_queue.size();
+}
+
+size_t PacedSubscriber::getQueuedBytes() {
+    std::lock_guard<std::mutex> lock(m_queueMutex);
+    return m_queuedBytes;
+}
+
+int64_t PacedSubscriber::getQueueDelayMicros() {
+    std::lock_guard<std::mutex> lock(m_queueMutex);
+    if (m_queue.empty()) {
+        return 0;
+    }
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - m_queue.front()->receivedAt).count();
+}
+
+void PacedSubscriber::drain(std::chrono::steady_clock::time_point now, const PacingSettings &settings) {
+    const int64_t rate = getRate();
+    if (rate > 0) {
+        if (m_lastRefill == std::chrono::steady_clock::time_point()) {
+            m_lastRefill = now;
+        }
+        double elapsed = std::chrono::duration<double>(now - m_lastRefill).count();
+        double burst = std::max(static_cast<double>(rate) * std::chrono::duration<double>(settings.maxBurst).count(),
+                                MIN_BURST_BYTES);
+        m_tokens = std::min(m_tokens + static_cast<double>(rate) * elapsed, burst);
+    } else {
+        m_tokens = 0.0;
+    }
+    m_lastRefill = now;
+
+    while (!hasFailed()) {
+        std::shared_ptr<const StreamPacket> packet; {
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            if (m_queue.empty()) {
+                break;
+            }
+            if (rate > 0 && m_queue.front()->size() > m_tokens) {
+                break;
+            }
+            packet = std::move(m_queue.front());
+            m_queue.pop_front();
+            m_queuedBytes -= packet->size();
+        }
+
+        int result = m_handler->send(packet->data.data(), packet->size(), packet->control);
+        if (result == STREAM_WOULD_BLOCK) {
+            // Send buffer full, as if out of tokens: the packet is retried next tick
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            m_queuedBytes += packet->size();
+            m_queue.push_front(std::move(packet));
+            break;
+        }
+        if (result == STREAM_ERROR) {
+            LOG_WARNING("Failed to send paced data to subscriber", LogFields()
+                        .stream(m_handler->getStreamId())
+                        .from(m_handler->getPeerAddress())
+                        .error(m_handler->getLastErrorCode())
+                        .with(m_handler->getLastErrorMessage()));
+            m_failed.store(true, std::memory_order_release);
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            m_queue.clear();
+            m_queuedBytes = 0;
+            break;
+        }
+        if (rate > 0) {
+            m_tokens -= packet->size();
+        }
+    }
+}
+
+SubscriberPacer::SubscriberPacer(PacingSettings settings, std::shared_ptr<CpuPlacement> placement)
+    : m_placement(std::move(placement)),
+      m_settings(settings) {
+}
+
+PacingSettings SubscriberPacer::getSettings() const {
+    std::lock_guard<std::mutex> lock(m_subscribersMutex);
+    return m_settings;
+}
+
+void SubscriberPacer::setSettings(PacingSettings settings) {
+    std::lock_guard<std::mutex> lock(m_subscribersMutex);
+    m_settings = settings;
+}
+
+SubscriberPacer::~SubscriberPacer() {
+    stop();
+}
+
+void SubscriberPacer::registerSubscriber(std::shared_ptr<PacedSubscriber> subscriber) {
+    std::lock_guard<std::mutex> lock(m_subscribersMutex);
+    m_subscribers.push_back(std::move(subscriber));
+
+    // The timer thread is only started once something needs pacing
+    if (!m_running.exchange(true)) {
+        m_pacerThread = std::make_unique<std::thread>(&SubscriberPacer::pacerThread, this);
+    }
+    m_subscribersCV.notify_one();
+}
+
+void SubscriberPacer::unregisterSubscriber(const std::shared_ptr<PacedSubscriber> &subscriber) {
+    std::lock_guard<std::mutex> lock(m_subscribersMutex);
+    m_subscribers.erase(
+        std::remove(m_subscribers.begin(), m_subscribers.end(), subscriber),
+        m_subscribers.end()
+    );
+}
+
+void SubscriberPacer::stop() {
+    std::unique_ptr<std::thread> pacerThread; {
+        std::lock_guard<std::mutex> lock(m_subscribersMutex);
+        if (!m_running.exchange(false)) {
+            return;
+        }
+        pacerThread = std::move(m_pacerThread);
+        m_subscribersCV.notify_all();
+    }
+
+    if (pacerThread && pacerThread->joinable()) {
+        pacerThread->join();
+    }
+}
+
+void SubscriberPacer::pacerThread() {
+    if (m_placement) {
+        m_placement->pinPacerThread();
+    }
+    auto nextTick = std::chrono::steady_clock::now();
+    std::vector<std::shared_ptr<PacedSubscriber> > currentSubscribers;
+    PacingSettings settings;
+
+    while (m_running.load(std::memory_order_acquire)) {
+        {
+            std::unique_lock<std::mutex> lock(m_subscribersMutex);
+            m_subscribersCV.wait(lock, [this] {
+                return !m_subscribers.empty() || !m_running.load(std::memory_order_acquire);
+            });
+            currentSubscribers = m_subscribers;
+            settings = m_settings;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        for (const auto &subscriber: currentSubscribers) {
+            subscriber->drain(now, settings);
+        }
+        currentSubscribers.clear();
+
+        // Fixed-rate ticks, skip ahead instead of bursting when we fall behind
+        nextTick += settings.tickInterval;
+        if (nextTick < now) {
+            nextTick = now + settings.tickInterval;
+        }
+        std::this_thread::sleep_until(nextTick);
+    }
+}
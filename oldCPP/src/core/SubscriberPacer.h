@@ -0,0 +1,143 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SUBSCRIBERPACER_H
+#define SUBSCRIBERPACER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "CpuPlacement.h"
+#include "utils/StreamHandler.h"
+#include "utils/StreamPacket.h"
+
+struct PacingSettings {
+    // Pace subscribers that don't ask for it explicitly with the "pace" stream ID parameter
+    bool enabledByDefault = false;
+    // Output rate above the measured input rate, also passed to SRT as SRTO_OHEADBW
+    int headroomPercent = 25;
+    // Interval of the shared pacing timer
+    std::chrono::milliseconds tickInterval{2};
+    // Largest burst a subscriber may send at once, expressed as time at the paced rate
+    std::chrono::milliseconds maxBurst{10};
+    // Subscribers that fall this far behind are dropped
+    size_t maxQueuedPackets = 4096;
+};
+
+// Per-subscriber send queue drained by the SubscriberPacer at a token-bucket rate
+class PacedSubscriber {
+public:
+    explicit PacedSubscriber(std::shared_ptr<StreamHandler> handler);
+
+    const std::shared_ptr<StreamHandler> &getHandler() const { return m_handler; }
+
+    // Queue a packet for paced sending, returns false if the subscriber has failed or overflowed
+    bool enqueue(std::shared_ptr<const StreamPacket> packet, size_t maxQueuedPackets);
+
+    // Paced output rate in bytes per second, 0 sends as fast as packets arrive
+    void setRate(int64_t bytesPerSecond) { m_rateBytesPerSecond.store(bytesPerSecond, std::memory_order_relaxed); }
+
+    int64_t getRate() const { return m_rateBytesPerSecond.load(std::memory_order_relaxed); }
+
+    // Queue limit the session enqueues with, scaled by the subscriber's QoS class
+    void setMaxQueuedPackets(size_t maxQueuedPackets) {
+        m_maxQueuedPackets.store(maxQueuedPackets, std::memory_order_relaxed);
+    }
+
+    size_t getMaxQueuedPackets() const { return m_maxQueuedPackets.load(std::memory_order_relaxed); }
+
+    // Best effort subscribers get nothing queued while their session is overloaded
+    void setBestEffort(bool bestEffort) { m_bestEffort.store(bestEffort, std::memory_order_relaxed); }
+
+    bool isBestEffort() const { return m_bestEffort.load(std::memory_order_relaxed); }
+
+    bool hasFailed() const { return m_failed.load(std::memory_order_acquire); }
+
+    size_t getQueuedPackets();
+
+    // Payload bytes waiting in the queue; the packets are shared with the other paced subscribers
+    size_t getQueuedBytes();
+
+    // Age of the oldest queued packet, 0 when the queue is empty
+    int64_t getQueueDelayMicros();
+
+private:
+    friend class SubscriberPacer;
+
+    // Send whatever the token bucket allows, called from the pacer thread only
+    void drain(std::chrono::steady_clock::time_point now, const PacingSettings &settings);
+
+    std::shared_ptr<StreamHandler> m_handler;
+
+    std::mutex m_queueMutex;
+    std::deque<std::shared_ptr<const StreamPacket> > m_queue;
+    size_t m_queuedBytes = 0;
+
+    std::atomic<int64_t> m_rateBytesPerSecond{0};
+    std::atomic<bool> m_failed{false};
+    std::atomic<size_t> m_maxQueuedPackets{0};
+    std::atomic<bool> m_bestEffort{false};
+
+    // Token bucket state, owned by the pacer thread
+    double m_tokens = 0.0;
+    std::chrono::steady_clock::time_point m_lastRefill{};
+};
+
+// Drives every paced subscriber from a single shared timer thread
+class SubscriberPacer {
+public:
+    explicit SubscriberPacer(PacingSettings settings = PacingSettings(),
+                             std::shared_ptr<CpuPlacement> placement = nullptr);
+
+    ~SubscriberPacer();
+
+    PacingSettings getSettings() const;
+
+    // Taken up by the pacer thread at its next tick
+    void setSettings(PacingSettings settings);
+
+    void registerSubscriber(std::shared_ptr<PacedSubscriber> subscriber);
+
+    void unregisterSubscriber(const std::shared_ptr<PacedSubscriber> &subscriber);
+
+    void stop();
+
+private:
+    void pacerThread();
+
+    std::shared_ptr<CpuPlacement> m_placement;
+
+    // Guards the settings as well as the subscriber list
+    mutable std::mutex m_subscribersMutex;
+    PacingSettings m_settings;
+    std::condition_variable m_subscribersCV;
+    std::vector<std::shared_ptr<PacedSubscriber> > m_subscribers;
+
+    std::atomic<bool> m_running{false};
+    std::unique_ptr<std::thread> m_pacerThread;
+};
+
+
+#endif //SUBSCRIBERPACER_H
@@ -18,41 +18,81 @@
  */
 
 #include "core/SRTServer.h"
-#include <iostream>
+#include "utils/Logger.h"
+#include <atomic>
 #include <csignal>
 
 std::unique_ptr<SRTServer> srtServer;
 
-void signalHandler(int) {
-    if (srtServer) {
-        std::cout << "Stopping server" << std::endl;
-        srtServer->stop();
+// Signal handlers only set flags, the main loop does the work
+std::atomic<bool> stopRequested{false};
+std::atomic<bool> reloadRequested{false};
+std::atomic<bool> drainRequested{false};
+
+// SIGTERM drains before exiting, a second SIGTERM or SIGINT stops right away
+void signalHandler(int signal) {
+#if defined(SIGHUP)
+    if (signal == SIGHUP) {
+        reloadRequested = true;
+        return;
+    }
+#endif
+    if (signal == SIGTERM && !drainRequested.exchange(true)) {
+        return;
     }
+    stopRequested = true;
 }
 
-int main() {
+int main(int argc, char *argv[]) {
     // Setup signal handling
     signal(SIGINT, signalHandler);
     signal(SIGTERM, signalHandler);
+#if defined(SIGHUP)
+    signal(SIGHUP, signalHandler);
+#endif
+
+    ServerConfig config;
+    std::string configPath = argc > 1 ? argv[1] : "";
+    if (!configPath.empty() && !ServerConfig::loadFromFile(configPath, config)) {
+        LOG_ERROR("Failed to load config file", LogFields().with(configPath));
+        return EXIT_FAILURE;
+    }
+    Logger::instance().configure(config.log);
 
-    srtServer = std::make_unique<SRTServer>();
+    srtServer = std::make_unique<SRTServer>(config, configPath);
 
     if (!srtServer->initialize()) {
-        std::cerr << "Failed to initialize SRT Server" << std::endl;
+        LOG_ERROR("Failed to initialize SRT Server");
         return EXIT_FAILURE;
     }
 
     if (!srtServer->start()) {
-        std::cerr << "Failed to start SRT Server" << std::endl;
+        LOG_ERROR("Failed to start SRT Server");
         return EXIT_FAILURE;
     }
 
-    std::cout << "SRT Server started. Press Ctrl+C to stop." << std::endl;
+    LOG_INFO("SRT Server started. Press Ctrl+C to stop.");
 
-    // Wait for signal
-    while (true) {
-        std::this_thread::sleep_for(std::chrono::seconds(1));
+    // Wait for signal, periodic reports run on the server's timer wheel
+    bool draining = false;
+    while (!stopRequested) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        if (reloadRequested.exchange(false)) {
+            std::vector<std::string> notApplied;
+            srtServer->reload(notApplied);
+        }
+        if (drainRequested && !draining) {
+            draining = true;
+            srtServer->startDrain();
+        }
+        // A drain started from the admin socket leaves the exit to the operator
+        if (draining && srtServer->isDrainComplete()) {
+            LOG_INFO("Drain complete");
+            break;
+        }
     }
 
+    LOG_INFO("Stopping server");
+    srtServer->stop();
     return 0;
 }
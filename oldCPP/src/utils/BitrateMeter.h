@@ -0,0 +1,68 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef BITRATEMETER_H
+#define BITRATEMETER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Measures the rate of a byte stream over fixed windows, smoothed with an EWMA.
+// addBytes() must be called from a single thread; bytesPerSecond() may be read from any thread.
+class BitrateMeter {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Returns true when a new estimate was published by this call.
+    bool addBytes(int64_t bytes, Clock::time_point now = Clock::now()) {
+        if (m_windowStart == Clock::time_point()) {
+            m_windowStart = now;
+        }
+        m_windowBytes += bytes;
+
+        auto elapsed = now - m_windowStart;
+        if (elapsed < WINDOW) {
+            return false;
+        }
+
+        double seconds = std::chrono::duration<double>(elapsed).count();
+        double windowRate = static_cast<double>(m_windowBytes) / seconds;
+        double previous = static_cast<double>(m_bytesPerSecond.load(std::memory_order_relaxed));
+        double smoothed = previous == 0.0 ? windowRate : previous + SMOOTHING * (windowRate - previous);
+
+        m_bytesPerSecond.store(static_cast<int64_t>(smoothed), std::memory_order_relaxed);
+        m_windowStart = now;
+        m_windowBytes = 0;
+        return true;
+    }
+
+    int64_t bytesPerSecond() const { return m_bytesPerSecond.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr std::chrono::milliseconds WINDOW{250};
+    static constexpr double SMOOTHING = 0.25;
+
+    Clock::time_point m_windowStart{};
+    int64_t m_windowBytes = 0;
+    std::atomic<int64_t> m_bytesPerSecond{0};
+};
+
+
+#endif //BITRATEMETER_H
@@ -0,0 +1,157 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "ConnectionCloser.h"
+
+#include <algorithm>
+
+bool CloseGroup::waitFor(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return m_doneCV.wait_for(lock, timeout, [this] { return m_remaining == 0; });
+}
+
+ConnectionCloser::ConnectionCloser(TeardownSettings settings)
+    : m_settings(settings) {
+}
+
+ConnectionCloser::~ConnectionCloser() {
+    stop();
+}
+
+std::shared_ptr<CloseGroup> ConnectionCloser::submit(std::vector<std::shared_ptr<StreamHandler> > handlers) {
+    auto group = std::make_shared<CloseGroup>();
+    group->m_handlers = std::move(handlers);
+    group->m_remaining = group->m_handlers.size();
+    group->m_submittedAt = std::chrono::steady_clock::now();
+    if (group->m_handlers.empty()) {
+        return group;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_stopped) {
+            const size_t batchSize = std::max<size_t>(m_settings.batchSize, 1);
+            for (size_t begin = 0; begin < group->m_handlers.size(); begin += batchSize) {
+                m_tasks.push_back(Task{group, begin, std::min(begin + batchSize, group->m_handlers.size())});
+            }
+            m_pendingConnections += group->m_handlers.size();
+            size_t wanted = std::min(std::max<size_t>(m_settings.workers, 1), m_tasks.size());
+            while (m_workers.size() < wanted) {
+                m_workers.emplace_back(&ConnectionCloser::workerThread, this);
+            }
+            m_taskCV.notify_all();
+            return group;
+        }
+        m_pendingConnections += group->m_handlers.size();
+    }
+
+    // Stopped, nobody is left to hand the work to
+    closeRange(Task{group, 0, group->m_handlers.size()});
+    return group;
+}
+
+bool ConnectionCloser::wait(const std::shared_ptr<CloseGroup> &group) {
+    std::chrono::milliseconds maxWait; {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        maxWait = m_settings.maxWait;
+    }
+    if (group->waitFor(maxWait)) {
+        return true;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_timedOutWaits;
+    return false;
+}
+
+void ConnectionCloser::closeRange(const Task &task) {
+    CloseGroup &group = *task.group;
+    for (size_t i = task.begin; i < task.end; ++i) {
+        group.m_handlers[i]->disconnect();
+    }
+
+    size_t closed = task.end - task.begin;
+    bool groupDone = false; {
+        std::lock_guard<std::mutex> lock(group.m_mutex);
+        group.m_remaining -= closed;
+        groupDone = group.m_remaining == 0;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pendingConnections -= closed;
+        m_closedConnections += closed;
+        if (groupDone) {
+            m_teardownLatency.record(std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - group.m_submittedAt).count());
+        }
+    }
+    if (groupDone) {
+        group.m_doneCV.notify_all();
+    }
+}
+
+void ConnectionCloser::workerThread() {
+    while (true) {
+        Task task; {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_taskCV.wait(lock, [this] { return m_stopped || !m_tasks.empty(); });
+            if (m_tasks.empty()) {
+                return;
+            }
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        closeRange(task);
+    }
+}
+
+void ConnectionCloser::stop() {
+    std::vector<std::thread> workers; {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopped = true;
+        workers.swap(m_workers);
+        m_taskCV.notify_all();
+    }
+    // Workers drain the queue before they exit
+    for (auto &worker: workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
+void ConnectionCloser::setSettings(TeardownSettings settings) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_settings = settings;
+}
+
+TeardownStats ConnectionCloser::getStats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    TeardownStats stats;
+    stats.closedConnections = m_closedConnections;
+    stats.pendingConnections = m_pendingConnections;
+    stats.timedOutWaits = m_timedOutWaits;
+    stats.averageTeardownMicros = m_teardownLatency.getAverage();
+    stats.maxTeardownMicros = m_teardownLatency.getMax();
+    return stats;
+}
+
+void ConnectionCloser::resetTeardownStats() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_teardownLatency.reset();
+}
@@ -0,0 +1,125 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef CONNECTIONCLOSER_H
+#define CONNECTIONCLOSER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "LatencyStats.h"
+#include "StreamHandler.h"
+
+struct TeardownSettings {
+    // Threads closing connections in parallel
+    size_t workers = 4;
+    // Connections a worker takes at once
+    size_t batchSize = 64;
+    // How long a session waits for its subscribers to close before leaving the rest in the background
+    std::chrono::milliseconds maxWait{2000};
+};
+
+struct TeardownStats {
+    uint64_t closedConnections = 0;
+    size_t pendingConnections = 0;
+    uint64_t timedOutWaits = 0;
+    // Time from submit until the last connection of a group was closed, since the last reset
+    int64_t averageTeardownMicros = 0;
+    int64_t maxTeardownMicros = 0;
+};
+
+// Connections handed over together; done once every one of them is disconnected
+class CloseGroup {
+public:
+    // Returns false if connections are still closing after timeout
+    bool waitFor(std::chrono::milliseconds timeout);
+
+    size_t getSize() const { return m_handlers.size(); }
+
+private:
+    friend class ConnectionCloser;
+
+    std::vector<std::shared_ptr<StreamHandler> > m_handlers;
+    std::chrono::steady_clock::time_point m_submittedAt;
+
+    std::mutex m_mutex;
+    std::condition_variable m_doneCV;
+    size_t m_remaining = 0;
+};
+
+// Shared pool disconnecting connections off the caller's thread. Closing a socket can take a while,
+// so a session that ends hands its audience over here instead of closing thousands of sockets
+// one by one under its own lock.
+class ConnectionCloser {
+public:
+    explicit ConnectionCloser(TeardownSettings settings = TeardownSettings());
+
+    ~ConnectionCloser();
+
+    ConnectionCloser(const ConnectionCloser &) = delete;
+
+    ConnectionCloser &operator=(const ConnectionCloser &) = delete;
+
+    // Workers start with the first submit. After stop() the handlers are closed on the calling thread.
+    std::shared_ptr<CloseGroup> submit(std::vector<std::shared_ptr<StreamHandler> > handlers);
+
+    // Waits for the group up to the configured bound, counting the waits that timed out
+    bool wait(const std::shared_ptr<CloseGroup> &group);
+
+    // Closes everything still queued, then joins the workers
+    void stop();
+
+    TeardownStats getStats() const;
+
+    // Applies to the next submit and wait; a smaller worker count doesn't stop running workers
+    void setSettings(TeardownSettings settings);
+
+    void resetTeardownStats();
+
+private:
+    struct Task {
+        std::shared_ptr<CloseGroup> group;
+        size_t begin;
+        size_t end;
+    };
+
+    void closeRange(const Task &task);
+
+    void workerThread();
+
+    mutable std::mutex m_mutex;
+    TeardownSettings m_settings;
+    std::condition_variable m_taskCV;
+    std::deque<Task> m_tasks;
+    size_t m_pendingConnections = 0;
+    uint64_t m_closedConnections = 0;
+    uint64_t m_timedOutWaits = 0;
+    LatencyStats m_teardownLatency;
+    bool m_stopped = false;
+    std::vector<std::thread> m_workers;
+};
+
+
+#endif //CONNECTIONCLOSER_H
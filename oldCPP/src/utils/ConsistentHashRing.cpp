@@ -0,0 +1,80 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "ConsistentHashRing.h"
+
+#include <algorithm>
+
+ConsistentHashRing::ConsistentHashRing(size_t pointsPerNode)
+    : m_pointsPerNode(std::max<size_t>(pointsPerNode, 1)) {
+}
+
+void ConsistentHashRing::addNode(const std::string &node) {
+    if (std::find(m_nodes.begin(), m_nodes.end(), node) != m_nodes.end()) {
+        return;
+    }
+    m_nodes.push_back(node);
+    for (size_t i = 0; i < m_pointsPerNode; ++i) {
+        // On the rare collision the smaller name keeps the point, so every node builds the same ring
+        auto point = m_points.emplace(hash(node + "#" + std::to_string(i)), node);
+        if (!point.second && node < point.first->second) {
+            point.first->second = node;
+        }
+    }
+}
+
+void ConsistentHashRing::removeNode(const std::string &node) {
+    auto it = std::find(m_nodes.begin(), m_nodes.end(), node);
+    if (it == m_nodes.end()) {
+        return;
+    }
+    m_nodes.erase(it);
+    m_points.clear();
+    std::vector<std::string> nodes;
+    nodes.swap(m_nodes);
+    for (const auto &remaining: nodes) {
+        addNode(remaining);
+    }
+}
+
+std::string ConsistentHashRing::nodeFor(const std::string &key) const {
+    if (m_points.empty()) {
+        return "";
+    }
+    auto it = m_points.lower_bound(hash(key));
+    if (it == m_points.end()) {
+        it = m_points.begin();
+    }
+    return it->second;
+}
+
+uint64_t ConsistentHashRing::hash(const std::string &value) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c: value) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    // FNV alone clusters keys differing only in their last characters, like "stream-1" and "stream-2"
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
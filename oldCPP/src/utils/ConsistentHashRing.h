@@ -0,0 +1,53 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef CONSISTENTHASHRING_H
+#define CONSISTENTHASHRING_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// Maps keys to nodes so adding or removing a node only moves the keys that node gains or loses.
+// Each node sits on the ring at several points, which evens out the share of keys each one gets.
+class ConsistentHashRing {
+public:
+    explicit ConsistentHashRing(size_t pointsPerNode = 64);
+
+    void addNode(const std::string &node);
+
+    void removeNode(const std::string &node);
+
+    // Empty when the ring has no nodes
+    std::string nodeFor(const std::string &key) const;
+
+    const std::vector<std::string> &getNodes() const { return m_nodes; }
+
+    // FNV-1a with a final mix, stable across processes and platforms so every node agrees
+    static uint64_t hash(const std::string &value);
+
+private:
+    size_t m_pointsPerNode;
+    std::vector<std::string> m_nodes;
+    std::map<uint64_t, std::string> m_points;
+};
+
+
+#endif //CONSISTENTHASHRING_H
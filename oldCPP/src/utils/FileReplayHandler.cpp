@@ -0,0 +1,292 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "FileReplayHandler.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Logger.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    constexpr uint8_t TS_SYNC_BYTE = 0x47;
+    constexpr uint64_t PCR_WRAP = (uint64_t(1) << 33) * 300;
+    // 27 MHz ticks; a larger jump between PCRs is a discontinuity, not elapsed time
+    constexpr uint64_t PCR_TICKS_PER_MICRO = 27;
+    constexpr uint64_t MAX_PCR_GAP = 27000000;
+
+    bool readPcr(const uint8_t *packet, uint16_t &pid, uint64_t &pcr) {
+        bool hasAdaptationField = (packet[3] & 0x20) != 0;
+        if (packet[0] != TS_SYNC_BYTE || !hasAdaptationField || packet[4] < 7 || (packet[5] & 0x10) == 0) {
+            return false;
+        }
+        pid = static_cast<uint16_t>(((packet[1] & 0x1f) << 8) | packet[2]);
+        uint64_t base = (uint64_t(packet[6]) << 25) | (uint64_t(packet[7]) << 17) | (uint64_t(packet[8]) << 9) |
+                        (uint64_t(packet[9]) << 1) | (packet[10] >> 7);
+        uint64_t extension = (uint64_t(packet[10] & 0x01) << 8) | packet[11];
+        pcr = base * 300 + extension;
+        return true;
+    }
+}
+
+ReplaySource::ReplaySource(std::string path)
+    : m_path(std::move(path)) {
+}
+
+ReplaySource::~ReplaySource() {
+#if defined(_WIN32)
+    if (m_mapping) {
+        UnmapViewOfFile(m_mapping);
+    }
+    if (m_fileMapping) {
+        CloseHandle(m_fileMapping);
+    }
+    if (m_file) {
+        CloseHandle(m_file);
+    }
+#else
+    if (m_mapping) {
+        munmap(m_mapping, m_mappingSize);
+    }
+#endif
+}
+
+std::shared_ptr<ReplaySource> ReplaySource::open(const std::string &path, int64_t bitrate) {
+    std::shared_ptr<ReplaySource> source(new ReplaySource(path));
+    if (!source->map()) {
+        LOG_ERROR("Failed to map replay file", LogFields().with(path));
+        return nullptr;
+    }
+
+    // Skip any partial packet at the start of the capture
+    const auto *bytes = reinterpret_cast<const uint8_t *>(source->m_mapping);
+    size_t start = 0;
+    while (start < source->m_mappingSize &&
+           !(bytes[start] == TS_SYNC_BYTE && (start + TS_PACKET_SIZE >= source->m_mappingSize ||
+                                              bytes[start + TS_PACKET_SIZE] == TS_SYNC_BYTE))) {
+        ++start;
+    }
+    source->m_data = static_cast<const char *>(source->m_mapping) + start;
+    source->m_size = (source->m_mappingSize - start) / TS_PACKET_SIZE * TS_PACKET_SIZE;
+    if (source->m_size == 0) {
+        LOG_ERROR("Replay file has no transport stream packets", LogFields().with(path));
+        return nullptr;
+    }
+
+    if (!source->buildTimeline(bitrate)) {
+        LOG_ERROR("Replay file has no usable PCR, set a replay bitrate", LogFields().with(path));
+        return nullptr;
+    }
+    return source;
+}
+
+bool ReplaySource::map() {
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(m_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    m_file = file;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        return false;
+    }
+    m_fileMapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!m_fileMapping) {
+        return false;
+    }
+    m_mapping = MapViewOfFile(m_fileMapping, FILE_MAP_READ, 0, 0, 0);
+    if (!m_mapping) {
+        return false;
+    }
+    m_mappingSize = static_cast<size_t>(size.QuadPart);
+#else
+    int fd = ::open(m_path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info{};
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    size_t size = static_cast<size_t>(info.st_size);
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    // Replays of one file sit at different positions, keep all of it resident
+    madvise(mapping, size, MADV_WILLNEED);
+    m_mapping = mapping;
+    m_mappingSize = size;
+#endif
+    return true;
+}
+
+bool ReplaySource::buildTimeline(int64_t bitrate) {
+    if (bitrate > 0) {
+        m_bytesPerMicro = static_cast<double>(bitrate) / 8 / 1000000;
+        return true;
+    }
+
+    const auto *bytes = reinterpret_cast<const uint8_t *>(m_data);
+    bool havePcrPid = false;
+    uint16_t pcrPid = 0;
+    uint64_t previousPcr = 0;
+    double segmentBytesPerMicro = 0.0;
+    for (size_t offset = 0; offset < m_size; offset += TS_PACKET_SIZE) {
+        uint16_t pid;
+        uint64_t pcr;
+        if (!readPcr(bytes + offset, pid, pcr) || (havePcrPid && pid != pcrPid)) {
+            continue;
+        }
+        if (!havePcrPid) {
+            havePcrPid = true;
+            pcrPid = pid;
+            previousPcr = pcr;
+            m_timeline.push_back(PcrPoint{offset, 0});
+            continue;
+        }
+
+        uint64_t delta = (pcr + PCR_WRAP - previousPcr) % PCR_WRAP;
+        previousPcr = pcr;
+        const PcrPoint &last = m_timeline.back();
+        int64_t micros;
+        if (delta > 0 && delta <= MAX_PCR_GAP) {
+            micros = last.micros + static_cast<int64_t>(delta / PCR_TICKS_PER_MICRO);
+        } else if (segmentBytesPerMicro > 0) {
+            // Discontinuity, carry on at the rate the stream had so far
+            micros = last.micros + static_cast<int64_t>((offset - last.offset) / segmentBytesPerMicro);
+        } else {
+            continue;
+        }
+        if (micros <= last.micros) {
+            continue;
+        }
+        segmentBytesPerMicro = static_cast<double>(offset - last.offset) / static_cast<double>(micros - last.micros);
+        m_timeline.push_back(PcrPoint{offset, micros});
+    }
+
+    if (m_timeline.size() < 2) {
+        return false;
+    }
+    const PcrPoint &first = m_timeline.front();
+    const PcrPoint &last = m_timeline.back();
+    m_bytesPerMicro = static_cast<double>(last.offset - first.offset) / static_cast<double>(last.micros - first.micros);
+
+    // Time zero is the start of the file, not the first PCR
+    int64_t lead = static_cast<int64_t>(first.offset / m_bytesPerMicro);
+    for (auto &point: m_timeline) {
+        point.micros += lead;
+    }
+    return true;
+}
+
+int64_t ReplaySource::timeAt(size_t offset) const {
+    if (m_timeline.empty()) {
+        return static_cast<int64_t>(offset / m_bytesPerMicro);
+    }
+    const PcrPoint &first = m_timeline.front();
+    const PcrPoint &last = m_timeline.back();
+    if (offset <= first.offset) {
+        return std::max<int64_t>(first.micros - static_cast<int64_t>((first.offset - offset) / m_bytesPerMicro), 0);
+    }
+    if (offset >= last.offset) {
+        return last.micros + static_cast<int64_t>((offset - last.offset) / m_bytesPerMicro);
+    }
+    auto next = std::upper_bound(m_timeline.begin(), m_timeline.end(), offset,
+                                 [](size_t value, const PcrPoint &point) { return value < point.offset; });
+    auto previous = next - 1;
+    double fraction = static_cast<double>(offset - previous->offset) / static_cast<double>(next->offset - previous->offset);
+    return previous->micros + static_cast<int64_t>(fraction * static_cast<double>(next->micros - previous->micros));
+}
+
+FileReplayHandler::FileReplayHandler(std::shared_ptr<ReplaySource> source, const std::string &streamId, bool loop)
+    : m_source(std::move(source)),
+      m_streamParams(StreamIdParams::parse(streamId)),
+      m_loop(loop) {
+}
+
+bool FileReplayHandler::disconnect() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_disconnected = true;
+    m_disconnectCV.notify_all();
+    return true;
+}
+
+bool FileReplayHandler::isConnected() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return !m_disconnected && !m_finished;
+}
+
+std::string FileReplayHandler::getLastErrorMessage() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_finished ? "end of replay file" : "replay stopped";
+}
+
+int FileReplayHandler::receive(char *buffer, int len, MessageControl &control) {
+    auto now = std::chrono::steady_clock::now();
+    if (m_passStart == std::chrono::steady_clock::time_point()) {
+        m_passStart = now;
+    }
+    if (m_offset >= m_source->size()) {
+        if (!m_loop) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_finished = true;
+            return STREAM_ERROR;
+        }
+        // The next pass starts where this one ends, so looping keeps the original pacing
+        m_passStart += std::chrono::microseconds(m_source->getDurationMicros());
+        m_offset = 0;
+        m_completedLoops.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    size_t packets = std::min(static_cast<size_t>(std::max(len, 0)) / ReplaySource::TS_PACKET_SIZE,
+                              PACKETS_PER_MESSAGE);
+    size_t bytes = std::min(packets * ReplaySource::TS_PACKET_SIZE, m_source->size() - m_offset);
+    if (bytes == 0) {
+        return STREAM_ERROR;
+    }
+
+    // Sleep until the message's first packet is due, a disconnect ends the wait
+    auto due = m_passStart + std::chrono::microseconds(m_source->timeAt(m_offset));
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_disconnectCV.wait_until(lock, due, [this] { return m_disconnected; })) {
+            return STREAM_ERROR;
+        }
+    }
+
+    std::memcpy(buffer, m_source->data() + m_offset, bytes);
+    m_offset += bytes;
+    control = MessageControl();
+    control.messageNumber = ++m_messageNumber;
+    return static_cast<int>(bytes);
+}
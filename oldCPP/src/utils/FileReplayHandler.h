@@ -0,0 +1,150 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef FILEREPLAYHANDLER_H
+#define FILEREPLAYHANDLER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "StreamHandler.h"
+
+struct ReplaySettings {
+    // Stream ID to recorded .ts file published under it when the server starts
+    std::unordered_map<std::string, std::string> files;
+    // Publishers per file; with more than one they are named "<stream id>-<n>"
+    int copies = 1;
+    bool loop = true;
+    // Fixed pacing in bits per second, 0 paces by the file's PCR
+    int64_t bitrate = 0;
+};
+
+// A recorded MPEG-TS file mapped read-only, with the playback time of every byte taken from the
+// PCRs of the first PID that carries them. Shared by all replays of the same file.
+class ReplaySource {
+public:
+    // nullptr if the file can't be mapped, isn't a transport stream, or has no PCR and no bitrate is given
+    static std::shared_ptr<ReplaySource> open(const std::string &path, int64_t bitrate = 0);
+
+    ~ReplaySource();
+
+    ReplaySource(const ReplaySource &) = delete;
+
+    ReplaySource &operator=(const ReplaySource &) = delete;
+
+    // Whole TS packets, starting at the first sync byte
+    const char *data() const { return m_data; }
+
+    size_t size() const { return m_size; }
+
+    const std::string &getPath() const { return m_path; }
+
+    // Playback time of the byte at offset, from the start of the file
+    int64_t timeAt(size_t offset) const;
+
+    int64_t getDurationMicros() const { return timeAt(m_size); }
+
+    static constexpr size_t TS_PACKET_SIZE = 188;
+
+private:
+    struct PcrPoint {
+        size_t offset;
+        int64_t micros;
+    };
+
+    explicit ReplaySource(std::string path);
+
+    bool map();
+
+    // Index the PCR timeline, or a constant rate if bitrate is set
+    bool buildTimeline(int64_t bitrate);
+
+    std::string m_path;
+    void *m_mapping = nullptr;
+    size_t m_mappingSize = 0;
+#if defined(_WIN32)
+    void *m_file = nullptr;
+    void *m_fileMapping = nullptr;
+#endif
+    const char *m_data = nullptr;
+    size_t m_size = 0;
+
+    std::vector<PcrPoint> m_timeline;
+    // Used outside the timeline and when pacing at a fixed rate
+    double m_bytesPerMicro = 0.0;
+};
+
+// Publisher that plays a ReplaySource into the server in real time, for load tests without encoders.
+// receive() hands out up to seven TS packets per message once their playback time is due.
+class FileReplayHandler : public StreamHandler {
+public:
+    FileReplayHandler(std::shared_ptr<ReplaySource> source, const std::string &streamId, bool loop);
+
+    bool disconnect() override;
+
+    int receive(char *buffer, int len, MessageControl &control) override;
+
+    int send(const char *buffer, int len, const MessageControl &control) override { return STREAM_ERROR; }
+
+    bool isConnected() const override;
+
+    std::string getStreamId() const override { return m_streamParams.getResource(); }
+
+    const StreamIdParams &getStreamParams() const override { return m_streamParams; }
+
+    void setBandwidthHints(int64_t inputBytesPerSecond, int overheadPercent) override {}
+
+    std::string getLastErrorMessage() const override;
+
+    int getLastErrorCode() const override { return 0; }
+
+    std::string getPeerAddress() const override { return "file:" + m_source->getPath(); }
+
+    bool getLinkStats(LinkStats &stats) const override { return false; }
+
+    uint64_t getCompletedLoops() const { return m_completedLoops.load(std::memory_order_relaxed); }
+
+private:
+    static constexpr size_t PACKETS_PER_MESSAGE = 7;
+
+    std::shared_ptr<ReplaySource> m_source;
+    StreamIdParams m_streamParams;
+    const bool m_loop;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_disconnectCV;
+    bool m_disconnected = false;
+    bool m_finished = false;
+
+    // Owned by the receiving thread
+    size_t m_offset = 0;
+    std::chrono::steady_clock::time_point m_passStart{};
+    int32_t m_messageNumber = 0;
+    std::atomic<uint64_t> m_completedLoops{0};
+};
+
+
+#endif //FILEREPLAYHANDLER_H
@@ -0,0 +1,54 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LATENCYSTATS_H
+#define LATENCYSTATS_H
+
+#include <algorithm>
+#include <cstdint>
+
+// Average and maximum of latency samples (microseconds) over a reporting window
+class LatencyStats {
+public:
+    void record(int64_t microseconds) {
+        ++m_count;
+        m_total += microseconds;
+        m_max = std::max(m_max, microseconds);
+    }
+
+    int64_t getCount() const { return m_count; }
+
+    int64_t getAverage() const { return m_count > 0 ? m_total / m_count : 0; }
+
+    int64_t getMax() const { return m_max; }
+
+    void reset() {
+        m_count = 0;
+        m_total = 0;
+        m_max = 0;
+    }
+
+private:
+    int64_t m_count = 0;
+    int64_t m_total = 0;
+    int64_t m_max = 0;
+};
+
+
+#endif //LATENCYSTATS_H
@@ -0,0 +1,330 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "Logger.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+namespace {
+    const char *levelName(LogLevel level) {
+        switch (level) {
+            case LogLevel::Debug:
+                return "debug";
+            case LogLevel::Info:
+                return "info";
+            case LogLevel::Warning:
+                return "warning";
+            case LogLevel::Error:
+                return "error";
+        }
+        return "unknown";
+    }
+
+    void appendValue(std::string &out, const char *key, std::string_view value) {
+        out += ' ';
+        out += key;
+        out += '=';
+        bool quote = value.empty() || value.find_first_of(" \"=") != std::string_view::npos;
+        if (!quote) {
+            out.append(value.data(), value.size());
+            return;
+        }
+        out += '"';
+        for (char c: value) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+            }
+            out += c;
+        }
+        out += '"';
+    }
+
+    int64_t steadyNowMs() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+Logger::ThreadBufferHolder::~ThreadBufferHolder() {
+    if (buffer) {
+        buffer->orphaned.store(true, std::memory_order_release);
+    }
+}
+
+Logger &Logger::instance() {
+    // Never destroyed, so detached threads logging during exit don't touch a dead object
+    static Logger *logger = [] {
+        auto *instance = new Logger();
+        std::atexit([] { Logger::instance().shutdown(); });
+        return instance;
+    }();
+    return *logger;
+}
+
+Logger::Logger()
+    : m_output([](const std::string &lines) {
+          std::fwrite(lines.data(), 1, lines.size(), stderr);
+          std::fflush(stderr);
+      }) {
+    m_writerThread = std::make_unique<std::thread>(&Logger::writerThread, this);
+}
+
+void Logger::configure(const LogSettings &settings) {
+    m_minLevel.store(static_cast<int>(settings.minLevel), std::memory_order_relaxed);
+    m_maxPerSitePerSecond.store(settings.maxPerSitePerSecond, std::memory_order_relaxed);
+}
+
+void Logger::setOutput(Output output) {
+    std::lock_guard<std::mutex> lock(m_outputMutex);
+    m_output = std::move(output);
+}
+
+bool Logger::shouldLog(LogLevel level, LogSite &site) {
+    if (static_cast<int>(level) < m_minLevel.load(std::memory_order_relaxed)) {
+        return false;
+    }
+
+    int64_t now = steadyNowMs();
+    int64_t windowStart = site.windowStartMs.load(std::memory_order_relaxed);
+    if (now - windowStart >= SUPPRESSION_WINDOW_MS &&
+        site.windowStartMs.compare_exchange_strong(windowStart, now, std::memory_order_relaxed)) {
+        site.countInWindow.store(0, std::memory_order_relaxed);
+    }
+
+    if (site.countInWindow.fetch_add(1, std::memory_order_relaxed) < m_maxPerSitePerSecond.load(
+            std::memory_order_relaxed)) {
+        return true;
+    }
+    site.suppressed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void Logger::write(LogLevel level, LogSite &site, const char *message, const LogFields &fields) {
+    LogRecord stackRecord{};
+    LogRecord *record = &stackRecord;
+
+    // Rare long messages (config errors, reload summaries) skip the ring rather than lose their tail
+    bool fits = fields.streamId.size() < sizeof(LogRecord::streamId) && fields.peer.size() < sizeof(LogRecord::peer) &&
+                fields.detail.size() < sizeof(LogRecord::detail);
+
+    ThreadBuffer *buffer = nullptr;
+    size_t head = 0;
+    if (fits && m_running.load(std::memory_order_acquire)) {
+        buffer = &getThreadBuffer();
+        head = buffer->head.load(std::memory_order_relaxed);
+        if (head - buffer->tail.load(std::memory_order_acquire) >= ThreadBuffer::CAPACITY) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        record = &buffer->records[head % ThreadBuffer::CAPACITY];
+    }
+
+    record->timestampUs = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    record->level = level;
+    record->message = message;
+    record->suppressed = site.suppressed.exchange(0, std::memory_order_relaxed);
+    record->threadIndex = buffer ? buffer->threadIndex : 0;
+    record->errorCode = fields.errorCode;
+    record->hasErrorCode = fields.hasErrorCode;
+    copyField(record->streamId, sizeof(record->streamId), fields.streamId);
+    copyField(record->peer, sizeof(record->peer), fields.peer);
+    copyField(record->detail, sizeof(record->detail), fields.detail);
+
+    if (buffer) {
+        buffer->head.store(head + 1, std::memory_order_release);
+        return;
+    }
+
+    // The writer has been shut down or the fields don't fit, write synchronously. A spilled line can
+    // come out ahead of older buffered ones of this thread, its timestamp still orders it.
+    std::string line;
+    formatRecord(*record, fields.streamId, fields.peer, fields.detail, line);
+    std::lock_guard<std::mutex> lock(m_outputMutex);
+    m_output(line);
+}
+
+void Logger::flush() {
+    std::unique_lock<std::mutex> lock(m_writerMutex);
+    if (!m_running.load(std::memory_order_acquire)) {
+        return;
+    }
+    uint64_t target = ++m_flushRequested;
+    m_writerCV.notify_one();
+    m_flushedCV.wait(lock, [this, target] {
+        return m_flushCompleted >= target || !m_running.load(std::memory_order_acquire);
+    });
+}
+
+void Logger::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(m_writerMutex);
+        if (!m_running.exchange(false)) {
+            return;
+        }
+        m_writerCV.notify_all();
+        m_flushedCV.notify_all();
+    }
+    if (m_writerThread && m_writerThread->joinable()) {
+        m_writerThread->join();
+    }
+}
+
+LogLevel Logger::parseLevel(const std::string &level, LogLevel defaultLevel) {
+    if (level == "debug") {
+        return LogLevel::Debug;
+    }
+    if (level == "info") {
+        return LogLevel::Info;
+    }
+    if (level == "warning" || level == "warn") {
+        return LogLevel::Warning;
+    }
+    if (level == "error") {
+        return LogLevel::Error;
+    }
+    return defaultLevel;
+}
+
+Logger::ThreadBuffer &Logger::getThreadBuffer() {
+    thread_local ThreadBufferHolder holder;
+    if (!holder.buffer) {
+        holder.buffer = std::make_shared<ThreadBuffer>();
+        std::lock_guard<std::mutex> lock(m_buffersMutex);
+        holder.buffer->threadIndex = m_nextThreadIndex++;
+        m_buffers.push_back(holder.buffer);
+    }
+    return *holder.buffer;
+}
+
+void Logger::writerThread() {
+    std::string out;
+    bool running = true;
+
+    while (running) {
+        uint64_t flushTarget; {
+            std::unique_lock<std::mutex> lock(m_writerMutex);
+            m_writerCV.wait_for(lock, WRITER_INTERVAL, [this] {
+                return m_flushRequested != m_flushCompleted || !m_running.load(std::memory_order_acquire);
+            });
+            flushTarget = m_flushRequested;
+            running = m_running.load(std::memory_order_acquire);
+        }
+
+        out.clear();
+        if (drain(out) > 0) {
+            std::lock_guard<std::mutex> lock(m_outputMutex);
+            m_output(out);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_writerMutex);
+            m_flushCompleted = flushTarget;
+        }
+        m_flushedCV.notify_all();
+    }
+}
+
+size_t Logger::drain(std::string &out) {
+    std::vector<std::shared_ptr<ThreadBuffer> > buffers; {
+        std::lock_guard<std::mutex> lock(m_buffersMutex);
+        buffers = m_buffers;
+    }
+
+    std::vector<LogRecord> batch;
+    bool hasOrphans = false;
+    for (const auto &buffer: buffers) {
+        // Read orphaned before head so a thread's last records are never left behind
+        bool orphaned = buffer->orphaned.load(std::memory_order_acquire);
+        size_t tail = buffer->tail.load(std::memory_order_relaxed);
+        size_t head = buffer->head.load(std::memory_order_acquire);
+        for (size_t i = tail; i != head; ++i) {
+            batch.push_back(buffer->records[i % ThreadBuffer::CAPACITY]);
+        }
+        buffer->tail.store(head, std::memory_order_release);
+        hasOrphans = hasOrphans || orphaned;
+    }
+
+    if (hasOrphans) {
+        std::lock_guard<std::mutex> lock(m_buffersMutex);
+        m_buffers.erase(std::remove_if(m_buffers.begin(), m_buffers.end(), [](const auto &buffer) {
+            return buffer->orphaned.load(std::memory_order_acquire) &&
+                   buffer->head.load(std::memory_order_acquire) == buffer->tail.load(std::memory_order_relaxed);
+        }), m_buffers.end());
+    }
+
+    // Interleave threads in time order
+    std::stable_sort(batch.begin(), batch.end(), [](const LogRecord &a, const LogRecord &b) {
+        return a.timestampUs < b.timestampUs;
+    });
+    for (const auto &record: batch) {
+        formatRecord(record, out);
+    }
+    return batch.size();
+}
+
+void Logger::formatRecord(const LogRecord &record, std::string &out) {
+    formatRecord(record, record.streamId, record.peer, record.detail, out);
+}
+
+void Logger::formatRecord(const LogRecord &record, std::string_view streamId, std::string_view peer,
+                          std::string_view detail, std::string &out) {
+    std::time_t seconds = static_cast<std::time_t>(record.timestampUs / 1000000);
+    std::tm utc{};
+#if defined(_WIN32)
+    gmtime_s(&utc, &seconds);
+#else
+    gmtime_r(&seconds, &utc);
+#endif
+    char timestamp[40];
+    size_t length = std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%S", &utc);
+    std::snprintf(timestamp + length, sizeof(timestamp) - length, ".%06dZ",
+                  static_cast<int>(record.timestampUs % 1000000));
+
+    out += timestamp;
+    appendValue(out, "level", levelName(record.level));
+    appendValue(out, "thread", std::to_string(record.threadIndex));
+    appendValue(out, "msg", record.message);
+    if (!streamId.empty()) {
+        appendValue(out, "stream", streamId);
+    }
+    if (!peer.empty()) {
+        appendValue(out, "peer", peer);
+    }
+    if (record.hasErrorCode) {
+        appendValue(out, "error", std::to_string(record.errorCode));
+    }
+    if (!detail.empty()) {
+        appendValue(out, "detail", detail);
+    }
+    if (record.suppressed > 0) {
+        appendValue(out, "suppressed", std::to_string(record.suppressed));
+    }
+    out += '\n';
+}
+
+void Logger::copyField(char *target, size_t size, std::string_view value) {
+    size_t length = std::min(value.size(), size - 1);
+    std::memcpy(target, value.data(), length);
+    target[length] = '\0';
+}
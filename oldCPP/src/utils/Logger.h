@@ -0,0 +1,200 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+enum class LogLevel {
+    Debug,
+    Info,
+    Warning,
+    Error,
+};
+
+struct LogSettings {
+    LogLevel minLevel = LogLevel::Info;
+    // Messages per call site per second before repeats are suppressed (and counted)
+    uint32_t maxPerSitePerSecond = 20;
+};
+
+// Structured fields attached to a log message. Views are only read while the message is
+// copied into the thread's buffer, so temporaries like getStreamId() are safe to pass.
+struct LogFields {
+    std::string_view streamId;
+    std::string_view peer;
+    std::string_view detail;
+    int errorCode = 0;
+    bool hasErrorCode = false;
+
+    LogFields &stream(std::string_view value) {
+        streamId = value;
+        return *this;
+    }
+
+    LogFields &from(std::string_view value) {
+        peer = value;
+        return *this;
+    }
+
+    LogFields &with(std::string_view value) {
+        detail = value;
+        return *this;
+    }
+
+    LogFields &error(int code) {
+        errorCode = code;
+        hasErrorCode = true;
+        return *this;
+    }
+};
+
+// Per call site state for repeat suppression, one static instance per LOG_* statement
+struct LogSite {
+    std::atomic<int64_t> windowStartMs{0};
+    std::atomic<uint32_t> countInWindow{0};
+    std::atomic<uint32_t> suppressed{0};
+};
+
+// Asynchronous logger. Each thread appends fixed-size records to its own lock-free ring;
+// a background writer drains the rings, formats the records and writes them in batches.
+// A full ring drops the record (and counts it) instead of blocking the caller. Fields too long
+// for a record are never cut: the message is written synchronously by the caller instead.
+class Logger {
+public:
+    using Output = std::function<void(const std::string &lines)>;
+
+    static Logger &instance();
+
+    void configure(const LogSettings &settings);
+
+    // Replace the output (stderr by default), mainly for tests
+    void setOutput(Output output);
+
+    bool shouldLog(LogLevel level, LogSite &site);
+
+    void write(LogLevel level, LogSite &site, const char *message, const LogFields &fields = LogFields());
+
+    // Block until every record written before this call has been output
+    void flush();
+
+    // Flush and stop the writer; later messages are written synchronously
+    void shutdown();
+
+    uint64_t getDroppedCount() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    static LogLevel parseLevel(const std::string &level, LogLevel defaultLevel);
+
+private:
+    struct LogRecord {
+        int64_t timestampUs;
+        LogLevel level;
+        const char *message;
+        uint32_t suppressed;
+        uint32_t threadIndex;
+        int errorCode;
+        bool hasErrorCode;
+        char streamId[48];
+        char peer[48];
+        char detail[112];
+    };
+
+    struct ThreadBuffer {
+        static constexpr size_t CAPACITY = 256;
+
+        std::array<LogRecord, CAPACITY> records;
+        alignas(64) std::atomic<size_t> head{0};
+        alignas(64) std::atomic<size_t> tail{0};
+        std::atomic<bool> orphaned{false};
+        uint32_t threadIndex = 0;
+    };
+
+    struct ThreadBufferHolder {
+        std::shared_ptr<ThreadBuffer> buffer;
+
+        ~ThreadBufferHolder();
+    };
+
+    Logger();
+
+    ThreadBuffer &getThreadBuffer();
+
+    void writerThread();
+
+    // Drain all thread buffers into text, returns the number of records written
+    size_t drain(std::string &out);
+
+    static void formatRecord(const LogRecord &record, std::string &out);
+
+    // Fields are passed separately so oversize ones can be written without a copy into the record
+    static void formatRecord(const LogRecord &record, std::string_view streamId, std::string_view peer,
+                             std::string_view detail, std::string &out);
+
+    static void copyField(char *target, size_t size, std::string_view value);
+
+    std::atomic<int> m_minLevel{static_cast<int>(LogLevel::Info)};
+    std::atomic<uint32_t> m_maxPerSitePerSecond{20};
+    std::atomic<uint64_t> m_dropped{0};
+
+    std::mutex m_buffersMutex;
+    std::vector<std::shared_ptr<ThreadBuffer> > m_buffers;
+    uint32_t m_nextThreadIndex = 0;
+
+    std::mutex m_outputMutex;
+    Output m_output;
+
+    std::mutex m_writerMutex;
+    std::condition_variable m_writerCV;
+    std::condition_variable m_flushedCV;
+    uint64_t m_flushRequested = 0;
+    uint64_t m_flushCompleted = 0;
+    std::atomic<bool> m_running{true};
+    std::unique_ptr<std::thread> m_writerThread;
+
+    static constexpr std::chrono::milliseconds WRITER_INTERVAL{5};
+    static constexpr int64_t SUPPRESSION_WINDOW_MS = 1000;
+};
+
+#define DL_LOG(level, ...) \
+    do { \
+        static LogSite dlLogSite; \
+        if (Logger::instance().shouldLog(level, dlLogSite)) { \
+            Logger::instance().write(level, dlLogSite, __VA_ARGS__); \
+        } \
+    } while (0)
+
+#define LOG_DEBUG(...) DL_LOG(LogLevel::Debug, __VA_ARGS__)
+#define LOG_INFO(...) DL_LOG(LogLevel::Info, __VA_ARGS__)
+#define LOG_WARNING(...) DL_LOG(LogLevel::Warning, __VA_ARGS__)
+#define LOG_ERROR(...) DL_LOG(LogLevel::Error, __VA_ARGS__)
+
+
+#endif //LOGGER_H
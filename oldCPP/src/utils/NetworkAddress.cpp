@@ -0,0 +1,89 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "NetworkAddress.h"
+
+#include <cstring>
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif
+
+bool NetworkAddress::splitHostPort(const std::string &address, std::string &host, std::string &port) {
+    size_t colon = address.rfind(':');
+    if (colon == std::string::npos || colon + 1 >= address.size()) {
+        return false;
+    }
+    host = address.substr(0, colon);
+    port = address.substr(colon + 1);
+    if (host.size() >= 2 && host.front() == '[' && host.back() == ']') {
+        host = host.substr(1, host.size() - 2);
+    }
+    return true;
+}
+
+bool NetworkAddress::resolve(const std::string &address, bool passive, sockaddr_storage &result, int &resultLength) {
+    std::string host;
+    std::string port;
+    if (!splitHostPort(address, host, port)) {
+        return false;
+    }
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+    addrinfo *info = nullptr;
+    if (getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &info) != 0 || !info) {
+        return false;
+    }
+    std::memset(&result, 0, sizeof(result));
+    std::memcpy(&result, info->ai_addr, info->ai_addrlen);
+    resultLength = static_cast<int>(info->ai_addrlen);
+    freeaddrinfo(info);
+    return true;
+}
+
+bool NetworkAddress::isMulticast(const sockaddr_storage &address) {
+    if (address.ss_family == AF_INET) {
+        auto *ipv4 = reinterpret_cast<const sockaddr_in *>(&address);
+        return (ntohl(ipv4->sin_addr.s_addr) & 0xf0000000) == 0xe0000000;
+    }
+    if (address.ss_family == AF_INET6) {
+        auto *ipv6 = reinterpret_cast<const sockaddr_in6 *>(&address);
+        return ipv6->sin6_addr.s6_addr[0] == 0xff;
+    }
+    return false;
+}
+
+bool NetworkAddress::isWildcard(const sockaddr_storage &address) {
+    if (address.ss_family == AF_INET) {
+        return reinterpret_cast<const sockaddr_in *>(&address)->sin_addr.s_addr == htonl(INADDR_ANY);
+    }
+    if (address.ss_family == AF_INET6) {
+        auto *ipv6 = reinterpret_cast<const sockaddr_in6 *>(&address);
+        return std::memcmp(&ipv6->sin6_addr, &in6addr_any, sizeof(in6addr_any)) == 0;
+    }
+    return false;
+}
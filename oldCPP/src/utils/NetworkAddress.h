@@ -0,0 +1,41 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef NETWORKADDRESS_H
+#define NETWORKADDRESS_H
+
+#include <string>
+
+struct sockaddr_storage;
+
+// "host:port" address helpers shared by the SRT listeners and plain UDP sockets.
+// IPv6 hosts go in brackets ("[::]:5500"), an empty host means every local address.
+namespace NetworkAddress {
+    bool splitHostPort(const std::string &address, std::string &host, std::string &port);
+
+    // Resolve to a socket address. passive resolves an empty host to the wildcard address.
+    bool resolve(const std::string &address, bool passive, sockaddr_storage &result, int &resultLength);
+
+    bool isMulticast(const sockaddr_storage &address);
+
+    bool isWildcard(const sockaddr_storage &address);
+}
+
+
+#endif //NETWORKADDRESS_H
@@ -0,0 +1,55 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "PidFilter.h"
+
+#include <sstream>
+
+bool PidFilter::parse(const std::string &value, PidFilter &filter) {
+    std::bitset<8192> pids;
+    pids.set(0);
+    std::stringstream entries(value);
+    std::string entry;
+    while (std::getline(entries, entry, ':')) {
+        if (entry.empty()) {
+            continue;
+        }
+        size_t parsed = 0;
+        unsigned long pid;
+        try {
+            bool hex = entry.size() > 2 && entry[0] == '0' && (entry[1] == 'x' || entry[1] == 'X');
+            pid = std::stoul(entry, &parsed, hex ? 16 : 10);
+        } catch (const std::exception &) {
+            return false;
+        }
+        if (parsed != entry.size() || pid > 0x1fff) {
+            return false;
+        }
+        pids.set(pid);
+    }
+
+    filter.m_pids = pids;
+    filter.m_key.clear();
+    for (size_t pid = 0; pid < pids.size(); ++pid) {
+        if (pids.test(pid)) {
+            filter.m_key += (filter.m_key.empty() ? "" : ":") + std::to_string(pid);
+        }
+    }
+    return true;
+}
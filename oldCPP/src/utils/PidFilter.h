@@ -0,0 +1,105 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef PIDFILTER_H
+#define PIDFILTER_H
+
+#include <bitset>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include "StreamHandler.h"
+
+// TS PIDs a subscriber wants, from the "pids" stream ID parameter. PIDs are ':' separated,
+// decimal or 0x hex: "pids=0x1000:257". The PAT (PID 0) is always kept, the PMT has to be listed.
+class PidFilter {
+public:
+    static constexpr size_t TS_PACKET_SIZE = 188;
+    static constexpr uint8_t TS_SYNC_BYTE = 0x47;
+
+    static bool parse(const std::string &value, PidFilter &filter);
+
+    bool matches(uint16_t pid) const { return m_pids.test(pid & 0x1fff); }
+
+    // Canonical form, filters with the same PIDs have the same key
+    const std::string &getKey() const { return m_key; }
+
+private:
+    std::bitset<8192> m_pids;
+    std::string m_key;
+};
+
+// Keeps the packets of one filter and repacks them into full SRT payloads, so a filtered
+// stream goes out in as few messages as the unfiltered one would need for the same bytes.
+class TsRepacketizer {
+public:
+    static constexpr size_t PACKETS_PER_PAYLOAD = 7;
+    static constexpr size_t PAYLOAD_SIZE = PACKETS_PER_PAYLOAD * PidFilter::TS_PACKET_SIZE;
+    // Sparse filters (audio, captions) would otherwise hold packets back for long
+    static constexpr std::chrono::milliseconds MAX_HOLD{10};
+
+    explicit TsRepacketizer(PidFilter filter = PidFilter()) : m_filter(std::move(filter)) {}
+
+    // Calls emit(data, len, control) for every payload completed by this message, and for a partial
+    // one whose oldest packet has waited MAX_HOLD. control is the one of the oldest packet in the payload.
+    template<typename Emit>
+    void process(const char *data, int len, const MessageControl &control, std::chrono::steady_clock::time_point now,
+                 Emit &&emit) {
+        for (int offset = 0; offset + static_cast<int>(PidFilter::TS_PACKET_SIZE) <= len;
+             offset += static_cast<int>(PidFilter::TS_PACKET_SIZE)) {
+            const auto *packet = reinterpret_cast<const uint8_t *>(data + offset);
+            uint16_t pid = static_cast<uint16_t>(((packet[1] & 0x1f) << 8) | packet[2]);
+            if (packet[0] != PidFilter::TS_SYNC_BYTE || !m_filter.matches(pid)) {
+                continue;
+            }
+            if (m_size == 0) {
+                m_firstBufferedAt = now;
+                m_firstControl = control;
+                // A repacked payload is a message of its own
+                m_firstControl.boundary = MessageBoundary::Solo;
+            }
+            std::memcpy(m_payload + m_size, packet, PidFilter::TS_PACKET_SIZE);
+            m_size += PidFilter::TS_PACKET_SIZE;
+            if (m_size == PAYLOAD_SIZE) {
+                emit(m_payload, static_cast<int>(m_size), m_firstControl);
+                m_size = 0;
+            }
+        }
+        if (m_size > 0 && now - m_firstBufferedAt >= MAX_HOLD) {
+            emit(m_payload, static_cast<int>(m_size), m_firstControl);
+            m_size = 0;
+        }
+    }
+
+    const PidFilter &getFilter() const { return m_filter; }
+
+    // Filtered packets waiting for their payload to fill
+    size_t getBufferedBytes() const { return m_size; }
+
+private:
+    PidFilter m_filter;
+    char m_payload[PAYLOAD_SIZE];
+    size_t m_size = 0;
+    std::chrono::steady_clock::time_point m_firstBufferedAt{};
+    MessageControl m_firstControl;
+};
+
+
+#endif //PIDFILTER_H
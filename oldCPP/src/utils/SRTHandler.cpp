@@ -19,27 +19,95 @@
 
 #include "SRTHandler.h"
 
+#include <algorithm>
+
+#if defined(_WIN32)
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#endif
+
+std::string SRTHandler::formatAddress(const sockaddr *address) {
+    char host[INET6_ADDRSTRLEN] = {};
+    if (address == nullptr) {
+        return "";
+    }
+    if (address->sa_family == AF_INET) {
+        const auto *ipv4 = reinterpret_cast<const sockaddr_in *>(address);
+        inet_ntop(AF_INET, &ipv4->sin_addr, host, sizeof(host));
+        return std::string(host) + ":" + std::to_string(ntohs(ipv4->sin_port));
+    }
+    if (address->sa_family == AF_INET6) {
+        const auto *ipv6 = reinterpret_cast<const sockaddr_in6 *>(address);
+        inet_ntop(AF_INET6, &ipv6->sin6_addr, host, sizeof(host));
+        return "[" + std::string(host) + "]:" + std::to_string(ntohs(ipv6->sin6_port));
+    }
+    return "";
+}
+
 bool SRTHandler::connect(SRTSOCKET listeningSocket) {
-    m_socket = srt_accept(listeningSocket, nullptr, nullptr);
+    sockaddr_storage peerAddress{};
+    int peerAddressLen = sizeof(peerAddress);
+    m_socket = srt_accept(listeningSocket, reinterpret_cast<sockaddr *>(&peerAddress), &peerAddressLen);
 
     if (m_socket == SRT_INVALID_SOCK) {
         return false;
     }
-    m_streamId = extractStreamId();
+    m_acceptedAt = std::chrono::steady_clock::now();
+    m_peerAddress = formatAddress(reinterpret_cast<const sockaddr *>(&peerAddress));
+    m_connectionTime = srt_connection_time(m_socket);
+    if (m_connectionTime > 0) {
+        m_acceptQueueMicros = std::max<int64_t>(srt_time_now() - m_connectionTime, 0);
+    }
+    m_streamParams = StreamIdParams::parse(extractStreamId());
+    m_streamId = m_streamParams.getResource();
+    m_streamIdMicros = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - m_acceptedAt).count();
     return true;
 }
 
 
 bool SRTHandler::disconnect() {
+    if (m_closeObserver && !m_closed.exchange(true)) {
+        LinkStats stats;
+        if (getLinkStats(stats)) {
+            m_closeObserver(m_peerAddress, stats);
+        }
+    }
     return srt_close(m_socket) >= 0;
 }
 
-int SRTHandler::receive(char *buffer, int len) {
-    return srt_recv(m_socket, buffer, len);
+int SRTHandler::receive(char *buffer, int len, MessageControl &control) {
+    SRT_MSGCTRL messageControl = srt_msgctrl_default;
+    int result = srt_recvmsg2(m_socket, buffer, len, &messageControl);
+    if (result == SRT_ERROR) {
+        return STREAM_ERROR;
+    }
+
+    // srctime is already translated to our clock by SRT
+    control.sourceTime = messageControl.srctime;
+    control.receiveTime = srt_time_now();
+    control.messageNumber = messageControl.msgno;
+    control.boundary = static_cast<MessageBoundary>(messageControl.boundary);
+    return result;
 }
 
-int SRTHandler::send(const char *buffer, int len) {
-    return srt_send(m_socket, buffer, len);
+int SRTHandler::send(const char *buffer, int len, const MessageControl &control) {
+    return sendTo(getSrtTarget(), buffer, len, control);
+}
+
+void SRTHandler::setBandwidthHints(int64_t inputBytesPerSecond, int overheadPercent) {
+    // SRTO_MAXBW = 0 makes SRT derive its max bandwidth from SRTO_INPUTBW + SRTO_OHEADBW
+    int64_t maxBandwidth = 0;
+    int overhead = std::min(std::max(overheadPercent, 5), 100);
+    srt_setsockflag(m_socket, SRTO_INPUTBW, &inputBytesPerSecond, sizeof(inputBytesPerSecond));
+    srt_setsockflag(m_socket, SRTO_OHEADBW, &overhead, sizeof(overhead));
+    srt_setsockflag(m_socket, SRTO_MAXBW, &maxBandwidth, sizeof(maxBandwidth));
+}
+
+void SRTHandler::setNonBlockingSend() {
+    bool blocking = false;
+    srt_setsockflag(m_socket, SRTO_SNDSYN, &blocking, sizeof(blocking));
 }
 
 bool SRTHandler::isConnected() const {
@@ -50,6 +118,25 @@ std::string SRTHandler::getLastErrorMessage() const {
     return srt_getlasterror_str();
 }
 
+bool SRTHandler::getLinkStats(LinkStats &stats) const {
+    SRT_TRACEBSTATS performance{};
+    if (srt_bstats(m_socket, &performance, 0) == SRT_ERROR) {
+        return false;
+    }
+    stats.rttMs = performance.msRTT;
+    stats.packetsSent = performance.pktSentTotal;
+    stats.packetsSendLost = performance.pktSndLossTotal;
+    stats.packetsRetransmitted = performance.pktRetransTotal;
+    stats.packetsReceived = performance.pktRecvTotal;
+    stats.packetsReceiveLost = performance.pktRcvLossTotal;
+    stats.sendBufferMs = performance.msSndBuf;
+    return true;
+}
+
+int SRTHandler::getLastErrorCode() const {
+    return srt_getlasterror(nullptr);
+}
+
 std::string SRTHandler::extractStreamId() const {
     char streamId[512];
     int streamIdLen = 512;
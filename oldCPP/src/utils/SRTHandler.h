@@ -20,12 +20,23 @@
 #ifndef SRTHANDLER_H
 #define SRTHANDLER_H
 
+#include <atomic>
+#include <functional>
 #include <srt/srt.h>
 
 #include "StreamHandler.h"
 
+// A connected SRT peer reduced to what sending needs, so fan-out can loop over a plain array
+struct SrtTarget {
+    SRTSOCKET socket;
+    int64_t connectionTime;
+};
+
 class SRTHandler : public StreamHandler {
 public:
+    // Receives the final link statistics of a connection right before it is closed
+    using CloseObserver = std::function<void(const std::string &peerAddress, const LinkStats &stats)>;
+
     explicit SRTHandler() {
     }
 
@@ -35,19 +46,71 @@ public:
 
     bool disconnect() override;
 
-    int receive(char *buffer, int len) override;
+    int receive(char *buffer, int len, MessageControl &control) override;
 
-    int send(const char *buffer, int len) override;
+    int send(const char *buffer, int len, const MessageControl &control) override;
 
     bool isConnected() const override;
 
     std::string getStreamId() const override { return m_streamId; };
 
+    const StreamIdParams &getStreamParams() const override { return m_streamParams; }
+
+    void setBandwidthHints(int64_t inputBytesPerSecond, int overheadPercent) override;
+
+    void setNonBlockingSend() override;
+
     std::string getLastErrorMessage() const override;
 
+    int getLastErrorCode() const override;
+
+    std::string getPeerAddress() const override { return m_peerAddress; }
+
+    bool getLinkStats(LinkStats &stats) const override;
+
+    std::chrono::steady_clock::time_point getAcceptedAt() const override { return m_acceptedAt; }
+
+    // Time the completed handshake waited for srt_accept
+    int64_t getAcceptQueueMicros() const { return m_acceptQueueMicros; }
+
+    // Time spent reading and parsing the stream ID after the accept
+    int64_t getStreamIdMicros() const { return m_streamIdMicros; }
+
+    void setCloseObserver(CloseObserver observer) { m_closeObserver = std::move(observer); }
+
+    SrtTarget getSrtTarget() const { return SrtTarget{m_socket, m_connectionTime}; }
+
+    // Send path shared by send() and the devirtualized fan-out; on failure srt_getlasterror() has the reason
+    static int sendTo(const SrtTarget &target, const char *buffer, int len, const MessageControl &control) {
+        SRT_MSGCTRL messageControl = srt_msgctrl_default;
+        // A source time from before this connection existed would be rejected, let SRT stamp it instead
+        if (control.sourceTime > target.connectionTime) {
+            messageControl.srctime = control.sourceTime;
+        }
+        int result = srt_sendmsg2(target.socket, buffer, len, &messageControl);
+        if (result != SRT_ERROR) {
+            return result;
+        }
+        // Only sockets set to non-blocking sends report a full send buffer
+        return srt_getlasterror(nullptr) == SRT_EASYNCSND ? STREAM_WOULD_BLOCK : STREAM_ERROR;
+    }
+
+    // Format an IPv4/IPv6 socket address as "ip:port" / "[ip]:port"
+    static std::string formatAddress(const sockaddr *address);
+
 private:
-    SRTSOCKET m_socket;
+    SRTSOCKET m_socket = SRT_INVALID_SOCK;
     std::string m_streamId;
+    StreamIdParams m_streamParams;
+    std::string m_peerAddress;
+    // Source times before the connection started are rejected by SRT
+    int64_t m_connectionTime = 0;
+    std::chrono::steady_clock::time_point m_acceptedAt{};
+    int64_t m_acceptQueueMicros = 0;
+    int64_t m_streamIdMicros = 0;
+
+    CloseObserver m_closeObserver;
+    std::atomic<bool> m_closed{false};
 };
 
 
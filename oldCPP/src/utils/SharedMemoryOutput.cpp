@@ -0,0 +1,55 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "SharedMemoryOutput.h"
+
+#include "Logger.h"
+
+SharedMemoryOutput::SharedMemoryOutput(std::string name, std::unique_ptr<SharedMemoryRing> ring)
+    : m_name(std::move(name)),
+      m_ring(std::move(ring)) {
+}
+
+std::shared_ptr<SharedMemoryOutput> SharedMemoryOutput::create(const std::string &streamId,
+                                                               const SharedMemorySettings &settings) {
+    std::string name = SharedMemoryRing::objectName(settings.namePrefix, streamId);
+    auto ring = SharedMemoryRing::create(name, settings.slotCount, settings.slotSize);
+    if (!ring) {
+        return nullptr;
+    }
+    LOG_INFO("Publishing stream to shared memory", LogFields().stream(streamId).with(name));
+    return std::shared_ptr<SharedMemoryOutput>(new SharedMemoryOutput(name, std::move(ring)));
+}
+
+bool SharedMemoryOutput::write(const char *data, int len, const MessageControl &control) {
+    // session.buffer_size can be reloaded past shm.slot_size; one large message shouldn't end the output
+    if (len < 0 || static_cast<uint32_t>(len) > m_ring->getSlotSize()) {
+        if (m_droppedPackets.fetch_add(1, std::memory_order_relaxed) == 0) {
+            LOG_WARNING("Message larger than a shared memory slot, dropping it", LogFields().with(
+                            m_name + " size=" + std::to_string(len) + " slot_size=" +
+                            std::to_string(m_ring->getSlotSize())));
+        }
+        return true;
+    }
+    return m_ring->publish(data, len, control);
+}
+
+void SharedMemoryOutput::close() {
+    m_ring->close();
+}
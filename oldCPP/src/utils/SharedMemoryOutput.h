@@ -0,0 +1,71 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SHAREDMEMORYOUTPUT_H
+#define SHAREDMEMORYOUTPUT_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "SharedMemoryRing.h"
+#include "StreamOutput.h"
+
+struct SharedMemorySettings {
+    // Publish streams to shared memory that don't ask for it with the "shm" stream ID parameter
+    bool enabledByDefault = false;
+    // The ring is named after the stream ID with this prefix, see SharedMemoryRing::objectName
+    std::string namePrefix = "dl_srt_";
+    // ~5 seconds of a 10 Mbit/s stream
+    uint32_t slotCount = 4096;
+    uint32_t slotSize = 1456;
+};
+
+// Session output that publishes the stream into a SharedMemoryRing for local consumers
+class SharedMemoryOutput : public StreamOutput {
+public:
+    // nullptr if the ring can't be created
+    static std::shared_ptr<SharedMemoryOutput> create(const std::string &streamId,
+                                                      const SharedMemorySettings &settings);
+
+    bool write(const char *data, int len, const MessageControl &control) override;
+
+    void close() override;
+
+    std::string getName() const override { return m_name; }
+
+    // Messages larger than a slot, skipped instead of failing the output
+    uint64_t getDroppedPackets() const { return m_droppedPackets.load(std::memory_order_relaxed); }
+
+    // Readers keep up or get overwritten, so the ring is a fixed cost and never a backlog
+    size_t getReservedBytes() const override {
+        return static_cast<size_t>(m_ring->getSlotCount()) * m_ring->getSlotSize();
+    }
+
+private:
+    SharedMemoryOutput(std::string name, std::unique_ptr<SharedMemoryRing> ring);
+
+    std::string m_name;
+    std::unique_ptr<SharedMemoryRing> m_ring;
+    std::atomic<uint64_t> m_droppedPackets{0};
+};
+
+
+#endif //SHAREDMEMORYOUTPUT_H
@@ -0,0 +1,363 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "SharedMemoryRing.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <climits>
+#include <cstring>
+#include <thread>
+
+#include "Logger.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+namespace {
+    constexpr uint32_t RING_MAGIC = 0x44535252; // "DSRR"
+    constexpr uint32_t RING_VERSION = 1;
+    constexpr size_t CACHE_LINE_SIZE = 64;
+
+    size_t alignToCacheLine(size_t size) {
+        return (size + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+    }
+}
+
+// Lives at the start of the mapping, shared by the writer and every reader
+struct SharedMemoryRing::Header {
+    std::atomic<uint32_t> magic;
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t slotSize;
+    uint64_t slotStride;
+
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> writeSequence;
+    // Bumped on every publish, readers sleep on it (futex words are 32 bits)
+    std::atomic<uint32_t> wakeCounter;
+    std::atomic<uint32_t> waiters;
+    std::atomic<uint32_t> closed;
+};
+
+// Precedes each packet's data. sequence is the packet's sequence + 1 once written, 0 while being written.
+struct SharedMemoryRing::SlotHeader {
+    std::atomic<uint64_t> sequence;
+    int64_t sourceTime;
+    int32_t size;
+    int32_t messageNumber;
+    int32_t boundary;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "Shared memory ring needs lock-free 64-bit atomics");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "Shared memory ring needs lock-free 32-bit atomics");
+
+SharedMemoryRing::SharedMemoryRing(std::string name, bool isWriter)
+    : m_name(std::move(name)),
+      m_isWriter(isWriter) {
+}
+
+SharedMemoryRing::~SharedMemoryRing() {
+    if (m_isWriter && m_header) {
+        close();
+    }
+#if defined(_WIN32)
+    if (m_mapping) {
+        UnmapViewOfFile(m_mapping);
+    }
+    if (m_fileMapping) {
+        CloseHandle(m_fileMapping);
+    }
+#else
+    if (m_mapping) {
+        munmap(m_mapping, m_mappingSize);
+    }
+    // Readers that are still attached keep their mapping, new ones can no longer find the ring
+    if (m_isWriter) {
+        shm_unlink(m_name.c_str());
+    }
+#endif
+}
+
+std::string SharedMemoryRing::objectName(const std::string &prefix, const std::string &streamId) {
+    std::string name = prefix + streamId.substr(0, 200);
+    for (auto &c: name) {
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '-' && c != '_' && c != '.') {
+            c = '_';
+        }
+    }
+#if defined(_WIN32)
+    return "Local\\" + name;
+#else
+    return "/" + name;
+#endif
+}
+
+bool SharedMemoryRing::map(size_t size, bool create) {
+#if defined(_WIN32)
+    if (create) {
+        m_fileMapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                           static_cast<DWORD>(static_cast<uint64_t>(size) >> 32),
+                                           static_cast<DWORD>(size & 0xffffffff), m_name.c_str());
+    } else {
+        m_fileMapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, m_name.c_str());
+    }
+    if (!m_fileMapping) {
+        return false;
+    }
+    // Windows keeps a mapping alive while any reader holds it, don't write over a ring still in use
+    if (create && GetLastError() == ERROR_ALREADY_EXISTS) {
+        return false;
+    }
+    m_mapping = MapViewOfFile(m_fileMapping, FILE_MAP_ALL_ACCESS, 0, 0, create ? size : 0);
+    if (!m_mapping) {
+        return false;
+    }
+    if (!create) {
+        MEMORY_BASIC_INFORMATION info;
+        if (VirtualQuery(m_mapping, &info, sizeof(info)) == 0) {
+            return false;
+        }
+        size = info.RegionSize;
+    }
+#else
+    int fd = create
+                 ? shm_open(m_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0660)
+                 : shm_open(m_name.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        return false;
+    }
+    if (create && ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        ::close(fd);
+        return false;
+    }
+    if (!create) {
+        struct stat info{};
+        if (fstat(fd, &info) != 0) {
+            ::close(fd);
+            return false;
+        }
+        size = static_cast<size_t>(info.st_size);
+    }
+    void *mapping = size > 0 ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    m_mapping = mapping;
+#endif
+    m_mappingSize = size;
+    m_header = static_cast<Header *>(m_mapping);
+    m_slots = static_cast<char *>(m_mapping) + alignToCacheLine(sizeof(Header));
+    return true;
+}
+
+std::unique_ptr<SharedMemoryRing> SharedMemoryRing::create(const std::string &name, uint32_t slotCount,
+                                                           uint32_t slotSize) {
+    if (slotCount == 0 || slotSize == 0) {
+        return nullptr;
+    }
+    size_t slotStride = alignToCacheLine(sizeof(SlotHeader) + slotSize);
+    size_t size = alignToCacheLine(sizeof(Header)) + slotStride * slotCount;
+
+#if !defined(_WIN32)
+    // A ring left behind by a crashed server would keep its old layout, start from a fresh object
+    shm_unlink(name.c_str());
+#endif
+    std::unique_ptr<SharedMemoryRing> ring(new SharedMemoryRing(name, true));
+    if (!ring->map(size, true)) {
+        LOG_ERROR("Failed to create shared memory ring", LogFields().with(name));
+        return nullptr;
+    }
+
+    // Fresh mappings are zeroed, so every slot sequence already reads as "not written"
+    Header *header = ring->m_header;
+    header->version = RING_VERSION;
+    header->slotCount = slotCount;
+    header->slotSize = slotSize;
+    header->slotStride = slotStride;
+    header->writeSequence.store(0, std::memory_order_relaxed);
+    header->wakeCounter.store(0, std::memory_order_relaxed);
+    header->waiters.store(0, std::memory_order_relaxed);
+    header->closed.store(0, std::memory_order_relaxed);
+    header->magic.store(RING_MAGIC, std::memory_order_release);
+
+    ring->m_slotCount = slotCount;
+    ring->m_slotSize = slotSize;
+    ring->m_slotStride = slotStride;
+    return ring;
+}
+
+std::unique_ptr<SharedMemoryRing> SharedMemoryRing::attach(const std::string &name) {
+    std::unique_ptr<SharedMemoryRing> ring(new SharedMemoryRing(name, false));
+    if (!ring->map(0, false) || ring->m_mappingSize < sizeof(Header)) {
+        return nullptr;
+    }
+
+    Header *header = ring->m_header;
+    if (header->magic.load(std::memory_order_acquire) != RING_MAGIC || header->version != RING_VERSION) {
+        return nullptr;
+    }
+    size_t required = alignToCacheLine(sizeof(Header)) + header->slotStride * header->slotCount;
+    if (header->slotCount == 0 || header->slotStride < sizeof(SlotHeader) + header->slotSize ||
+        ring->m_mappingSize < required) {
+        return nullptr;
+    }
+
+    ring->m_slotCount = header->slotCount;
+    ring->m_slotSize = header->slotSize;
+    ring->m_slotStride = header->slotStride;
+    return ring;
+}
+
+SharedMemoryRing::SlotHeader *SharedMemoryRing::slotAt(uint64_t sequence) const {
+    return reinterpret_cast<SlotHeader *>(m_slots + (sequence % m_slotCount) * m_slotStride);
+}
+
+bool SharedMemoryRing::publish(const char *data, int len, const MessageControl &control) {
+    if (!m_isWriter || len < 0 || static_cast<uint32_t>(len) > m_slotSize) {
+        return false;
+    }
+
+    uint64_t sequence = m_nextSequence++;
+    SlotHeader *slot = slotAt(sequence);
+
+    // Seqlock write: readers that see the slot change under them treat it as overwritten
+    slot->sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot->sourceTime = control.sourceTime;
+    slot->size = len;
+    slot->messageNumber = control.messageNumber;
+    slot->boundary = static_cast<int32_t>(control.boundary);
+    std::memcpy(reinterpret_cast<char *>(slot) + sizeof(SlotHeader), data, len);
+    slot->sequence.store(sequence + 1, std::memory_order_release);
+
+    m_header->writeSequence.store(sequence + 1, std::memory_order_release);
+    wakeReaders();
+    return true;
+}
+
+void SharedMemoryRing::close() {
+    if (!m_isWriter || m_header->closed.exchange(1) != 0) {
+        return;
+    }
+    wakeReaders();
+}
+
+void SharedMemoryRing::wakeReaders() {
+    m_header->wakeCounter.fetch_add(1);
+    // Only pay for the syscall when someone is actually asleep
+    if (m_header->waiters.load() == 0) {
+        return;
+    }
+#if defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&m_header->wakeCounter), FUTEX_WAKE, INT_MAX,
+            nullptr, nullptr, 0);
+#endif
+}
+
+uint64_t SharedMemoryRing::getWriteSequence() const {
+    return m_header->writeSequence.load(std::memory_order_acquire);
+}
+
+bool SharedMemoryRing::isClosed() const {
+    return m_header->closed.load(std::memory_order_acquire) != 0;
+}
+
+int SharedMemoryRing::read(uint64_t &cursor, char *buffer, int bufferSize, MessageControl &control,
+                           uint64_t &lost) {
+    lost = 0;
+    while (true) {
+        uint64_t writeSequence = getWriteSequence();
+        if (cursor >= writeSequence) {
+            return isClosed() && cursor >= getWriteSequence() ? STREAM_ERROR : 0;
+        }
+        // Skip whatever has already been overwritten, plus one slot the writer may be filling now
+        if (writeSequence - cursor >= m_slotCount) {
+            uint64_t oldest = writeSequence - m_slotCount + 1;
+            lost += oldest - cursor;
+            cursor = oldest;
+        }
+
+        SlotHeader *slot = slotAt(cursor);
+        if (slot->sequence.load(std::memory_order_acquire) != cursor + 1) {
+            // Overwritten between the two loads, look again from the new write position
+            lost += 1;
+            cursor += 1;
+            continue;
+        }
+        int size = std::min(slot->size, bufferSize);
+        if (size < 0) {
+            size = 0;
+        }
+        MessageControl copied;
+        copied.sourceTime = slot->sourceTime;
+        copied.messageNumber = slot->messageNumber;
+        copied.boundary = static_cast<MessageBoundary>(slot->boundary);
+        std::memcpy(buffer, reinterpret_cast<const char *>(slot) + sizeof(SlotHeader), size);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot->sequence.load(std::memory_order_relaxed) != cursor + 1) {
+            lost += 1;
+            cursor += 1;
+            continue;
+        }
+
+        control = copied;
+        cursor += 1;
+        return size;
+    }
+}
+
+bool SharedMemoryRing::waitForData(uint64_t cursor, std::chrono::milliseconds timeout) {
+    auto hasData = [this, cursor] {
+        return getWriteSequence() > cursor || isClosed();
+    };
+#if defined(__linux__)
+    m_header->waiters.fetch_add(1);
+    uint32_t wakeCounter = m_header->wakeCounter.load();
+    if (!hasData()) {
+        timespec relative{};
+        relative.tv_sec = static_cast<time_t>(timeout.count() / 1000);
+        relative.tv_nsec = static_cast<long>(timeout.count() % 1000) * 1000000;
+        // Returns at once if a publish bumped the counter since we read it
+        syscall(SYS_futex, reinterpret_cast<uint32_t *>(&m_header->wakeCounter), FUTEX_WAIT, wakeCounter,
+                &relative, nullptr, 0);
+    }
+    m_header->waiters.fetch_sub(1);
+    return hasData();
+#else
+    // No cross-process futex here, poll the write sequence at a short interval
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!hasData() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return hasData();
+#endif
+}
@@ -0,0 +1,103 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SHAREDMEMORYRING_H
+#define SHAREDMEMORYRING_H
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "StreamHandler.h"
+
+// Named, memory-mapped packet ring for consumers running on the same host.
+// One writer broadcasts to any number of readers, each keeping its own cursor. Readers never block
+// the writer: one that falls a whole ring behind skips ahead and is told how many packets it lost.
+class SharedMemoryRing {
+public:
+    ~SharedMemoryRing();
+
+    SharedMemoryRing(const SharedMemoryRing &) = delete;
+
+    SharedMemoryRing &operator=(const SharedMemoryRing &) = delete;
+
+    // Create the ring for writing, replacing a stale one of the same name. nullptr on failure.
+    static std::unique_ptr<SharedMemoryRing> create(const std::string &name, uint32_t slotCount, uint32_t slotSize);
+
+    // Attach to an existing ring for reading, nullptr if it doesn't exist or has another layout
+    static std::unique_ptr<SharedMemoryRing> attach(const std::string &name);
+
+    // Platform object name for a stream, e.g. "/dl_srt_live" on POSIX or "Local\dl_srt_live" on Windows
+    static std::string objectName(const std::string &prefix, const std::string &streamId);
+
+    // Writer side, returns false if the packet doesn't fit a slot
+    bool publish(const char *data, int len, const MessageControl &control);
+
+    // Mark the ring closed and wake every reader
+    void close();
+
+    // Reader side. Copies the packet at cursor and advances it, returns 0 when nothing new has been
+    // published and STREAM_ERROR once the writer has closed and the reader has caught up.
+    int read(uint64_t &cursor, char *buffer, int bufferSize, MessageControl &control, uint64_t &lost);
+
+    // Block until a packet past cursor is published, the ring is closed or the timeout elapses
+    bool waitForData(uint64_t cursor, std::chrono::milliseconds timeout);
+
+    // Cursor of the next packet to be published, readers start here to skip history
+    uint64_t getWriteSequence() const;
+
+    bool isClosed() const;
+
+    uint32_t getSlotCount() const { return m_slotCount; }
+    uint32_t getSlotSize() const { return m_slotSize; }
+
+private:
+    struct Header;
+    struct SlotHeader;
+
+    SharedMemoryRing(std::string name, bool isWriter);
+
+    bool map(size_t size, bool create);
+
+    SlotHeader *slotAt(uint64_t sequence) const;
+
+    void wakeReaders();
+
+    std::string m_name;
+    bool m_isWriter;
+
+    void *m_mapping = nullptr;
+    size_t m_mappingSize = 0;
+#if defined(_WIN32)
+    void *m_fileMapping = nullptr;
+#endif
+
+    Header *m_header = nullptr;
+    char *m_slots = nullptr;
+    uint32_t m_slotCount = 0;
+    uint32_t m_slotSize = 0;
+    size_t m_slotStride = 0;
+
+    // Writer only, the next sequence to publish
+    uint64_t m_nextSequence = 0;
+};
+
+
+#endif //SHAREDMEMORYRING_H
@@ -19,9 +19,45 @@
 
 #ifndef STREAMHANDLER_H
 #define STREAMHANDLER_H
+#include <chrono>
+#include <cstdint>
 #include <string>
 
+#include "StreamIdParams.h"
+
 static const int STREAM_ERROR = -1;
+// Returned by send() on a non-blocking sender whose transport can't take the message yet
+static const int STREAM_WOULD_BLOCK = -2;
+
+// Position of a payload within its message, same values as SRT's PB_* flags
+enum class MessageBoundary {
+    Subsequent = 0,
+    Last = 1,
+    First = 2,
+    Solo = 3,
+};
+
+// Per-message metadata carried from the publisher to every subscriber.
+// Times are in microseconds on the transport's clock.
+struct MessageControl {
+    // Time the publisher sent the message, 0 if unknown
+    int64_t sourceTime = 0;
+    // Time the message was handed to the server, 0 if unknown
+    int64_t receiveTime = 0;
+    int32_t messageNumber = -1;
+    MessageBoundary boundary = MessageBoundary::Solo;
+};
+
+// Transport statistics for the connection so far
+struct LinkStats {
+    double rttMs = 0.0;
+    int64_t packetsSent = 0;
+    int64_t packetsSendLost = 0;
+    int64_t packetsRetransmitted = 0;
+    int64_t packetsReceived = 0;
+    int64_t packetsReceiveLost = 0;
+    int sendBufferMs = 0;
+};
 
 class StreamHandler {
 public:
@@ -29,15 +65,36 @@ public:
 
     virtual bool disconnect() = 0;
 
-    virtual int receive(char *buffer, int len) = 0;
+    virtual int receive(char *buffer, int len, MessageControl &control) = 0;
 
-    virtual int send(const char *buffer, int len) = 0;
+    // Sending with the received control forwards the original source time
+    virtual int send(const char *buffer, int len, const MessageControl &control) = 0;
 
     virtual bool isConnected() const = 0;
 
     virtual std::string getStreamId() const = 0;
 
+    virtual const StreamIdParams &getStreamParams() const = 0;
+
+    // Hint the transport about the expected send rate so it can shape its own output
+    virtual void setBandwidthHints(int64_t inputBytesPerSecond, int overheadPercent) = 0;
+
+    // From then on send() returns STREAM_WOULD_BLOCK instead of waiting for buffer space, for
+    // senders that serve many connections from one thread. A no-op for transports that never block.
+    virtual void setNonBlockingSend() {
+    }
+
     virtual std::string getLastErrorMessage() const = 0;
+
+    virtual int getLastErrorCode() const = 0;
+
+    // Remote address as "ip:port", empty if unknown
+    virtual std::string getPeerAddress() const = 0;
+
+    virtual bool getLinkStats(LinkStats &stats) const = 0;
+
+    // When the connection was accepted, default for sources that weren't; start of its startup latency
+    virtual std::chrono::steady_clock::time_point getAcceptedAt() const { return {}; }
 };
 
 
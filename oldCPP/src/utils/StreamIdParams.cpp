@@ -0,0 +1,83 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "StreamIdParams.h"
+
+#include <stdexcept>
+
+namespace {
+    const std::string ACCESS_CONTROL_PREFIX = "#!::";
+}
+
+StreamIdParams StreamIdParams::parse(const std::string &rawStreamId) {
+    StreamIdParams params;
+
+    if (rawStreamId.compare(0, ACCESS_CONTROL_PREFIX.size(), ACCESS_CONTROL_PREFIX) != 0) {
+        params.m_resource = rawStreamId;
+        return params;
+    }
+
+    size_t position = ACCESS_CONTROL_PREFIX.size();
+    while (position < rawStreamId.size()) {
+        size_t end = rawStreamId.find(',', position);
+        if (end == std::string::npos) {
+            end = rawStreamId.size();
+        }
+
+        std::string pair = rawStreamId.substr(position, end - position);
+        size_t separator = pair.find('=');
+        if (separator != std::string::npos && separator > 0) {
+            params.m_values[pair.substr(0, separator)] = pair.substr(separator + 1);
+        }
+        position = end + 1;
+    }
+
+    params.m_resource = params.get("r");
+    return params;
+}
+
+bool StreamIdParams::has(const std::string &key) const {
+    return m_values.find(key) != m_values.end();
+}
+
+std::string StreamIdParams::get(const std::string &key, const std::string &defaultValue) const {
+    auto it = m_values.find(key);
+    return it != m_values.end() ? it->second : defaultValue;
+}
+
+bool StreamIdParams::getBool(const std::string &key, bool defaultValue) const {
+    auto it = m_values.find(key);
+    if (it == m_values.end()) {
+        return defaultValue;
+    }
+    const std::string &value = it->second;
+    return value == "1" || value == "true" || value == "yes" || value == "on";
+}
+
+int StreamIdParams::getInt(const std::string &key, int defaultValue) const {
+    auto it = m_values.find(key);
+    if (it == m_values.end()) {
+        return defaultValue;
+    }
+    try {
+        return std::stoi(it->second);
+    } catch (const std::exception &) {
+        return defaultValue;
+    }
+}
@@ -0,0 +1,52 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef STREAMIDPARAMS_H
+#define STREAMIDPARAMS_H
+
+#include <string>
+#include <unordered_map>
+
+// Parsed form of an SRT stream ID.
+// Plain stream IDs ("my-stream") are used as the resource name as-is. IDs using the
+// SRT access control syntax ("#!::r=my-stream,pace=1") are split into the resource
+// name and the remaining key/value parameters.
+class StreamIdParams {
+public:
+    StreamIdParams() = default;
+
+    static StreamIdParams parse(const std::string &rawStreamId);
+
+    const std::string &getResource() const { return m_resource; }
+
+    bool has(const std::string &key) const;
+
+    std::string get(const std::string &key, const std::string &defaultValue = "") const;
+
+    bool getBool(const std::string &key, bool defaultValue) const;
+
+    int getInt(const std::string &key, int defaultValue) const;
+
+private:
+    std::string m_resource;
+    std::unordered_map<std::string, std::string> m_values;
+};
+
+
+#endif //STREAMIDPARAMS_H
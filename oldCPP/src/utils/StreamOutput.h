@@ -0,0 +1,47 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef STREAMOUTPUT_H
+#define STREAMOUTPUT_H
+
+#include <string>
+
+#include "StreamHandler.h"
+
+// Destination a session fans every packet into next to its SRT subscribers, e.g. a local consumer
+class StreamOutput {
+public:
+    virtual ~StreamOutput() = default;
+
+    // Returns false once the output can't take more data, the session then drops it
+    virtual bool write(const char *data, int len, const MessageControl &control) = 0;
+
+    virtual void close() = 0;
+
+    virtual std::string getName() const = 0;
+
+    // Packets the output holds right now, counted against the session's budget
+    virtual size_t getBufferedBytes() const { return 0; }
+
+    // Memory the output reserved up front, reported but not budgeted: it doesn't grow with load
+    virtual size_t getReservedBytes() const { return 0; }
+};
+
+
+#endif //STREAMOUTPUT_H
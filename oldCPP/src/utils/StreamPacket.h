@@ -0,0 +1,39 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef STREAMPACKET_H
+#define STREAMPACKET_H
+
+#include <chrono>
+#include <vector>
+
+#include "StreamHandler.h"
+
+// A single payload received from a publisher. Packets are shared (read-only) between
+// every output that still has to send them, so they are never copied per subscriber.
+struct StreamPacket {
+    std::vector<char> data;
+    std::chrono::steady_clock::time_point receivedAt;
+    MessageControl control;
+
+    int size() const { return static_cast<int>(data.size()); }
+};
+
+
+#endif //STREAMPACKET_H
@@ -0,0 +1,69 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "ThreadCpuClock.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <time.h>
+#endif
+
+ThreadCpuClock ThreadCpuClock::forCurrentThread() {
+    ThreadCpuClock clock;
+#if defined(_WIN32)
+    HANDLE thread = OpenThread(THREAD_QUERY_LIMITED_INFORMATION, FALSE, GetCurrentThreadId());
+    if (thread) {
+        clock.m_thread = std::shared_ptr<void>(thread, CloseHandle);
+        clock.m_valid = true;
+    }
+#elif defined(__linux__)
+    clockid_t clockId;
+    if (pthread_getcpuclockid(pthread_self(), &clockId) == 0) {
+        clock.m_clock = static_cast<int64_t>(clockId);
+        clock.m_valid = true;
+    }
+#endif
+    return clock;
+}
+
+int64_t ThreadCpuClock::cpuMicros() const {
+    if (!m_valid) {
+        return 0;
+    }
+#if defined(_WIN32)
+    FILETIME creation, exit, kernel, user;
+    if (!GetThreadTimes(m_thread.get(), &creation, &exit, &kernel, &user)) {
+        return 0;
+    }
+    auto toMicros = [](const FILETIME &time) {
+        return static_cast<int64_t>((static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime) / 10;
+    };
+    return toMicros(kernel) + toMicros(user);
+#elif defined(__linux__)
+    timespec time{};
+    if (clock_gettime(static_cast<clockid_t>(m_clock), &time) != 0) {
+        return 0;
+    }
+    return static_cast<int64_t>(time.tv_sec) * 1000000 + time.tv_nsec / 1000;
+#else
+    return 0;
+#endif
+}
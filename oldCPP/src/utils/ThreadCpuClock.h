@@ -0,0 +1,49 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef THREADCPUCLOCK_H
+#define THREADCPUCLOCK_H
+
+#include <cstdint>
+#include <memory>
+
+// CPU time consumed by one thread, readable from any thread while it runs.
+// Unsupported platforms and exited threads read as 0.
+class ThreadCpuClock {
+public:
+    ThreadCpuClock() = default;
+
+    static ThreadCpuClock forCurrentThread();
+
+    int64_t cpuMicros() const;
+
+    bool isValid() const { return m_valid; }
+
+private:
+    bool m_valid = false;
+#if defined(_WIN32)
+    std::shared_ptr<void> m_thread;
+#else
+    // clockid_t, kept as an integer so the header stays free of platform includes
+    int64_t m_clock = 0;
+#endif
+};
+
+
+#endif //THREADCPUCLOCK_H
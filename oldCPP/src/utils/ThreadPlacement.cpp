@@ -0,0 +1,198 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "ThreadPlacement.h"
+
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <arpa/inet.h>
+#include <ifaddrs.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/stat.h>
+#endif
+
+CpuSet ThreadPlacement::parseCpuList(const std::string &cpuList) {
+    CpuSet cpus;
+    std::stringstream stream(cpuList);
+    std::string range;
+
+    while (std::getline(stream, range, ',')) {
+        try {
+            size_t dash = range.find('-');
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int cpu = first; cpu <= last && cpu >= 0; ++cpu) {
+                cpus.push_back(cpu);
+            }
+        } catch (const std::exception &) {
+            // Skip malformed entries
+        }
+    }
+    return cpus;
+}
+
+std::string ThreadPlacement::formatCpuList(const CpuSet &cpus) {
+    std::ostringstream out;
+    for (size_t i = 0; i < cpus.size(); ++i) {
+        out << (i ? "," : "") << cpus[i];
+    }
+    return out.str();
+}
+
+bool ThreadPlacement::pinCurrentThread(const CpuSet &cpus) {
+    if (cpus.empty()) {
+        return false;
+    }
+#if defined(_WIN32)
+    DWORD_PTR mask = 0;
+    for (int cpu: cpus) {
+        if (cpu < static_cast<int>(sizeof(DWORD_PTR) * 8)) {
+            mask |= static_cast<DWORD_PTR>(1) << cpu;
+        }
+    }
+    return mask != 0 && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#elif defined(__linux__)
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    for (int cpu: cpus) {
+        if (cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &cpuSet);
+        }
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) == 0;
+#else
+    return false;
+#endif
+}
+
+int ThreadPlacement::currentCpu() {
+#if defined(_WIN32)
+    return static_cast<int>(GetCurrentProcessorNumber());
+#elif defined(__linux__)
+    return sched_getcpu();
+#else
+    return -1;
+#endif
+}
+
+int ThreadPlacement::numaNodeOfCpu(int cpu) {
+#if defined(_WIN32)
+    UCHAR node = 0;
+    if (cpu < 0 || cpu > 255 || !GetNumaProcessorNode(static_cast<UCHAR>(cpu), &node)) {
+        return -1;
+    }
+    return node;
+#elif defined(__linux__)
+    // The kernel exposes the owning node as a "nodeN" entry in the CPU's sysfs directory
+    for (int node = 0; node < 64; ++node) {
+        std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/node" + std::to_string(node);
+        struct stat info{};
+        if (stat(path.c_str(), &info) == 0) {
+            return node;
+        }
+    }
+    return -1;
+#else
+    return -1;
+#endif
+}
+
+int ThreadPlacement::cpuCount() {
+    unsigned int count = std::thread::hardware_concurrency();
+    return count > 0 ? static_cast<int>(count) : 1;
+}
+
+CpuSet ThreadPlacement::cpusOfNumaNode(int node) {
+    if (node < 0) {
+        return CpuSet();
+    }
+#if defined(_WIN32)
+    GROUP_AFFINITY affinity{};
+    if (!GetNumaNodeProcessorMaskEx(static_cast<USHORT>(node), &affinity) || affinity.Group != 0) {
+        return CpuSet();
+    }
+    CpuSet cpus;
+    for (int cpu = 0; cpu < static_cast<int>(sizeof(KAFFINITY) * 8); ++cpu) {
+        if (affinity.Mask & (static_cast<KAFFINITY>(1) << cpu)) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+#elif defined(__linux__)
+    std::ifstream cpuList("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    std::string line;
+    if (!std::getline(cpuList, line)) {
+        return CpuSet();
+    }
+    return parseCpuList(line);
+#else
+    return CpuSet();
+#endif
+}
+
+int ThreadPlacement::numaNodeOfAddress(const std::string &ipAddress) {
+#if defined(__linux__)
+    ifaddrs *interfaces = nullptr;
+    if (getifaddrs(&interfaces) != 0) {
+        return -1;
+    }
+
+    // Find the interface carrying the address, then ask sysfs which node its device hangs off
+    std::string interfaceName;
+    char formatted[INET6_ADDRSTRLEN];
+    for (ifaddrs *entry = interfaces; entry != nullptr; entry = entry->ifa_next) {
+        if (entry->ifa_addr == nullptr) {
+            continue;
+        }
+        const void *raw = nullptr;
+        if (entry->ifa_addr->sa_family == AF_INET) {
+            raw = &reinterpret_cast<sockaddr_in *>(entry->ifa_addr)->sin_addr;
+        } else if (entry->ifa_addr->sa_family == AF_INET6) {
+            raw = &reinterpret_cast<sockaddr_in6 *>(entry->ifa_addr)->sin6_addr;
+        }
+        if (raw && inet_ntop(entry->ifa_addr->sa_family, raw, formatted, sizeof(formatted)) &&
+            ipAddress == formatted) {
+            interfaceName = entry->ifa_name;
+            break;
+        }
+    }
+    freeifaddrs(interfaces);
+    if (interfaceName.empty()) {
+        return -1;
+    }
+
+    std::ifstream numaNode("/sys/class/net/" + interfaceName + "/device/numa_node");
+    int node = -1;
+    if (!(numaNode >> node)) {
+        return -1;
+    }
+    return node;
+#else
+    // Windows has no simple mapping from an address to the NIC's node, leave it to explicit CPU lists
+    (void) ipAddress;
+    return -1;
+#endif
+}
@@ -0,0 +1,54 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef THREADPLACEMENT_H
+#define THREADPLACEMENT_H
+
+#include <string>
+#include <vector>
+
+using CpuSet = std::vector<int>;
+
+// Thin platform layer for pinning threads and querying CPU/NUMA topology.
+// Unsupported platforms report failure and leave scheduling to the OS.
+namespace ThreadPlacement {
+    // Parse a CPU list like "0-3,8,10-11"; invalid entries are skipped
+    CpuSet parseCpuList(const std::string &cpuList);
+
+    std::string formatCpuList(const CpuSet &cpus);
+
+    bool pinCurrentThread(const CpuSet &cpus);
+
+    // CPU the calling thread is currently running on, -1 if unknown
+    int currentCpu();
+
+    // NUMA node owning the CPU, -1 if unknown
+    int numaNodeOfCpu(int cpu);
+
+    int cpuCount();
+
+    // CPUs belonging to a NUMA node, empty if unknown
+    CpuSet cpusOfNumaNode(int node);
+
+    // NUMA node of the NIC that owns a local IP address, -1 if unknown or not a single NIC
+    int numaNodeOfAddress(const std::string &ipAddress);
+}
+
+
+#endif //THREADPLACEMENT_H
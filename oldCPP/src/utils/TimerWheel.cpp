@@ -0,0 +1,272 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "TimerWheel.h"
+
+#include <algorithm>
+
+namespace {
+    uint32_t indexOf(TimerWheel::TimerId id) {
+        return static_cast<uint32_t>(id & 0xffffffff);
+    }
+
+    uint32_t generationOf(TimerWheel::TimerId id) {
+        return static_cast<uint32_t>(id >> 32);
+    }
+}
+
+TimerWheel::TimerWheel(std::chrono::milliseconds tick)
+    : m_tick(std::max(tick, std::chrono::milliseconds(1))),
+      m_start(std::chrono::steady_clock::now()) {
+    m_slots.fill(NONE);
+}
+
+TimerWheel::~TimerWheel() {
+    stop();
+}
+
+uint64_t TimerWheel::ticksFor(std::chrono::steady_clock::duration duration) const {
+    if (duration <= std::chrono::steady_clock::duration::zero()) {
+        return 0;
+    }
+    // Round up so a timer never fires before its delay has passed
+    return static_cast<uint64_t>((duration + m_tick - std::chrono::nanoseconds(1)) / m_tick);
+}
+
+TimerWheel::TimerId TimerWheel::schedule(std::chrono::steady_clock::duration delay, Callback callback) {
+    return add(delay, 0, std::move(callback));
+}
+
+TimerWheel::TimerId TimerWheel::scheduleRepeating(std::chrono::steady_clock::duration interval, Callback callback) {
+    return add(interval, std::max<uint64_t>(ticksFor(interval), 1), std::move(callback));
+}
+
+TimerWheel::TimerId TimerWheel::add(std::chrono::steady_clock::duration delay, uint64_t intervalTicks,
+                                    Callback callback) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_stopped) {
+        return INVALID_TIMER;
+    }
+
+    int32_t index;
+    if (!m_freeNodes.empty()) {
+        index = m_freeNodes.back();
+        m_freeNodes.pop_back();
+    } else {
+        index = static_cast<int32_t>(m_nodes.size());
+        m_nodes.emplace_back();
+    }
+
+    // Due at the first tick boundary after now + delay
+    auto now = std::chrono::steady_clock::now();
+    uint64_t nowTick = ticksFor(now - m_start);
+    if (m_activeTimers == 0) {
+        // An empty wheel has nothing to cascade, skip the ticks that passed while it was idle
+        m_nextTick = std::max(m_nextTick, nowTick);
+    }
+    Node &node = m_nodes[index];
+    node.callback = std::move(callback);
+    node.intervalTicks = intervalTicks;
+    node.expiryTick = std::max(nowTick + ticksFor(delay), m_nextTick);
+    link(index);
+    ++m_activeTimers;
+
+    if (!m_running.exchange(true)) {
+        m_timerThread = std::make_unique<std::thread>(&TimerWheel::timerThread, this);
+    }
+    m_timerCV.notify_one();
+    return (static_cast<uint64_t>(node.generation) << 32) | static_cast<uint32_t>(index);
+}
+
+bool TimerWheel::cancel(TimerId id) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint32_t index = indexOf(id);
+    if (index >= m_nodes.size()) {
+        return false;
+    }
+    Node &node = m_nodes[index];
+    if (node.generation != generationOf(id) || node.slot == NONE) {
+        return false;
+    }
+    unlink(static_cast<int32_t>(index));
+    release(static_cast<int32_t>(index));
+    --m_activeTimers;
+    return true;
+}
+
+void TimerWheel::link(int32_t index) {
+    Node &node = m_nodes[index];
+    uint64_t expiry = std::max(node.expiryTick, m_nextTick);
+    uint64_t delta = expiry - m_nextTick;
+
+    // Pick the finest level whose span still covers the delay
+    int level = 0;
+    while (level < LEVELS - 1 && delta >= (static_cast<uint64_t>(1) << (LEVEL_BITS * (level + 1)))) {
+        ++level;
+    }
+    if (level == LEVELS - 1 && delta >= (static_cast<uint64_t>(1) << (LEVEL_BITS * LEVELS))) {
+        // Beyond the wheel's range, park in the last slot and re-file when it cascades
+        expiry = m_nextTick + (static_cast<uint64_t>(1) << (LEVEL_BITS * LEVELS)) - 1;
+    }
+    int slot = level * SLOTS_PER_LEVEL + static_cast<int>((expiry >> (LEVEL_BITS * level)) & (SLOTS_PER_LEVEL - 1));
+
+    node.slot = slot;
+    node.prev = NONE;
+    node.next = m_slots[slot];
+    if (node.next != NONE) {
+        m_nodes[node.next].prev = index;
+    }
+    m_slots[slot] = index;
+}
+
+void TimerWheel::unlink(int32_t index) {
+    Node &node = m_nodes[index];
+    if (node.prev != NONE) {
+        m_nodes[node.prev].next = node.next;
+    } else {
+        m_slots[node.slot] = node.next;
+    }
+    if (node.next != NONE) {
+        m_nodes[node.next].prev = node.prev;
+    }
+    node.slot = NONE;
+    node.prev = NONE;
+    node.next = NONE;
+}
+
+void TimerWheel::release(int32_t index) {
+    Node &node = m_nodes[index];
+    node.callback = nullptr;
+    // Old ids stop matching, so a late cancel can't hit the node's next timer
+    ++node.generation;
+    m_freeNodes.push_back(index);
+}
+
+void TimerWheel::cascade(int level) {
+    int slot = level * SLOTS_PER_LEVEL +
+               static_cast<int>((m_nextTick >> (LEVEL_BITS * level)) & (SLOTS_PER_LEVEL - 1));
+    int32_t index = m_slots[slot];
+    m_slots[slot] = NONE;
+    while (index != NONE) {
+        int32_t next = m_nodes[index].next;
+        link(index);
+        index = next;
+    }
+}
+
+void TimerWheel::advance(std::chrono::steady_clock::time_point now) {
+    uint64_t nowTick = static_cast<uint64_t>((now - m_start) / m_tick);
+    std::vector<DueTimer> due;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (m_nextTick <= nowTick) {
+        // Entering a new lap of a level pulls the next slot of the level above down into it
+        for (int level = 1; level < LEVELS; ++level) {
+            if ((m_nextTick & ((static_cast<uint64_t>(1) << (LEVEL_BITS * level)) - 1)) != 0) {
+                break;
+            }
+            cascade(level);
+        }
+
+        int slot = static_cast<int>(m_nextTick & (SLOTS_PER_LEVEL - 1));
+        int32_t index = m_slots[slot];
+        m_slots[slot] = NONE;
+        ++m_nextTick;
+
+        while (index != NONE) {
+            Node &node = m_nodes[index];
+            int32_t next = node.next;
+            node.slot = NONE;
+            if (node.intervalTicks > 0) {
+                due.push_back(DueTimer{node.callback, node.expiryTick});
+                // Skip missed periods rather than firing them back to back
+                node.expiryTick = std::max(node.expiryTick + node.intervalTicks, m_nextTick);
+                link(index);
+            } else {
+                due.push_back(DueTimer{std::move(node.callback), node.expiryTick});
+                release(index);
+                --m_activeTimers;
+            }
+            index = next;
+        }
+    }
+    if (due.empty()) {
+        return;
+    }
+
+    m_firedTimers += due.size();
+    for (const auto &timer: due) {
+        auto dueAt = m_start + m_tick * timer.expiryTick;
+        m_lateness.record(std::chrono::duration_cast<std::chrono::microseconds>(now - dueAt).count());
+    }
+    lock.unlock();
+
+    for (auto &timer: due) {
+        timer.callback();
+    }
+}
+
+void TimerWheel::stop() {
+    std::unique_ptr<std::thread> timerThread; {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopped = true;
+        m_running = false;
+        timerThread = std::move(m_timerThread);
+        m_timerCV.notify_all();
+    }
+    if (timerThread && timerThread->joinable() && timerThread->get_id() != std::this_thread::get_id()) {
+        timerThread->join();
+    } else if (timerThread && timerThread->joinable()) {
+        timerThread->detach();
+    }
+}
+
+TimerWheelStats TimerWheel::getStats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    TimerWheelStats stats;
+    stats.activeTimers = m_activeTimers;
+    stats.firedTimers = m_firedTimers;
+    stats.averageLatenessMicros = m_lateness.getAverage();
+    stats.maxLatenessMicros = m_lateness.getMax();
+    return stats;
+}
+
+void TimerWheel::resetLatenessStats() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_lateness.reset();
+}
+
+void TimerWheel::timerThread() {
+    while (m_running.load(std::memory_order_acquire)) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            // Nothing to turn the wheel for, sleep until a timer is added
+            m_timerCV.wait(lock, [this] {
+                return m_activeTimers > 0 || !m_running.load(std::memory_order_acquire);
+            });
+            if (!m_running.load(std::memory_order_acquire)) {
+                break;
+            }
+            m_timerCV.wait_until(lock, m_start + m_tick * m_nextTick, [this] {
+                return !m_running.load(std::memory_order_acquire);
+            });
+        }
+        advance(std::chrono::steady_clock::now());
+    }
+}
@@ -0,0 +1,139 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "LatencyStats.h"
+
+struct TimerWheelStats {
+    size_t activeTimers = 0;
+    uint64_t firedTimers = 0;
+    // How late timers fired compared to their due time, since the last reset
+    int64_t averageLatenessMicros = 0;
+    int64_t maxLatenessMicros = 0;
+};
+
+// Hierarchical timer wheel: four levels of 256 slots, each level a 256x coarser tick than the one
+// below. Scheduling and cancelling are O(1); timers far in the future cascade down a level as the
+// wheel turns. One thread drives every timer, callbacks run on it without the wheel locked, so they
+// may schedule or cancel timers themselves but should hand long work elsewhere.
+class TimerWheel {
+public:
+    using TimerId = uint64_t;
+    using Callback = std::function<void()>;
+
+    static constexpr TimerId INVALID_TIMER = 0;
+
+    // Timers fire at tick granularity, never early
+    explicit TimerWheel(std::chrono::milliseconds tick = std::chrono::milliseconds(10));
+
+    ~TimerWheel();
+
+    TimerWheel(const TimerWheel &) = delete;
+
+    TimerWheel &operator=(const TimerWheel &) = delete;
+
+    // The timer thread starts with the first timer, like the pacer thread
+    TimerId schedule(std::chrono::steady_clock::duration delay, Callback callback);
+
+    TimerId scheduleRepeating(std::chrono::steady_clock::duration interval, Callback callback);
+
+    // Returns false if the timer already fired (one-shot), was cancelled or is unknown
+    bool cancel(TimerId id);
+
+    // Fire everything due at or before now. Called by the timer thread; tests can drive it directly.
+    void advance(std::chrono::steady_clock::time_point now);
+
+    void stop();
+
+    TimerWheelStats getStats() const;
+
+    void resetLatenessStats();
+
+    std::chrono::milliseconds getTick() const { return m_tick; }
+
+private:
+    static constexpr int LEVEL_BITS = 8;
+    static constexpr int SLOTS_PER_LEVEL = 1 << LEVEL_BITS;
+    static constexpr int LEVELS = 4;
+    static constexpr int32_t NONE = -1;
+
+    struct Node {
+        Callback callback;
+        uint64_t expiryTick = 0;
+        uint64_t intervalTicks = 0;
+        uint32_t generation = 1;
+        int32_t slot = NONE;
+        int32_t prev = NONE;
+        int32_t next = NONE;
+    };
+
+    struct DueTimer {
+        Callback callback;
+        uint64_t expiryTick;
+    };
+
+    TimerId add(std::chrono::steady_clock::duration delay, uint64_t intervalTicks, Callback callback);
+
+    uint64_t ticksFor(std::chrono::steady_clock::duration duration) const;
+
+    // Slot list helpers, all called with m_mutex held
+    void link(int32_t index);
+
+    void unlink(int32_t index);
+
+    void release(int32_t index);
+
+    void cascade(int level);
+
+    void timerThread();
+
+    const std::chrono::milliseconds m_tick;
+    const std::chrono::steady_clock::time_point m_start;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_timerCV;
+    std::vector<Node> m_nodes;
+    std::vector<int32_t> m_freeNodes;
+    std::array<int32_t, LEVELS * SLOTS_PER_LEVEL> m_slots;
+    // Next tick to be processed, ticks count from m_start
+    uint64_t m_nextTick = 0;
+    size_t m_activeTimers = 0;
+    uint64_t m_firedTimers = 0;
+    LatencyStats m_lateness;
+
+    std::atomic<bool> m_running{false};
+    bool m_stopped = false;
+    std::unique_ptr<std::thread> m_timerThread;
+};
+
+
+#endif //TIMERWHEEL_H
@@ -0,0 +1,155 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "UdpOutput.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Logger.h"
+
+namespace {
+    constexpr size_t MAX_BATCH = 64;
+}
+
+UdpOutput::UdpOutput(std::string streamId, std::string destination, size_t maxQueuedPackets)
+    : m_streamId(std::move(streamId)),
+      m_destination(std::move(destination)),
+      m_slots(std::max<size_t>(maxQueuedPackets, 1) * MAX_DATAGRAM_SIZE),
+      m_sizes(std::max<size_t>(maxQueuedPackets, 1)) {
+}
+
+UdpOutput::~UdpOutput() {
+    close();
+}
+
+std::shared_ptr<UdpOutput> UdpOutput::create(const std::string &streamId, const std::string &destination,
+                                             const UdpOutputSettings &settings) {
+    std::shared_ptr<UdpOutput> output(new UdpOutput(streamId, destination, settings.maxQueuedPackets));
+    if (!output->m_socket.connect(destination)) {
+        LOG_ERROR("Failed to open UDP output", LogFields().stream(streamId)
+                  .with(destination + ": " + output->m_socket.getLastErrorMessage()));
+        return nullptr;
+    }
+    if (UdpSocket::isMulticastAddress(destination) &&
+        !output->m_socket.setMulticastOptions(settings.multicastTtl, settings.multicastLoopback,
+                                              settings.multicastInterface)) {
+        LOG_WARNING("Failed to set multicast options", LogFields().stream(streamId)
+                    .with(destination + ": " + output->m_socket.getLastErrorMessage()));
+    }
+
+    output->m_running = true;
+    output->m_senderThread = std::make_unique<std::thread>(&UdpOutput::senderThread, output.get());
+    LOG_INFO("Sending stream to UDP output", LogFields().stream(streamId).with(destination));
+    return output;
+}
+
+bool UdpOutput::write(const char *data, int len, const MessageControl &) {
+    if (!m_running.load(std::memory_order_acquire)) {
+        return false;
+    }
+    if (len <= 0 || len > MAX_DATAGRAM_SIZE) {
+        m_droppedPackets.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    bool queued;
+    bool firstDrop = false; {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        // UDP receivers cope with loss, so a stalled sender costs packets rather than the output
+        queued = m_head - m_tail < m_sizes.size();
+        if (queued) {
+            size_t slot = m_head % m_sizes.size();
+            std::memcpy(&m_slots[slot * MAX_DATAGRAM_SIZE], data, len);
+            m_sizes[slot] = len;
+            ++m_head;
+        } else {
+            m_droppedPackets.fetch_add(1, std::memory_order_relaxed);
+            firstDrop = !m_dropping;
+        }
+        m_dropping = !queued;
+    }
+    if (queued) {
+        m_queueCV.notify_one();
+    } else if (firstDrop) {
+        // Once per run of drops, a log line per packet would slow the publisher thread further
+        LOG_WARNING("UDP output queue full, dropping packets", LogFields().stream(m_streamId).with(m_destination));
+    }
+    return true;
+}
+
+void UdpOutput::close() {
+    std::unique_ptr<std::thread> senderThread; {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        if (!m_running.exchange(false)) {
+            return;
+        }
+        senderThread = std::move(m_senderThread);
+        m_queueCV.notify_all();
+    }
+    if (senderThread && senderThread->joinable()) {
+        senderThread->join();
+    }
+    m_socket.close();
+}
+
+size_t UdpOutput::getBufferedBytes() const {
+    std::lock_guard<std::mutex> lock(m_queueMutex);
+    size_t bytes = 0;
+    for (uint64_t i = m_tail; i != m_head; ++i) {
+        bytes += static_cast<size_t>(m_sizes[i % m_sizes.size()]);
+    }
+    return bytes;
+}
+
+void UdpOutput::senderThread() {
+    UdpDatagram datagrams[MAX_BATCH];
+
+    while (true) {
+        uint64_t first;
+        size_t count; {
+            std::unique_lock<std::mutex> lock(m_queueMutex);
+            m_queueCV.wait(lock, [this] {
+                return m_head != m_tail || !m_running.load(std::memory_order_acquire);
+            });
+            if (!m_running.load(std::memory_order_acquire)) {
+                break;
+            }
+            first = m_tail;
+            count = std::min<size_t>(m_head - m_tail, MAX_BATCH);
+        }
+
+        // Slots between tail and head are only rewritten after the tail moves past them
+        for (size_t i = 0; i < count; ++i) {
+            size_t slot = (first + i) % m_sizes.size();
+            datagrams[i] = UdpDatagram{&m_slots[slot * MAX_DATAGRAM_SIZE], m_sizes[slot]};
+        }
+        int sent = m_socket.sendBatch(datagrams, static_cast<int>(count));
+        if (sent <= 0) {
+            // Unicast receivers that went away show up as send errors, keep going for when they return
+            LOG_WARNING("Failed to send to UDP output", LogFields().stream(m_streamId)
+                        .with(m_destination + ": " + m_socket.getLastErrorMessage()));
+            m_droppedPackets.fetch_add(count, std::memory_order_relaxed);
+            sent = static_cast<int>(count);
+        }
+
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        m_tail += sent;
+    }
+}
@@ -0,0 +1,101 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef UDPOUTPUT_H
+#define UDPOUTPUT_H
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "StreamOutput.h"
+#include "UdpSocket.h"
+
+struct UdpOutputSettings {
+    // Stream ID to "host:port" destination, unicast or multicast
+    std::unordered_map<std::string, std::string> destinations;
+    // 1 keeps multicast on the local segment
+    int multicastTtl = 1;
+    // Whether this host also receives our multicast, needed by local probes
+    bool multicastLoopback = false;
+    // Outgoing IPv4 interface for multicast, empty uses the routing table
+    std::string multicastInterface;
+    // Packets waiting for the sender thread, more than this are dropped
+    size_t maxQueuedPackets = 1024;
+};
+
+// Session output that re-sends the stream as plain UDP, so one send serves every receiver of a
+// multicast group. Packets are handed to a sender thread that flushes whatever has queued up in
+// one batched send, the publisher thread only pays for a copy.
+class UdpOutput : public StreamOutput {
+public:
+    // nullptr if the destination can't be opened
+    static std::shared_ptr<UdpOutput> create(const std::string &streamId, const std::string &destination,
+                                             const UdpOutputSettings &settings);
+
+    ~UdpOutput() override;
+
+    bool write(const char *data, int len, const MessageControl &control) override;
+
+    void close() override;
+
+    std::string getName() const override { return "udp://" + m_destination; }
+
+    uint64_t getDroppedPackets() const { return m_droppedPackets.load(std::memory_order_relaxed); }
+
+    // Datagrams queued for the sender thread
+    size_t getBufferedBytes() const override;
+
+    // The slot queue is allocated up front
+    size_t getReservedBytes() const override { return m_slots.size(); }
+
+private:
+    UdpOutput(std::string streamId, std::string destination, size_t maxQueuedPackets);
+
+    void senderThread();
+
+    // Largest datagram we forward, SRT live payloads are at most 1456 bytes
+    static constexpr int MAX_DATAGRAM_SIZE = 1500;
+
+    std::string m_streamId;
+    std::string m_destination;
+    UdpSocket m_socket;
+
+    // Fixed slots written by the publisher at m_head and sent by the sender thread from m_tail
+    mutable std::mutex m_queueMutex;
+    std::condition_variable m_queueCV;
+    std::vector<char> m_slots;
+    std::vector<int> m_sizes;
+    uint64_t m_head = 0;
+    uint64_t m_tail = 0;
+    // Set by the first drop of a full queue, cleared once a packet is queued again
+    bool m_dropping = false;
+
+    std::atomic<bool> m_running{false};
+    std::atomic<uint64_t> m_droppedPackets{0};
+    std::unique_ptr<std::thread> m_senderThread;
+};
+
+
+#endif //UDPOUTPUT_H
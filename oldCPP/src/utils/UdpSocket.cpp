@@ -0,0 +1,285 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "UdpSocket.h"
+
+#include <cstring>
+
+#include "NetworkAddress.h"
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <mutex>
+using NativeSocket = SOCKET;
+#else
+#include <arpa/inet.h>
+#include <cerrno>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+using NativeSocket = int;
+#endif
+
+namespace {
+    // Largest batch handed to one sendmmsg call
+    constexpr int MAX_BATCH = 64;
+
+    NativeSocket native(intptr_t socket) {
+        return static_cast<NativeSocket>(socket);
+    }
+
+    int lastSocketError() {
+#if defined(_WIN32)
+        return WSAGetLastError();
+#else
+        return errno;
+#endif
+    }
+}
+
+UdpSocket::~UdpSocket() {
+    close();
+}
+
+bool UdpSocket::isMulticastAddress(const std::string &address) {
+    sockaddr_storage resolved{};
+    int length = 0;
+    return NetworkAddress::resolve(address, false, resolved, length) && NetworkAddress::isMulticast(resolved);
+}
+
+bool UdpSocket::isOpen() const {
+    return m_socket != -1;
+}
+
+void UdpSocket::close() {
+    if (!isOpen()) {
+        return;
+    }
+#if defined(_WIN32)
+    closesocket(native(m_socket));
+#else
+    ::close(native(m_socket));
+#endif
+    m_socket = -1;
+}
+
+void UdpSocket::setLastError(const std::string &operation) {
+    m_lastErrorMessage = operation + " failed, error " + std::to_string(lastSocketError());
+}
+
+bool UdpSocket::open(const std::string &address, bool forSending) {
+    close();
+#if defined(_WIN32)
+    static std::once_flag winsockStarted;
+    std::call_once(winsockStarted, [] {
+        WSADATA data;
+        WSAStartup(MAKEWORD(2, 2), &data);
+    });
+#endif
+
+    sockaddr_storage resolved{};
+    int length = 0;
+    if (!NetworkAddress::resolve(address, !forSending, resolved, length)) {
+        m_lastErrorMessage = "Invalid UDP address " + address;
+        return false;
+    }
+
+    NativeSocket socket = ::socket(resolved.ss_family, SOCK_DGRAM, IPPROTO_UDP);
+#if defined(_WIN32)
+    if (socket == INVALID_SOCKET) {
+#else
+    if (socket < 0) {
+#endif
+        setLastError("socket");
+        return false;
+    }
+    m_socket = static_cast<intptr_t>(socket);
+    m_family = resolved.ss_family;
+
+    if (forSending) {
+        // Connected UDP lets every datagram of a batch go out without its own address
+        if (::connect(socket, reinterpret_cast<sockaddr *>(&resolved), length) != 0) {
+            setLastError("connect");
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    int yes = 1;
+    setsockopt(socket, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&yes), sizeof(yes));
+
+    bool multicast = NetworkAddress::isMulticast(resolved);
+    sockaddr_storage bindAddress = resolved;
+    if (multicast && resolved.ss_family == AF_INET) {
+        // Bind the group's port on any address, the membership decides what arrives
+        reinterpret_cast<sockaddr_in *>(&bindAddress)->sin_addr.s_addr = htonl(INADDR_ANY);
+    } else if (multicast) {
+        reinterpret_cast<sockaddr_in6 *>(&bindAddress)->sin6_addr = in6addr_any;
+    }
+    if (::bind(socket, reinterpret_cast<sockaddr *>(&bindAddress), length) != 0) {
+        setLastError("bind");
+        close();
+        return false;
+    }
+
+    if (multicast && resolved.ss_family == AF_INET) {
+        ip_mreq membership{};
+        membership.imr_multiaddr = reinterpret_cast<sockaddr_in *>(&resolved)->sin_addr;
+        membership.imr_interface.s_addr = htonl(INADDR_ANY);
+        if (setsockopt(socket, IPPROTO_IP, IP_ADD_MEMBERSHIP, reinterpret_cast<const char *>(&membership),
+                       sizeof(membership)) != 0) {
+            setLastError("IP_ADD_MEMBERSHIP");
+            close();
+            return false;
+        }
+    } else if (multicast) {
+        ipv6_mreq membership{};
+        membership.ipv6mr_multiaddr = reinterpret_cast<sockaddr_in6 *>(&resolved)->sin6_addr;
+        if (setsockopt(socket, IPPROTO_IPV6, IPV6_JOIN_GROUP, reinterpret_cast<const char *>(&membership),
+                       sizeof(membership)) != 0) {
+            setLastError("IPV6_JOIN_GROUP");
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool UdpSocket::connect(const std::string &address) {
+    return open(address, true);
+}
+
+bool UdpSocket::bind(const std::string &address) {
+    return open(address, false);
+}
+
+bool UdpSocket::setMulticastOptions(int ttl, bool loopback, const std::string &interfaceAddress) {
+    if (!isOpen()) {
+        return false;
+    }
+    NativeSocket socket = native(m_socket);
+    int loop = loopback ? 1 : 0;
+    if (m_family == AF_INET6) {
+        return setsockopt(socket, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, reinterpret_cast<const char *>(&ttl),
+                          sizeof(ttl)) == 0 &&
+               setsockopt(socket, IPPROTO_IPV6, IPV6_MULTICAST_LOOP, reinterpret_cast<const char *>(&loop),
+                          sizeof(loop)) == 0;
+    }
+
+#if defined(_WIN32)
+    DWORD ipv4Ttl = static_cast<DWORD>(ttl);
+    DWORD ipv4Loop = static_cast<DWORD>(loop);
+#else
+    unsigned char ipv4Ttl = static_cast<unsigned char>(ttl);
+    unsigned char ipv4Loop = static_cast<unsigned char>(loop);
+#endif
+    if (setsockopt(socket, IPPROTO_IP, IP_MULTICAST_TTL, reinterpret_cast<const char *>(&ipv4Ttl),
+                   sizeof(ipv4Ttl)) != 0 ||
+        setsockopt(socket, IPPROTO_IP, IP_MULTICAST_LOOP, reinterpret_cast<const char *>(&ipv4Loop),
+                   sizeof(ipv4Loop)) != 0) {
+        setLastError("multicast options");
+        return false;
+    }
+
+    if (!interfaceAddress.empty()) {
+        in_addr interfaceAddr{};
+        if (inet_pton(AF_INET, interfaceAddress.c_str(), &interfaceAddr) != 1 ||
+            setsockopt(socket, IPPROTO_IP, IP_MULTICAST_IF, reinterpret_cast<const char *>(&interfaceAddr),
+                       sizeof(interfaceAddr)) != 0) {
+            setLastError("IP_MULTICAST_IF");
+            return false;
+        }
+    }
+    return true;
+}
+
+int UdpSocket::sendBatch(const UdpDatagram *datagrams, int count) {
+    if (!isOpen()) {
+        return -1;
+    }
+    NativeSocket socket = native(m_socket);
+#if defined(__linux__)
+    mmsghdr messages[MAX_BATCH];
+    iovec vectors[MAX_BATCH];
+    int batch = count < MAX_BATCH ? count : MAX_BATCH;
+    for (int i = 0; i < batch; ++i) {
+        vectors[i].iov_base = const_cast<char *>(datagrams[i].data);
+        vectors[i].iov_len = static_cast<size_t>(datagrams[i].size);
+        std::memset(&messages[i], 0, sizeof(mmsghdr));
+        messages[i].msg_hdr.msg_iov = &vectors[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+    int sent = sendmmsg(socket, messages, static_cast<unsigned int>(batch), 0);
+    if (sent < 0) {
+        setLastError("sendmmsg");
+    }
+    return sent;
+#else
+    // No batched send on this platform, one call per datagram
+    int sent = 0;
+    for (; sent < count; ++sent) {
+        if (::send(socket, datagrams[sent].data, datagrams[sent].size, 0) < 0) {
+            setLastError("send");
+            return sent > 0 ? sent : -1;
+        }
+    }
+    return sent;
+#endif
+}
+
+int UdpSocket::receive(char *buffer, int bufferSize, std::chrono::milliseconds timeout) {
+    if (!isOpen()) {
+        return -1;
+    }
+    NativeSocket socket = native(m_socket);
+#if defined(_WIN32)
+    WSAPOLLFD poller{socket, POLLRDNORM, 0};
+    int ready = WSAPoll(&poller, 1, static_cast<int>(timeout.count()));
+#else
+    pollfd poller{socket, POLLIN, 0};
+    int ready = poll(&poller, 1, static_cast<int>(timeout.count()));
+#endif
+    if (ready <= 0) {
+        return ready == 0 ? 0 : -1;
+    }
+    int received = static_cast<int>(recv(socket, buffer, bufferSize, 0));
+    if (received < 0) {
+        setLastError("recv");
+    }
+    return received;
+}
+
+int UdpSocket::getLocalPort() const {
+    if (!isOpen()) {
+        return -1;
+    }
+    sockaddr_storage local{};
+    socklen_t length = sizeof(local);
+    if (getsockname(native(m_socket), reinterpret_cast<sockaddr *>(&local), &length) != 0) {
+        return -1;
+    }
+    if (local.ss_family == AF_INET6) {
+        return ntohs(reinterpret_cast<sockaddr_in6 *>(&local)->sin6_port);
+    }
+    return ntohs(reinterpret_cast<sockaddr_in *>(&local)->sin_port);
+}
@@ -0,0 +1,84 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef UDPSOCKET_H
+#define UDPSOCKET_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct UdpDatagram {
+    const char *data;
+    int size;
+};
+
+// Thin platform layer over a plain UDP socket, used for raw UDP and multicast outputs.
+// Addresses are "host:port", with IPv6 hosts in brackets: "[ff15::1]:5000".
+class UdpSocket {
+public:
+    UdpSocket() = default;
+
+    ~UdpSocket();
+
+    UdpSocket(const UdpSocket &) = delete;
+
+    UdpSocket &operator=(const UdpSocket &) = delete;
+
+    // Open a socket that sends every datagram to address
+    bool connect(const std::string &address);
+
+    // Open a socket that receives on address, joining the group if it is multicast
+    bool bind(const std::string &address);
+
+    // Multicast hop limit and whether our own host receives what we send. interfaceAddress picks
+    // the outgoing IPv4 interface, empty leaves it to the routing table.
+    bool setMulticastOptions(int ttl, bool loopback, const std::string &interfaceAddress);
+
+    // Send as many datagrams as possible in one call where the platform allows it (sendmmsg).
+    // Returns how many were handed to the kernel, -1 on error.
+    int sendBatch(const UdpDatagram *datagrams, int count);
+
+    // Returns bytes received, 0 on timeout, -1 on error
+    int receive(char *buffer, int bufferSize, std::chrono::milliseconds timeout);
+
+    // Port actually bound, useful after binding port 0
+    int getLocalPort() const;
+
+    bool isOpen() const;
+
+    void close();
+
+    std::string getLastErrorMessage() const { return m_lastErrorMessage; }
+
+    static bool isMulticastAddress(const std::string &address);
+
+private:
+    bool open(const std::string &address, bool forSending);
+
+    void setLastError(const std::string &operation);
+
+    intptr_t m_socket = -1;
+    int m_family = 0;
+    std::string m_lastErrorMessage;
+};
+
+
+#endif //UDPSOCKET_H
@@ -0,0 +1,178 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "WarmThreadPool.h"
+
+#include <algorithm>
+#include <numeric>
+
+#include "Logger.h"
+#include "ThreadPlacement.h"
+
+void PooledJob::wait() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_doneCV.wait(lock, [this] { return m_done; });
+}
+
+std::thread::id PooledJob::getThreadId() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_threadId;
+}
+
+WarmThreadPool::WarmThreadPool(PrewarmSettings settings)
+    : m_state(std::make_shared<State>()) {
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    m_state->settings = settings;
+    for (size_t i = 0; i < settings.sessionThreads; ++i) {
+        spawnLocked(m_state);
+    }
+}
+
+WarmThreadPool::~WarmThreadPool() {
+    std::list<Worker> workers; {
+        std::lock_guard<std::mutex> lock(m_state->mutex);
+        m_state->stopping = true;
+        m_state->workCV.notify_all();
+        workers.swap(m_state->workers);
+    }
+    for (auto &worker: workers) {
+        if (worker.thread.get_id() == std::this_thread::get_id()) {
+            worker.thread.detach();
+        } else {
+            worker.thread.join();
+        }
+    }
+}
+
+std::shared_ptr<PooledJob> WarmThreadPool::run(std::function<void()> job) {
+    auto handle = std::make_shared<PooledJob>();
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    reapLocked(*m_state);
+    m_state->jobs.emplace_back([job = std::move(job), handle] {
+        {
+            std::lock_guard<std::mutex> jobLock(handle->m_mutex);
+            handle->m_threadId = std::this_thread::get_id();
+        }
+        // Caught here, not on the worker thread, so the handle is done whatever the job does
+        try {
+            job();
+        } catch (const std::exception &e) {
+            LOG_ERROR("Pooled job failed", LogFields().with(e.what()));
+        } catch (...) {
+            LOG_ERROR("Pooled job failed");
+        }
+        std::lock_guard<std::mutex> jobLock(handle->m_mutex);
+        handle->m_done = true;
+        handle->m_doneCV.notify_all();
+    });
+    // Cold path, every thread is busy
+    if (m_state->idle < m_state->jobs.size()) {
+        spawnLocked(m_state);
+    }
+    m_state->workCV.notify_one();
+    return handle;
+}
+
+void WarmThreadPool::setSettings(PrewarmSettings settings) {
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    m_state->settings = settings;
+    if (m_state->idle < settings.sessionThreads) {
+        m_state->refills = settings.sessionThreads - m_state->idle;
+        m_state->workCV.notify_all();
+    }
+}
+
+size_t WarmThreadPool::getIdleCount() const {
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    return m_state->idle;
+}
+
+size_t WarmThreadPool::getThreadCount() const {
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    reapLocked(*m_state);
+    return m_state->workers.size();
+}
+
+void WarmThreadPool::spawnLocked(const std::shared_ptr<State> &state) {
+    state->workers.emplace_back();
+    auto worker = std::prev(state->workers.end());
+    ++state->idle;
+    worker->thread = std::thread(&WarmThreadPool::workerThread, state, worker);
+}
+
+void WarmThreadPool::reapLocked(State &state) {
+    for (auto it = state.workers.begin(); it != state.workers.end();) {
+        if (!it->exited) {
+            ++it;
+            continue;
+        }
+        // Marked just before returning, so the join is short
+        it->thread.join();
+        it = state.workers.erase(it);
+    }
+}
+
+void WarmThreadPool::workerThread(std::shared_ptr<State> state, std::list<Worker>::iterator worker) {
+    CpuSet allCpus(static_cast<size_t>(std::max(ThreadPlacement::cpuCount(), 0)));
+    std::iota(allCpus.begin(), allCpus.end(), 0);
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    while (true) {
+        state->workCV.wait(lock, [&state] {
+            return state->stopping || !state->jobs.empty() || state->refills > 0;
+        });
+        if (state->jobs.empty() && state->refills > 0 && !state->stopping) {
+            --state->refills;
+            if (state->idle < state->settings.sessionThreads) {
+                spawnLocked(state);
+            }
+            continue;
+        }
+        if (state->jobs.empty()) {
+            break;
+        }
+
+        auto job = std::move(state->jobs.front());
+        state->jobs.pop_front();
+        --state->idle;
+        if (state->idle + state->refills < state->settings.sessionThreads && !state->stopping) {
+            ++state->refills;
+            state->workCV.notify_one();
+        }
+        lock.unlock();
+        job();
+        // Released before locking, it may hold the last reference to the pool
+        job = nullptr;
+        // A session may have pinned the thread, the next one starts from every CPU
+        if (!allCpus.empty()) {
+            ThreadPlacement::pinCurrentThread(allCpus);
+        }
+        lock.lock();
+
+        size_t maxIdle = std::max(state->settings.maxIdleThreads, state->settings.sessionThreads);
+        if (state->stopping || state->idle >= maxIdle) {
+            break;
+        }
+        ++state->idle;
+    }
+    // Once stopping, the destructor owns the thread and the list entry is gone
+    if (!state->stopping) {
+        worker->exited = true;
+    }
+}
@@ -0,0 +1,110 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef WARMTHREADPOOL_H
+#define WARMTHREADPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+struct PrewarmSettings {
+    // Threads kept parked for new sessions, so starting one doesn't create a thread
+    size_t sessionThreads = 4;
+    // Threads whose session ended park again up to this many, the rest exit
+    size_t maxIdleThreads = 16;
+};
+
+// One job handed to the pool; done once it returned
+class PooledJob {
+public:
+    void wait();
+
+    // Thread running the job, default until it started
+    std::thread::id getThreadId();
+
+private:
+    friend class WarmThreadPool;
+
+    std::mutex m_mutex;
+    std::condition_variable m_doneCV;
+    std::thread::id m_threadId;
+    bool m_done = false;
+};
+
+// Long-running jobs, such as a session's publisher loop, started on threads created ahead of time.
+// When a parked thread takes a job, another parked one creates a replacement, keeping thread
+// creation off the caller's path. Threads go back to parking when their job returns.
+class WarmThreadPool {
+public:
+    explicit WarmThreadPool(PrewarmSettings settings = PrewarmSettings());
+
+    // Waits for running jobs, unless called from one of them
+    ~WarmThreadPool();
+
+    WarmThreadPool(const WarmThreadPool &) = delete;
+
+    WarmThreadPool &operator=(const WarmThreadPool &) = delete;
+
+    // Creates a thread only when none is parked
+    std::shared_ptr<PooledJob> run(std::function<void()> job);
+
+    // Takes effect as threads take and finish jobs
+    void setSettings(PrewarmSettings settings);
+
+    size_t getIdleCount() const;
+
+    size_t getThreadCount() const;
+
+private:
+    struct Worker {
+        std::thread thread;
+        bool exited = false;
+    };
+
+    // Shared with the threads, so one finishing the job that destroyed the pool still has it
+    struct State {
+        PrewarmSettings settings;
+        std::mutex mutex;
+        std::condition_variable workCV;
+        std::deque<std::function<void()> > jobs;
+        std::list<Worker> workers;
+        // Threads not running a job, including ones just created
+        size_t idle = 0;
+        // Replacements a parked thread should create
+        size_t refills = 0;
+        bool stopping = false;
+    };
+
+    static void workerThread(std::shared_ptr<State> state, std::list<Worker>::iterator worker);
+
+    // Both need the state's mutex held
+    static void spawnLocked(const std::shared_ptr<State> &state);
+
+    static void reapLocked(State &state);
+
+    std::shared_ptr<State> m_state;
+};
+
+
+#endif //WARMTHREADPOOL_H
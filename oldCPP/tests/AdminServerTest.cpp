@@ -0,0 +1,181 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <atomic>
+#include <thread>
+
+#include <core/AdminServer.h>
+#include <core/StreamManager.h>
+
+#include "MockSRTHandler.h"
+
+#if !defined(_WIN32)
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+class AdminServerTest : public ::testing::Test {
+protected:
+    std::shared_ptr<StreamManager> streamManager;
+    std::shared_ptr<MockSRTHandler> publisherHandler;
+
+    void SetUp() override {
+        streamManager = std::make_shared<StreamManager>();
+        publisherHandler = std::make_shared<MockSRTHandler>("test-stream-id");
+    }
+
+    void TearDown() override {
+        streamManager.reset();
+        publisherHandler.reset();
+    }
+};
+
+TEST(AdminSnapshotTest, SerializesStreamsAndEscapesStrings) {
+    AdminSnapshot snapshot;
+    StreamStatus stream;
+    stream.streamId = "live \"main\"";
+    stream.publisherAddress = "10.0.0.1:4000";
+    stream.bitsPerSecond = 8000000;
+    SubscriberStatus subscriber;
+    subscriber.peerAddress = "10.0.0.2:5000";
+    subscriber.qosClass = "critical";
+    subscriber.lagMicros = 1500;
+    stream.subscribers.push_back(subscriber);
+    snapshot.streams.push_back(stream);
+    snapshot.startup.subscriber.push_back(StageLatency{"first_data", 3, 1200, 2500});
+
+    std::string json = snapshot.toJson();
+    EXPECT_NE(json.find("\"stream_id\":\"live \\\"main\\\"\""), std::string::npos);
+    EXPECT_NE(json.find("\"bitrate_bps\":8000000"), std::string::npos);
+    EXPECT_NE(json.find("\"peer\":\"10.0.0.2:5000\""), std::string::npos);
+    EXPECT_NE(json.find("\"lag_us\":1500"), std::string::npos);
+    EXPECT_NE(json.find("\"startup\":{\"publisher\":[],\"subscriber\":[{\"stage\":\"first_data\",\"count\":3,"
+                        "\"avg_us\":1200,\"max_us\":2500}]}"), std::string::npos);
+    EXPECT_EQ(json.find('\n'), std::string::npos);
+}
+
+TEST_F(AdminServerTest, StatusComesFromPublishedSnapshot) {
+    AdminServer admin(AdminSettings(), streamManager);
+    publisherHandler->expectReceivingData("Some Test Data", 14);
+    EXPECT_TRUE(streamManager->onPublisherConnected(publisherHandler));
+
+    // Nothing published yet, the new stream only shows up with the next snapshot
+    EXPECT_EQ(admin.handleCommand("status").find("test-stream-id"), std::string::npos);
+    streamManager->publishAdminSnapshot();
+    EXPECT_NE(admin.handleCommand("status").find("\"stream_id\":\"test-stream-id\""), std::string::npos);
+
+    streamManager->removePublishingStream(publisherHandler);
+}
+
+TEST_F(AdminServerTest, CommandsKickDropAndDrain) {
+    AdminServer admin(AdminSettings(), streamManager);
+    publisherHandler->expectReceivingData("Some Test Data", 14);
+    EXPECT_TRUE(streamManager->onPublisherConnected(publisherHandler));
+
+    // Mock subscribers have no peer address, so kicking "" matches them
+    auto subscriber = std::make_shared<MockSRTHandler>("test-stream-id");
+    EXPECT_CALL(*subscriber, send(testing::_, testing::_, testing::_)).WillRepeatedly(testing::ReturnArg<1>());
+    EXPECT_CALL(*subscriber, disconnect()).Times(1);
+    EXPECT_TRUE(streamManager->onSubscriberConnected(subscriber));
+    EXPECT_EQ(admin.handleCommand("kick test-stream-id 10.9.9.9:1"), "{\"ok\":false,\"kicked\":0}");
+    EXPECT_EQ(streamManager->kickSubscriber("test-stream-id", ""), 1u);
+
+    EXPECT_EQ(admin.handleCommand("drain"), "{\"ok\":true,\"draining\":true}");
+    EXPECT_FALSE(streamManager->onSubscriberConnected(std::make_shared<MockSRTHandler>("test-stream-id")));
+    EXPECT_EQ(admin.handleCommand("resume"), "{\"ok\":true,\"draining\":false}");
+
+    std::atomic<bool> publisherClosed{false};
+    EXPECT_CALL(*publisherHandler, disconnect()).WillOnce(testing::Invoke([&publisherClosed] {
+        publisherClosed = true;
+        return true;
+    }));
+    EXPECT_EQ(admin.handleCommand("drop test-stream-id"), "{\"ok\":true}");
+    // The reply doesn't wait for the teardown
+    for (int i = 0; i < 100 && !publisherClosed.load(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    EXPECT_TRUE(publisherClosed.load());
+    EXPECT_NE(admin.handleCommand("drop test-stream-id").find("unknown stream"), std::string::npos);
+    EXPECT_NE(admin.handleCommand("reboot").find("unknown command"), std::string::npos);
+}
+
+#if !defined(_WIN32)
+TEST_F(AdminServerTest, ServesCommandsOverTheSocket) {
+    AdminSettings settings;
+    settings.socketPath = "/tmp/dl_srt_server_admin_test_" + std::to_string(::getpid()) + ".sock";
+    AdminServer admin(settings, streamManager);
+    ASSERT_TRUE(admin.start());
+    struct stat info{};
+    ASSERT_EQ(::stat(settings.socketPath.c_str(), &info), 0);
+    EXPECT_EQ(info.st_mode & 0777, 0660u);
+
+    std::string reply;
+    ASSERT_TRUE(AdminServer::sendCommand(settings.socketPath, "status", reply));
+    EXPECT_EQ(reply.rfind("{\"taken_at_ms\":", 0), 0u);
+    ASSERT_TRUE(AdminServer::sendCommand(settings.socketPath, "drain", reply));
+    EXPECT_TRUE(streamManager->isDraining());
+
+    admin.stop();
+    EXPECT_FALSE(AdminServer::sendCommand(settings.socketPath, "status", reply));
+}
+
+TEST_F(AdminServerTest, ClientNotReadingRepliesDoesNotStallOthers) {
+    AdminSettings settings;
+    settings.socketPath = "/tmp/dl_srt_server_admin_stall_test_" + std::to_string(::getpid()) + ".sock";
+    AdminServer admin(settings, streamManager);
+    ASSERT_TRUE(admin.start());
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, settings.socketPath.data(), settings.socketPath.size());
+    int stalled = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    ASSERT_EQ(::connect(stalled, reinterpret_cast<sockaddr *>(&address), sizeof(address)), 0);
+    // Far more replies than the socket buffers hold, none of them read
+    std::string commands;
+    for (int i = 0; i < 100; ++i) {
+        commands += "status\n";
+    }
+    for (int i = 0; i < 500; ++i) {
+        if (::send(stalled, commands.data(), commands.size(), MSG_NOSIGNAL) <= 0) {
+            break;
+        }
+    }
+
+    auto started = std::chrono::steady_clock::now();
+    std::string reply;
+    ASSERT_TRUE(AdminServer::sendCommand(settings.socketPath, "status", reply));
+    EXPECT_EQ(reply.rfind("{\"taken_at_ms\":", 0), 0u);
+    EXPECT_LT(std::chrono::steady_clock::now() - started, std::chrono::seconds(1));
+
+    // Its backlog went over the cap, so the server hung up on it
+    char buffer[65536];
+    int received;
+    while ((received = static_cast<int>(::recv(stalled, buffer, sizeof(buffer), 0))) > 0) {
+    }
+    EXPECT_EQ(received, 0);
+    ::close(stalled);
+    admin.stop();
+}
+#endif
@@ -0,0 +1,220 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <filesystem>
+#include <map>
+
+#include <core/ClusterPlacement.h>
+#include <core/StreamManager.h>
+
+#include "MockSRTHandler.h"
+
+namespace {
+    const std::vector<std::string> NODES = {"10.0.0.5:6000", "10.0.0.6:6000", "10.0.0.7:6000"};
+
+    // Counts the lookups that reach the backend
+    class CountingDirectory : public StreamDirectory {
+    public:
+        bool registerStream(const std::string &streamId, const std::string &node, std::chrono::seconds) override {
+            entries[streamId] = node;
+            return true;
+        }
+
+        void unregisterStream(const std::string &streamId, const std::string &) override {
+            entries.erase(streamId);
+        }
+
+        bool lookup(const std::string &streamId, std::string &node) override {
+            ++lookups;
+            auto it = entries.find(streamId);
+            if (it == entries.end()) {
+                return false;
+            }
+            node = it->second;
+            return true;
+        }
+
+        bool listStreams(std::unordered_map<std::string, std::string> &owners) override {
+            owners.insert(entries.begin(), entries.end());
+            return true;
+        }
+
+        std::map<std::string, std::string> entries;
+        int lookups = 0;
+    };
+}
+
+class ClusterPlacementTest : public ::testing::Test {
+protected:
+    std::string directoryPath;
+
+    void SetUp() override {
+        directoryPath = (std::filesystem::temp_directory_path() /
+                         ("dl_srt_directory_" + std::to_string(std::chrono::steady_clock::now()
+                                                                   .time_since_epoch().count()))).string();
+    }
+
+    void TearDown() override {
+        std::error_code error;
+        std::filesystem::remove_all(directoryPath, error);
+    }
+};
+
+TEST(ConsistentHashRingTest, SpreadsKeysAndMovesOnlyThoseOfARemovedNode) {
+    ConsistentHashRing ring;
+    for (const auto &node: NODES) {
+        ring.addNode(node);
+    }
+
+    std::map<std::string, std::string> placed;
+    std::map<std::string, int> perNode;
+    for (int i = 0; i < 3000; ++i) {
+        std::string key = "stream-" + std::to_string(i);
+        placed[key] = ring.nodeFor(key);
+        ++perNode[placed[key]];
+    }
+    for (const auto &node: NODES) {
+        EXPECT_GT(perNode[node], 600) << node;
+    }
+
+    ring.removeNode(NODES[1]);
+    for (const auto &entry: placed) {
+        if (entry.second != NODES[1]) {
+            EXPECT_EQ(ring.nodeFor(entry.first), entry.second) << entry.first;
+        } else {
+            EXPECT_NE(ring.nodeFor(entry.first), NODES[1]);
+        }
+    }
+    EXPECT_EQ(ConsistentHashRing().nodeFor("stream-1"), "");
+}
+
+TEST_F(ClusterPlacementTest, FileDirectoryRegistersLooksUpAndExpires) {
+    FileStreamDirectory directory(directoryPath);
+    std::string node;
+    EXPECT_FALSE(directory.lookup("live/main", node));
+
+    EXPECT_TRUE(directory.registerStream("live/main", NODES[0], std::chrono::seconds(30)));
+    ASSERT_TRUE(directory.lookup("live/main", node));
+    EXPECT_EQ(node, NODES[0]);
+
+    // Only the node holding the entry can remove it
+    directory.unregisterStream("live/main", NODES[1]);
+    EXPECT_TRUE(directory.lookup("live/main", node));
+    directory.unregisterStream("live/main", NODES[0]);
+    EXPECT_FALSE(directory.lookup("live/main", node));
+
+    EXPECT_TRUE(directory.registerStream("crashed", NODES[2], std::chrono::seconds(0)));
+    EXPECT_FALSE(directory.lookup("crashed", node));
+
+    // Listing reverses the file name escaping and skips expired entries
+    EXPECT_TRUE(directory.registerStream("live/main?x=1", NODES[1], std::chrono::seconds(30)));
+    std::unordered_map<std::string, std::string> owners;
+    ASSERT_TRUE(directory.listStreams(owners));
+    EXPECT_EQ(owners.size(), 1u);
+    EXPECT_EQ(owners["live/main?x=1"], NODES[1]);
+}
+
+TEST_F(ClusterPlacementTest, PublishedStreamsOverrideTheRing) {
+    ClusterSettings settings;
+    settings.nodeAddress = NODES[0];
+    settings.nodes = NODES;
+    auto directory = std::make_shared<CountingDirectory>();
+    ClusterPlacement placement(settings, directory);
+
+    std::string ringOwner = placement.ownerFor("stream-A");
+    EXPECT_GE(placement.nodeIndex(ringOwner), 0);
+
+    std::string elsewhere = ringOwner == NODES[1] ? NODES[2] : NODES[1];
+    directory->entries["stream-A"] = elsewhere;
+    placement.refreshPlacements();
+    EXPECT_EQ(placement.ownerFor("stream-A"), elsewhere);
+    EXPECT_FALSE(placement.isLocal(elsewhere));
+    EXPECT_EQ(placement.nodeIndex("10.0.0.9:6000"), -1);
+}
+
+TEST_F(ClusterPlacementTest, HandshakeOwnersNeverAskTheDirectory) {
+    ClusterSettings settings;
+    settings.nodeAddress = NODES[0];
+    settings.nodes = NODES;
+    auto directory = std::make_shared<CountingDirectory>();
+    ClusterPlacement placement(settings, directory);
+    std::string ringOwner = placement.ownerFor("stream-A");
+    std::string elsewhere = ringOwner == NODES[1] ? NODES[2] : NODES[1];
+
+    // Seen only after the next refresh
+    directory->entries["stream-A"] = elsewhere;
+    EXPECT_EQ(placement.ownerFor("stream-A"), ringOwner);
+    placement.refreshPlacements();
+    EXPECT_EQ(placement.ownerFor("stream-A"), elsewhere);
+
+    // Published here wins right away
+    placement.streamStarted("stream-A");
+    EXPECT_EQ(placement.ownerFor("stream-A"), NODES[0]);
+    placement.streamEnded("stream-A");
+    EXPECT_EQ(placement.ownerFor("stream-A"), ringOwner);
+    EXPECT_EQ(directory->lookups, 0);
+}
+
+TEST_F(ClusterPlacementTest, OwnerEntriesLastUntilTheDirectoryDropsThem) {
+    ClusterSettings settings;
+    settings.nodeAddress = NODES[0];
+    settings.nodes = NODES;
+    auto directory = std::make_shared<CountingDirectory>();
+    ClusterPlacement placement(settings, directory);
+    std::string ringOwner = placement.ownerFor("stream-B");
+    std::string elsewhere = ringOwner == NODES[1] ? NODES[2] : NODES[1];
+    directory->entries["stream-B"] = elsewhere;
+    placement.refreshPlacements();
+
+    // Viewers behind one address joining back to back all belong on the owner
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_EQ(placement.ownerFor("stream-B"), elsewhere);
+    }
+    // Once the owner unregisters, the next refresh hands the stream back to the ring
+    directory->entries.erase("stream-B");
+    placement.refreshPlacements();
+    EXPECT_EQ(placement.ownerFor("stream-B"), ringOwner);
+}
+
+TEST_F(ClusterPlacementTest, ManagerRegistersItsStreams) {
+    ServerConfig config;
+    EXPECT_TRUE(config.apply("cluster.node_address", NODES[1]));
+    EXPECT_TRUE(config.apply("cluster.nodes", "10.0.0.5:6000; 10.0.0.6:6000; 10.0.0.7:6000"));
+    EXPECT_TRUE(config.apply("cluster.directory_path", directoryPath));
+    EXPECT_TRUE(config.apply("cluster.cache_ttl_ms", "0"));
+    auto streamManager = std::make_shared<StreamManager>(config);
+    ASSERT_TRUE(streamManager->getCluster());
+
+    auto publisher = std::make_shared<MockSRTHandler>("stream-A");
+    publisher->expectReceivingData("Some Test Data", 14);
+    EXPECT_TRUE(streamManager->onPublisherConnected(publisher));
+
+    // Other nodes find the stream here whatever the ring says
+    FileStreamDirectory directory(directoryPath);
+    std::string node;
+    ASSERT_TRUE(directory.lookup("stream-A", node));
+    EXPECT_EQ(node, NODES[1]);
+    EXPECT_EQ(streamManager->getCluster()->ownerFor("stream-A"), NODES[1]);
+
+    streamManager->removePublishingStream(publisher);
+    EXPECT_FALSE(directory.lookup("stream-A", node));
+}
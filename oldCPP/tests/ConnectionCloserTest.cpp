@@ -0,0 +1,84 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <utils/ConnectionCloser.h>
+
+#include "MockSRTHandler.h"
+
+namespace {
+    std::vector<std::shared_ptr<StreamHandler> > slowClosingHandlers(size_t count, std::chrono::milliseconds delay) {
+        std::vector<std::shared_ptr<StreamHandler> > handlers;
+        for (size_t i = 0; i < count; ++i) {
+            auto handler = std::make_shared<MockSRTHandler>("test-stream-id");
+            EXPECT_CALL(*handler, disconnect())
+                    .WillOnce(testing::Invoke([delay] {
+                        std::this_thread::sleep_for(delay);
+                        return true;
+                    }));
+            handlers.push_back(handler);
+        }
+        return handlers;
+    }
+}
+
+TEST(ConnectionCloserTest, ClosesGroupInParallel) {
+    TeardownSettings settings;
+    settings.workers = 4;
+    settings.batchSize = 2;
+    ConnectionCloser closer(settings);
+
+    // 16 closes of 10ms each take 160ms one by one, ~40ms on four workers
+    auto startedAt = std::chrono::steady_clock::now();
+    auto group = closer.submit(slowClosingHandlers(16, std::chrono::milliseconds(10)));
+    EXPECT_TRUE(closer.wait(group));
+    EXPECT_LT(std::chrono::steady_clock::now() - startedAt, std::chrono::milliseconds(120));
+
+    TeardownStats stats = closer.getStats();
+    EXPECT_EQ(stats.closedConnections, 16u);
+    EXPECT_EQ(stats.pendingConnections, 0u);
+    EXPECT_GT(stats.maxTeardownMicros, 0);
+}
+
+TEST(ConnectionCloserTest, WaitIsBounded) {
+    TeardownSettings settings;
+    settings.workers = 1;
+    settings.maxWait = std::chrono::milliseconds(20);
+    ConnectionCloser closer(settings);
+
+    auto group = closer.submit(slowClosingHandlers(1, std::chrono::milliseconds(200)));
+    EXPECT_FALSE(closer.wait(group));
+    EXPECT_EQ(closer.getStats().timedOutWaits, 1u);
+    EXPECT_EQ(closer.getStats().pendingConnections, 1u);
+
+    // Closing carries on in the background and stop() lets it finish
+    closer.stop();
+    EXPECT_TRUE(group->waitFor(std::chrono::milliseconds(0)));
+}
+
+TEST(ConnectionCloserTest, ClosesInlineAfterStop) {
+    ConnectionCloser closer;
+    closer.stop();
+
+    auto group = closer.submit(slowClosingHandlers(3, std::chrono::milliseconds(0)));
+    EXPECT_TRUE(group->waitFor(std::chrono::milliseconds(0)));
+    EXPECT_EQ(closer.getStats().closedConnections, 3u);
+}
@@ -0,0 +1,105 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <core/CpuPlacement.h>
+#include <core/ServerConfig.h>
+
+TEST(CpuPlacementTest, ParsesCpuLists) {
+    EXPECT_EQ(ThreadPlacement::parseCpuList("0-3,8"), (CpuSet{0, 1, 2, 3, 8}));
+    EXPECT_EQ(ThreadPlacement::parseCpuList("5"), (CpuSet{5}));
+    EXPECT_EQ(ThreadPlacement::parseCpuList("x,2"), (CpuSet{2}));
+    EXPECT_TRUE(ThreadPlacement::parseCpuList("").empty());
+}
+
+TEST(CpuPlacementTest, ConfigParsesSessionCpuSets) {
+    ServerConfig config;
+    EXPECT_TRUE(config.apply("affinity.session_cpu_sets", "0-1; 2-3"));
+    EXPECT_TRUE(config.apply("affinity.accept_cpus", "4"));
+    EXPECT_FALSE(config.apply("affinity.unknown", "1"));
+
+    ASSERT_EQ(config.affinity.sessionCpuSets.size(), 2);
+    EXPECT_EQ(config.affinity.sessionCpuSets[1], (CpuSet{2, 3}));
+    EXPECT_EQ(config.affinity.acceptCpus, (CpuSet{4}));
+}
+
+TEST(CpuPlacementTest, SessionsGoToLeastLoadedSet) {
+    AffinitySettings settings;
+    settings.sessionCpuSets = {{0}, {0}};
+    CpuPlacement placement(settings);
+
+    int first = placement.acquireSessionSlot();
+    int second = placement.acquireSessionSlot();
+    EXPECT_NE(first, second);
+    EXPECT_EQ(placement.getSessionsPerSlot(), (std::vector<int>{1, 1}));
+
+    placement.releaseSessionSlot(first);
+    EXPECT_EQ(placement.acquireSessionSlot(), first);
+}
+
+TEST(CpuPlacementTest, SessionsPreferSetsNearTheirListener) {
+    AffinitySettings settings;
+    settings.sessionCpuSets = {{0, 1}, {2, 3}, {4, 5}};
+    CpuPlacement placement(settings);
+
+    EXPECT_EQ(placement.acquireSessionSlot(CpuSet{2, 3}), 1);
+    // Still preferred even though the other sets are less loaded
+    EXPECT_EQ(placement.acquireSessionSlot(CpuSet{3}), 1);
+    EXPECT_EQ(placement.acquireSessionSlot(CpuSet{2, 3, 4, 5}), 2);
+    EXPECT_EQ(placement.acquireSessionSlot(CpuSet{9}), 0);
+}
+
+TEST(CpuPlacementTest, ConfigParsesListenAddresses) {
+    ServerConfig config;
+    ASSERT_EQ(config.listen.publisher.size(), 1);
+    EXPECT_EQ(config.listen.publisher[0].address, "0.0.0.0:5500");
+
+    EXPECT_TRUE(config.apply("listen.publisher", "10.0.0.5:5500@2-3,8; [fd00::5]:5500"));
+    ASSERT_EQ(config.listen.publisher.size(), 2);
+    EXPECT_EQ(config.listen.publisher[0].address, "10.0.0.5:5500");
+    EXPECT_EQ(config.listen.publisher[0].cpus, (CpuSet{2, 3, 8}));
+    EXPECT_EQ(config.listen.publisher[1].address, "[fd00::5]:5500");
+    EXPECT_TRUE(config.listen.publisher[1].cpus.empty());
+
+    EXPECT_FALSE(config.apply("listen.subscriber", "no-port"));
+    EXPECT_EQ(config.listen.subscriber[0].address, "0.0.0.0:6000");
+}
+
+TEST(CpuPlacementTest, NoSessionSetsLeavesSessionsUnpinned) {
+    CpuPlacement placement;
+    EXPECT_EQ(placement.acquireSessionSlot(), -1);
+    EXPECT_FALSE(placement.pinToSessionSlot(-1));
+}
+
+TEST(CpuPlacementTest, RecordsWorkOnCurrentCore) {
+    CpuPlacement placement;
+    placement.recordWork(1316);
+
+    int64_t packets = 0;
+    int64_t bytes = 0;
+    for (const auto &core: placement.getCoreLoad()) {
+        packets += core.packets;
+        bytes += core.bytes;
+    }
+    if (ThreadPlacement::currentCpu() >= 0) {
+        EXPECT_EQ(packets, 1);
+        EXPECT_EQ(bytes, 1316);
+    }
+}
@@ -0,0 +1,158 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <map>
+#include <set>
+
+#include <core/FanoutPath.h>
+#include <core/FanoutWorkers.h>
+
+#include "MockSRTHandler.h"
+
+class FanoutWorkersTest : public ::testing::Test {
+protected:
+    SubscriberClassGroup subscribers;
+    std::mutex sendThreadsMutex;
+    std::set<std::thread::id> sendThreads;
+    std::atomic<bool> isDisconnecting{false};
+
+    std::map<StreamHandler *, int> sendCounts;
+
+    std::shared_ptr<MockSRTHandler> addSubscriber(int result) {
+        auto subscriber = std::make_shared<MockSRTHandler>("test-stream-id");
+        StreamHandler *handler = subscriber.get();
+        EXPECT_CALL(*subscriber, send(testing::_, testing::_, testing::_))
+                .WillRepeatedly(testing::Invoke([this, handler, result](const char *, int len, const MessageControl &) {
+                    std::lock_guard<std::mutex> lock(sendThreadsMutex);
+                    sendThreads.insert(std::this_thread::get_id());
+                    ++sendCounts[handler];
+                    return result == STREAM_ERROR ? STREAM_ERROR : len;
+                }));
+        subscribers.add(subscriber);
+        return subscriber;
+    }
+
+    static FanoutSettings smallShards() {
+        FanoutSettings settings;
+        settings.shardThreshold = 1;
+        settings.minSubscribersPerShard = 3;
+        settings.maxWorkers = 3;
+        return settings;
+    }
+};
+
+TEST_F(FanoutWorkersTest, SendsToEverySubscriberAcrossWorkers) {
+    for (int i = 0; i < 12; ++i) {
+        addSubscriber(0);
+    }
+
+    FanoutWorkers fanoutWorkers("test-stream-id", smallShards());
+    std::vector<std::shared_ptr<StreamHandler> > failedSubscribers;
+    fanoutWorkers.send(subscribers, "test data", 9, MessageControl(), isDisconnecting, failedSubscribers);
+    fanoutWorkers.send(subscribers, "test data", 9, MessageControl(), isDisconnecting, failedSubscribers);
+
+    EXPECT_TRUE(failedSubscribers.empty());
+    for (const auto &subscriber: subscribers.handlers) {
+        EXPECT_EQ(sendCounts[subscriber.get()], 2);
+    }
+    EXPECT_EQ(fanoutWorkers.getWorkerCount(), 3);
+    EXPECT_EQ(sendThreads.size(), 4);
+}
+
+TEST_F(FanoutWorkersTest, SmallAudienceUsesFewerShards) {
+    for (int i = 0; i < 5; ++i) {
+        addSubscriber(0);
+    }
+
+    FanoutWorkers fanoutWorkers("test-stream-id", smallShards());
+    std::vector<std::shared_ptr<StreamHandler> > failedSubscribers;
+    fanoutWorkers.send(subscribers, "test data", 9, MessageControl(), isDisconnecting, failedSubscribers);
+
+    // 5 subscribers with at least 3 per shard only need the caller and one worker
+    EXPECT_EQ(fanoutWorkers.getWorkerCount(), 1);
+    EXPECT_LE(sendThreads.size(), 2);
+}
+
+TEST_F(FanoutWorkersTest, CollectsFailedSubscribersFromAllShards) {
+    std::vector<std::shared_ptr<StreamHandler> > expectedFailures;
+    for (int i = 0; i < 12; ++i) {
+        auto subscriber = addSubscriber(i % 4 == 0 ? STREAM_ERROR : 0);
+        if (i % 4 == 0) {
+            expectedFailures.push_back(subscriber);
+        }
+    }
+
+    FanoutWorkers fanoutWorkers("test-stream-id", smallShards());
+    std::vector<std::shared_ptr<StreamHandler> > failedSubscribers;
+    fanoutWorkers.send(subscribers, "test data", 9, MessageControl(), isDisconnecting, failedSubscribers);
+
+    EXPECT_THAT(failedSubscribers, testing::UnorderedElementsAreArray(expectedFailures));
+}
+
+TEST_F(FanoutWorkersTest, ShardsSpanSrtTargetsAndOtherHandlers) {
+    // Never connected, so SRT rejects every send to them
+    std::vector<std::shared_ptr<StreamHandler> > srtSubscribers;
+    for (int i = 0; i < 6; ++i) {
+        auto subscriber = std::make_shared<SRTHandler>();
+        srtSubscribers.push_back(subscriber);
+        subscribers.add(subscriber);
+    }
+    for (int i = 0; i < 6; ++i) {
+        addSubscriber(0);
+    }
+    ASSERT_EQ(subscribers.srtTargets.size(), 6u);
+    ASSERT_EQ(subscribers.otherHandlers.size(), 6u);
+
+    FanoutWorkers fanoutWorkers("test-stream-id", smallShards());
+    std::vector<std::shared_ptr<StreamHandler> > failedSubscribers;
+    fanoutWorkers.send(subscribers, "test data", 9, MessageControl(), isDisconnecting, failedSubscribers);
+
+    EXPECT_THAT(failedSubscribers, testing::UnorderedElementsAreArray(srtSubscribers));
+    for (const auto &subscriber: subscribers.otherHandlers) {
+        EXPECT_EQ(sendCounts[subscriber.get()], 1);
+    }
+}
+
+namespace {
+    struct RecordingTransport {
+        using Target = int;
+
+        static int send(const Target &target, const char *, int len, const MessageControl &) {
+            return target < 0 ? STREAM_ERROR : len;
+        }
+    };
+}
+
+TEST_F(FanoutWorkersTest, SendToAllReportsFailedTargetsByIndex) {
+    std::vector<int> targets = {1, -1, 2, -1};
+    std::vector<size_t> failed;
+
+    sendToAll<RecordingTransport>(targets.data(), targets.size(), "data", 4, MessageControl(), isDisconnecting,
+                                  [&failed](size_t index) { failed.push_back(index); });
+    EXPECT_EQ(failed, (std::vector<size_t>{1, 3}));
+
+    failed.clear();
+    isDisconnecting = true;
+    sendToAll<RecordingTransport>(targets.data(), targets.size(), "data", 4, MessageControl(), isDisconnecting,
+                                  [&failed](size_t index) { failed.push_back(index); });
+    EXPECT_TRUE(failed.empty());
+}
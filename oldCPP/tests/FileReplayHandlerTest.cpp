@@ -0,0 +1,138 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <thread>
+
+#include <utils/FileReplayHandler.h>
+
+namespace {
+    constexpr size_t PACKET = ReplaySource::TS_PACKET_SIZE;
+
+    // TS packets on PID 0x100, every pcrInterval-th one carrying a PCR stepping by pcrStep (27 MHz)
+    std::string writeCapture(const std::string &name, int packets, int pcrInterval, uint64_t firstPcr,
+                             uint64_t pcrStep, size_t leadingGarbage = 0) {
+        std::string path = testing::TempDir() + name;
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file << std::string(leadingGarbage, '\x01');
+        uint64_t pcr = firstPcr;
+        for (int i = 0; i < packets; ++i) {
+            std::string packet(PACKET, '\xff');
+            packet[0] = 0x47;
+            packet[1] = 0x01;
+            packet[2] = 0x00;
+            if (pcrInterval > 0 && i % pcrInterval == 0) {
+                uint64_t base = (pcr / 300) & ((uint64_t(1) << 33) - 1);
+                uint64_t extension = pcr % 300;
+                packet[3] = 0x30;
+                packet[4] = 7;
+                packet[5] = 0x10;
+                packet[6] = static_cast<char>(base >> 25);
+                packet[7] = static_cast<char>(base >> 17);
+                packet[8] = static_cast<char>(base >> 9);
+                packet[9] = static_cast<char>(base >> 1);
+                packet[10] = static_cast<char>(((base & 1) << 7) | 0x7e | (extension >> 8));
+                packet[11] = static_cast<char>(extension);
+                pcr = (pcr + pcrStep) % ((uint64_t(1) << 33) * 300);
+            } else {
+                packet[3] = 0x10;
+            }
+            file << packet;
+        }
+        return path;
+    }
+}
+
+TEST(FileReplayHandlerTest, TimelineFollowsPcr) {
+    // A PCR every 5 packets, 10ms apart
+    auto source = ReplaySource::open(writeCapture("pcr.ts", 50, 5, 0, 270000));
+    ASSERT_NE(source, nullptr);
+
+    EXPECT_EQ(source->size(), 50 * PACKET);
+    EXPECT_EQ(source->timeAt(0), 0);
+    EXPECT_EQ(source->timeAt(5 * PACKET), 10000);
+    EXPECT_EQ(source->timeAt(7 * PACKET + PACKET / 2), 15000);
+    EXPECT_EQ(source->getDurationMicros(), 100000);
+}
+
+TEST(FileReplayHandlerTest, PcrWrapAndLeadingGarbageAreHandled) {
+    uint64_t nearWrap = (uint64_t(1) << 33) * 300 - 270000;
+    auto source = ReplaySource::open(writeCapture("wrap.ts", 20, 5, nearWrap, 270000, 77));
+    ASSERT_NE(source, nullptr);
+
+    EXPECT_EQ(source->size(), 20 * PACKET);
+    EXPECT_EQ(source->timeAt(10 * PACKET), 20000);
+}
+
+TEST(FileReplayHandlerTest, FileWithoutPcrNeedsBitrate) {
+    std::string path = writeCapture("nopcr.ts", 20, 0, 0, 0);
+    EXPECT_EQ(ReplaySource::open(path), nullptr);
+
+    // 188 bytes per millisecond
+    auto source = ReplaySource::open(path, 188 * 8 * 1000);
+    ASSERT_NE(source, nullptr);
+    EXPECT_EQ(source->timeAt(10 * PACKET), 10000);
+}
+
+TEST(FileReplayHandlerTest, ReplayIsPacedAndEnds) {
+    auto source = ReplaySource::open(writeCapture("paced.ts", 50, 5, 0, 270000));
+    ASSERT_NE(source, nullptr);
+    FileReplayHandler handler(source, "replay", false);
+    EXPECT_EQ(handler.getStreamId(), "replay");
+
+    std::vector<char> buffer(1456);
+    MessageControl control;
+    size_t bytes = 0;
+    auto start = std::chrono::steady_clock::now();
+    int received;
+    while ((received = handler.receive(buffer.data(), static_cast<int>(buffer.size()), control)) != STREAM_ERROR) {
+        EXPECT_EQ(received % PACKET, 0u);
+        EXPECT_EQ(buffer[0], 0x47);
+        bytes += received;
+    }
+
+    // The last message starts at packet 49, 98ms into the file
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(95));
+    EXPECT_EQ(bytes, 50 * PACKET);
+    EXPECT_FALSE(handler.isConnected());
+}
+
+TEST(FileReplayHandlerTest, LoopsUntilDisconnected) {
+    // 10 packets at 188 bytes per millisecond, 10ms per pass
+    auto source = ReplaySource::open(writeCapture("loop.ts", 10, 0, 0, 0), 188 * 8 * 1000);
+    ASSERT_NE(source, nullptr);
+    auto handler = std::make_shared<FileReplayHandler>(source, "replay", true);
+
+    std::thread stopper([handler] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        handler->disconnect();
+    });
+
+    std::vector<char> buffer(1456);
+    MessageControl control;
+    while (handler->receive(buffer.data(), static_cast<int>(buffer.size()), control) != STREAM_ERROR) {
+    }
+    stopper.join();
+
+    EXPECT_GE(handler->getCompletedLoops(), 3u);
+    EXPECT_LE(handler->getCompletedLoops(), 6u);
+}
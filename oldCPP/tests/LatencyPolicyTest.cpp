@@ -0,0 +1,95 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <core/LatencyPolicy.h>
+
+TEST(LatencyPolicyTest, UnknownPeerGetsDefaultLatency) {
+    LatencySettings settings;
+    settings.defaultLatencyMs = 150;
+    LatencyPolicy policy(settings);
+
+    EXPECT_EQ(policy.chooseLatencyMs("10.0.0.1"), 150);
+}
+
+TEST(LatencyPolicyTest, PicksFirstMatchingTier) {
+    LatencyPolicy policy;
+
+    EXPECT_EQ(policy.latencyForSample(LinkSample{5, 0}), 40);
+    EXPECT_EQ(policy.latencyForSample(LinkSample{5, 3}), 250);
+    EXPECT_EQ(policy.latencyForSample(LinkSample{50, 1}), 250);
+    EXPECT_EQ(policy.latencyForSample(LinkSample{400, 30}), 1000);
+}
+
+TEST(LatencyPolicyTest, ReconnectUsesMeasuredLink) {
+    LatencyPolicy policy;
+
+    policy.recordSample("10.0.0.1", LinkSample{4, 0.1});
+    policy.recordSample("10.0.0.2", LinkSample{150, 12});
+
+    EXPECT_EQ(policy.chooseLatencyMs("10.0.0.1"), 40);
+    EXPECT_EQ(policy.chooseLatencyMs("10.0.0.2"), 1000);
+}
+
+TEST(LatencyPolicyTest, SamplesAreSmoothed) {
+    LatencyPolicy policy;
+
+    policy.recordSample("10.0.0.1", LinkSample{4, 0.1});
+    // A single bad sample moves the estimate but doesn't jump straight to the worst tier
+    policy.recordSample("10.0.0.1", LinkSample{100, 8});
+    EXPECT_EQ(policy.chooseLatencyMs("10.0.0.1"), 250);
+}
+
+TEST(LatencyPolicyTest, EvictsLeastRecentlySeenPeers) {
+    LatencySettings settings;
+    settings.maxPeers = 2;
+    LatencyPolicy policy(settings);
+
+    policy.recordSample("10.0.0.1", LinkSample{4, 0});
+    policy.recordSample("10.0.0.2", LinkSample{4, 0});
+    policy.recordSample("10.0.0.3", LinkSample{4, 0});
+
+    EXPECT_EQ(policy.getPeerCount(), 2);
+    EXPECT_EQ(policy.chooseLatencyMs("10.0.0.1"), settings.defaultLatencyMs);
+}
+
+TEST(LatencyPolicyTest, ParsesTiersAndHosts) {
+    std::vector<LatencyTier> tiers;
+    EXPECT_TRUE(LatencySettings::parseTiers("20/1/60,*/*/800", tiers));
+    ASSERT_EQ(tiers.size(), 2);
+    EXPECT_EQ(tiers[0].latencyMs, 60);
+    EXPECT_EQ(tiers[1].latencyMs, 800);
+    EXPECT_FALSE(LatencySettings::parseTiers("20/1", tiers));
+
+    EXPECT_EQ(LatencyPolicy::hostFromAddress("10.0.0.1:5000"), "10.0.0.1");
+    EXPECT_EQ(LatencyPolicy::hostFromAddress("[::1]:5000"), "::1");
+}
+
+TEST(LatencyPolicyTest, ReloadedTiersKeepMeasuredPeers) {
+    LatencyPolicy policy;
+    policy.recordSample("10.0.0.1", LinkSample{4, 0.1});
+    EXPECT_EQ(policy.chooseLatencyMs("10.0.0.1"), 40);
+
+    LatencySettings settings;
+    ASSERT_TRUE(LatencySettings::parseTiers("20/1/80,*/*/600", settings.tiers));
+    policy.setSettings(settings);
+    EXPECT_EQ(policy.chooseLatencyMs("10.0.0.1"), 80);
+    EXPECT_EQ(policy.getPeerCount(), 1u);
+}
@@ -0,0 +1,142 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include <utils/Logger.h>
+
+class LoggerTest : public ::testing::Test {
+protected:
+    std::mutex capturedMutex;
+    std::string captured;
+
+    void SetUp() override {
+        Logger::instance().flush();
+        Logger::instance().setOutput([this](const std::string &lines) {
+            std::lock_guard<std::mutex> lock(capturedMutex);
+            captured += lines;
+        });
+    }
+
+    void TearDown() override {
+        Logger::instance().flush();
+        Logger::instance().configure(LogSettings());
+        Logger::instance().setOutput([](const std::string &lines) {
+            std::fwrite(lines.data(), 1, lines.size(), stderr);
+        });
+    }
+
+    std::string getCaptured() {
+        Logger::instance().flush();
+        std::lock_guard<std::mutex> lock(capturedMutex);
+        return captured;
+    }
+
+    static size_t countOccurrences(const std::string &text, const std::string &pattern) {
+        size_t count = 0;
+        for (size_t position = text.find(pattern); position != std::string::npos;
+             position = text.find(pattern, position + 1)) {
+            ++count;
+        }
+        return count;
+    }
+};
+
+TEST_F(LoggerTest, WritesStructuredFields) {
+    LOG_ERROR("Send failed", LogFields().stream("stream-A").from("10.0.0.1:5000").error(2001).with("broken pipe"));
+
+    std::string output = getCaptured();
+    EXPECT_NE(output.find("level=error"), std::string::npos);
+    EXPECT_NE(output.find("msg=\"Send failed\""), std::string::npos);
+    EXPECT_NE(output.find("stream=stream-A"), std::string::npos);
+    EXPECT_NE(output.find("peer=10.0.0.1:5000"), std::string::npos);
+    EXPECT_NE(output.find("error=2001"), std::string::npos);
+    EXPECT_NE(output.find("detail=\"broken pipe\""), std::string::npos);
+}
+
+TEST_F(LoggerTest, LongFieldsAreWrittenWhole) {
+    std::string streamId = "live/" + std::string(200, 's');
+    std::string detail = "/etc/dl_srt_server.conf: " + std::string(400, 'k');
+    LOG_WARNING("Ignored config keys", LogFields().stream(streamId).with(detail));
+    LOG_INFO("Short message after", LogFields().with("short"));
+
+    std::string output = getCaptured();
+    EXPECT_NE(output.find("stream=" + streamId), std::string::npos);
+    EXPECT_NE(output.find("detail=\"" + detail + "\""), std::string::npos);
+    EXPECT_NE(output.find("detail=short"), std::string::npos);
+}
+
+TEST_F(LoggerTest, FiltersBelowMinimumLevel) {
+    LogSettings settings;
+    settings.minLevel = LogLevel::Warning;
+    Logger::instance().configure(settings);
+
+    LOG_INFO("Filtered message");
+    LOG_WARNING("Visible message");
+
+    std::string output = getCaptured();
+    EXPECT_EQ(output.find("Filtered message"), std::string::npos);
+    EXPECT_NE(output.find("Visible message"), std::string::npos);
+}
+
+TEST_F(LoggerTest, SuppressesRepeatsAndReportsCount) {
+    LogSettings settings;
+    settings.maxPerSitePerSecond = 5;
+    Logger::instance().configure(settings);
+
+    auto logRepeated = [] {
+        LOG_WARNING("Repeated message");
+    };
+    for (int i = 0; i < 100; ++i) {
+        logRepeated();
+    }
+    EXPECT_EQ(countOccurrences(getCaptured(), "Repeated message"), 5);
+
+    // The next message after the window reports how many were suppressed
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    logRepeated();
+    std::string output = getCaptured();
+    EXPECT_EQ(countOccurrences(output, "Repeated message"), 6);
+    EXPECT_NE(output.find("suppressed=95"), std::string::npos);
+}
+
+TEST_F(LoggerTest, CollectsMessagesFromAllThreads) {
+    LogSettings settings;
+    settings.maxPerSitePerSecond = 1000;
+    Logger::instance().configure(settings);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([] {
+            for (int i = 0; i < 50; ++i) {
+                LOG_INFO("Threaded message");
+            }
+        });
+    }
+    for (auto &thread: threads) {
+        thread.join();
+    }
+
+    EXPECT_EQ(countOccurrences(getCaptured(), "Threaded message"), 200);
+    EXPECT_EQ(Logger::instance().getDroppedCount(), 0);
+}
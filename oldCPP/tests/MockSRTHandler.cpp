@@ -22,12 +22,14 @@
 MockSRTHandler::MockSRTHandler(std::string streamId) {
     EXPECT_CALL(*this, getStreamId())
             .WillRepeatedly(testing::Return(streamId));
+    EXPECT_CALL(*this, getStreamParams())
+            .WillRepeatedly(testing::ReturnRef(m_streamParams));
 }
 
 void MockSRTHandler::expectReceivingData(const char *data, int len) {
-    EXPECT_CALL(*this, receive(testing::_, testing::_))
+    EXPECT_CALL(*this, receive(testing::_, testing::_, testing::_))
             .WillRepeatedly(testing::DoAll(
-                testing::Invoke([data, len](char *buffer, int bufferLen) {
+                testing::Invoke([data, len](char *buffer, int bufferLen, MessageControl &) {
                     // Simulate receiving some data
                     memcpy(buffer, data, len);
                     return len;
@@ -38,10 +40,10 @@ void MockSRTHandler::expectReceivingData(const char *data, int len) {
 
 void MockSRTHandler::expectReceivingDataDisconnects() {
     const char *data = "Some Test Data";
-    EXPECT_CALL(*this, receive(testing::_, testing::_))
+    EXPECT_CALL(*this, receive(testing::_, testing::_, testing::_))
             // First request Succeeds
             .WillOnce(testing::DoAll(
-                testing::Invoke([data](char *buffer, int bufferLen) {
+                testing::Invoke([data](char *buffer, int bufferLen, MessageControl &) {
                     // Simulate receiving some data
                     memcpy(buffer, data, bufferLen);
                     return strlen(data);
@@ -50,7 +52,7 @@ void MockSRTHandler::expectReceivingDataDisconnects() {
             ))
             // Second request fails (simulate stream disconnect)
             .WillOnce(testing::DoAll(
-                testing::Invoke([](char *buffer, int bufferLen) {
+                testing::Invoke([](char *buffer, int bufferLen, MessageControl &) {
                     std::vector<char> data(bufferLen);
                     // Simulate receiving no data
                     memcpy(buffer, data.data(), bufferLen);
@@ -62,9 +64,9 @@ void MockSRTHandler::expectReceivingDataDisconnects() {
 
 
 void MockSRTHandler::expectSendingData(const char *expectedData, int expectedLen) {
-    EXPECT_CALL(*this, send(testing::_, testing::_))
+    EXPECT_CALL(*this, send(testing::_, testing::_, testing::_))
             .WillRepeatedly(testing::DoAll(
-                testing::Invoke([expectedData, expectedLen](const char *buffer, int len) {
+                testing::Invoke([expectedData, expectedLen](const char *buffer, int len, const MessageControl &) {
                     // Verify that the subscriber received the data
                     EXPECT_EQ(len, expectedLen);
                     EXPECT_EQ(memcmp(buffer, expectedData, len), 0);
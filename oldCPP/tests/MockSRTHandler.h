@@ -29,13 +29,21 @@ public:
     explicit MockSRTHandler(std::string streamId);
 
     MOCK_METHOD(std::string, getStreamId, (), (const, override));
-    MOCK_METHOD(int, receive, (char *, int), (override));
-    MOCK_METHOD(int, send, (const char *, int), (override));
+    MOCK_METHOD(int, receive, (char *, int, MessageControl &), (override));
+    MOCK_METHOD(int, send, (const char *, int, const MessageControl &), (override));
     MOCK_METHOD(bool, disconnect, (), (override));
+    MOCK_METHOD(const StreamIdParams &, getStreamParams, (), (const, override));
+    MOCK_METHOD(void, setNonBlockingSend, (), (override));
+
+    // Parameters returned by getStreamParams(), e.g. "#!::r=test,qos=critical"
+    void setStreamParams(const std::string &rawStreamId) { m_streamParams = StreamIdParams::parse(rawStreamId); }
 
     void expectReceivingData(const char *data, int len);
     void expectReceivingDataDisconnects();
     void expectSendingData(const char *data, int len);
+
+private:
+    StreamIdParams m_streamParams;
 };
 
 #endif //MOCKSRTHANDLER_H
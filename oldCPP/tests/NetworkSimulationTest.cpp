@@ -0,0 +1,176 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <core/StreamManager.h>
+
+#include "SimulatedNetwork.h"
+
+// Congestion scenarios run through StreamManager and StreamSession over simulated links. Delivery is
+// computed in virtual time, so the assertions on throughput and latency hold on any CI machine.
+class NetworkSimulationTest : public ::testing::Test {
+protected:
+    struct Viewer {
+        std::shared_ptr<SimulatedSubscriber> handler;
+        LinkResult result;
+    };
+
+    std::shared_ptr<VirtualClock> clock = std::make_shared<VirtualClock>();
+    std::shared_ptr<SimulatedPublisher> publisher;
+
+    static LinkProfile healthyLink(uint64_t seed) {
+        LinkProfile link;
+        link.bandwidthBitsPerSecond = 20000000;
+        link.delayMicros = 20000;
+        link.jitterMicros = 5000;
+        link.lossRate = 0.01;
+        link.seed = seed;
+        return link;
+    }
+
+    // Subscribers join first and are attached in one batch when the publisher connects, so every
+    // one of them sees the stream from its first packet
+    std::vector<Viewer> run(const EncoderProfile &encoder, const std::vector<LinkProfile> &links) {
+        auto manager = std::make_shared<StreamManager>();
+        std::vector<Viewer> viewers;
+        for (size_t i = 0; i < links.size(); ++i) {
+            auto handler = std::make_shared<SimulatedSubscriber>("sim-stream", "10.1.0." + std::to_string(i) +
+                                                                 ":9000", links[i]);
+            EXPECT_TRUE(manager->onSubscriberConnected(handler));
+            viewers.push_back(Viewer{handler, LinkResult()});
+        }
+        publisher = std::make_shared<SimulatedPublisher>("sim-stream", encoder, clock);
+        EXPECT_TRUE(manager->onPublisherConnected(publisher));
+        publisher->start();
+
+        // The session ends itself when the script runs out
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+        while ((!publisher->isFinished() || manager->getSessionCount() > 0) &&
+               std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        EXPECT_TRUE(publisher->isFinished());
+        EXPECT_EQ(manager->getSessionCount(), 0u);
+        manager.reset();
+
+        for (auto &viewer: viewers) {
+            viewer.result = viewer.handler->getResult();
+        }
+        return viewers;
+    }
+};
+
+TEST_F(NetworkSimulationTest, SlowViewerIsCutOffWhileOthersKeepUp) {
+    EncoderProfile encoder;
+    encoder.bitrateBitsPerSecond = 4000000;
+    encoder.durationMicros = 3000000;
+
+    LinkProfile slowLink;
+    slowLink.bandwidthBitsPerSecond = 2000000;
+    slowLink.sendBufferBytes = 64 * 1024;
+    auto viewers = run(encoder, {healthyLink(1), healthyLink(2), healthyLink(3), slowLink});
+
+    const LinkResult &slow = viewers[3].result;
+    EXPECT_TRUE(slow.failed);
+    EXPECT_LT(slow.packetsSent, publisher->getPacketCount());
+
+    for (size_t i = 0; i < 3; ++i) {
+        const LinkResult &healthy = viewers[i].result;
+        EXPECT_FALSE(healthy.failed);
+        EXPECT_EQ(healthy.packetsSent, publisher->getPacketCount());
+        EXPECT_EQ(healthy.packetsDropped, 0);
+        EXPECT_GT(healthy.packetsRetransmitted, 0);
+        EXPECT_NEAR(healthy.throughputBitsPerSecond(), 4000000.0, 200000.0);
+        EXPECT_LT(healthy.latencyPercentile(50), 30000);
+        EXPECT_LT(healthy.latencyPercentile(99), 120000);
+    }
+}
+
+TEST_F(NetworkSimulationTest, KeyframeBurstsQueueWithinTheLatencyWindow) {
+    EncoderProfile encoder;
+    encoder.bitrateBitsPerSecond = 6000000;
+    encoder.durationMicros = 3000000;
+    encoder.gopMicros = 500000;
+    encoder.burstPackets = 40;
+
+    LinkProfile link;
+    link.bandwidthBitsPerSecond = 10000000;
+    link.sendBufferBytes = 256 * 1024;
+    auto viewers = run(encoder, {link});
+
+    const LinkResult &result = viewers[0].result;
+    EXPECT_FALSE(result.failed);
+    EXPECT_EQ(result.packetsDelivered, publisher->getPacketCount());
+    // The last packet of a 40 packet burst waits behind the other 39 on a 10 Mbps link
+    EXPECT_GT(result.latencyPercentile(100), 50000);
+    EXPECT_LT(result.latencyPercentile(100), 70000);
+    EXPECT_LT(result.latencyPercentile(50), 15000);
+    EXPECT_GE(clock->now(), encoder.durationMicros - encoder.gopMicros);
+}
+
+TEST_F(NetworkSimulationTest, MassDisconnectLeavesSurvivorsIntact) {
+    EncoderProfile encoder;
+    encoder.bitrateBitsPerSecond = 2000000;
+    encoder.durationMicros = 2000000;
+
+    // Enough viewers for the sharded fan-out, most of them dropping at once halfway through
+    std::vector<LinkProfile> links;
+    for (uint64_t i = 0; i < 600; ++i) {
+        LinkProfile link = healthyLink(i + 1);
+        if (i % 6 != 0) {
+            link.downAtMicros = 1000000;
+        }
+        links.push_back(link);
+    }
+    auto viewers = run(encoder, links);
+
+    int64_t halfway = publisher->getPacketCount() / 2;
+    for (size_t i = 0; i < viewers.size(); ++i) {
+        const LinkResult &result = viewers[i].result;
+        if (i % 6 == 0) {
+            EXPECT_FALSE(result.failed) << i;
+            EXPECT_EQ(result.packetsSent, publisher->getPacketCount()) << i;
+            EXPECT_EQ(result.packetsDropped, 0) << i;
+        } else {
+            EXPECT_TRUE(result.failed) << i;
+            EXPECT_NEAR(static_cast<double>(result.packetsSent), static_cast<double>(halfway), 2.0) << i;
+        }
+    }
+}
+
+TEST_F(NetworkSimulationTest, ScenariosReplayIdentically) {
+    EncoderProfile encoder;
+    encoder.durationMicros = 2000000;
+    encoder.gopMicros = 500000;
+    encoder.burstPackets = 20;
+
+    LinkProfile slowLink = healthyLink(7);
+    slowLink.bandwidthBitsPerSecond = 3000000;
+    slowLink.sendBufferBytes = 32 * 1024;
+    auto first = run(encoder, {healthyLink(5), slowLink});
+    auto second = run(encoder, {healthyLink(5), slowLink});
+
+    for (size_t i = 0; i < first.size(); ++i) {
+        EXPECT_EQ(first[i].result.packetsSent, second[i].result.packetsSent);
+        EXPECT_EQ(first[i].result.packetsRetransmitted, second[i].result.packetsRetransmitted);
+        EXPECT_EQ(first[i].result.latencies, second[i].result.latencies);
+        EXPECT_EQ(first[i].result.failed, second[i].result.failed);
+    }
+}
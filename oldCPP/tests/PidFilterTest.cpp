@@ -0,0 +1,137 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include <utils/PidFilter.h>
+
+namespace {
+    void appendPacket(std::string &message, uint16_t pid) {
+        std::string packet(PidFilter::TS_PACKET_SIZE, '\xff');
+        packet[0] = 0x47;
+        packet[1] = static_cast<char>((pid >> 8) & 0x1f);
+        packet[2] = static_cast<char>(pid & 0xff);
+        message += packet;
+    }
+
+    uint16_t pidAt(const char *data, size_t index) {
+        const auto *packet = reinterpret_cast<const uint8_t *>(data + index * PidFilter::TS_PACKET_SIZE);
+        return static_cast<uint16_t>(((packet[1] & 0x1f) << 8) | packet[2]);
+    }
+}
+
+TEST(PidFilterTest, ParsesDecimalAndHexPids) {
+    PidFilter filter;
+    EXPECT_TRUE(PidFilter::parse("0x100:257", filter));
+    EXPECT_TRUE(filter.matches(0));
+    EXPECT_TRUE(filter.matches(256));
+    EXPECT_TRUE(filter.matches(257));
+    EXPECT_FALSE(filter.matches(258));
+    EXPECT_EQ(filter.getKey(), "0:256:257");
+
+    PidFilter reordered;
+    EXPECT_TRUE(PidFilter::parse("257:256", reordered));
+    EXPECT_EQ(reordered.getKey(), filter.getKey());
+
+    EXPECT_FALSE(PidFilter::parse("256:audio", filter));
+    EXPECT_FALSE(PidFilter::parse("9000", filter));
+}
+
+TEST(PidFilterTest, RepacksMatchingPacketsIntoFullPayloads) {
+    PidFilter filter;
+    ASSERT_TRUE(PidFilter::parse("256", filter));
+    TsRepacketizer repacketizer(filter);
+
+    // Each message carries 4 video (256) and 3 other packets
+    std::string message;
+    for (uint16_t pid: {256, 300, 256, 301, 256, 302, 256}) {
+        appendPacket(message, pid);
+    }
+
+    std::vector<std::string> payloads;
+    auto now = std::chrono::steady_clock::now();
+    for (int i = 0; i < 7; ++i) {
+        repacketizer.process(message.data(), static_cast<int>(message.size()), MessageControl(), now,
+                             [&payloads](const char *data, int len, const MessageControl &) {
+                                 payloads.emplace_back(data, len);
+                             });
+    }
+
+    // 28 matching packets make four full payloads
+    ASSERT_EQ(payloads.size(), 4u);
+    for (const auto &payload: payloads) {
+        ASSERT_EQ(payload.size(), TsRepacketizer::PAYLOAD_SIZE);
+        for (size_t i = 0; i < TsRepacketizer::PACKETS_PER_PAYLOAD; ++i) {
+            EXPECT_EQ(pidAt(payload.data(), i), 256);
+        }
+    }
+}
+
+TEST(PidFilterTest, SparsePacketsAreFlushedAfterMaxHold) {
+    PidFilter filter;
+    ASSERT_TRUE(PidFilter::parse("400", filter));
+    TsRepacketizer repacketizer(filter);
+
+    std::string message;
+    appendPacket(message, 400);
+    appendPacket(message, 256);
+
+    std::vector<std::string> payloads;
+    auto emit = [&payloads](const char *data, int len, const MessageControl &) { payloads.emplace_back(data, len); };
+    auto start = std::chrono::steady_clock::now();
+    repacketizer.process(message.data(), static_cast<int>(message.size()), MessageControl(), start, emit);
+    EXPECT_TRUE(payloads.empty());
+
+    repacketizer.process(message.data(), static_cast<int>(message.size()), MessageControl(),
+                         start + TsRepacketizer::MAX_HOLD, emit);
+    ASSERT_EQ(payloads.size(), 1u);
+    EXPECT_EQ(payloads[0].size(), 2 * PidFilter::TS_PACKET_SIZE);
+}
+
+TEST(PidFilterTest, PayloadsCarryTheControlOfTheirOldestPacket) {
+    PidFilter filter;
+    ASSERT_TRUE(PidFilter::parse("256", filter));
+    TsRepacketizer repacketizer(filter);
+
+    // Three matching packets per message, a payload completes in the third message
+    std::string message;
+    for (uint16_t pid: {256, 300, 256, 256}) {
+        appendPacket(message, pid);
+    }
+
+    std::vector<MessageControl> controls;
+    auto now = std::chrono::steady_clock::now();
+    for (int32_t messageNumber = 1; messageNumber <= 3; ++messageNumber) {
+        MessageControl control;
+        control.sourceTime = messageNumber * 1000;
+        control.messageNumber = messageNumber;
+        control.boundary = MessageBoundary::First;
+        repacketizer.process(message.data(), static_cast<int>(message.size()), control, now,
+                             [&controls](const char *, int, const MessageControl &payloadControl) {
+                                 controls.push_back(payloadControl);
+                             });
+    }
+
+    ASSERT_EQ(controls.size(), 1u);
+    EXPECT_EQ(controls[0].messageNumber, 1);
+    EXPECT_EQ(controls[0].sourceTime, 1000);
+    EXPECT_EQ(controls[0].boundary, MessageBoundary::Solo);
+}
@@ -0,0 +1,49 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <core/QosPolicy.h>
+#include <core/ServerConfig.h>
+
+TEST(QosPolicyTest, ClassComesFromStreamIdOrDefault) {
+    QosSettings qos;
+    EXPECT_EQ(qos.classOf(StreamIdParams::parse("#!::r=live,qos=critical")), QosClass::Critical);
+    EXPECT_EQ(qos.classOf(StreamIdParams::parse("#!::r=live,qos=preview")), QosClass::BestEffort);
+    EXPECT_EQ(qos.classOf(StreamIdParams::parse("#!::r=live,qos=bogus")), QosClass::Standard);
+    EXPECT_EQ(qos.classOf(StreamIdParams::parse("live")), QosClass::Standard);
+
+    qos.defaultClass = QosClass::BestEffort;
+    EXPECT_EQ(qos.classOf(StreamIdParams::parse("live")), QosClass::BestEffort);
+}
+
+TEST(QosPolicyTest, ConfigSetsPerClassBudgets) {
+    ServerConfig config;
+    EXPECT_TRUE(config.apply("qos.default_class", "best_effort"));
+    EXPECT_TRUE(config.apply("qos.critical.queue_percent", "800"));
+    EXPECT_TRUE(config.apply("qos.best_effort.send_budget_us", "5000"));
+    EXPECT_TRUE(config.apply("qos.overload_disconnect_ms", "0"));
+    EXPECT_FALSE(config.apply("qos.gold.queue_percent", "100"));
+    EXPECT_FALSE(config.apply("qos.standard.unknown", "1"));
+
+    EXPECT_EQ(config.qos.defaultClass, QosClass::BestEffort);
+    EXPECT_EQ(config.qos.get(QosClass::Critical).queuePercent, 800);
+    EXPECT_EQ(config.qos.get(QosClass::BestEffort).sendBudget, std::chrono::microseconds(5000));
+    EXPECT_EQ(config.qos.overloadDisconnect.count(), 0);
+}
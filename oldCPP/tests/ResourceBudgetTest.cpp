@@ -0,0 +1,87 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <core/ResourceBudget.h>
+#include <core/ServerConfig.h>
+
+namespace {
+    SessionUsage usageOf(int64_t cpuMicros, size_t bufferedBytes) {
+        SessionUsage usage;
+        usage.cpuMicros = cpuMicros;
+        usage.bufferedBytes = bufferedBytes;
+        return usage;
+    }
+}
+
+TEST(ResourceBudgetTest, CpuPercentComesFromDeltasBetweenChecks) {
+    ResourceBudgetSettings settings;
+    settings.streamCpuPercent = 50;
+    ResourceBudget budget(settings);
+    auto start = std::chrono::steady_clock::now();
+    bool nodeOverBudget = true;
+
+    // The first sample has nothing to compare against
+    auto usage = budget.evaluate({{"a", usageOf(5000000, 0)}, {"b", usageOf(0, 0)}}, start, nodeOverBudget);
+    ASSERT_EQ(usage.size(), 2u);
+    EXPECT_EQ(usage[0].cpuPercent, 0.0);
+    EXPECT_FALSE(usage[0].overBudget);
+    EXPECT_FALSE(nodeOverBudget);
+
+    // One second later "a" used 0.8s of CPU and "b" 0.1s
+    usage = budget.evaluate({{"a", usageOf(5800000, 0)}, {"b", usageOf(100000, 0)}},
+                            start + std::chrono::seconds(1), nodeOverBudget);
+    EXPECT_NEAR(usage[0].cpuPercent, 80.0, 0.01);
+    EXPECT_TRUE(usage[0].overBudget);
+    EXPECT_NEAR(usage[1].cpuPercent, 10.0, 0.01);
+    EXPECT_FALSE(usage[1].overBudget);
+}
+
+TEST(ResourceBudgetTest, NodeBudgetSumsAllStreams) {
+    ResourceBudgetSettings settings;
+    settings.totalBufferedBytes = 1000;
+    settings.streamBufferedBytes = 800;
+    ResourceBudget budget(settings);
+    bool nodeOverBudget = false;
+
+    auto usage = budget.evaluate({{"a", usageOf(0, 600)}, {"b", usageOf(0, 600)}},
+                                 std::chrono::steady_clock::now(), nodeOverBudget);
+    EXPECT_FALSE(usage[0].overBudget);
+    EXPECT_FALSE(usage[1].overBudget);
+    EXPECT_TRUE(nodeOverBudget);
+
+    usage = budget.evaluate({{"a", usageOf(0, 900)}}, std::chrono::steady_clock::now(), nodeOverBudget);
+    EXPECT_TRUE(usage[0].overBudget);
+    EXPECT_FALSE(nodeOverBudget);
+}
+
+TEST(ResourceBudgetTest, ConfigSetsBudgets) {
+    ServerConfig config;
+    EXPECT_TRUE(config.apply("budget.stream_cpu_percent", "40"));
+    EXPECT_TRUE(config.apply("budget.stream_buffered_kb", "512"));
+    EXPECT_TRUE(config.apply("budget.total_cpu_percent", "600"));
+    EXPECT_TRUE(config.apply("budget.check_interval_ms", "250"));
+    EXPECT_FALSE(config.apply("budget.total_buffered_kb", "lots"));
+
+    EXPECT_EQ(config.budget.streamCpuPercent, 40);
+    EXPECT_EQ(config.budget.streamBufferedBytes, 512u * 1024);
+    EXPECT_EQ(config.budget.totalCpuPercent, 600);
+    EXPECT_EQ(config.budget.checkInterval, std::chrono::milliseconds(250));
+}
@@ -0,0 +1,157 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+
+#include <utils/SharedMemoryOutput.h>
+#include <utils/SharedMemoryRing.h>
+
+class SharedMemoryRingTest : public ::testing::Test {
+protected:
+    std::string ringName;
+
+    void SetUp() override {
+        // Unique per test so parallel runs don't share a ring
+        ringName = SharedMemoryRing::objectName(
+            "dl_srt_test_", ::testing::UnitTest::GetInstance()->current_test_info()->name());
+    }
+
+    static MessageControl makeControl(int64_t sourceTime) {
+        MessageControl control;
+        control.sourceTime = sourceTime;
+        return control;
+    }
+};
+
+TEST_F(SharedMemoryRingTest, ReaderReceivesPublishedPackets) {
+    auto writer = SharedMemoryRing::create(ringName, 16, 1456);
+    ASSERT_NE(writer, nullptr);
+    auto reader = SharedMemoryRing::attach(ringName);
+    ASSERT_NE(reader, nullptr);
+    EXPECT_EQ(reader->getSlotCount(), 16);
+
+    EXPECT_TRUE(writer->publish("first", 5, makeControl(100)));
+    EXPECT_TRUE(writer->publish("second", 6, makeControl(200)));
+
+    uint64_t cursor = 0;
+    uint64_t lost = 0;
+    char buffer[1456];
+    MessageControl control;
+
+    EXPECT_EQ(reader->read(cursor, buffer, sizeof(buffer), control, lost), 5);
+    EXPECT_EQ(std::string(buffer, 5), "first");
+    EXPECT_EQ(control.sourceTime, 100);
+    EXPECT_EQ(reader->read(cursor, buffer, sizeof(buffer), control, lost), 6);
+    EXPECT_EQ(std::string(buffer, 6), "second");
+    EXPECT_EQ(reader->read(cursor, buffer, sizeof(buffer), control, lost), 0);
+    EXPECT_EQ(lost, 0);
+}
+
+TEST_F(SharedMemoryRingTest, SlowReaderSkipsOverwrittenPackets) {
+    auto writer = SharedMemoryRing::create(ringName, 8, 64);
+    ASSERT_NE(writer, nullptr);
+    auto reader = SharedMemoryRing::attach(ringName);
+    ASSERT_NE(reader, nullptr);
+
+    for (int i = 0; i < 20; ++i) {
+        EXPECT_TRUE(writer->publish("x", 1, makeControl(i)));
+    }
+
+    uint64_t cursor = 0;
+    uint64_t lost = 0;
+    char buffer[64];
+    MessageControl control;
+    EXPECT_EQ(reader->read(cursor, buffer, sizeof(buffer), control, lost), 1);
+    EXPECT_GE(lost, 12);
+    EXPECT_EQ(control.sourceTime, static_cast<int64_t>(lost));
+}
+
+TEST_F(SharedMemoryRingTest, RejectsOversizedPackets) {
+    auto writer = SharedMemoryRing::create(ringName, 8, 16);
+    ASSERT_NE(writer, nullptr);
+
+    char packet[32] = {};
+    EXPECT_FALSE(writer->publish(packet, sizeof(packet), MessageControl()));
+    EXPECT_EQ(writer->getWriteSequence(), 0);
+}
+
+TEST_F(SharedMemoryRingTest, OutputSkipsOversizedPackets) {
+    SharedMemorySettings settings;
+    settings.namePrefix = "dl_srt_test_output_";
+    settings.slotCount = 8;
+    settings.slotSize = 16;
+    auto output = SharedMemoryOutput::create(ringName, settings);
+    ASSERT_NE(output, nullptr);
+
+    // Dropped and counted, the output stays usable
+    char packet[32] = {};
+    EXPECT_TRUE(output->write(packet, sizeof(packet), MessageControl()));
+    EXPECT_EQ(output->getDroppedPackets(), 1u);
+    EXPECT_TRUE(output->write(packet, 16, MessageControl()));
+    EXPECT_EQ(output->getDroppedPackets(), 1u);
+    output->close();
+}
+
+TEST_F(SharedMemoryRingTest, WaitingReaderWakesOnPublishAndClose) {
+    auto writer = SharedMemoryRing::create(ringName, 16, 64);
+    ASSERT_NE(writer, nullptr);
+    auto reader = SharedMemoryRing::attach(ringName);
+    ASSERT_NE(reader, nullptr);
+
+    std::atomic<int> packetsRead{0};
+    std::atomic<bool> sawClose{false};
+    std::thread consumer([&] {
+        uint64_t cursor = 0;
+        uint64_t lost = 0;
+        char buffer[64];
+        MessageControl control;
+        while (reader->waitForData(cursor, std::chrono::milliseconds(1000))) {
+            int result;
+            while ((result = reader->read(cursor, buffer, sizeof(buffer), control, lost)) > 0) {
+                ++packetsRead;
+            }
+            if (result == STREAM_ERROR) {
+                sawClose = true;
+                return;
+            }
+        }
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    for (int i = 0; i < 5; ++i) {
+        writer->publish("data", 4, MessageControl());
+    }
+    writer->close();
+    consumer.join();
+
+    EXPECT_EQ(packetsRead.load(), 5);
+    EXPECT_TRUE(sawClose.load());
+}
+
+TEST_F(SharedMemoryRingTest, AttachFailsWithoutWriter) {
+    EXPECT_EQ(SharedMemoryRing::attach(ringName), nullptr);
+
+    auto writer = SharedMemoryRing::create(ringName, 8, 64);
+    ASSERT_NE(writer, nullptr);
+    writer.reset();
+    EXPECT_EQ(SharedMemoryRing::attach(ringName), nullptr);
+}
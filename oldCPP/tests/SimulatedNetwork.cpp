@@ -0,0 +1,197 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "SimulatedNetwork.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    constexpr int64_t MICROS_PER_SECOND = 1000000;
+}
+
+void VirtualClock::advanceTo(int64_t time) {
+    int64_t current = m_now.load(std::memory_order_relaxed);
+    while (time > current && !m_now.compare_exchange_weak(current, time, std::memory_order_acq_rel)) {
+    }
+}
+
+SimulatedPublisher::SimulatedPublisher(std::string streamId, EncoderProfile profile,
+                                       std::shared_ptr<VirtualClock> clock)
+    : m_streamId(std::move(streamId)),
+      m_profile(profile),
+      m_clock(std::move(clock)) {
+    int64_t bytes = m_profile.bitrateBitsPerSecond / 8 * m_profile.durationMicros / MICROS_PER_SECOND;
+    m_packetCount = std::max<int64_t>(bytes / m_profile.packetSize, 1);
+    m_packetInterval = static_cast<int64_t>(m_profile.packetSize) * 8 * MICROS_PER_SECOND /
+                       m_profile.bitrateBitsPerSecond;
+}
+
+void SimulatedPublisher::start() {
+    std::lock_guard<std::mutex> lock(m_startMutex);
+    m_started = true;
+    m_startCV.notify_all();
+}
+
+bool SimulatedPublisher::disconnect() {
+    // Also releases a session stopped before start()
+    start();
+    m_finished = true;
+    return true;
+}
+
+int SimulatedPublisher::receive(char *buffer, int len, MessageControl &control) {
+    {
+        std::unique_lock<std::mutex> lock(m_startMutex);
+        m_startCV.wait(lock, [this] { return m_started; });
+    }
+    if (m_finished || m_nextPacket >= m_packetCount) {
+        m_finished = true;
+        return STREAM_ERROR;
+    }
+
+    int64_t sequence = m_nextPacket++;
+    int64_t sendTime = sequence * m_packetInterval;
+    if (m_profile.gopMicros > 0 && m_profile.burstPackets > 0) {
+        // The group's first packets leave together at the start of the group, the rest keep their slots
+        int64_t packetsPerGop = std::max<int64_t>(m_profile.gopMicros / m_packetInterval, 1);
+        int64_t inGop = sequence % packetsPerGop;
+        if (inGop < m_profile.burstPackets) {
+            sendTime = (sequence - inGop) * m_packetInterval;
+        }
+    }
+    // Timestamps start at 1, 0 means unknown to the session
+    control.sourceTime = sendTime + 1;
+    control.receiveTime = sendTime + 1;
+    control.messageNumber = static_cast<int32_t>(sequence);
+    m_clock->advanceTo(control.sourceTime);
+
+    int size = std::min(len, m_profile.packetSize);
+    std::memset(buffer, 0, size);
+    std::memcpy(buffer, &sequence, std::min<int>(size, sizeof(sequence)));
+    return size;
+}
+
+double LinkResult::throughputBitsPerSecond() const {
+    if (firstSendMicros < 0 || lastArrivalMicros <= firstSendMicros) {
+        return 0.0;
+    }
+    return static_cast<double>(bytesDelivered) * 8 * MICROS_PER_SECOND / (lastArrivalMicros - firstSendMicros);
+}
+
+int64_t LinkResult::latencyPercentile(double p) const {
+    if (latencies.empty()) {
+        return 0;
+    }
+    std::vector<int64_t> sorted = latencies;
+    std::sort(sorted.begin(), sorted.end());
+    size_t index = static_cast<size_t>(p / 100.0 * static_cast<double>(sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+SimulatedSubscriber::SimulatedSubscriber(std::string streamId, std::string peerAddress, LinkProfile profile)
+    : m_streamId(std::move(streamId)),
+      m_peerAddress(std::move(peerAddress)),
+      m_profile(profile),
+      m_random(profile.seed) {
+}
+
+LinkResult SimulatedSubscriber::getResult() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_result;
+}
+
+bool SimulatedSubscriber::disconnect() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_result.disconnected = true;
+    return true;
+}
+
+bool SimulatedSubscriber::isConnected() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return !m_result.disconnected && !m_result.failed;
+}
+
+std::string SimulatedSubscriber::getLastErrorMessage() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_lastError;
+}
+
+bool SimulatedSubscriber::getLinkStats(LinkStats &stats) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    stats.rttMs = static_cast<double>(2 * m_profile.delayMicros) / 1000.0;
+    stats.packetsSent = m_result.packetsSent;
+    stats.packetsRetransmitted = m_result.packetsRetransmitted;
+    stats.packetsSendLost = m_result.packetsDropped;
+    return true;
+}
+
+double SimulatedSubscriber::nextRandom() {
+    return static_cast<double>(m_random() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+int SimulatedSubscriber::send(const char *, int len, const MessageControl &control) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_result.disconnected || m_result.failed) {
+        return STREAM_ERROR;
+    }
+    int64_t now = control.sourceTime;
+    if (m_profile.downAtMicros > 0 && now >= m_profile.downAtMicros) {
+        m_result.failed = true;
+        m_lastError = "link down";
+        return STREAM_ERROR;
+    }
+
+    // What is still queued drains at the link rate
+    m_linkFreeAt = std::max(m_linkFreeAt, now);
+    int64_t queuedBytes = (m_linkFreeAt - now) * m_profile.bandwidthBitsPerSecond / 8 / MICROS_PER_SECOND;
+    if (queuedBytes + len > static_cast<int64_t>(m_profile.sendBufferBytes)) {
+        m_result.failed = true;
+        m_lastError = "send buffer full";
+        return STREAM_ERROR;
+    }
+    m_linkFreeAt += static_cast<int64_t>(len) * 8 * MICROS_PER_SECOND / m_profile.bandwidthBitsPerSecond;
+
+    if (m_result.firstSendMicros < 0) {
+        m_result.firstSendMicros = now;
+    }
+    ++m_result.packetsSent;
+
+    int64_t arrival = m_linkFreeAt + m_profile.delayMicros;
+    if (m_profile.jitterMicros > 0) {
+        arrival += static_cast<int64_t>(nextRandom() * static_cast<double>(m_profile.jitterMicros + 1));
+    }
+    // Each loss costs a round trip before the retransmission arrives, until the packet is too late anyway
+    while (m_profile.lossRate > 0.0 && arrival - now <= m_profile.latencyWindowMicros &&
+           nextRandom() < m_profile.lossRate) {
+        ++m_result.packetsRetransmitted;
+        arrival += 2 * m_profile.delayMicros;
+    }
+
+    int64_t latency = arrival - control.sourceTime;
+    if (latency > m_profile.latencyWindowMicros) {
+        ++m_result.packetsDropped;
+        return len;
+    }
+    ++m_result.packetsDelivered;
+    m_result.bytesDelivered += len;
+    m_result.latencies.push_back(latency);
+    m_result.lastArrivalMicros = std::max(m_result.lastArrivalMicros, arrival);
+    return len;
+}
@@ -0,0 +1,196 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SIMULATEDNETWORK_H
+#define SIMULATEDNETWORK_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <utils/StreamHandler.h>
+
+// Deterministic stand-ins for SRT connections. Time is virtual: the publisher stamps every packet with
+// its scripted send time in sourceTime, and links compute delivery from that stamp rather than from
+// the wall clock. Results don't depend on how fast the host runs the session threads.
+
+// Latest virtual time any publisher has reached, in microseconds
+class VirtualClock {
+public:
+    int64_t now() const { return m_now.load(std::memory_order_acquire); }
+
+    void advanceTo(int64_t time);
+
+private:
+    std::atomic<int64_t> m_now{0};
+};
+
+// One subscriber's path, from the server's send buffer to the player
+struct LinkProfile {
+    int64_t bandwidthBitsPerSecond = 100000000;
+    int64_t delayMicros = 10000;
+    // Extra delay drawn uniformly from [0, jitterMicros] per packet
+    int64_t jitterMicros = 0;
+    // Probability a transmission is lost and has to be retransmitted one round trip later
+    double lossRate = 0.0;
+    // Bytes waiting to go out before send() fails, like a full SRT send buffer
+    size_t sendBufferBytes = 1 << 20;
+    // Packets arriving later than this after their source time are dropped by the receiver, like SRT's TLPKTDROP
+    int64_t latencyWindowMicros = 120000;
+    // The link breaks at this virtual time, 0 keeps it up
+    int64_t downAtMicros = 0;
+    uint64_t seed = 1;
+};
+
+// Encoder script. Packets are spread evenly at bitrate, except that every gopMicros the first
+// burstPackets of the group go out back to back, like a keyframe.
+struct EncoderProfile {
+    int64_t bitrateBitsPerSecond = 4000000;
+    int packetSize = 1316;
+    int64_t durationMicros = 1000000;
+    int64_t gopMicros = 0;
+    int burstPackets = 0;
+};
+
+// Publisher connection replaying an EncoderProfile. Holds the first packet until start(), so the
+// subscribers of a scenario are attached before anything is sent.
+class SimulatedPublisher : public StreamHandler {
+public:
+    SimulatedPublisher(std::string streamId, EncoderProfile profile, std::shared_ptr<VirtualClock> clock);
+
+    void start();
+
+    // The script ran out and the publisher reported a disconnect
+    bool isFinished() const { return m_finished.load(std::memory_order_acquire); }
+
+    int64_t getPacketCount() const { return m_packetCount; }
+
+    bool disconnect() override;
+
+    int receive(char *buffer, int len, MessageControl &control) override;
+
+    int send(const char *, int, const MessageControl &) override { return STREAM_ERROR; }
+
+    bool isConnected() const override { return !m_finished; }
+
+    std::string getStreamId() const override { return m_streamId; }
+
+    const StreamIdParams &getStreamParams() const override { return m_streamParams; }
+
+    void setBandwidthHints(int64_t, int) override {}
+
+    std::string getLastErrorMessage() const override { return "end of script"; }
+
+    int getLastErrorCode() const override { return 0; }
+
+    std::string getPeerAddress() const override { return "sim-encoder:" + m_streamId; }
+
+    bool getLinkStats(LinkStats &) const override { return false; }
+
+private:
+    std::string m_streamId;
+    StreamIdParams m_streamParams;
+    EncoderProfile m_profile;
+    std::shared_ptr<VirtualClock> m_clock;
+    int64_t m_packetCount;
+    int64_t m_packetInterval;
+    int64_t m_nextPacket = 0;
+
+    std::mutex m_startMutex;
+    std::condition_variable m_startCV;
+    bool m_started = false;
+    std::atomic<bool> m_finished{false};
+};
+
+// What a subscriber's player saw, in virtual time
+struct LinkResult {
+    int64_t packetsSent = 0;
+    int64_t packetsDelivered = 0;
+    int64_t packetsRetransmitted = 0;
+    // Arrived after the latency window
+    int64_t packetsDropped = 0;
+    int64_t bytesDelivered = 0;
+    // Source to player, per delivered packet
+    std::vector<int64_t> latencies;
+    int64_t firstSendMicros = -1;
+    int64_t lastArrivalMicros = 0;
+    // send() failed, because the send buffer overflowed or the link went down
+    bool failed = false;
+    bool disconnected = false;
+
+    double throughputBitsPerSecond() const;
+
+    // p in [0, 100], 0 without deliveries
+    int64_t latencyPercentile(double p) const;
+};
+
+// Subscriber connection over a LinkProfile. The send buffer drains at the link bandwidth; a packet
+// that doesn't fit fails the send.
+class SimulatedSubscriber : public StreamHandler {
+public:
+    SimulatedSubscriber(std::string streamId, std::string peerAddress, LinkProfile profile);
+
+    LinkResult getResult() const;
+
+    bool disconnect() override;
+
+    int receive(char *, int, MessageControl &) override { return STREAM_ERROR; }
+
+    int send(const char *buffer, int len, const MessageControl &control) override;
+
+    bool isConnected() const override;
+
+    std::string getStreamId() const override { return m_streamId; }
+
+    const StreamIdParams &getStreamParams() const override { return m_streamParams; }
+
+    void setBandwidthHints(int64_t, int) override {}
+
+    std::string getLastErrorMessage() const override;
+
+    int getLastErrorCode() const override { return 0; }
+
+    std::string getPeerAddress() const override { return m_peerAddress; }
+
+    bool getLinkStats(LinkStats &stats) const override;
+
+private:
+    // Uniform in [0, 1), computed the same on every standard library
+    double nextRandom();
+
+    std::string m_streamId;
+    StreamIdParams m_streamParams;
+    std::string m_peerAddress;
+    LinkProfile m_profile;
+    std::mt19937_64 m_random;
+
+    mutable std::mutex m_mutex;
+    // Virtual time the link finishes transmitting what is already queued
+    int64_t m_linkFreeAt = 0;
+    std::string m_lastError;
+    LinkResult m_result;
+};
+
+
+#endif //SIMULATEDNETWORK_H
@@ -37,6 +37,21 @@ public:
     }
 };
 
+namespace {
+    // Output that always has a backlog
+    class BacklogOutput : public StreamOutput {
+    public:
+        bool write(const char *, int, const MessageControl &) override { return true; }
+
+        void close() override {
+        }
+
+        std::string getName() const override { return "backlog"; }
+
+        size_t getBufferedBytes() const override { return 4096; }
+    };
+}
+
 class StreamManagerTest : public ::testing::Test {
 protected:
     std::shared_ptr<StreamManagerTestHelper> streamManager;
@@ -106,6 +121,26 @@ TEST_F(StreamManagerTest, RemoveStreamRemovesStream) {
     EXPECT_TRUE(sessionsByStreamId.empty());
 }
 
+TEST_F(StreamManagerTest, StaleRemovalKeepsReconnectedPublisher) {
+    publisherAHandler->expectReceivingData("Some Test Data", 14);
+    EXPECT_TRUE(streamManager->onPublisherConnected(publisherAHandler));
+    EXPECT_TRUE(streamManager->dropStream("test-stream-A"));
+
+    // The encoder reconnects under the same ID before the old publisher's event is handled
+    auto reconnected = std::make_shared<MockSRTHandler>("test-stream-A");
+    reconnected->expectReceivingData("Some Test Data", 14);
+    EXPECT_TRUE(streamManager->onPublisherConnected(reconnected));
+    streamManager->removePublishingStream(publisherAHandler);
+
+    {
+        std::lock_guard<std::mutex> lock(streamManager->getSessionsMutex());
+        auto &sessions = streamManager->getSessionsByStreamId();
+        ASSERT_EQ(sessions.count("test-stream-A"), 1u);
+        EXPECT_EQ(sessions["test-stream-A"]->getStreamHandler(), reconnected);
+    }
+    streamManager->removePublishingStream(reconnected);
+}
+
 TEST_F(StreamManagerTest, OnPublisherDisconnectRemovesStream) {
     publisherAHandler->expectReceivingDataDisconnects();
 
@@ -124,3 +159,129 @@ TEST_F(StreamManagerTest, OnPublisherDisconnectRemovesStream) {
     }
     EXPECT_TRUE(sessionsByStreamId.empty());
 }
+
+TEST_F(StreamManagerTest, EarlySubscriberWaitsAndAttachesWithPublisher) {
+    EXPECT_TRUE(streamManager->onSubscriberConnected(subscriberAHandler));
+    EXPECT_EQ(streamManager->getWaitingSubscriberCount(), 1);
+
+    std::atomic<int> packetsSent{0};
+    EXPECT_CALL(*subscriberAHandler, send(testing::_, testing::_, testing::_))
+            .WillRepeatedly(testing::Invoke([&packetsSent](const char *, int len, const MessageControl &) {
+                ++packetsSent;
+                return len;
+            }));
+    publisherAHandler->expectReceivingData("Some Test Data", 14);
+    EXPECT_TRUE(streamManager->onPublisherConnected(publisherAHandler));
+    EXPECT_EQ(streamManager->getWaitingSubscriberCount(), 0);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_GT(packetsSent.load(), 0);
+
+    streamManager->removePublishingStream(publisherAHandler);
+}
+
+TEST_F(StreamManagerTest, WaitingSubscriberTimesOut) {
+    ServerConfig config;
+    config.waiting.timeout = std::chrono::seconds(1);
+    streamManager = std::make_shared<StreamManagerTestHelper>(config);
+
+    EXPECT_CALL(*subscriberAHandler, disconnect()).Times(1);
+    EXPECT_TRUE(streamManager->onSubscriberConnected(subscriberAHandler));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(1200));
+    EXPECT_EQ(streamManager->getWaitingSubscriberCount(), 0);
+}
+
+TEST_F(StreamManagerTest, SubscriberRejectedWhenWaitingDisabledOrFull) {
+    ServerConfig config;
+    config.waiting.maxPerStream = 1;
+    streamManager = std::make_shared<StreamManagerTestHelper>(config);
+
+    EXPECT_TRUE(streamManager->onSubscriberConnected(subscriberAHandler));
+    EXPECT_FALSE(streamManager->onSubscriberConnected(std::make_shared<MockSRTHandler>("test-stream-A")));
+
+    config.waiting.timeout = std::chrono::seconds(0);
+    auto noWaiting = std::make_shared<StreamManagerTestHelper>(config);
+    EXPECT_FALSE(noWaiting->onSubscriberConnected(subscriberBHandler));
+}
+
+TEST_F(StreamManagerTest, SubscriberWithInvalidPidFilterIsRejected) {
+    subscriberAHandler->setStreamParams("#!::r=test-stream-A,pids=video");
+    EXPECT_FALSE(streamManager->onSubscriberConnected(subscriberAHandler));
+    EXPECT_EQ(streamManager->getWaitingSubscriberCount(), 0);
+}
+
+TEST_F(StreamManagerTest, StreamOverBudgetRejectsSubscribers) {
+    ServerConfig config;
+    config.budget.streamBufferedBytes = 1;
+    config.sharedMemory.enabledByDefault = true;
+    streamManager = std::make_shared<StreamManagerTestHelper>(config);
+
+    publisherAHandler->expectReceivingData("Some Test Data", 14);
+    EXPECT_TRUE(streamManager->onPublisherConnected(publisherAHandler));
+    streamManager->checkResourceBudgets();
+
+    // The shared memory ring is reserved up front, it doesn't count against the budget
+    auto usage = streamManager->getSessionUsage();
+    ASSERT_EQ(usage.size(), 1u);
+    EXPECT_FALSE(usage[0].overBudget);
+    EXPECT_GT(usage[0].usage.reservedBytes, 0u);
+
+    // An output falling behind does
+    {
+        std::lock_guard<std::mutex> lock(streamManager->getSessionsMutex());
+        streamManager->getSessionsByStreamId().at("test-stream-A")->addOutput(std::make_shared<BacklogOutput>());
+    }
+    streamManager->checkResourceBudgets();
+
+    usage = streamManager->getSessionUsage();
+    ASSERT_EQ(usage.size(), 1u);
+    EXPECT_TRUE(usage[0].overBudget);
+    EXPECT_GT(usage[0].usage.bufferedBytes, 0u);
+    EXPECT_FALSE(streamManager->isNodeOverloaded());
+    EXPECT_FALSE(streamManager->onSubscriberConnected(subscriberAHandler));
+
+    streamManager->removePublishingStream(publisherAHandler);
+}
+
+TEST_F(StreamManagerTest, AppliedConfigChangesLimitsInPlace) {
+    EXPECT_TRUE(streamManager->onSubscriberConnected(subscriberAHandler));
+    EXPECT_EQ(streamManager->getWaitingSubscriberCount(), 1);
+
+    ServerConfig config;
+    config.waiting.maxPerStream = 1;
+    config.pacing.headroomPercent = 40;
+    EXPECT_TRUE(config.apply("listen.backlog", "64"));
+    EXPECT_TRUE(config.apply("session.buffer_size", "1316"));
+    streamManager->applyConfig(config);
+
+    // The subscriber already waiting stays, the limit applies to the next one
+    EXPECT_EQ(streamManager->getWaitingSubscriberCount(), 1);
+    EXPECT_FALSE(streamManager->onSubscriberConnected(std::make_shared<MockSRTHandler>("test-stream-A")));
+    EXPECT_EQ(config.listen.backlog, 64);
+}
+
+TEST_F(StreamManagerTest, DrainReleasesWaitingSubscribersAndDropsStreams) {
+    publisherAHandler->expectReceivingData("Some Test Data", 14);
+    EXPECT_TRUE(streamManager->onPublisherConnected(publisherAHandler));
+    EXPECT_TRUE(streamManager->onSubscriberConnected(subscriberBHandler));
+    EXPECT_EQ(streamManager->getSessionCount(), 1u);
+
+    // Stream B will never be published here again, its subscriber goes looking elsewhere
+    EXPECT_CALL(*subscriberBHandler, disconnect()).Times(1);
+    streamManager->setDraining(true);
+    EXPECT_EQ(streamManager->getWaitingSubscriberCount(), 0);
+    EXPECT_FALSE(streamManager->onPublisherConnected(publisherBHandler));
+    EXPECT_EQ(streamManager->getSessionCount(), 1u);
+
+    ServerConfig config;
+    EXPECT_TRUE(config.apply("drain.redirect_peers", "10.0.0.6:6000; [fd00::7]:6000;"));
+    EXPECT_EQ(config.drain.redirectPeers.size(), 2u);
+    EXPECT_FALSE(config.apply("drain.redirect_peers", "no-port"));
+    EXPECT_TRUE(config.apply("drain.close_spread_seconds", "0"));
+    streamManager->dropAllStreams(config.drain.closeSpread);
+    for (int i = 0; i < 100 && streamManager->getSessionCount() > 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(streamManager->getSessionCount(), 0u);
+}
@@ -48,6 +48,10 @@ public:
         return StreamSession::getSubscribers();
     }
 
+    const std::vector<std::shared_ptr<PacedSubscriber> > &getPacedSubscribers() const {
+        return StreamSession::getPacedSubscribers();
+    }
+
     std::atomic<bool> &getCleanupDone() {
         return StreamSession::getCleanupDone();
     }
@@ -215,3 +219,542 @@ TEST_F(StreamSessionTest, OnDisconnectCallbackIsCalled) {
 
     session.cleanupSession();
 }
+
+TEST_F(StreamSessionTest, FailedSubscriberKickedMeanwhileIsClosedOnce) {
+    auto mockEventListener = std::make_shared<MockStreamEventListener>();
+    StreamSessionTestHelper session(publisherHandler, mockEventListener);
+
+    const char testData[] = "some test data";
+    publisherHandler->expectReceivingData(testData, strlen(testData));
+
+    // Kicked while its failing send is in flight, both the kick and the failure removal see it
+    std::atomic<bool> kicked{false};
+    EXPECT_CALL(*subscriberHandler, send(testing::_, testing::_, testing::_))
+            .WillOnce(testing::Invoke([&](const char *, int, const MessageControl &) {
+                kicked = session.kickSubscriber("") == 1;
+                return STREAM_ERROR;
+            }));
+    std::atomic<int> closes{0};
+    EXPECT_CALL(*subscriberHandler, disconnect()).WillRepeatedly(testing::Invoke([&closes] {
+        ++closes;
+        return true;
+    }));
+
+    session.addSubscriber(subscriberHandler);
+    EXPECT_TRUE(session.startPublishing());
+    for (int i = 0; i < 100 && closes.load() == 0; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_TRUE(kicked.load());
+
+    EXPECT_CALL(*publisherHandler, disconnect()).Times(1);
+    session.cleanupSession();
+    EXPECT_EQ(closes.load(), 1);
+}
+
+TEST_F(StreamSessionTest, PacedSubscriberReceivesData) {
+    auto mockEventListener = std::make_shared<MockStreamEventListener>();
+    PacingSettings pacingSettings;
+    pacingSettings.enabledByDefault = true;
+    auto pacer = std::make_shared<SubscriberPacer>(pacingSettings);
+    SessionContext context;
+    context.pacer = pacer;
+    StreamSessionTestHelper session(publisherHandler, mockEventListener, context);
+
+    const char testData[] = "some test data";
+    const char testDataSend[] = "some test data";
+
+    publisherHandler->expectReceivingData(testData, strlen(testData));
+    subscriberHandler->expectSendingData(testDataSend, strlen(testDataSend));
+
+    session.addSubscriber(subscriberHandler);
+
+    // Paced subscribers are kept apart from the directly-sent ones
+    std::vector<std::shared_ptr<StreamHandler> > subscribers;
+    std::vector<std::shared_ptr<PacedSubscriber> > pacedSubscribers; {
+        std::lock_guard<std::mutex> lock(session.getSubscribersMutex());
+        subscribers = session.getSubscribers();
+        pacedSubscribers = session.getPacedSubscribers();
+    }
+    EXPECT_TRUE(subscribers.empty());
+    ASSERT_EQ(pacedSubscribers.size(), 1);
+    EXPECT_EQ(pacedSubscribers[0]->getHandler(), subscriberHandler);
+
+    EXPECT_TRUE(session.startPublishing());
+
+    // Wait for data to be queued and sent by the pacer
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    EXPECT_CALL(*publisherHandler, disconnect()).Times(1);
+    EXPECT_CALL(*subscriberHandler, disconnect()).Times(1);
+
+    session.cleanupSession();
+    pacer->stop();
+}
+
+TEST_F(StreamSessionTest, SubscribersReceiveSourceTime) {
+    auto mockEventListener = std::make_shared<MockStreamEventListener>();
+    StreamSessionTestHelper session(publisherHandler, mockEventListener);
+
+    EXPECT_CALL(*publisherHandler, receive(testing::_, testing::_, testing::_))
+            .WillRepeatedly(testing::Invoke([](char *buffer, int, MessageControl &control) {
+                memcpy(buffer, "test data", 9);
+                control.sourceTime = 1000;
+                control.receiveTime = 1500;
+                control.messageNumber = 7;
+                return 9;
+            }));
+
+    std::atomic<int> packetsWithSourceTime{0};
+    EXPECT_CALL(*subscriberHandler, send(testing::_, testing::_, testing::_))
+            .WillRepeatedly(testing::Invoke([&packetsWithSourceTime](const char *, int len,
+                                                                     const MessageControl &control) {
+                EXPECT_EQ(control.sourceTime, 1000);
+                EXPECT_EQ(control.messageNumber, 7);
+                ++packetsWithSourceTime;
+                return len;
+            }));
+
+    session.addSubscriber(subscriberHandler);
+    EXPECT_TRUE(session.startPublishing());
+
+    // Wait for data to be sent and received
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    EXPECT_CALL(*publisherHandler, disconnect()).Times(1);
+    EXPECT_CALL(*subscriberHandler, disconnect()).Times(1);
+
+    session.cleanupSession();
+    EXPECT_GT(packetsWithSourceTime.load(), 0);
+}
+
+class RecordingOutput : public StreamOutput {
+public:
+    std::atomic<int> packetsWritten{0};
+    std::atomic<bool> closed{false};
+
+    bool write(const char *, int, const MessageControl &) override {
+        ++packetsWritten;
+        return true;
+    }
+
+    void close() override { closed = true; }
+
+    std::string getName() const override { return "recording"; }
+};
+
+TEST_F(StreamSessionTest, OutputsReceiveDataAndCloseWithSession) {
+    auto mockEventListener = std::make_shared<MockStreamEventListener>();
+    StreamSessionTestHelper session(publisherHandler, mockEventListener);
+
+    EXPECT_CALL(*publisherHandler, receive(testing::_, testing::_, testing::_))
+            .WillRepeatedly(testing::Invoke([](char *buffer, int, MessageControl &) {
+                memcpy(buffer, "test data", 9);
+                return 9;
+            }));
+
+    auto output = std::make_shared<RecordingOutput>();
+    session.addOutput(output);
+    EXPECT_TRUE(session.startPublishing());
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    EXPECT_CALL(*publisherHandler, disconnect()).Times(1);
+    session.cleanupSession();
+
+    EXPECT_GT(output->packetsWritten.load(), 0);
+    EXPECT_TRUE(output->closed.load());
+}
+
+TEST_F(StreamSessionTest, HigherQosClassesAreSentFirst) {
+    auto mockEventListener = std::make_shared<MockStreamEventListener>();
+    StreamSessionTestHelper session(publisherHandler, mockEventListener);
+
+    EXPECT_CALL(*publisherHandler, receive(testing::_, testing::_, testing::_))
+            .WillOnce(testing::Invoke([](char *buffer, int, MessageControl &) {
+                memcpy(buffer, "test data", 9);
+                return 9;
+            }))
+            .WillRepeatedly(testing::Invoke([](char *, int, MessageControl &) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                return 0;
+            }));
+
+    std::mutex orderMutex;
+    std::vector<std::string> order;
+    std::vector<std::shared_ptr<StreamHandler> > subscribers;
+    for (const char *qos: {"best_effort", "standard", "critical"}) {
+        auto subscriber = std::make_shared<MockSRTHandler>("test-stream-id");
+        subscriber->setStreamParams(std::string("#!::r=test-stream-id,qos=") + qos);
+        std::string name = qos;
+        EXPECT_CALL(*subscriber, send(testing::_, testing::_, testing::_))
+                .WillRepeatedly(testing::Invoke([&orderMutex, &order, name](const char *, int len,
+                                                                            const MessageControl &) {
+                    std::lock_guard<std::mutex> lock(orderMutex);
+                    if (len > 0) {
+                        order.push_back(name);
+                    }
+                    return len;
+                }));
+        EXPECT_CALL(*subscriber, disconnect()).Times(1);
+        subscribers.push_back(subscriber);
+    }
+    session.addSubscribers(subscribers);
+    EXPECT_TRUE(session.startPublishing());
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+    EXPECT_CALL(*publisherHandler, disconnect()).Times(1);
+    session.cleanupSession();
+
+    std::lock_guard<std::mutex> lock(orderMutex);
+    EXPECT_EQ(order, (std::vector<std::string>{"critical", "standard", "best_effort"}));
+}
+
+TEST_F(StreamSessionTest, BestEffortIsShedWhenOverBudget) {
+    auto mockEventListener = std::make_shared<MockStreamEventListener>();
+    SessionContext context;
+    context.qos.get(QosClass::BestEffort).sendBudget = std::chrono::microseconds(100);
+    StreamSessionTestHelper session(publisherHandler, mockEventListener, context);
+
+    const char testData[] = "some test data";
+    publisherHandler->expectReceivingData(testData, strlen(testData));
+
+    // The critical subscriber is slow, so every packet is past the preview budget
+    auto critical = std::make_shared<MockSRTHandler>("test-stream-id");
+    critical->setStreamParams("#!::r=test-stream-id,qos=critical");
+    std::atomic<int> criticalPackets{0};
+    EXPECT_CALL(*critical, send(testing::_, testing::_, testing::_))
+            .WillRepeatedly(testing::Invoke([&criticalPackets](const char *, int len, const MessageControl &) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                ++criticalPackets;
+                return len;
+            }));
+    auto preview = std::make_shared<MockSRTHandler>("test-stream-id");
+    preview->setStreamParams("#!::r=test-stream-id,qos=preview");
+    EXPECT_CALL(*preview, send(testing::_, testing::_, testing::_)).Times(0);
+
+    session.addSubscribers({critical, preview});
+    EXPECT_TRUE(session.startPublishing());
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    EXPECT_CALL(*publisherHandler, disconnect()).Times(1);
+    EXPECT_CALL(*critical, disconnect()).Times(1);
+    EXPECT_CALL(*preview, disconnect()).Times(1);
+    session.cleanupSession();
+
+    EXPECT_GT(criticalPackets.load(), 0);
+    EXPECT_GT(session.getShedPackets(QosClass::BestEffort), 0u);
+    EXPECT_EQ(session.getShedPackets(QosClass::Critical), 0u);
+}
+
+TEST_F(StreamSessionTest, OverloadedSessionShedsBestEffort) {
+    auto mockEventListener = std::make_shared<MockStreamEventListener>();
+    StreamSessionTestHelper session(publisherHandler, mockEventListener);
+    session.setOverloaded(true);
+
+    const char testData[] = "some test data";
+    publisherHandler->expectReceivingData(testData, strlen(testData));
+
+    auto standard = std::make_shared<MockSRTHandler>("test-stream-id");
+    std::atomic<int> standardPackets{0};
+    EXPECT_CALL(*standard, send(testing::_, testing::_, testing::_))
+            .WillRepeatedly(testing::Invoke([&standardPackets](const char *, int len, const MessageControl &) {
+                ++standardPackets;
+                return len;
+            }));
+    auto preview = std::make_shared<MockSRTHandler>("test-stream-id");
+    preview->setStreamParams("#!::r=test-stream-id,qos=preview");
+    EXPECT_CALL(*preview, send(testing::_, testing::_, testing::_)).Times(0);
+
+    session.addSubscribers({standard, preview});
+    EXPECT_TRUE(session.startPublishing());
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    SessionUsage usage = session.getUsage();
+    EXPECT_EQ(usage.subscribers, 2u);
+    EXPECT_GT(usage.allocations, 0u);
+
+    EXPECT_CALL(*publisherHandler, disconnect()).Times(1);
+    EXPECT_CALL(*standard, disconnect()).Times(1);
+    EXPECT_CALL(*preview, disconnect()).Times(1);
+    session.cleanupSession();
+
+    EXPECT_GT(standardPackets.load(), 0);
+    EXPECT_GT(session.getShedPackets(QosClass::BestEffort), 0u);
+}
+
+TEST_F(StreamSessionTest, LastingOverloadDisconnectsStarvedBestEffort) {
+    auto mockEventListener = std::make_shared<MockStreamEventListener>();
+    StreamSessionTestHelper session(publisherHandler, mockEventListener);
+    QosSettings qos;
+    qos.overloadDisconnect = std::chrono::milliseconds(20);
+    session.applyTuning(FanoutSettings(), qos);
+    session.setOverloaded(true);
+
+    const char testData[] = "some test data";
+    publisherHandler->expectReceivingData(testData, strlen(testData));
+
+    auto standard = std::make_shared<MockSRTHandler>("test-stream-id");
+    EXPECT_CALL(*standard, send(testing::_, testing::_, testing::_))
+            .WillRepeatedly(testing::Invoke([](const char *, int len, const MessageControl &) { return len; }));
+    auto preview = std::make_shared<MockSRTHandler>("test-stream-id");
+    preview->setStreamParams("#!::r=test-stream-id,qos=preview");
+    EXPECT_CALL(*preview, send(testing::_, testing::_, testing::_)).Times(0);
+    std::atomic<bool> previewClosed{false};
+    EXPECT_CALL(*preview, disconnect()).WillOnce(testing::Invoke([&previewClosed] {
+        previewClosed = true;
+        return true;
+    }));
+
+    session.addSubscribers({standard, preview});
+    EXPECT_TRUE(session.startPublishing());
+
+    // Starved past the grace period, the preview is closed while the standard subscriber stays
+    for (int i = 0; i < 100 && !previewClosed.load(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    EXPECT_TRUE(previewClosed.load());
+    EXPECT_EQ(session.getUsage().subscribers, 1u);
+
+    EXPECT_CALL(*publisherHandler, disconnect()).Times(1);
+    EXPECT_CALL(*standard, disconnect()).Times(1);
+    session.cleanupSession();
+}
+
+TEST_F(StreamSessionTest, OverloadShedsAndDisconnectsPacedBestEffort) {
+    auto mockEventListener = std::make_shared<MockStreamEventListener>();
+    PacingSettings pacingSettings;
+    pacingSettings.enabledByDefault = true;
+    auto pacer = std::make_shared<SubscriberPacer>(pacingSettings);
+    SessionContext context;
+    context.pacer = pacer;
+    context.qos.overloadDisconnect = std::chrono::milliseconds(20);
+    StreamSessionTestHelper session(publisherHandler, mockEventListener, context);
+    session.setOverloaded(true);
+
+    const char testData[] = "some test data";
+    publisherHandler->expectReceivingData(testData, strlen(testData));
+
+    // Nothing is queued for the paced preview, so it adds nothing to the buffered bytes
+    auto preview = std::make_shared<MockSRTHandler>("test-stream-id");
+    preview->setStreamParams("#!::r=test-stream-id,qos=preview");
+    EXPECT_CALL(*preview, send(testing::_, testing::_, testing::_)).Times(0);
+    std::atomic<bool> previewClosed{false};
+    EXPECT_CALL(*preview, disconnect()).WillOnce(testing::Invoke([&previewClosed] {
+        previewClosed = true;
+        return true;
+    }));
+
+    session.addSubscriber(preview);
+    EXPECT_TRUE(session.startPublishing());
+
+    for (int i = 0; i < 100 && !previewClosed.load(); ++i) {
+        EXPECT_EQ(session.getUsage().bufferedBytes, 0u);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    EXPECT_TRUE(previewClosed.load());
+    EXPECT_EQ(session.getUsage().subscribers, 0u);
+    EXPECT_GT(session.getShedPackets(QosClass::BestEffort), 0u);
+
+    EXPECT_CALL(*publisherHandler, disconnect()).Times(1);
+    session.cleanupSession();
+    pacer->stop();
+}
+
+TEST_F(StreamSessionTest, AppliedTuningReachesRunningSession) {
+    auto mockEventListener = std::make_shared<MockStreamEventListener>();
+    StreamSessionTestHelper session(publisherHandler, mockEventListener);
+    session.setOverloaded(true);
+
+    const char testData[] = "some test data";
+    publisherHandler->expectReceivingData(testData, strlen(testData));
+
+    // A standard subscriber keeps receiving while the session is overloaded...
+    auto subscriber = std::make_shared<MockSRTHandler>("test-stream-id");
+    std::atomic<int> packets{0};
+    EXPECT_CALL(*subscriber, send(testing::_, testing::_, testing::_))
+            .WillRepeatedly(testing::Invoke([&packets](const char *, int len, const MessageControl &) {
+                ++packets;
+                return len;
+            }));
+    session.addSubscriber(subscriber);
+    EXPECT_TRUE(session.startPublishing());
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_GT(packets.load(), 0);
+
+    // ...until a reload makes best effort the default class, then it is shed
+    QosSettings qos;
+    qos.defaultClass = QosClass::BestEffort;
+    session.applyTuning(FanoutSettings(), qos);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    int packetsAfterReload = packets.load();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(packets.load(), packetsAfterReload);
+
+    EXPECT_CALL(*publisherHandler, disconnect()).Times(1);
+    EXPECT_CALL(*subscriber, disconnect()).Times(1);
+    session.cleanupSession();
+}
+
+TEST_F(StreamSessionTest, FilteredSubscribersShareRepackedPayloads) {
+    auto mockEventListener = std::make_shared<MockStreamEventListener>();
+    StreamSessionTestHelper session(publisherHandler, mockEventListener);
+
+    // Seven packets per message, alternating PIDs 256 and 257
+    std::string message;
+    for (int i = 0; i < 7; ++i) {
+        std::string packet(188, '\xff');
+        packet[0] = 0x47;
+        packet[1] = 0x01;
+        packet[2] = static_cast<char>(i % 2);
+        message += packet;
+    }
+    EXPECT_CALL(*publisherHandler, receive(testing::_, testing::_, testing::_))
+            .WillRepeatedly(testing::Invoke([&message](char *buffer, int, MessageControl &) {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+                memcpy(buffer, message.data(), message.size());
+                return static_cast<int>(message.size());
+            }));
+
+    std::atomic<int> filteredBytes{0};
+    std::atomic<int> wrongPid{0};
+    std::vector<std::shared_ptr<MockSRTHandler> > filtered;
+    for (const char *pids: {"256", "0x100"}) {
+        auto subscriber = std::make_shared<MockSRTHandler>("test-stream-id");
+        subscriber->setStreamParams(std::string("#!::r=test-stream-id,pids=") + pids);
+        EXPECT_CALL(*subscriber, send(testing::_, testing::_, testing::_))
+                .WillRepeatedly(testing::Invoke([&](const char *data, int len, const MessageControl &) {
+                    for (int offset = 0; offset < len; offset += 188) {
+                        if (static_cast<uint8_t>(data[offset + 2]) != 0) {
+                            ++wrongPid;
+                        }
+                    }
+                    filteredBytes += len;
+                    return len;
+                }));
+        EXPECT_CALL(*subscriber, disconnect()).Times(1);
+        filtered.push_back(subscriber);
+    }
+    std::atomic<int> fullBytes{0};
+    EXPECT_CALL(*subscriberHandler, send(testing::_, testing::_, testing::_))
+            .WillRepeatedly(testing::Invoke([&fullBytes](const char *, int len, const MessageControl &) {
+                fullBytes += len;
+                return len;
+            }));
+
+    session.addSubscribers({filtered[0], filtered[1], subscriberHandler});
+    EXPECT_TRUE(session.startPublishing());
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    EXPECT_CALL(*publisherHandler, disconnect()).Times(1);
+    EXPECT_CALL(*subscriberHandler, disconnect()).Times(1);
+    session.cleanupSession();
+
+    EXPECT_EQ(wrongPid.load(), 0);
+    EXPECT_GT(filteredBytes.load(), 0);
+    // Each filtered subscriber gets about four of every seven packets
+    EXPECT_LT(filteredBytes.load(), fullBytes.load() * 2);
+}
+
+TEST_F(StreamSessionTest, FilteredSubscribersKeepTheirQosClass) {
+    auto mockEventListener = std::make_shared<MockStreamEventListener>();
+    StreamSessionTestHelper session(publisherHandler, mockEventListener);
+    session.setOverloaded(true);
+
+    // A full payload of PID 256 per message
+    std::string message;
+    for (int i = 0; i < 7; ++i) {
+        std::string packet(188, '\xff');
+        packet[0] = 0x47;
+        packet[1] = 0x01;
+        packet[2] = 0x00;
+        message += packet;
+    }
+    EXPECT_CALL(*publisherHandler, receive(testing::_, testing::_, testing::_))
+            .WillRepeatedly(testing::Invoke([&message](char *buffer, int, MessageControl &) {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+                memcpy(buffer, message.data(), message.size());
+                return static_cast<int>(message.size());
+            }));
+
+    auto standard = std::make_shared<MockSRTHandler>("test-stream-id");
+    standard->setStreamParams("#!::r=test-stream-id,pids=256");
+    std::atomic<int> standardPackets{0};
+    EXPECT_CALL(*standard, send(testing::_, testing::_, testing::_))
+            .WillRepeatedly(testing::Invoke([&standardPackets](const char *, int len, const MessageControl &) {
+                ++standardPackets;
+                return len;
+            }));
+    // Same filter, but best effort: an overloaded session sheds it like an unfiltered preview
+    auto preview = std::make_shared<MockSRTHandler>("test-stream-id");
+    preview->setStreamParams("#!::r=test-stream-id,pids=256,qos=preview");
+    EXPECT_CALL(*preview, send(testing::_, testing::_, testing::_)).Times(0);
+
+    session.addSubscribers({standard, preview});
+    EXPECT_TRUE(session.startPublishing());
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    EXPECT_CALL(*publisherHandler, disconnect()).Times(1);
+    EXPECT_CALL(*standard, disconnect()).Times(1);
+    EXPECT_CALL(*preview, disconnect()).Times(1);
+    session.cleanupSession();
+
+    EXPECT_GT(standardPackets.load(), 0);
+    EXPECT_GT(session.getShedPackets(QosClass::BestEffort), 0u);
+}
+
+namespace {
+    // Stands in for a connection the server accepted just now
+    class AcceptedMockHandler : public MockSRTHandler {
+    public:
+        AcceptedMockHandler() : MockSRTHandler("test-stream-id"), m_acceptedAt(std::chrono::steady_clock::now()) {
+        }
+
+        std::chrono::steady_clock::time_point getAcceptedAt() const override { return m_acceptedAt; }
+
+    private:
+        std::chrono::steady_clock::time_point m_acceptedAt;
+    };
+
+    std::vector<std::string> stageNames(const std::vector<StageLatency> &stages) {
+        std::vector<std::string> names;
+        for (const auto &stage: stages) {
+            EXPECT_EQ(stage.count, 1);
+            names.push_back(stage.stage);
+        }
+        return names;
+    }
+}
+
+TEST_F(StreamSessionTest, RecordsStartupOfAcceptedConnectionsOnPooledThread) {
+    auto mockEventListener = std::make_shared<MockStreamEventListener>();
+    auto publisher = std::make_shared<AcceptedMockHandler>();
+    auto subscriber = std::make_shared<AcceptedMockHandler>();
+    SessionContext context;
+    context.startup = std::make_shared<StartupLatency>();
+    context.threads = std::make_shared<WarmThreadPool>();
+    StreamSessionTestHelper session(publisher, mockEventListener, context);
+
+    const char testData[] = "some test data";
+    publisher->expectReceivingData(testData, strlen(testData));
+    subscriber->expectSendingData(testData, strlen(testData));
+
+    EXPECT_TRUE(session.startPublishing());
+    session.addSubscriber(subscriber);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+    EXPECT_CALL(*publisher, disconnect()).Times(1);
+    EXPECT_CALL(*subscriber, disconnect()).Times(1);
+    session.cleanupSession();
+    EXPECT_EQ(session.getPublisherThread(), nullptr);
+
+    // Recorded once each, however many packets followed
+    StartupStatus stats = context.startup->getStats();
+    EXPECT_THAT(stageNames(stats.publisher), testing::ElementsAre("thread_start", "first_data", "total"));
+    EXPECT_THAT(stageNames(stats.subscriber), testing::ElementsAre("first_data", "total"));
+}
@@ -0,0 +1,156 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+
+#include <core/SubscriberPacer.h>
+
+#include "MockSRTHandler.h"
+
+class SubscriberPacerTest : public ::testing::Test {
+protected:
+    std::shared_ptr<MockSRTHandler> subscriberHandler;
+    std::atomic<int> packetsSent{0};
+
+    void SetUp() override {
+        subscriberHandler = std::make_shared<MockSRTHandler>("test-stream-id");
+    }
+
+    void TearDown() override {
+        subscriberHandler.reset();
+    }
+
+    void expectCountedSends() {
+        EXPECT_CALL(*subscriberHandler, send(testing::_, testing::_, testing::_))
+                .WillRepeatedly(testing::Invoke([this](const char *, int len, const MessageControl &) {
+                    ++packetsSent;
+                    return len;
+                }));
+    }
+
+    static std::shared_ptr<const StreamPacket> makePacket(int size) {
+        auto packet = std::make_shared<StreamPacket>();
+        packet->data.assign(size, 'x');
+        packet->receivedAt = std::chrono::steady_clock::now();
+        return packet;
+    }
+};
+
+TEST_F(SubscriberPacerTest, UnpacedSubscriberSendsImmediately) {
+    expectCountedSends();
+    SubscriberPacer pacer;
+    auto pacedSubscriber = std::make_shared<PacedSubscriber>(subscriberHandler);
+    pacer.registerSubscriber(pacedSubscriber);
+
+    for (int i = 0; i < 20; ++i) {
+        EXPECT_TRUE(pacedSubscriber->enqueue(makePacket(1000), 100));
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(packetsSent.load(), 20);
+    EXPECT_EQ(pacedSubscriber->getQueuedPackets(), 0);
+
+    pacer.stop();
+}
+
+TEST_F(SubscriberPacerTest, PacedSubscriberSpreadsBurst) {
+    expectCountedSends();
+    SubscriberPacer pacer;
+    auto pacedSubscriber = std::make_shared<PacedSubscriber>(subscriberHandler);
+    // 20 packets of 1000 bytes at 100 kB/s take ~200ms to drain
+    pacedSubscriber->setRate(100000);
+    pacer.registerSubscriber(pacedSubscriber);
+
+    for (int i = 0; i < 20; ++i) {
+        EXPECT_TRUE(pacedSubscriber->enqueue(makePacket(1000), 100));
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_GT(packetsSent.load(), 0);
+    EXPECT_LT(packetsSent.load(), 20);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(400));
+    EXPECT_EQ(packetsSent.load(), 20);
+
+    pacer.stop();
+}
+
+TEST_F(SubscriberPacerTest, QueueOverflowIsRejected) {
+    auto pacedSubscriber = std::make_shared<PacedSubscriber>(subscriberHandler);
+
+    EXPECT_TRUE(pacedSubscriber->enqueue(makePacket(1000), 2));
+    EXPECT_TRUE(pacedSubscriber->enqueue(makePacket(1000), 2));
+    EXPECT_FALSE(pacedSubscriber->enqueue(makePacket(1000), 2));
+}
+
+TEST_F(SubscriberPacerTest, SendFailureMarksSubscriberFailed) {
+    EXPECT_CALL(*subscriberHandler, send(testing::_, testing::_, testing::_))
+            .WillRepeatedly(testing::Return(STREAM_ERROR));
+    SubscriberPacer pacer;
+    auto pacedSubscriber = std::make_shared<PacedSubscriber>(subscriberHandler);
+    pacer.registerSubscriber(pacedSubscriber);
+
+    EXPECT_TRUE(pacedSubscriber->enqueue(makePacket(1000), 100));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_TRUE(pacedSubscriber->hasFailed());
+    EXPECT_FALSE(pacedSubscriber->enqueue(makePacket(1000), 100));
+
+    pacer.stop();
+}
+
+TEST_F(SubscriberPacerTest, StalledSubscriberDoesNotDelayOthers) {
+    expectCountedSends();
+    auto stalledHandler = std::make_shared<MockSRTHandler>("stalled-stream-id");
+    std::atomic<bool> nonBlocking{false};
+    std::atomic<int> stalledAttempts{0};
+    EXPECT_CALL(*stalledHandler, setNonBlockingSend())
+            .WillOnce(testing::Invoke([&nonBlocking]() { nonBlocking = true; }));
+    // A viewer whose send buffer is full: a blocking send would hold the pacer thread for 200ms
+    EXPECT_CALL(*stalledHandler, send(testing::_, testing::_, testing::_))
+            .WillRepeatedly(testing::Invoke([&](const char *, int len, const MessageControl &) {
+                ++stalledAttempts;
+                if (nonBlocking) {
+                    return STREAM_WOULD_BLOCK;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(200));
+                return len;
+            }));
+
+    SubscriberPacer pacer;
+    auto stalledSubscriber = std::make_shared<PacedSubscriber>(stalledHandler);
+    auto pacedSubscriber = std::make_shared<PacedSubscriber>(subscriberHandler);
+    pacer.registerSubscriber(stalledSubscriber);
+    pacer.registerSubscriber(pacedSubscriber);
+
+    for (int i = 0; i < 20; ++i) {
+        EXPECT_TRUE(stalledSubscriber->enqueue(makePacket(1000), 100));
+        EXPECT_TRUE(pacedSubscriber->enqueue(makePacket(1000), 100));
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_EQ(packetsSent.load(), 20);
+    EXPECT_GT(stalledAttempts.load(), 0);
+    // The stalled subscriber keeps its backlog for the next tick instead of failing
+    EXPECT_FALSE(stalledSubscriber->hasFailed());
+    EXPECT_EQ(stalledSubscriber->getQueuedPackets(), 20);
+
+    pacer.stop();
+}
@@ -0,0 +1,134 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+
+#include <utils/TimerWheel.h>
+
+TEST(TimerWheelTest, OneShotTimerFiresOnce) {
+    TimerWheel wheel(std::chrono::milliseconds(1));
+    std::atomic<int> fired{0};
+
+    wheel.schedule(std::chrono::milliseconds(20), [&fired] { ++fired; });
+    EXPECT_EQ(wheel.getStats().activeTimers, 1);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(fired.load(), 1);
+    EXPECT_EQ(wheel.getStats().activeTimers, 0);
+    EXPECT_EQ(wheel.getStats().firedTimers, 1);
+}
+
+TEST(TimerWheelTest, NeverFiresEarly) {
+    TimerWheel wheel(std::chrono::milliseconds(5));
+    auto scheduledAt = std::chrono::steady_clock::now();
+    std::atomic<int64_t> elapsedMs{-1};
+
+    wheel.schedule(std::chrono::milliseconds(30), [&elapsedMs, scheduledAt] {
+        elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - scheduledAt).count();
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    EXPECT_GE(elapsedMs.load(), 30);
+}
+
+TEST(TimerWheelTest, CancelledTimerDoesNotFire) {
+    TimerWheel wheel(std::chrono::milliseconds(1));
+    std::atomic<int> fired{0};
+
+    auto id = wheel.schedule(std::chrono::milliseconds(20), [&fired] { ++fired; });
+    EXPECT_TRUE(wheel.cancel(id));
+    EXPECT_FALSE(wheel.cancel(id));
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    EXPECT_EQ(fired.load(), 0);
+    EXPECT_EQ(wheel.getStats().activeTimers, 0);
+}
+
+TEST(TimerWheelTest, StaleIdDoesNotCancelReusedSlot) {
+    TimerWheel wheel(std::chrono::milliseconds(1));
+    std::atomic<int> fired{0};
+
+    auto first = wheel.schedule(std::chrono::seconds(10), [] {});
+    EXPECT_TRUE(wheel.cancel(first));
+    wheel.schedule(std::chrono::milliseconds(10), [&fired] { ++fired; });
+
+    EXPECT_FALSE(wheel.cancel(first));
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    EXPECT_EQ(fired.load(), 1);
+}
+
+TEST(TimerWheelTest, RepeatingTimerKeepsFiringUntilCancelled) {
+    TimerWheel wheel(std::chrono::milliseconds(1));
+    std::atomic<int> fired{0};
+
+    auto id = wheel.scheduleRepeating(std::chrono::milliseconds(10), [&fired] { ++fired; });
+    std::this_thread::sleep_for(std::chrono::milliseconds(105));
+    EXPECT_TRUE(wheel.cancel(id));
+    int firedBeforeCancel = fired.load();
+
+    EXPECT_GE(firedBeforeCancel, 5);
+    EXPECT_LE(firedBeforeCancel, 11);
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    EXPECT_EQ(fired.load(), firedBeforeCancel);
+}
+
+TEST(TimerWheelTest, TimersBeyondFirstLevelCascadeDown) {
+    TimerWheel wheel(std::chrono::milliseconds(1));
+    std::vector<int> order;
+    std::mutex orderMutex;
+    auto record = [&order, &orderMutex](int value) {
+        return [&order, &orderMutex, value] {
+            std::lock_guard<std::mutex> lock(orderMutex);
+            order.push_back(value);
+        };
+    };
+
+    // 300 and 600 ticks land in the second level, 70000 in the third
+    wheel.schedule(std::chrono::milliseconds(600), record(3));
+    wheel.schedule(std::chrono::milliseconds(300), record(2));
+    wheel.schedule(std::chrono::milliseconds(70000), record(4));
+    wheel.schedule(std::chrono::milliseconds(5), record(1));
+    wheel.stop();
+
+    // Drive the wheel by hand, well past every due time
+    auto start = std::chrono::steady_clock::now();
+    wheel.advance(start + std::chrono::milliseconds(299));
+    EXPECT_EQ(order, std::vector<int>({1}));
+    wheel.advance(start + std::chrono::milliseconds(800));
+    EXPECT_EQ(order, std::vector<int>({1, 2, 3}));
+    wheel.advance(start + std::chrono::milliseconds(70100));
+    EXPECT_EQ(order, std::vector<int>({1, 2, 3, 4}));
+    EXPECT_EQ(wheel.getStats().firedTimers, 4);
+}
+
+TEST(TimerWheelTest, CallbacksMayScheduleTimers) {
+    TimerWheel wheel(std::chrono::milliseconds(1));
+    std::atomic<int> fired{0};
+
+    wheel.schedule(std::chrono::milliseconds(5), [&wheel, &fired] {
+        ++fired;
+        wheel.schedule(std::chrono::milliseconds(5), [&fired] { ++fired; });
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    EXPECT_EQ(fired.load(), 2);
+}
@@ -0,0 +1,83 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <utils/UdpOutput.h>
+
+class UdpOutputTest : public ::testing::Test {
+protected:
+    // Sends count packets through an output to address and returns how many the receiver got
+    static int sendAndCount(UdpSocket &receiver, const std::string &destination, const UdpOutputSettings &settings,
+                            int count) {
+        auto output = UdpOutput::create("test-stream-id", destination, settings);
+        EXPECT_NE(output, nullptr);
+        if (!output) {
+            return 0;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            std::string payload = "packet " + std::to_string(i);
+            EXPECT_TRUE(output->write(payload.data(), static_cast<int>(payload.size()), MessageControl()));
+        }
+
+        int received = 0;
+        char buffer[1500];
+        while (received < count && receiver.receive(buffer, sizeof(buffer), std::chrono::milliseconds(500)) > 0) {
+            ++received;
+        }
+        output->close();
+        return received;
+    }
+};
+
+TEST_F(UdpOutputTest, UnicastReceiverGetsEveryPacket) {
+    UdpSocket receiver;
+    ASSERT_TRUE(receiver.bind("127.0.0.1:0")) << receiver.getLastErrorMessage();
+    std::string destination = "127.0.0.1:" + std::to_string(receiver.getLocalPort());
+
+    EXPECT_EQ(sendAndCount(receiver, destination, UdpOutputSettings(), 100), 100);
+}
+
+TEST_F(UdpOutputTest, LoopbackMulticastReceiverGetsPackets) {
+    const std::string group = "239.255.42.42:15042";
+    UdpSocket receiver;
+    if (!receiver.bind(group)) {
+        GTEST_SKIP() << "Multicast not available: " << receiver.getLastErrorMessage();
+    }
+
+    UdpOutputSettings settings;
+    settings.multicastLoopback = true;
+    EXPECT_EQ(sendAndCount(receiver, group, settings, 20), 20);
+}
+
+TEST_F(UdpOutputTest, ClosedOutputRefusesWrites) {
+    UdpSocket receiver;
+    ASSERT_TRUE(receiver.bind("127.0.0.1:0"));
+    auto output = UdpOutput::create("test-stream-id", "127.0.0.1:" + std::to_string(receiver.getLocalPort()),
+                                    UdpOutputSettings());
+    ASSERT_NE(output, nullptr);
+
+    output->close();
+    EXPECT_FALSE(output->write("data", 4, MessageControl()));
+}
+
+TEST_F(UdpOutputTest, InvalidDestinationFails) {
+    EXPECT_EQ(UdpOutput::create("test-stream-id", "not-an-address", UdpOutputSettings()), nullptr);
+}
@@ -0,0 +1,123 @@
+/*
+ * dl_srt_server
+ * Copyright (C) 2024 DragN Life LLC (Adam B)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <future>
+#include <stdexcept>
+
+#include <utils/WarmThreadPool.h>
+
+namespace {
+    template<typename Condition>
+    bool waitFor(Condition condition, std::chrono::milliseconds timeout = std::chrono::milliseconds(2000)) {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (!condition()) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return true;
+    }
+}
+
+TEST(WarmThreadPoolTest, JobsTakeParkedThreadsAndAreReplaced) {
+    PrewarmSettings settings;
+    settings.sessionThreads = 2;
+    WarmThreadPool pool(settings);
+    EXPECT_EQ(pool.getIdleCount(), 2u);
+
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    auto job = pool.run([released] { released.wait(); });
+
+    EXPECT_TRUE(waitFor([&job] { return job->getThreadId() != std::thread::id(); }));
+    EXPECT_NE(job->getThreadId(), std::this_thread::get_id());
+
+    // A parked thread refills the pool while the job runs
+    EXPECT_TRUE(waitFor([&pool] { return pool.getThreadCount() == 3; }));
+    EXPECT_EQ(pool.getIdleCount(), 2u);
+
+    release.set_value();
+    job->wait();
+
+    // The finished thread parks again, the next job doesn't create one
+    EXPECT_TRUE(waitFor([&pool] { return pool.getIdleCount() == 3; }));
+    pool.run([] {})->wait();
+    EXPECT_EQ(pool.getThreadCount(), 3u);
+}
+
+TEST(WarmThreadPoolTest, ThreadsAboveIdleLimitExit) {
+    PrewarmSettings settings;
+    settings.sessionThreads = 0;
+    settings.maxIdleThreads = 1;
+    WarmThreadPool pool(settings);
+
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::vector<std::shared_ptr<PooledJob> > jobs;
+    for (int i = 0; i < 3; ++i) {
+        jobs.push_back(pool.run([released] { released.wait(); }));
+    }
+    EXPECT_EQ(pool.getThreadCount(), 3u);
+    for (const auto &job: jobs) {
+        EXPECT_TRUE(waitFor([&job] { return job->getThreadId() != std::thread::id(); }));
+    }
+
+    release.set_value();
+    for (const auto &job: jobs) {
+        job->wait();
+    }
+    EXPECT_TRUE(waitFor([&pool] { return pool.getThreadCount() == 1; }));
+    EXPECT_EQ(pool.getIdleCount(), 1u);
+}
+
+TEST(WarmThreadPoolTest, JobMayReleaseTheLastReference) {
+    auto pool = std::make_shared<WarmThreadPool>();
+    std::weak_ptr<WarmThreadPool> weakPool = pool;
+    std::atomic<bool> ran{false};
+
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    auto job = pool->run([owner = pool, released, &ran] {
+        released.wait();
+        ran = true;
+    });
+    pool.reset();
+    release.set_value();
+    job->wait();
+
+    EXPECT_TRUE(ran);
+    EXPECT_TRUE(waitFor([&weakPool] { return weakPool.expired(); }));
+}
+
+TEST(WarmThreadPoolTest, ThrowingJobIsStillDone) {
+    WarmThreadPool pool;
+    auto job = pool.run([] {
+        throw std::runtime_error("publisher loop failed");
+    });
+    job->wait();
+
+    // The thread survives the job and takes the next one
+    std::atomic<bool> ran{false};
+    pool.run([&ran] { ran = true; })->wait();
+    EXPECT_TRUE(ran);
+}